@@ -6,10 +6,18 @@
 
 #pragma once
 
-#include "driver/rmt.h"
-#include "pwe_io_spi.h"
+#include "sdkconfig.h"
 #include "esp_err.h"
 #include "pwe.h"
+#include "pwe_io_sim.h"
+#include "dshot_erpm.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "freertos/FreeRTOS.h"
+#include "driver/rmt.h"
+#include "driver/timer.h"
+#include "pwe_io_rmt.h"
+#include "pwe_io_spi.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -106,8 +114,88 @@ typedef enum {
 
 typedef struct dshot_s dshot_t;
 
+/**
+ * @brief Storage taken by the dshot handle itself, not counting PWE backend
+ */
+#define DSHOT_HANDLE_SIZE   sizeof(dshot_t)
+
+#if !CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief Storage required by dshot_pwe_rmt_init_static()
+ *
+ * @param flags: flags of pwe_config_t
+ */
+#define DSHOT_PWE_RMT_STORAGE_SIZE(flags)   (PWE_STORAGE_ALIGN_UP(DSHOT_HANDLE_SIZE) + PWE_RMT_STORAGE_SIZE(16, flags))
+
+/**
+ * @brief Storage required by dshot_pwe_spi_init_static(), enough for any timing
+ *
+ * @param flags: flags of pwe_config_t
+ */
+#define DSHOT_PWE_SPI_STORAGE_SIZE(flags)   \
+    (PWE_STORAGE_ALIGN_UP(DSHOT_HANDLE_SIZE) + PWE_SPI_STORAGE_SIZE(16, PWE_IO_SPI_MAX_SLOTS_PER_BIT, flags))
+#endif
+
 typedef dshot_t *dshot_handle_t;
 
+/**
+ * @brief Create Dshot instance on a simulated PWE interface, see pwe_new_sim_backend()
+ *
+ * @param pwe_conf: pwe configuration
+ * @param sim_conf: simulation configuration
+ * @param hdl: created dshot instance
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_new_pwe_sim(const pwe_config_t *pwe_conf, const pwe_io_sim_config_t *sim_conf, dshot_handle_t *hdl);
+
+/**
+ * @brief Create Dshot instance sending the frames of dshot_new_pwe_rmt_bidir() on a simulated PWE interface
+ *
+ * Checksum is inverted and the line idles high, sim_conf->invert being forced. Nothing answers on the line, so no
+ * eRPM is ever decoded. Delete with dshot_del_pwe_sim().
+ *
+ * @param pwe_conf: pwe configuration
+ * @param sim_conf: simulation configuration
+ * @param hdl: created dshot instance
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_new_pwe_sim_bidir(const pwe_config_t *pwe_conf, const pwe_io_sim_config_t *sim_conf, dshot_handle_t *hdl);
+
+/**
+ * @brief Delete Dshot instance created by dshot_new_pwe_sim()
+ *
+ * @param hdl: dshot instance
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_del_pwe_sim(dshot_handle_t hdl);
+
+/**
+ * @brief Get PWE interface of a Dshot instance, such as to read back the waveform of a simulated one
+ *
+ * @param hdl: dshot instance
+ * @param pwe: filled with PWE handle
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_get_pwe_handle(dshot_handle_t hdl, pwe_handle_t *pwe);
+
+/**
+ * @brief Send latest message set by dshot_update() once, which is what the periodic output does each interval
+ *
+ * Converts the message into outgoing buffer only when it changed since last send. Frames go out one at a time: this
+ * may be called from several tasks and while periodic output runs, a caller sleeps until the frame being sent is done.
+ *
+ * @param hdl: dshot instance
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_STATE: continuous output running, or driven by a group
+ */
+esp_err_t dshot_send(dshot_handle_t hdl);
+
+#if !CONFIG_IDF_TARGET_LINUX
 /**
  * @brief Create Dshot instance from given pwe configuration
  *
@@ -128,6 +216,53 @@ esp_err_t dshot_new_pwe_rmt(const pwe_config_t *pwe_conf, const rmt_config_t *rm
  */
 esp_err_t dshot_del_pwe_rmt(dshot_handle_t hdl);
 
+/**
+ * @brief Create bidirectional Dshot instance, reading eRPM telemetry from the ESC after each frame
+ *
+ * Frames are inverted, the line idling high, and the pin turns open drain with pull-up so that the ESC can answer on
+ * it. Replies are captured by a second RMT channel on the same pin and decoded before next frame, see dshot_get_erpm().
+ * The ESC starts answering once it sees inverted frames, DShot_cmd_signal_line_continuous_erpm_telemetry is not needed.
+ * Delete with dshot_del_pwe_rmt().
+ *
+ * @param pwe_conf: pwe configuration
+ * @param rmt_conf: rmt config of frames
+ * @param rx_channel: RMT channel capturing replies, must be able to receive
+ * @param hdl: created dshot instance
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: rx_channel is the channel of frames
+ */
+esp_err_t dshot_new_pwe_rmt_bidir(const pwe_config_t *pwe_conf, const rmt_config_t *rmt_conf, rmt_channel_t rx_channel, dshot_handle_t *hdl);
+
+/**
+ * @brief Get eRPM of the motor from the reply to last frame of a bidirectional instance
+ *
+ * @param hdl: dshot instance created by dshot_new_pwe_rmt_bidir()
+ * @param erpm: filled with electrical RPM of latest valid reply, 0 if none yet. See dshot_erpm_to_rpm()
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NOT_FOUND: no valid reply to last frame, erpm is from an older one
+ *      ESP_ERR_INVALID_STATE: instance is not bidirectional
+ */
+esp_err_t dshot_get_erpm(dshot_handle_t hdl, uint32_t *erpm);
+
+/**
+ * @brief Create Dshot instance on RMT in caller provided storage, without allocating from heap
+ *
+ * Same as dshot_new_pwe_rmt() otherwise. The storage must stay valid until dshot_del_pwe_rmt() is called,
+ * which does not free it.
+ *
+ * @param pwe_conf: pwe configuration
+ * @param rmt_conf: rmt config
+ * @param storage: memory for the instance and its PWE backend, aligned to PWE_STATIC_STORAGE_ALIGN
+ * @param storage_size: size of storage, at least DSHOT_PWE_RMT_STORAGE_SIZE(pwe_conf->flags)
+ * @param hdl: created dshot instance
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_SIZE: storage too small or misaligned
+ */
+esp_err_t dshot_pwe_rmt_init_static(const pwe_config_t *pwe_conf, const rmt_config_t *rmt_conf, void *storage, size_t storage_size, dshot_handle_t *hdl);
+
 /**
  * @brief Create Dshot instance from given pwe configuration
  *
@@ -149,7 +284,74 @@ esp_err_t dshot_new_pwe_spi(const pwe_config_t *pwe_conf, const pwe_io_spi_confi
 esp_err_t dshot_del_pwe_spi(dshot_handle_t hdl);
 
 /**
- * @brief Start Dshot output
+ * @brief Create Dshot instance on SPI in caller provided storage, without allocating from heap
+ *
+ * Same as dshot_new_pwe_spi() otherwise. The storage must stay valid until dshot_del_pwe_spi() is called,
+ * which does not free it.
+ *
+ * @param pwe_conf: pwe configuration
+ * @param spi_conf: spi config
+ * @param storage: memory for the instance and its PWE backend, DMA capable and aligned to PWE_STATIC_STORAGE_ALIGN
+ * @param storage_size: size of storage, at least DSHOT_PWE_SPI_STORAGE_SIZE(pwe_conf->flags)
+ * @param hdl: created dshot instance
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_SIZE: storage too small or misaligned
+ */
+esp_err_t dshot_pwe_spi_init_static(const pwe_config_t *pwe_conf, const pwe_io_spi_config_t *spi_conf, void *storage, size_t storage_size, dshot_handle_t *hdl);
+
+typedef enum {
+    DSHOT_DISPATCH_TIMER_TASK,  /*!< esp_timer callback from esp_timer task, delayed by other timers and higher priority tasks */
+    DSHOT_DISPATCH_HW_TIMER,    /*!< hardware timer interrupt wakes a dedicated sender task */
+} dshot_dispatch_t;
+
+typedef struct {
+    uint32_t interval_us;       /*!< Interval between frames */
+    dshot_dispatch_t dispatch;  /*!< What triggers each frame */
+    timer_group_t timer_group;  /*!< Hardware timer, DSHOT_DISPATCH_HW_TIMER only */
+    timer_idx_t timer_idx;
+    UBaseType_t task_priority;  /*!< Sender task, DSHOT_DISPATCH_HW_TIMER only */
+    int core_id;                /*!< Core of sender task, -1 for any */
+    uint32_t hist_bin_us;       /*!< Width of jitter histogram bins, 0 for 1us */
+} dshot_output_config_t;
+
+#define DSHOT_OUTPUT_CONFIG_DEFAULT(interval)   \
+    {                                           \
+        .interval_us = (interval),              \
+        .dispatch = DSHOT_DISPATCH_TIMER_TASK,  \
+        .timer_group = TIMER_GROUP_0,           \
+        .timer_idx = TIMER_0,                   \
+        .task_priority = 0,                     \
+        .core_id = -1,                          \
+        .hist_bin_us = 1,                       \
+    }
+
+/* above esp_timer task, so that other timer callbacks do not delay frames */
+#define DSHOT_OUTPUT_CONFIG_HW_TIMER(interval, group, idx)  \
+    {                                                       \
+        .interval_us = (interval),                          \
+        .dispatch = DSHOT_DISPATCH_HW_TIMER,                \
+        .timer_group = (group),                             \
+        .timer_idx = (idx),                                 \
+        .task_priority = configMAX_PRIORITIES - 2,          \
+        .core_id = -1,                                      \
+        .hist_bin_us = 1,                                   \
+    }
+
+#define DSHOT_JITTER_HIST_BINS  32
+
+typedef struct {
+    uint32_t frames;            /*!< Frames sent by periodic output */
+    uint32_t skipped;           /*!< Ticks that sent no frame, from intervals spanning several periods */
+    uint32_t errors;            /*!< Frames failed to send */
+    int32_t min_jitter_us;      /*!< Smallest deviation of an interval from the nearest multiple of interval_us */
+    int32_t max_jitter_us;      /*!< Largest one */
+    uint32_t bin_us;            /*!< Width of hist bins */
+    uint32_t hist[DSHOT_JITTER_HIST_BINS];  /*!< Deviations, bin 16 holding [0, bin_us), the end bins also count everything beyond */
+} dshot_timing_stats_t;
+
+/**
+ * @brief Start Dshot output from esp_timer task, same as dshot_start_with_config() with DSHOT_OUTPUT_CONFIG_DEFAULT()
  *
  * @param hdl: dshot instance
  * @return
@@ -158,17 +360,72 @@ esp_err_t dshot_del_pwe_spi(dshot_handle_t hdl);
 esp_err_t dshot_start(dshot_handle_t hdl, uint32_t interval_us);
 
 /**
- * @brief Stop Dshot output
+ * @brief Start Dshot output, disarming the ESC first
+ *
+ * Each frame is time stamped as it is sent, intervals between them go into the timing stats.
  *
  * @param hdl: dshot instance
+ * @param conf: output configuration
  * @return
  *      ESP_OK
+ *      ESP_ERR_INVALID_STATE: already started, or driven by a group
+ */
+esp_err_t dshot_start_with_config(dshot_handle_t hdl, const dshot_output_config_t *conf);
+
+/**
+ * @brief Start Dshot output at the highest rate the protocol allows, disarming the ESC first
+ *
+ * Frames are sent back to back without any timer or task: each one is started from the RMT TX end interrupt of the
+ * previous one, TRST plus interrupt latency apart: with DShot1200 a frame is 13.3us of bits and 1.7us of TRST. Every
+ * frame carries the latest dshot_update() or a queued command. Only the number of frames is counted in the timing
+ * stats.
+ *
+ * @param hdl: dshot instance created by dshot_new_pwe_rmt() or dshot_pwe_rmt_init_static()
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NOT_SUPPORTED: not RMT backend, bidirectional, or RMT driver configured with ESP_INTR_FLAG_IRAM
+ *      ESP_ERR_INVALID_STATE: already started, or in a group
+ */
+esp_err_t dshot_start_continuous(dshot_handle_t hdl);
+
+/**
+ * @brief Stop Dshot output, periodic or continuous
+ *
+ * @param hdl: dshot instance
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_STATE: not started, or continuous output already stopped by a failed restart
+ *      ESP_ERR_TIMEOUT: last continuous frame not done, still running, call again
  */
 esp_err_t dshot_stop(dshot_handle_t hdl);
 
+/**
+ * @brief Get frame interval statistics of periodic output since start or last reset
+ *
+ * @param hdl: dshot instance
+ * @param stats: filled with statistics
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_get_timing_stats(dshot_handle_t hdl, dshot_timing_stats_t *stats);
+
+/**
+ * @brief Clear frame interval statistics of periodic output
+ *
+ * @param hdl: dshot instance
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_reset_timing_stats(dshot_handle_t hdl);
+
+#endif // !CONFIG_IDF_TARGET_LINUX
+
 /**
  * @brief Send control message to ESC
  *
+ * Wait-free: the frame is taken from a precomputed table and published for the periodic output (or dshot_send()),
+ * which converts it on its next tick. Never waits for an ongoing transmission.
+ *
  * @param pwe: pwe handle
  * @param thrust: 0: disarming, 1~2000 for throttle
  * @param request_telemetry: whether telemetry is requested or not
@@ -177,6 +434,180 @@ esp_err_t dshot_stop(dshot_handle_t hdl);
  */
 esp_err_t dshot_update(dshot_handle_t hdl, uint16_t thrust, bool request_telemetry);
 
+#define DSHOT_CMD_REPEAT_DEFAULT    10  /*!< ESCs act on settings commands only after receiving them 6 times */
+
+/**
+ * @brief Queue a special command, sent instead of throttle by the periodic output (or dshot_send())
+ *
+ * The command goes out in repeat consecutive frames with telemetry bit set, followed by gap_frames frames of
+ * DShot_cmd_motor_stop, such as to give the ESC time to save settings. Throttle set by dshot_update() resumes once
+ * all queued commands are sent. Never blocks.
+ *
+ * @param hdl: dshot instance
+ * @param command: DShot_cmd_motor_stop ~ DShot_cmd_MAX
+ * @param repeat: number of frames carrying the command, see DSHOT_CMD_REPEAT_DEFAULT
+ * @param gap_frames: frames of motor stop after the command
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NO_MEM: queue full, try again once dshot_get_commands_pending() goes down
+ *      ESP_ERR_INVALID_STATE: driven by a group, queue commands with dshot_group_queue_command()
+ *
+ * @note Not reentrant, to be called from a single task
+ */
+esp_err_t dshot_queue_command(dshot_handle_t hdl, dshot_command_t command, uint8_t repeat, uint16_t gap_frames);
+
+/**
+ * @brief Get number of queued commands not fully sent yet, gap included
+ *
+ * @param hdl: dshot instance
+ * @param pending: filled with number of commands
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_get_commands_pending(dshot_handle_t hdl, uint32_t *pending);
+
+#define DSHOT_GROUP_MAX_MOTORS  8
+
+typedef struct dshot_group_s dshot_group_t;
+typedef dshot_group_t *dshot_group_handle_t;
+
+/**
+ * @brief Drive several Dshot instances together, such as the motors of a multirotor
+ *
+ * All frames are encoded in one pass and sent by one timer tick. Motors on RMT join the TX sync group where the
+ * target has it so that frames start at the same time, otherwise they are started back to back.
+ *
+ * @param motors: dshot instances, must not be started by dshot_start() nor sent by dshot_send() while in group
+ * @param num: number of motors, up to DSHOT_GROUP_MAX_MOTORS
+ * @param group: created group
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: a motor is given more than once
+ *      ESP_ERR_INVALID_STATE: a motor is already in another group, or its own output is started
+ */
+esp_err_t dshot_group_new(const dshot_handle_t *motors, uint32_t num, dshot_group_handle_t *group);
+
+/**
+ * @brief Delete Dshot group, its motors can be used alone again
+ *
+ * @param group: dshot group
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_group_del(dshot_group_handle_t group);
+
+/**
+ * @brief Set control messages of all motors at once
+ *
+ * Either every throttle is replaced or none, a tick never sends a mix of old and new ones. Wait-free, neither side
+ * waits for the other.
+ *
+ * @param group: dshot group
+ * @param thrust: one per motor, in the order given to dshot_group_new(). 0: disarming, 1~2000 for throttle
+ * @param telemetry_mask: bit i requests telemetry from motor i
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: a thrust out of range, nothing is updated
+ *
+ * @note Not reentrant, to be called from a single control task
+ */
+esp_err_t dshot_group_update(dshot_group_handle_t group, const uint16_t *thrust, uint32_t telemetry_mask);
+
+/**
+ * @brief Queue a special command for some motors of a group, see dshot_queue_command()
+ *
+ * @param group: dshot group
+ * @param motor_mask: bit i to send the command to motor i
+ * @param command: DShot_cmd_motor_stop ~ DShot_cmd_MAX
+ * @param repeat: number of frames carrying the command
+ * @param gap_frames: frames of motor stop after the command
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NO_MEM: queue of a motor full, nothing is queued
+ *
+ * @note Not reentrant, to be called from a single task. While in the group, this is the only way commands are queued
+ *       for its motors, dshot_queue_command() refuses them
+ */
+esp_err_t dshot_group_queue_command(dshot_group_handle_t group, uint32_t motor_mask, dshot_command_t command, uint8_t repeat,
+                                    uint16_t gap_frames);
+
+/**
+ * @brief Send latest messages of all motors once, which is what the periodic output does each interval
+ *
+ * Same as dshot_send(): may be called from several tasks and while periodic output runs, a caller sleeps until the
+ * frames being sent are done.
+ *
+ * @param group: dshot group
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_group_send(dshot_group_handle_t group);
+
+#if !CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief Start periodic output of all motors from esp_timer task, see dshot_group_start_with_config()
+ *
+ * @param group: dshot group
+ * @param interval_us: interval between frames
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_group_start(dshot_group_handle_t group, uint32_t interval_us);
+
+/**
+ * @brief Start periodic output of all motors from a single timer
+ *
+ * @param group: dshot group
+ * @param conf: output configuration
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_STATE: already started
+ */
+esp_err_t dshot_group_start_with_config(dshot_group_handle_t group, const dshot_output_config_t *conf);
+
+/**
+ * @brief Stop periodic output of all motors
+ *
+ * @param group: dshot group
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_STATE: not started
+ */
+esp_err_t dshot_group_stop(dshot_group_handle_t group);
+
+/**
+ * @brief Get eRPM of all motors, see dshot_get_erpm()
+ *
+ * @param group: dshot group
+ * @param erpm: one per motor, filled with latest valid eRPM, 0 for motors that are not bidirectional
+ * @param valid_mask: bit i set if the reply of motor i to last frame was valid, can be NULL
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_group_get_erpm(dshot_group_handle_t group, uint32_t *erpm, uint32_t *valid_mask);
+
+/**
+ * @brief Get frame interval statistics of periodic group output, see dshot_get_timing_stats()
+ *
+ * @param group: dshot group
+ * @param stats: filled with statistics
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_group_get_timing_stats(dshot_group_handle_t group, dshot_timing_stats_t *stats);
+
+/**
+ * @brief Clear frame interval statistics of periodic group output
+ *
+ * @param group: dshot group
+ * @return
+ *      ESP_OK
+ */
+esp_err_t dshot_group_reset_timing_stats(dshot_group_handle_t group);
+#endif // !CONFIG_IDF_TARGET_LINUX
+
 #ifdef __cplusplus
 }
 #endif
+
+#include "dshot_private/dshot_handle.h"
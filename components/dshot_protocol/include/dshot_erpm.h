@@ -0,0 +1,84 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * eRPM telemetry of bidirectional DShot
+ *
+ * After each frame the ESC answers on the same line, idle high, at 5/4 of the DShot bitrate: a start bit (low) and 20
+ * bits where a level change encodes 1, which are 4 GCR quintets of the 16 bits reply: 3 bits exponent, 9 bits mantissa
+ * of the eRPM period in us, 4 bits inverted checksum.
+ * Decoding works on captured RMT items (duration0, level0, duration1, level1), does not depend on any driver.
+ */
+
+#define DSHOT_ERPM_REPLY_BITS   21
+
+typedef struct {
+    uint32_t bits_per_tick_q16; /*!< Reply bits per capture tick, Q16 */
+} dshot_erpm_decoder_t;
+
+/**
+ * @brief Init decoder for a capture resolution and a DShot bitrate
+ *
+ * @param decoder: decoder to init
+ * @param resolution_hz: tick frequency of the capture
+ * @param dshot_bitrate: bitrate of outgoing frames, e.g. 600000 for DShot600, the reply being 5/4 of it
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: a reply bit shorter than a tick
+ */
+esp_err_t dshot_erpm_decoder_init(dshot_erpm_decoder_t *decoder, uint32_t resolution_hz, uint32_t dshot_bitrate);
+
+/**
+ * @brief Decode one captured reply into eRPM
+ *
+ * Level runs before the start bit are skipped, a zero duration ends the capture. The last run may be cut by the end
+ * of the capture if it is high, the missing bits being high as well. Nothing but high level may follow the reply.
+ *
+ * @param decoder: decoder
+ * @param items: captured RMT items
+ * @param item_num: number of items
+ * @param erpm: filled with electrical RPM, 0 when the motor is stopped
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_SIZE: capture does not hold a reply, or holds more than one
+ *      ESP_ERR_INVALID_RESPONSE: not a GCR code
+ *      ESP_ERR_INVALID_CRC: checksum mismatch
+ */
+esp_err_t dshot_erpm_decode(const dshot_erpm_decoder_t *decoder, const uint32_t *items, size_t item_num, uint32_t *erpm);
+
+/**
+ * @brief Decode the 20 GCR bits of a reply, start bit removed, into eRPM
+ *
+ * @return same as dshot_erpm_decode()
+ */
+esp_err_t dshot_erpm_decode_gcr(uint32_t gcr, uint32_t *erpm);
+
+/**
+ * @brief Mechanical RPM from eRPM
+ *
+ * @param erpm: electrical RPM
+ * @param pole_count: number of magnet poles of the motor
+ */
+static inline uint32_t dshot_erpm_to_rpm(uint32_t erpm, uint32_t pole_count)
+{
+    return pole_count >= 2 ? erpm / (pole_count / 2) : erpm;
+}
+
+#ifdef __cplusplus
+}
+#endif
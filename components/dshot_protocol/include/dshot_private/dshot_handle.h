@@ -0,0 +1,101 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Handle of dshot, not part of public API. Only visible so that DSHOT_HANDLE_SIZE is its real size
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "dshot.h"
+#include "dshot_erpm.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
+#include "esp_timer.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DSHOT_CMD_QUEUE_LEN         8       // power of 2
+
+#ifdef __cplusplus
+// C++ only takes the size of the handle, lock-free atomics have the layout of their plain type
+#define DSHOT_ATOMIC(type)  type
+#else
+#define DSHOT_ATOMIC(type)  _Atomic type
+#endif
+
+#if !CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief Periodic output of a dshot instance or group
+ */
+typedef struct {
+    dshot_output_config_t conf;
+    esp_err_t (*send)(void *arg);   // sends one frame
+    void *arg;
+    esp_timer_handle_t esp_timer;   // DSHOT_DISPATCH_TIMER_TASK, kept once created
+    TaskHandle_t task;              // sender of DSHOT_DISPATCH_HW_TIMER, alive with the hardware timer
+    TaskHandle_t task_waiter;       // notified once sender task exits
+    volatile bool task_exit;
+    bool running;
+    int64_t last_us;                // time stamp of last frame, 0 if none since start
+    portMUX_TYPE stats_lock;
+    dshot_timing_stats_t stats;
+} dshot_output_t;
+#endif
+
+typedef struct {
+    uint8_t command;
+    uint8_t repeat;
+    uint16_t gap_frames;
+} dshot_cmd_t;
+
+struct dshot_s {
+    pwe_handle_t pwe;
+    uint32_t io_buffer_len;
+#if !CONFIG_IDF_TARGET_LINUX
+    dshot_output_t output;
+    StaticSemaphore_t lock_storage;
+    SemaphoreHandle_t lock;     // mutex of sender, outgoing buffer is written and sent under it
+    gpio_num_t gpio;
+    rmt_channel_t rx_channel;   // bidirectional only, captures replies of the ESC
+    RingbufHandle_t rx_ringbuf;
+    dshot_erpm_decoder_t erpm_decoder;
+    bool rx_armed;              // capture started after last frame
+    bool continuous;            // frames chained by RMT TX end, see dshot_start_continuous()
+    uint16_t continuous_frame;  // frame being sent in continuous mode, only touched from RMT interrupt
+#endif
+    DSHOT_ATOMIC(uint32_t) frame;       // published by dshot_update(), read by the sender
+    DSHOT_ATOMIC(uint32_t) erpm;        // latest valid reply
+    DSHOT_ATOMIC(bool) erpm_valid;      // reply to last frame was valid
+    uint16_t converted_frame;   // frame held by outgoing buffer, only touched by the sender
+    uint16_t frame_xor;     // DSHOT_FRAME_CRC_MASK in bidirectional mode, checksum is inverted
+    /* commands, queued by dshot_queue_command(), drained by the sender */
+    dshot_cmd_t cmd_queue[DSHOT_CMD_QUEUE_LEN];
+    DSHOT_ATOMIC(uint32_t) cmd_head;    // queued so far
+    DSHOT_ATOMIC(uint32_t) cmd_tail;    // taken by the sender so far
+    DSHOT_ATOMIC(uint32_t) cmd_done;    // sent so far, gap included
+    uint8_t cmd_command;    // command being sent, only touched by the sender
+    uint8_t cmd_repeat_left;
+    uint16_t cmd_gap_left;
+    bool converted;
+    bool bidirectional;
+    bool static_storage;    // created by dshot_pwe_*_init_static(), not to be freed
+    bool rmt_backend;       // pwe can join RMT TX sync group
+    bool in_group;          // driven by a dshot group
+};
+
+#ifdef __cplusplus
+}
+#endif
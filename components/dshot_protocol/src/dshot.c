@@ -4,44 +4,460 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <stdlib.h>
 #include <string.h>
+#include <stdatomic.h>
 #include "esp_log.h"
 #include "esp_check.h"
 #include "dshot.h"
+#include "dshot_private/dshot_handle.h"
+#include "dshot_erpm.h"
+#include "dshot_frames.h"
+#if !CONFIG_IDF_TARGET_LINUX
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "soc/soc.h"
+#include "esp_timer.h"
+#include "esp_intr_alloc.h"
 #include "pwe_io_rmt.h"
+#endif
 
 static const char *TAG = "DSHOT";
 
-#define DSHOT_THROTTLE_POSITION     5u
-#define DSHOT_TELEMETRY_POSITION    4u
-#define NIBBLES_SIZE                4u
-#define DSHOT_NUMBER_OF_NIBBLES     3u
+#define DSHOT_GROUP_WAIT_MS         10
+#define DSHOT_GROUP_SLOT_MASK       0x3u
+#define DSHOT_GROUP_SLOT_FRESH      0x4u    // slot in the middle was published and not taken yet
+#define DSHOT_BIDIR_RX_CLK_DIV      8       // 10MHz capture of replies
+#define DSHOT_BIDIR_RX_RINGBUF_SIZE 256
+#define DSHOT_BIDIR_RX_IDLE_BITS    5       // longer than any run of a reply
 
-struct dshot_s {
-    pwe_handle_t pwe;
-    esp_timer_handle_t periodic_timer;
-    uint32_t io_buffer_len;
-    spinlock_t spinlock;
+#if !CONFIG_IDF_TARGET_LINUX
+#define DSHOT_OUTPUT_TASK_STACK     3072
+#endif
+
+// handle is only seen by C++ for its size, atomics must not change the layout
+_Static_assert(sizeof(_Atomic uint32_t) == sizeof(uint32_t) && _Alignof(_Atomic uint32_t) == _Alignof(uint32_t),
+               "DSHOT_ATOMIC layout");
+_Static_assert(sizeof(_Atomic bool) == sizeof(bool) && _Alignof(_Atomic bool) == _Alignof(bool), "DSHOT_ATOMIC layout");
+
+/*
+ * Frames of all motors are handed from dshot_group_update() to dshot_group_send() by triple buffering: each side owns
+ * one slot and swaps it with the middle one, so that neither waits for the other and a tick always sees one complete
+ * update.
+ */
+struct dshot_group_s {
+    uint32_t num;
+    bool synced;            // all motors joined RMT TX sync group, so that frames leave at the same time
+    uint8_t back;           // slot filled by dshot_group_update()
+    uint8_t front;          // slot sent by dshot_group_send()
+    _Atomic uint32_t middle;    // slot index, with DSHOT_GROUP_SLOT_FRESH
+    uint16_t frames[3][DSHOT_GROUP_MAX_MOTORS];
+#if !CONFIG_IDF_TARGET_LINUX
+    dshot_output_t output;
+    StaticSemaphore_t lock_storage;
+    SemaphoreHandle_t lock;     // mutex of sender
+#endif
+    dshot_handle_t motors[0];
 };
 
-esp_err_t dshot_new_pwe_rmt(const pwe_config_t *pwe_conf, const rmt_config_t *rmt_conf, dshot_handle_t *hdl)
+/*
+ * Outgoing buffer is shared by periodic output and dshot_send(), which block until the frame is sent: a mutex, so that
+ * a sender waiting for it sleeps. Static, no heap is taken by instances created in place. No such concurrency on host.
+ */
+#if CONFIG_IDF_TARGET_LINUX
+#define DSHOT_LOCK_INIT(hdl)
+#define DSHOT_LOCK(hdl)
+#define DSHOT_UNLOCK(hdl)
+#else
+#define DSHOT_LOCK_INIT(hdl)    ((hdl)->lock = xSemaphoreCreateMutexStatic(&(hdl)->lock_storage))
+#define DSHOT_LOCK(hdl)         xSemaphoreTake((hdl)->lock, portMAX_DELAY)
+#define DSHOT_UNLOCK(hdl)       xSemaphoreGive((hdl)->lock)
+#endif
+
+#if !CONFIG_IDF_TARGET_LINUX
+static void dshot_output_init(dshot_output_t *out, esp_err_t (*send)(void *arg), void *arg)
+{
+    memset(out, 0, sizeof(dshot_output_t));
+    out->send = send;
+    out->arg = arg;
+    out->stats_lock = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
+}
+
+static void dshot_output_reset_stats(dshot_output_t *out)
+{
+    portENTER_CRITICAL(&out->stats_lock);
+    memset(&out->stats, 0, sizeof(dshot_timing_stats_t));
+    out->stats.bin_us = out->conf.hist_bin_us ? out->conf.hist_bin_us : 1;
+    out->last_us = 0;
+    portEXIT_CRITICAL(&out->stats_lock);
+}
+
+/**
+ * @brief Send one frame and account its interval from the previous one
+ *
+ * An interval is attributed to the nearest number of periods, the extra ones being skipped ticks, and what is left
+ * is the jitter of the frame.
+ */
+static void dshot_output_tick(dshot_output_t *out)
+{
+    const int64_t now = esp_timer_get_time();
+    const esp_err_t ret = out->send(out->arg);
+
+    dshot_timing_stats_t *stats = &out->stats;
+    const int64_t period = out->conf.interval_us;
+    portENTER_CRITICAL(&out->stats_lock);
+    if (out->last_us != 0) {
+        const int64_t elapsed = now - out->last_us;
+        int64_t periods = (elapsed + period / 2) / period;
+        periods = periods < 1 ? 1 : periods;
+        const int32_t jitter = (int32_t)(elapsed - periods * period);
+        const int32_t bin = jitter >= 0 ? jitter / (int32_t)stats->bin_us : -1 - (-1 - jitter) / (int32_t)stats->bin_us;
+        const int32_t index = bin + DSHOT_JITTER_HIST_BINS / 2;
+        stats->skipped += periods - 1;
+        const bool first = stats->frames == 1;
+        stats->min_jitter_us = first || jitter < stats->min_jitter_us ? jitter : stats->min_jitter_us;
+        stats->max_jitter_us = first || jitter > stats->max_jitter_us ? jitter : stats->max_jitter_us;
+        ++stats->hist[index < 0 ? 0 : (index >= DSHOT_JITTER_HIST_BINS ? DSHOT_JITTER_HIST_BINS - 1 : index)];
+    }
+    out->last_us = now;
+    ++stats->frames;
+    stats->errors += ret != ESP_OK;
+    portEXIT_CRITICAL(&out->stats_lock);
+}
+
+static void dshot_output_timer_cb(void *arg)
+{
+    dshot_output_tick((dshot_output_t *)arg);
+}
+
+static bool IRAM_ATTR dshot_output_isr(void *arg)
+{
+    dshot_output_t *out = (dshot_output_t *)arg;
+    BaseType_t task_woken = pdFALSE;
+    vTaskNotifyGiveFromISR(out->task, &task_woken);
+    return task_woken == pdTRUE;
+}
+
+static void dshot_output_task(void *arg)
+{
+    dshot_output_t *out = (dshot_output_t *)arg;
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (out->task_exit) {
+            break;
+        }
+        dshot_output_tick(out);
+    }
+    xTaskNotifyGive(out->task_waiter);
+    vTaskDelete(NULL);
+}
+
+static esp_err_t dshot_output_start_hw_timer(dshot_output_t *out)
+{
+    const dshot_output_config_t *conf = &out->conf;
+    const timer_config_t timer_conf = {
+        .divider = TIMER_BASE_CLK / 1000000,   // 1us per count
+        .counter_dir = TIMER_COUNT_UP,
+        .counter_en = TIMER_PAUSE,
+        .alarm_en = TIMER_ALARM_EN,
+        .auto_reload = TIMER_AUTORELOAD_EN,
+        .intr_type = TIMER_INTR_LEVEL,
+    };
+    out->task_exit = false;
+    ESP_RETURN_ON_FALSE(xTaskCreatePinnedToCore(dshot_output_task, "dshot", DSHOT_OUTPUT_TASK_STACK, out, conf->task_priority,
+                                                &out->task, conf->core_id < 0 ? tskNO_AFFINITY : conf->core_id) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "Failed to create sender task");
+    ESP_RETURN_ON_ERROR(timer_init(conf->timer_group, conf->timer_idx, &timer_conf), TAG, "Failed to init timer");
+    ESP_RETURN_ON_ERROR(timer_set_counter_value(conf->timer_group, conf->timer_idx, 0), TAG, "Failed to set timer counter");
+    ESP_RETURN_ON_ERROR(timer_set_alarm_value(conf->timer_group, conf->timer_idx, conf->interval_us), TAG, "Failed to set timer alarm");
+    ESP_RETURN_ON_ERROR(timer_enable_intr(conf->timer_group, conf->timer_idx), TAG, "Failed to enable timer interrupt");
+    ESP_RETURN_ON_ERROR(timer_isr_callback_add(conf->timer_group, conf->timer_idx, dshot_output_isr, out, ESP_INTR_FLAG_IRAM),
+                        TAG, "Failed to add timer ISR");
+    return timer_start(conf->timer_group, conf->timer_idx);
+}
+
+/**
+ * @brief Release hardware timer and sender task, or esp_timer, whichever the output holds
+ */
+static void dshot_output_release(dshot_output_t *out)
+{
+    if (out->esp_timer != NULL) {
+        esp_timer_stop(out->esp_timer);
+        esp_timer_delete(out->esp_timer);
+        out->esp_timer = NULL;
+    }
+    if (out->task != NULL) {
+        timer_pause(out->conf.timer_group, out->conf.timer_idx);
+        timer_isr_callback_remove(out->conf.timer_group, out->conf.timer_idx);
+        timer_deinit(out->conf.timer_group, out->conf.timer_idx);
+        out->task_waiter = xTaskGetCurrentTaskHandle();
+        out->task_exit = true;
+        xTaskNotifyGive(out->task);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        out->task = NULL;
+    }
+    out->running = false;
+}
+
+static esp_err_t dshot_output_start(dshot_output_t *out, const dshot_output_config_t *conf)
+{
+    ESP_RETURN_ON_FALSE(conf != NULL && conf->interval_us > 0, ESP_ERR_INVALID_ARG, TAG, "invalid output config");
+    ESP_RETURN_ON_FALSE(!out->running, ESP_ERR_INVALID_STATE, TAG, "output already started");
+    if (out->task != NULL || (out->esp_timer != NULL && conf->dispatch != DSHOT_DISPATCH_TIMER_TASK)) {
+        dshot_output_release(out);
+    }
+    out->conf = *conf;
+    dshot_output_reset_stats(out);
+
+    esp_err_t ret = ESP_OK;
+    if (conf->dispatch == DSHOT_DISPATCH_HW_TIMER) {
+        ret = dshot_output_start_hw_timer(out);
+    } else {
+        if (out->esp_timer == NULL) {
+            const esp_timer_create_args_t periodic_timer_args = {
+                .callback = &dshot_output_timer_cb,
+                .name = "Dshot",
+                .arg = out,
+                .skip_unhandled_events = true,
+                .dispatch_method = ESP_TIMER_TASK,
+            };
+            ESP_RETURN_ON_ERROR(esp_timer_create(&periodic_timer_args, &out->esp_timer), TAG, "Faild to create esp_timer");
+        }
+        ret = esp_timer_start_periodic(out->esp_timer, conf->interval_us);
+    }
+    if (ret != ESP_OK) {
+        dshot_output_release(out);
+        return ret;
+    }
+    out->running = true;
+    return ESP_OK;
+}
+
+static esp_err_t dshot_output_stop(dshot_output_t *out)
+{
+    ESP_RETURN_ON_FALSE(out->running, ESP_ERR_INVALID_STATE, TAG, "output not started");
+    out->running = false;
+    if (out->task != NULL) {
+        return timer_pause(out->conf.timer_group, out->conf.timer_idx);
+    }
+    return esp_timer_stop(out->esp_timer);
+}
+
+static void dshot_output_get_stats(dshot_output_t *out, dshot_timing_stats_t *stats)
+{
+    portENTER_CRITICAL(&out->stats_lock);
+    *stats = out->stats;
+    portEXIT_CRITICAL(&out->stats_lock);
+}
+#endif // !CONFIG_IDF_TARGET_LINUX
+
+static inline uint16_t dshot_thrust_value(uint16_t thrust)
+{
+    return thrust == 0 ? 0 : thrust + 47;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+static esp_err_t dshot_output_send(void *arg)
+{
+    return dshot_send((dshot_handle_t)arg);
+}
+
+static esp_err_t dshot_group_output_send(void *arg)
+{
+    return dshot_group_send((dshot_group_handle_t)arg);
+}
+#endif
+
+static void dshot_state_init(dshot_handle_t hdl)
+{
+    DSHOT_LOCK_INIT(hdl);
+#if !CONFIG_IDF_TARGET_LINUX
+    dshot_output_init(&hdl->output, dshot_output_send, hdl);
+#endif
+    dshot_frames_init();
+    atomic_init(&hdl->frame, DSHOT_FRAME(0, false));
+    atomic_init(&hdl->erpm, 0);
+    atomic_init(&hdl->erpm_valid, false);
+    atomic_init(&hdl->cmd_head, 0);
+    atomic_init(&hdl->cmd_tail, 0);
+    atomic_init(&hdl->cmd_done, 0);
+    hdl->cmd_repeat_left = 0;
+    hdl->cmd_gap_left = 0;
+    hdl->frame_xor = 0;
+    hdl->converted = false;
+}
+
+/**
+ * @brief Get frame into outgoing buffer, converting it only when it changed since last time
+ */
+static esp_err_t dshot_prepare(dshot_handle_t hdl, uint16_t frame)
+{
+    if (hdl->converted && hdl->converted_frame == frame) {
+        return ESP_OK;
+    }
+    hdl->converted = false;
+    const uint16_t wire_frame = frame ^ hdl->frame_xor;
+    ESP_RETURN_ON_ERROR(pwe_io_convert_buffer(hdl->pwe, (uint8_t *)&wire_frame, 16, &hdl->io_buffer_len), TAG, "Failed to convert frame");
+    hdl->converted_frame = frame;
+    hdl->converted = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief Get next frame of queued commands, if any
+ *
+ * A command goes out repeat times with telemetry bit set, as ESCs require for settings, then motor stop for
+ * gap_frames. Throttle resumes once the queue is empty.
+ *
+ * @return whether frame was filled, otherwise throttle is to be sent
+ */
+static bool IRAM_ATTR dshot_cmd_next(dshot_handle_t hdl, uint16_t *frame)
+{
+    if (hdl->cmd_repeat_left == 0 && hdl->cmd_gap_left == 0) {
+        const uint32_t tail = atomic_load_explicit(&hdl->cmd_tail, memory_order_relaxed);
+        if (tail == atomic_load_explicit(&hdl->cmd_head, memory_order_acquire)) {
+            return false;
+        }
+        const dshot_cmd_t *cmd = &hdl->cmd_queue[tail % DSHOT_CMD_QUEUE_LEN];
+        hdl->cmd_command = cmd->command;
+        hdl->cmd_repeat_left = cmd->repeat;
+        hdl->cmd_gap_left = cmd->gap_frames;
+        atomic_store_explicit(&hdl->cmd_tail, tail + 1, memory_order_release);
+    }
+    if (hdl->cmd_repeat_left > 0) {
+        --hdl->cmd_repeat_left;
+        *frame = DSHOT_FRAME(hdl->cmd_command, true);
+    } else {
+        --hdl->cmd_gap_left;
+        *frame = DSHOT_FRAME(DShot_cmd_motor_stop, false);
+    }
+    if (hdl->cmd_repeat_left == 0 && hdl->cmd_gap_left == 0) {
+        atomic_fetch_add_explicit(&hdl->cmd_done, 1, memory_order_release);
+    }
+    return true;
+}
+
+/**
+ * @brief Frame to send on this tick: queued commands first, latest throttle otherwise
+ */
+static uint16_t IRAM_ATTR dshot_next_frame(dshot_handle_t hdl)
+{
+    uint16_t frame;
+    if (!dshot_cmd_next(hdl, &frame)) {
+        frame = atomic_load_explicit(&hdl->frame, memory_order_acquire);
+    }
+    return frame;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief Decode the reply to last frame, before the line is driven again
+ */
+static void dshot_bidir_collect(dshot_handle_t hdl)
+{
+    if (!hdl->rx_armed) {
+        return;
+    }
+    hdl->rx_armed = false;
+    rmt_rx_stop(hdl->rx_channel);
+    size_t size = 0;
+    size_t newest_size = 0;
+    uint32_t *newest = NULL;
+    uint32_t *items;
+    // captures left over from earlier frames are stale, only the newest one answers the last frame
+    while ((items = (uint32_t *)xRingbufferReceive(hdl->rx_ringbuf, &size, 0)) != NULL) {
+        if (newest != NULL) {
+            vRingbufferReturnItem(hdl->rx_ringbuf, newest);
+        }
+        newest = items;
+        newest_size = size;
+    }
+    uint32_t erpm = 0;
+    const bool valid = newest != NULL && dshot_erpm_decode(&hdl->erpm_decoder, newest, newest_size / sizeof(uint32_t), &erpm) == ESP_OK;
+    if (newest != NULL) {
+        vRingbufferReturnItem(hdl->rx_ringbuf, newest);
+    }
+    if (valid) {
+        atomic_store_explicit(&hdl->erpm, erpm, memory_order_relaxed);
+    }
+    atomic_store_explicit(&hdl->erpm_valid, valid, memory_order_release);
+}
+
+/**
+ * @brief Capture the reply once the frame is out, the ESC answers about 30us later
+ */
+static void dshot_bidir_arm(dshot_handle_t hdl)
+{
+    if (hdl->bidirectional) {
+        hdl->rx_armed = rmt_rx_start(hdl->rx_channel, true) == ESP_OK;
+    }
+}
+#else
+static inline void dshot_bidir_collect(dshot_handle_t hdl)
+{
+}
+
+static inline void dshot_bidir_arm(dshot_handle_t hdl)
+{
+}
+#endif
+
+/**
+ * @brief Take the dshot handle from the head of storage, or allocate it if storage is NULL
+ *
+ * @param pwe_storage: filled with what is left of storage for PWE backend, NULL if storage is NULL
+ * @param pwe_storage_size: filled with size of pwe_storage
+ */
+static esp_err_t dshot_alloc(void *storage, size_t storage_size, dshot_handle_t *hdl, void **pwe_storage, size_t *pwe_storage_size)
+{
+    if (storage == NULL) {
+        *hdl = calloc(1, sizeof(dshot_t));
+        ESP_RETURN_ON_FALSE(*hdl != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate dshot_handle_t");
+        *pwe_storage = NULL;
+        *pwe_storage_size = 0;
+        return ESP_OK;
+    }
+    const size_t offset = PWE_STORAGE_ALIGN_UP(sizeof(dshot_t));
+    ESP_RETURN_ON_FALSE((uintptr_t)storage % PWE_STATIC_STORAGE_ALIGN == 0 && storage_size > offset, ESP_ERR_INVALID_SIZE,
+                        TAG, "storage must be more than %u bytes aligned to %d", (unsigned)offset, PWE_STATIC_STORAGE_ALIGN);
+    *hdl = memset(storage, 0, sizeof(dshot_t));
+    (*hdl)->static_storage = true;
+    *pwe_storage = (uint8_t *)storage + offset;
+    *pwe_storage_size = storage_size - offset;
+    return ESP_OK;
+}
+
+static void dshot_free(dshot_handle_t hdl)
+{
+    if (!hdl->static_storage) {
+        free(hdl);
+    }
+}
+
+/**
+ * @param bidirectional: frames of bidirectional DShot on an inverted line, without any reply
+ */
+static esp_err_t dshot_create_sim(const pwe_config_t *pwe_conf, const pwe_io_sim_config_t *sim_conf, bool bidirectional, dshot_handle_t *hdl)
 {
     ESP_RETURN_ON_FALSE(pwe_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL pwe_conf");
-    ESP_RETURN_ON_FALSE(rmt_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL rmt_conf");
+    ESP_RETURN_ON_FALSE(sim_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL sim_conf");
+    ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL hdl");
     esp_err_t ret = ESP_OK;
     pwe_handle_t pwe_handle = NULL;
-    rmt_config_t rmtconf;
-    memcpy(&rmtconf, rmt_conf, sizeof(rmt_config_t));
-    rmtconf.clk_div = 4;
-    ESP_RETURN_ON_ERROR(pwe_new_rmt_backend(pwe_conf, &rmtconf, 16, &pwe_handle), TAG, "Failed to create pwe driver");
+    pwe_io_sim_config_t sim_config = *sim_conf;
+    sim_config.invert |= bidirectional;
+    ESP_RETURN_ON_ERROR(pwe_new_sim_backend(pwe_conf, &sim_config, 16, &pwe_handle), TAG, "Failed to create pwe driver");
 
-    dshot_handle_t dshot_handle = malloc(sizeof(dshot_t));
-    ESP_GOTO_ON_FALSE(hdl != NULL, ESP_ERR_NO_MEM, err_dshot_alloc, TAG, "Failed to allocate dshot_handle_t");
+    dshot_handle_t dshot_handle = calloc(1, sizeof(dshot_t));
+    ESP_GOTO_ON_FALSE(dshot_handle != NULL, ESP_ERR_NO_MEM, err_dshot_alloc, TAG, "Failed to allocate dshot_handle_t");
 
     dshot_handle->pwe = pwe_handle;
     ESP_GOTO_ON_ERROR(pwe_init(pwe_handle), err_pwe_init, TAG, "Failed to init pwe");
 
-    spinlock_initialize(&dshot_handle->spinlock);
+    dshot_state_init(dshot_handle);
+    if (bidirectional) {
+        dshot_handle->frame_xor = DSHOT_FRAME_CRC_MASK;
+    }
 
     *hdl = dshot_handle;
     return ESP_OK;
@@ -49,117 +465,559 @@ esp_err_t dshot_new_pwe_rmt(const pwe_config_t *pwe_conf, const rmt_config_t *rm
 err_pwe_init:
     free(dshot_handle);
 err_dshot_alloc:
-    ESP_ERROR_CHECK(pwe_delete_rmt_backend(pwe_handle));
+    pwe_delete_sim_backend(pwe_handle);
     return ret;
 }
 
+esp_err_t dshot_new_pwe_sim(const pwe_config_t *pwe_conf, const pwe_io_sim_config_t *sim_conf, dshot_handle_t *hdl)
+{
+    return dshot_create_sim(pwe_conf, sim_conf, false, hdl);
+}
+
+esp_err_t dshot_new_pwe_sim_bidir(const pwe_config_t *pwe_conf, const pwe_io_sim_config_t *sim_conf, dshot_handle_t *hdl)
+{
+    return dshot_create_sim(pwe_conf, sim_conf, true, hdl);
+}
+
+esp_err_t dshot_del_pwe_sim(dshot_handle_t hdl)
+{
+    ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+#if !CONFIG_IDF_TARGET_LINUX
+    dshot_output_release(&hdl->output);
+#endif
+    ESP_RETURN_ON_ERROR(pwe_deinit(hdl->pwe), TAG, "Failed to deinit pwe");
+    ESP_RETURN_ON_ERROR(pwe_delete_sim_backend(hdl->pwe), TAG, "Failed delete pwe");
+    dshot_free(hdl);
+    return ESP_OK;
+}
+
+esp_err_t dshot_get_pwe_handle(dshot_handle_t hdl, pwe_handle_t *pwe)
+{
+    ESP_RETURN_ON_FALSE(hdl != NULL && pwe != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+    *pwe = hdl->pwe;
+    return ESP_OK;
+}
+
+esp_err_t dshot_send(dshot_handle_t hdl)
+{
+    ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+    DSHOT_LOCK(hdl);
+    // frames of a group and of continuous mode are sent without taking the lock
+    bool busy = hdl->in_group;
+#if !CONFIG_IDF_TARGET_LINUX
+    busy = busy || hdl->continuous;
+#endif
+    if (busy) {
+        DSHOT_UNLOCK(hdl);
+        ESP_LOGE(TAG, "driven by a group or continuous output");
+        return ESP_ERR_INVALID_STATE;
+    }
+    dshot_bidir_collect(hdl);
+    esp_err_t ret = dshot_prepare(hdl, dshot_next_frame(hdl));
+    if (ret == ESP_OK) {
+        ret = pwe_io_write(hdl->pwe, hdl->io_buffer_len);
+    }
+    if (ret == ESP_OK) {
+        dshot_bidir_arm(hdl);
+    }
+    DSHOT_UNLOCK(hdl);
+    return ret;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+
+/**
+ * @brief Capture replies on the line of the frames, which turns open drain so that the ESC can pull it low
+ */
+static esp_err_t dshot_bidir_init(dshot_handle_t hdl, const pwe_config_t *pwe_conf, rmt_channel_t rx_channel)
+{
+    const uint32_t reply_bit_ns = (pwe_conf->T0H + pwe_conf->T0L) * 4 / 5;
+    const uint32_t resolution_hz = APB_CLK_FREQ / DSHOT_BIDIR_RX_CLK_DIV;
+    const uint32_t filter_ticks = (uint64_t)reply_bit_ns / 4 * APB_CLK_FREQ / 1000000000ULL;
+    rmt_config_t rx_conf = RMT_DEFAULT_CONFIG_RX(hdl->gpio, rx_channel);
+    rx_conf.clk_div = DSHOT_BIDIR_RX_CLK_DIV;
+    rx_conf.rx_config.idle_threshold = (uint64_t)reply_bit_ns * DSHOT_BIDIR_RX_IDLE_BITS * resolution_hz / 1000000000ULL;
+    rx_conf.rx_config.filter_en = true;
+    rx_conf.rx_config.filter_ticks_thresh = filter_ticks > 255 ? 255 : filter_ticks;
+    ESP_RETURN_ON_ERROR(dshot_erpm_decoder_init(&hdl->erpm_decoder, resolution_hz, 1000000000ULL / (pwe_conf->T0H + pwe_conf->T0L)),
+                        TAG, "Failed to init eRPM decoder");
+    ESP_RETURN_ON_ERROR(rmt_config(&rx_conf), TAG, "Failed to config RX channel");
+    ESP_RETURN_ON_ERROR(rmt_driver_install(rx_channel, DSHOT_BIDIR_RX_RINGBUF_SIZE, 0), TAG, "Failed to install RX channel");
+    esp_err_t ret = ESP_OK;
+    ESP_GOTO_ON_ERROR(rmt_get_ringbuf_handle(rx_channel, &hdl->rx_ringbuf), err, TAG, "Failed to get RX ring buffer");
+    // RX took the pad as input only
+    ESP_GOTO_ON_ERROR(gpio_set_direction(hdl->gpio, GPIO_MODE_INPUT_OUTPUT_OD), err, TAG, "Failed to set GPIO open drain");
+    ESP_GOTO_ON_ERROR(gpio_pullup_en(hdl->gpio), err, TAG, "Failed to pull GPIO up");
+    hdl->rx_channel = rx_channel;
+    hdl->frame_xor = DSHOT_FRAME_CRC_MASK;
+    hdl->converted = false;
+    hdl->bidirectional = true;
+    return ESP_OK;
+
+err:
+    rmt_driver_uninstall(rx_channel);
+    return ret;
+}
+
+static void dshot_bidir_deinit(dshot_handle_t hdl)
+{
+    if (hdl->bidirectional) {
+        rmt_rx_stop(hdl->rx_channel);
+        rmt_driver_uninstall(hdl->rx_channel);
+        hdl->bidirectional = false;
+        hdl->rx_armed = false;
+    }
+}
+
+/**
+ * @param rx_channel: RMT_CHANNEL_MAX for a transmit only instance
+ */
+static esp_err_t dshot_create_rmt(const pwe_config_t *pwe_conf, const rmt_config_t *rmt_conf, rmt_channel_t rx_channel,
+                                  void *storage, size_t storage_size, dshot_handle_t *hdl)
+{
+    ESP_RETURN_ON_FALSE(pwe_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL pwe_conf");
+    ESP_RETURN_ON_FALSE(rmt_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL rmt_conf");
+    ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL hdl");
+    esp_err_t ret = ESP_OK;
+    dshot_handle_t dshot_handle = NULL;
+    void *pwe_storage = NULL;
+    size_t pwe_storage_size = 0;
+    ESP_RETURN_ON_ERROR(dshot_alloc(storage, storage_size, &dshot_handle, &pwe_storage, &pwe_storage_size), TAG, "Failed to create dshot handle");
+
+    rmt_config_t rmtconf;
+    memcpy(&rmtconf, rmt_conf, sizeof(rmt_config_t));
+    rmtconf.clk_div = 4;
+    if (rx_channel != RMT_CHANNEL_MAX) {
+        // bidirectional DShot is inverted, line idles high
+        rmtconf.flags |= RMT_CHANNEL_FLAGS_INVERT_SIG;
+        rmtconf.tx_config.idle_output_en = true;
+        rmtconf.tx_config.idle_level = RMT_IDLE_LEVEL_LOW;
+    }
+    ret = pwe_storage ? pwe_rmt_backend_init_static(pwe_conf, &rmtconf, 16, pwe_storage, pwe_storage_size, &dshot_handle->pwe) :
+          pwe_new_rmt_backend(pwe_conf, &rmtconf, 16, &dshot_handle->pwe);
+    ESP_GOTO_ON_ERROR(ret, err_pwe_new, TAG, "Failed to create pwe driver");
+    ESP_GOTO_ON_ERROR(pwe_init(dshot_handle->pwe), err_pwe_init, TAG, "Failed to init pwe");
+
+    dshot_state_init(dshot_handle);
+    dshot_handle->rmt_backend = true;
+    dshot_handle->gpio = rmt_conf->gpio_num;
+    if (rx_channel != RMT_CHANNEL_MAX) {
+        ESP_GOTO_ON_ERROR(dshot_bidir_init(dshot_handle, pwe_conf, rx_channel), err_bidir, TAG, "Failed to init bidirectional DShot");
+    }
+
+    *hdl = dshot_handle;
+    return ESP_OK;
+
+err_bidir:
+    pwe_deinit(dshot_handle->pwe);
+err_pwe_init:
+    pwe_delete_rmt_backend(dshot_handle->pwe);
+err_pwe_new:
+    dshot_free(dshot_handle);
+    return ret;
+}
+
+esp_err_t dshot_new_pwe_rmt(const pwe_config_t *pwe_conf, const rmt_config_t *rmt_conf, dshot_handle_t *hdl)
+{
+    return dshot_create_rmt(pwe_conf, rmt_conf, RMT_CHANNEL_MAX, NULL, 0, hdl);
+}
+
+esp_err_t dshot_new_pwe_rmt_bidir(const pwe_config_t *pwe_conf, const rmt_config_t *rmt_conf, rmt_channel_t rx_channel, dshot_handle_t *hdl)
+{
+    ESP_RETURN_ON_FALSE(rx_channel < RMT_CHANNEL_MAX && rmt_conf != NULL && rx_channel != rmt_conf->channel, ESP_ERR_INVALID_ARG,
+                        TAG, "invalid RX channel");
+    return dshot_create_rmt(pwe_conf, rmt_conf, rx_channel, NULL, 0, hdl);
+}
+
+esp_err_t dshot_pwe_rmt_init_static(const pwe_config_t *pwe_conf, const rmt_config_t *rmt_conf, void *storage, size_t storage_size, dshot_handle_t *hdl)
+{
+    ESP_RETURN_ON_FALSE(storage != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL storage");
+    return dshot_create_rmt(pwe_conf, rmt_conf, RMT_CHANNEL_MAX, storage, storage_size, hdl);
+}
+
 esp_err_t dshot_del_pwe_rmt(dshot_handle_t hdl)
 {
     ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+    dshot_output_release(&hdl->output);
+    dshot_bidir_deinit(hdl);
     ESP_RETURN_ON_ERROR(pwe_deinit(hdl->pwe), TAG, "Failed to deinit pwe");
     ESP_RETURN_ON_ERROR(pwe_delete_rmt_backend(hdl->pwe), TAG, "Failed delete pwe");
-    free(hdl);
+    dshot_free(hdl);
     return ESP_OK;
 }
 
-esp_err_t dshot_new_pwe_spi(const pwe_config_t *pwe_conf, const pwe_io_spi_config_t *spi_conf, dshot_handle_t *hdl)
+static esp_err_t dshot_create_spi(const pwe_config_t *pwe_conf, const pwe_io_spi_config_t *spi_conf, void *storage, size_t storage_size, dshot_handle_t *hdl)
 {
     ESP_RETURN_ON_FALSE(pwe_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL pwe_conf");
-    ESP_RETURN_ON_FALSE(spi_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL rmt_conf");
+    ESP_RETURN_ON_FALSE(spi_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL spi_conf");
+    ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL hdl");
     esp_err_t ret = ESP_OK;
-    pwe_handle_t pwe_handle;
-    ESP_RETURN_ON_ERROR(pwe_new_spi_backend(pwe_conf, spi_conf, 16, &pwe_handle), TAG, "Failed to create pwe driver");
+    dshot_handle_t dshot_handle = NULL;
+    void *pwe_storage = NULL;
+    size_t pwe_storage_size = 0;
+    ESP_RETURN_ON_ERROR(dshot_alloc(storage, storage_size, &dshot_handle, &pwe_storage, &pwe_storage_size), TAG, "Failed to create dshot handle");
 
-    dshot_handle_t dshot_handle = malloc(sizeof(dshot_t));
-    ESP_GOTO_ON_FALSE(hdl != NULL, ESP_ERR_NO_MEM, err_dshot_alloc, TAG, "Failed to allocate dshot_handle_t");
+    ret = pwe_storage ? pwe_spi_backend_init_static(pwe_conf, spi_conf, 16, pwe_storage, pwe_storage_size, &dshot_handle->pwe) :
+          pwe_new_spi_backend(pwe_conf, spi_conf, 16, &dshot_handle->pwe);
+    ESP_GOTO_ON_ERROR(ret, err_pwe_new, TAG, "Failed to create pwe driver");
+    ESP_GOTO_ON_ERROR(pwe_init(dshot_handle->pwe), err_pwe_init, TAG, "Failed to init pwe");
 
-    dshot_handle->pwe = pwe_handle;
-    ESP_GOTO_ON_ERROR(pwe_init(pwe_handle), err_pwe_init, TAG, "Failed to init pwe");
-
-    spinlock_initialize(&dshot_handle->spinlock);
+    dshot_state_init(dshot_handle);
 
     *hdl = dshot_handle;
     return ESP_OK;
 
 err_pwe_init:
-    free(dshot_handle);
-err_dshot_alloc:
-    ESP_ERROR_CHECK(pwe_delete_rmt_backend(pwe_handle));
+    pwe_delete_spi_backend(dshot_handle->pwe);
+err_pwe_new:
+    dshot_free(dshot_handle);
     return ret;
 }
 
+esp_err_t dshot_new_pwe_spi(const pwe_config_t *pwe_conf, const pwe_io_spi_config_t *spi_conf, dshot_handle_t *hdl)
+{
+    return dshot_create_spi(pwe_conf, spi_conf, NULL, 0, hdl);
+}
+
+esp_err_t dshot_pwe_spi_init_static(const pwe_config_t *pwe_conf, const pwe_io_spi_config_t *spi_conf, void *storage, size_t storage_size, dshot_handle_t *hdl)
+{
+    ESP_RETURN_ON_FALSE(storage != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL storage");
+    return dshot_create_spi(pwe_conf, spi_conf, storage, storage_size, hdl);
+}
+
 esp_err_t dshot_del_pwe_spi(dshot_handle_t hdl)
 {
     ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+    dshot_output_release(&hdl->output);
     ESP_RETURN_ON_ERROR(pwe_deinit(hdl->pwe), TAG, "Failed to deinit pwe");
     ESP_RETURN_ON_ERROR(pwe_delete_spi_backend(hdl->pwe), TAG, "Failed delete pwe");
-    free(hdl);
+    dshot_free(hdl);
     return ESP_OK;
 }
 
-static void periodic_timer_callback(void *arg)
+/**
+ * @brief Next frame of continuous mode, from RMT TX end interrupt
+ */
+static const void *IRAM_ATTR dshot_continuous_next(pwe_handle_t pwe, void *arg)
 {
     dshot_handle_t hdl = (dshot_handle_t)arg;
-    spinlock_acquire(&hdl->spinlock, SPINLOCK_WAIT_FOREVER);
-    pwe_io_write(hdl->pwe, hdl->io_buffer_len);
-    spinlock_release(&hdl->spinlock);
+    hdl->continuous_frame = dshot_next_frame(hdl) ^ hdl->frame_xor;
+    portENTER_CRITICAL_SAFE(&hdl->output.stats_lock);
+    ++hdl->output.stats.frames;
+    portEXIT_CRITICAL_SAFE(&hdl->output.stats_lock);
+    return &hdl->continuous_frame;
 }
 
 esp_err_t dshot_start(dshot_handle_t hdl, uint32_t interval_us)
+{
+    const dshot_output_config_t conf = DSHOT_OUTPUT_CONFIG_DEFAULT(interval_us);
+    return dshot_start_with_config(hdl, &conf);
+}
+
+esp_err_t dshot_start_with_config(dshot_handle_t hdl, const dshot_output_config_t *conf)
 {
     ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+    ESP_RETURN_ON_FALSE(!hdl->in_group, ESP_ERR_INVALID_STATE, TAG, "driven by a group");
+    ESP_RETURN_ON_FALSE(!hdl->continuous, ESP_ERR_INVALID_STATE, TAG, "continuous output running");
     ESP_RETURN_ON_ERROR(dshot_update(hdl, 0, false), TAG, "Failed to update initial Dshot message");
-    const esp_timer_create_args_t periodic_timer_args = {
-        .callback = &periodic_timer_callback,
-        .name = "Dshot",
-        .arg = hdl,
-        .skip_unhandled_events = true,
-        .dispatch_method = ESP_TIMER_TASK,
-    };
-    ESP_RETURN_ON_ERROR(esp_timer_create(&periodic_timer_args, &hdl->periodic_timer), TAG, "Faild to create esp_timer");
-    return esp_timer_start_periodic(hdl->periodic_timer, interval_us);
+    return dshot_output_start(&hdl->output, conf);
+}
+
+esp_err_t dshot_start_continuous(dshot_handle_t hdl)
+{
+    ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+    ESP_RETURN_ON_FALSE(hdl->rmt_backend && !hdl->bidirectional, ESP_ERR_NOT_SUPPORTED, TAG, "needs unidirectional RMT backend");
+    ESP_RETURN_ON_FALSE(!hdl->in_group, ESP_ERR_INVALID_STATE, TAG, "driven by a group");
+    ESP_RETURN_ON_FALSE(!hdl->output.running && !hdl->continuous, ESP_ERR_INVALID_STATE, TAG, "output already started");
+    ESP_RETURN_ON_ERROR(dshot_update(hdl, 0, false), TAG, "Failed to update initial Dshot message");
+    dshot_output_reset_stats(&hdl->output);
+    // outgoing buffer is taken over by the frames of continuous mode, wait for a frame of dshot_send() to be done
+    DSHOT_LOCK(hdl);
+    hdl->converted = false;
+    const esp_err_t ret = pwe_rmt_start_continuous(hdl->pwe, 16, dshot_continuous_next, hdl);
+    hdl->continuous = ret == ESP_OK;
+    DSHOT_UNLOCK(hdl);
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to start continuous output");
+    return ESP_OK;
 }
 
 esp_err_t dshot_stop(dshot_handle_t hdl)
 {
     ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
-    return esp_timer_stop(hdl->periodic_timer);
+    if (hdl->continuous) {
+        // still running on timeout, stop can be retried. Not running any more if a restart failed in the ISR
+        const esp_err_t ret = pwe_rmt_stop_continuous(hdl->pwe, DSHOT_GROUP_WAIT_MS);
+        if (ret == ESP_OK || ret == ESP_ERR_INVALID_STATE) {
+            hdl->continuous = false;
+        }
+        return ret;
+    }
+    return dshot_output_stop(&hdl->output);
+}
+
+esp_err_t dshot_get_timing_stats(dshot_handle_t hdl, dshot_timing_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(hdl != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL argument");
+    dshot_output_get_stats(&hdl->output, stats);
+    return ESP_OK;
+}
+
+esp_err_t dshot_reset_timing_stats(dshot_handle_t hdl)
+{
+    ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+    dshot_output_reset_stats(&hdl->output);
+    return ESP_OK;
+}
+
+esp_err_t dshot_get_erpm(dshot_handle_t hdl, uint32_t *erpm)
+{
+    ESP_RETURN_ON_FALSE(hdl != NULL && erpm != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL argument");
+    ESP_RETURN_ON_FALSE(hdl->bidirectional, ESP_ERR_INVALID_STATE, TAG, "not bidirectional");
+    const bool valid = atomic_load_explicit(&hdl->erpm_valid, memory_order_acquire);
+    *erpm = atomic_load_explicit(&hdl->erpm, memory_order_relaxed);
+    return valid ? ESP_OK : ESP_ERR_NOT_FOUND;
 }
 
+esp_err_t dshot_group_get_erpm(dshot_group_handle_t group, uint32_t *erpm, uint32_t *valid_mask)
+{
+    ESP_RETURN_ON_FALSE(group != NULL && erpm != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL argument");
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < group->num; ++i) {
+        dshot_handle_t motor = group->motors[i];
+        erpm[i] = 0;
+        if (motor->bidirectional && dshot_get_erpm(motor, &erpm[i]) == ESP_OK) {
+            mask |= 1u << i;
+        }
+    }
+    if (valid_mask != NULL) {
+        *valid_mask = mask;
+    }
+    return ESP_OK;
+}
+
+esp_err_t dshot_group_start(dshot_group_handle_t group, uint32_t interval_us)
+{
+    const dshot_output_config_t conf = DSHOT_OUTPUT_CONFIG_DEFAULT(interval_us);
+    return dshot_group_start_with_config(group, &conf);
+}
+
+esp_err_t dshot_group_start_with_config(dshot_group_handle_t group, const dshot_output_config_t *conf)
+{
+    ESP_RETURN_ON_FALSE(group != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot group");
+    return dshot_output_start(&group->output, conf);
+}
+
+esp_err_t dshot_group_stop(dshot_group_handle_t group)
+{
+    ESP_RETURN_ON_FALSE(group != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot group");
+    return dshot_output_stop(&group->output);
+}
+
+esp_err_t dshot_group_get_timing_stats(dshot_group_handle_t group, dshot_timing_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(group != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL argument");
+    dshot_output_get_stats(&group->output, stats);
+    return ESP_OK;
+}
+
+esp_err_t dshot_group_reset_timing_stats(dshot_group_handle_t group)
+{
+    ESP_RETURN_ON_FALSE(group != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot group");
+    dshot_output_reset_stats(&group->output);
+    return ESP_OK;
+}
+#endif // !CONFIG_IDF_TARGET_LINUX
+
 esp_err_t dshot_update(dshot_handle_t hdl, uint16_t thrust, bool request_telemetry)
 {
     ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
     ESP_RETURN_ON_FALSE(thrust <= 2000, ESP_ERR_INVALID_ARG, TAG, "thrust out of range");
 
-    thrust = thrust == 0 ? 0 : thrust + 47;
+    // wait-free: the sender picks the frame up on next tick and converts it there
+    atomic_store_explicit(&hdl->frame, DSHOT_FRAME(dshot_thrust_value(thrust), request_telemetry), memory_order_release);
+    return ESP_OK;
+}
+
+/**
+ * @brief Append a command to the queue of a motor, which has a single producer: the motor alone or its group
+ */
+static esp_err_t dshot_cmd_push(dshot_handle_t hdl, dshot_command_t command, uint8_t repeat, uint16_t gap_frames)
+{
+    const uint32_t head = atomic_load_explicit(&hdl->cmd_head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&hdl->cmd_tail, memory_order_acquire) >= DSHOT_CMD_QUEUE_LEN) {
+        return ESP_ERR_NO_MEM;
+    }
+    dshot_cmd_t *cmd = &hdl->cmd_queue[head % DSHOT_CMD_QUEUE_LEN];
+    cmd->command = command;
+    cmd->repeat = repeat;
+    cmd->gap_frames = gap_frames;
+    atomic_store_explicit(&hdl->cmd_head, head + 1, memory_order_release);
+    return ESP_OK;
+}
+
+esp_err_t dshot_queue_command(dshot_handle_t hdl, dshot_command_t command, uint8_t repeat, uint16_t gap_frames)
+{
+    ESP_RETURN_ON_FALSE(hdl != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+    ESP_RETURN_ON_FALSE(command <= DShot_cmd_MAX && repeat > 0, ESP_ERR_INVALID_ARG, TAG, "invalid command");
+    ESP_RETURN_ON_FALSE(!hdl->in_group, ESP_ERR_INVALID_STATE, TAG, "driven by a group");
+    return dshot_cmd_push(hdl, command, repeat, gap_frames);
+}
 
-    /*
-     * Refer to https://github.com/PX4/PX4-Autopilot/blob/master/platforms/nuttx/src/px4/stm/stm32_common/dshot/dshot.c
-     */
-    uint16_t packet = 0;
-    uint16_t checksum = 0;
-    packet |= thrust << DSHOT_THROTTLE_POSITION;
-    packet |= ((uint16_t)request_telemetry & 0x01) << DSHOT_TELEMETRY_POSITION;
+esp_err_t dshot_get_commands_pending(dshot_handle_t hdl, uint32_t *pending)
+{
+    ESP_RETURN_ON_FALSE(hdl != NULL && pending != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL argument");
+    *pending = atomic_load_explicit(&hdl->cmd_head, memory_order_relaxed) - atomic_load_explicit(&hdl->cmd_done, memory_order_acquire);
+    return ESP_OK;
+}
 
-    uint16_t csum_data = packet;
-    /* XOR checksum calculation */
-    csum_data >>= NIBBLES_SIZE;
+static void dshot_group_leave_sync(dshot_group_handle_t group, uint32_t num)
+{
+    for (uint32_t i = 0; i < num; ++i) {
+#if !CONFIG_IDF_TARGET_LINUX
+        pwe_rmt_remove_from_sync_group(group->motors[i]->pwe);
+#endif
+    }
+    group->synced = false;
+}
 
-    for (unsigned i = 0; i < DSHOT_NUMBER_OF_NIBBLES; i++) {
-        checksum ^= (csum_data & 0x0F); // XOR data by nibbles
-        csum_data >>= NIBBLES_SIZE;
+esp_err_t dshot_group_new(const dshot_handle_t *motors, uint32_t num, dshot_group_handle_t *group)
+{
+    ESP_RETURN_ON_FALSE(motors != NULL && group != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL argument");
+    ESP_RETURN_ON_FALSE(num > 0 && num <= DSHOT_GROUP_MAX_MOTORS, ESP_ERR_INVALID_ARG, TAG, "invalid number of motors");
+    for (uint32_t i = 0; i < num; ++i) {
+        ESP_RETURN_ON_FALSE(motors[i] != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot handle");
+        ESP_RETURN_ON_FALSE(!motors[i]->in_group, ESP_ERR_INVALID_STATE, TAG, "motor %u already in a group", (unsigned)i);
+#if !CONFIG_IDF_TARGET_LINUX
+        // the group would be a second writer of the channel
+        ESP_RETURN_ON_FALSE(!motors[i]->output.running && !motors[i]->continuous, ESP_ERR_INVALID_STATE, TAG,
+                            "motor %u output running", (unsigned)i);
+#endif
+        for (uint32_t j = 0; j < i; ++j) {
+            ESP_RETURN_ON_FALSE(motors[j] != motors[i], ESP_ERR_INVALID_ARG, TAG, "motor %u given twice", (unsigned)i);
+        }
     }
+    dshot_group_handle_t grp = calloc(1, sizeof(dshot_group_t) + num * sizeof(dshot_handle_t));
+    ESP_RETURN_ON_FALSE(grp != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate dshot_group_t");
+    grp->num = num;
+    memcpy(grp->motors, motors, num * sizeof(dshot_handle_t));
+    for (uint32_t slot = 0; slot < 3; ++slot) {
+        for (uint32_t i = 0; i < num; ++i) {
+            grp->frames[slot][i] = DSHOT_FRAME(0, false);
+        }
+    }
+    grp->back = 0;
+    atomic_init(&grp->middle, 1);
+    grp->front = 2;
+    DSHOT_LOCK_INIT(grp);
+#if !CONFIG_IDF_TARGET_LINUX
+    dshot_output_init(&grp->output, dshot_group_output_send, grp);
+#endif
+#if !CONFIG_IDF_TARGET_LINUX
+    // channels in sync group start together once all of them are started, targets without it start one by one
+    grp->synced = true;
+    for (uint32_t i = 0; i < num && grp->synced; ++i) {
+        grp->synced = motors[i]->rmt_backend;
+    }
+    for (uint32_t i = 0; i < num && grp->synced; ++i) {
+        if (pwe_rmt_add_to_sync_group(motors[i]->pwe) != ESP_OK) {
+            dshot_group_leave_sync(grp, i);
+        }
+    }
+#endif
+    for (uint32_t i = 0; i < num; ++i) {
+        // a frame of dshot_send() may be on its way
+        DSHOT_LOCK(motors[i]);
+        motors[i]->in_group = true;
+        DSHOT_UNLOCK(motors[i]);
+    }
+    ESP_LOGD(TAG, "group of %u motors, %s start", (unsigned)num, grp->synced ? "synchronized" : "back to back");
+    *group = grp;
+    return ESP_OK;
+}
 
-    packet |= (checksum & 0x0F);
+esp_err_t dshot_group_del(dshot_group_handle_t group)
+{
+    ESP_RETURN_ON_FALSE(group != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot group");
+#if !CONFIG_IDF_TARGET_LINUX
+    dshot_output_release(&group->output);
+#endif
+    // wait for a dshot_group_send() or a last tick of the output in progress
+    DSHOT_LOCK(group);
+    DSHOT_UNLOCK(group);
+    for (uint32_t i = 0; i < group->num; ++i) {
+        ESP_RETURN_ON_ERROR(pwe_wait_done(group->motors[i]->pwe, DSHOT_GROUP_WAIT_MS), TAG, "Failed to finish transmission");
+        group->motors[i]->in_group = false;
+    }
+    if (group->synced) {
+        dshot_group_leave_sync(group, group->num);
+    }
+    free(group);
+    return ESP_OK;
+}
 
-    // endian convert
-    uint16_t out_buffer = 0x00;
-    out_buffer |= packet >> 8;
-    out_buffer |= packet << 8;
+esp_err_t dshot_group_update(dshot_group_handle_t group, const uint16_t *thrust, uint32_t telemetry_mask)
+{
+    ESP_RETURN_ON_FALSE(group != NULL && thrust != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL argument");
+    for (uint32_t i = 0; i < group->num; ++i) {
+        ESP_RETURN_ON_FALSE(thrust[i] <= 2000, ESP_ERR_INVALID_ARG, TAG, "thrust of motor %u out of range", (unsigned)i);
+    }
+    uint16_t *frames = group->frames[group->back];
+    for (uint32_t i = 0; i < group->num; ++i) {
+        frames[i] = DSHOT_FRAME(dshot_thrust_value(thrust[i]), (telemetry_mask >> i) & 1);
+    }
+    // publish all frames at once, a tick never sends old and new throttles together
+    group->back = atomic_exchange(&group->middle, group->back | DSHOT_GROUP_SLOT_FRESH) & DSHOT_GROUP_SLOT_MASK;
+    return ESP_OK;
+}
+
+esp_err_t dshot_group_queue_command(dshot_group_handle_t group, uint32_t motor_mask, dshot_command_t command, uint8_t repeat,
+                                    uint16_t gap_frames)
+{
+    ESP_RETURN_ON_FALSE(group != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot group");
+    ESP_RETURN_ON_FALSE(command <= DShot_cmd_MAX && repeat > 0, ESP_ERR_INVALID_ARG, TAG, "invalid command");
+    // all or none, so that motors stay in step
+    for (uint32_t i = 0; i < group->num; ++i) {
+        const dshot_handle_t motor = group->motors[i];
+        if (((motor_mask >> i) & 1) && atomic_load(&motor->cmd_head) - atomic_load(&motor->cmd_tail) >= DSHOT_CMD_QUEUE_LEN) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    for (uint32_t i = 0; i < group->num; ++i) {
+        if ((motor_mask >> i) & 1) {
+            // the group is the only producer of its motors, room found above is still there
+            ESP_RETURN_ON_ERROR(dshot_cmd_push(group->motors[i], command, repeat, gap_frames), TAG,
+                                "queue of motor %u full", (unsigned)i);
+        }
+    }
+    return ESP_OK;
+}
 
+esp_err_t dshot_group_send(dshot_group_handle_t group)
+{
+    ESP_RETURN_ON_FALSE(group != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL dshot group");
     esp_err_t ret = ESP_OK;
-    spinlock_acquire(&hdl->spinlock, SPINLOCK_WAIT_FOREVER);
-    ret = pwe_io_convert_buffer(hdl->pwe, (uint8_t *)&out_buffer, 16, &hdl->io_buffer_len);
-    spinlock_release(&hdl->spinlock);
+    DSHOT_LOCK(group);
+    if (atomic_load(&group->middle) & DSHOT_GROUP_SLOT_FRESH) {
+        group->front = atomic_exchange(&group->middle, group->front) & DSHOT_GROUP_SLOT_MASK;
+    }
+    const uint16_t *frames = group->frames[group->front];
+    for (uint32_t i = 0; i < group->num && ret == ESP_OK; ++i) {
+        dshot_handle_t motor = group->motors[i];
+        uint16_t frame = frames[i];
+        dshot_bidir_collect(motor);
+        dshot_cmd_next(motor, &frame);
+        ret = dshot_prepare(motor, frame);
+    }
+    for (uint32_t i = 0; i < group->num && ret == ESP_OK; ++i) {
+        dshot_handle_t motor = group->motors[i];
+        ret = pwe_io_write_async(motor->pwe, motor->io_buffer_len);
+    }
+    for (uint32_t i = 0; i < group->num && ret == ESP_OK; ++i) {
+        ret = pwe_wait_done(group->motors[i]->pwe, DSHOT_GROUP_WAIT_MS);
+        if (ret == ESP_OK) {
+            dshot_bidir_arm(group->motors[i]);
+        }
+    }
+    DSHOT_UNLOCK(group);
     return ret;
 }
@@ -0,0 +1,107 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "esp_attr.h"
+#include "esp_check.h"
+#include "dshot_erpm.h"
+
+static const char *TAG = "DSHOT_ERPM";
+
+#define DSHOT_ERPM_STOPPED      0x0fff  // longest period, the motor does not turn
+#define DSHOT_ERPM_US_PER_MIN   60000000u
+
+/* GCR quintet to nibble, 0xff for codes not in use */
+static const DRAM_ATTR uint8_t s_gcr_to_nibble[32] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x09, 0x0a, 0x0b, 0xff, 0x0d, 0x0e, 0x0f,
+    0xff, 0xff, 0x02, 0x03, 0xff, 0x05, 0x06, 0x07, 0xff, 0x00, 0x08, 0x01, 0xff, 0x04, 0x0c, 0xff,
+};
+
+esp_err_t dshot_erpm_decoder_init(dshot_erpm_decoder_t *decoder, uint32_t resolution_hz, uint32_t dshot_bitrate)
+{
+    ESP_RETURN_ON_FALSE(decoder != NULL && resolution_hz > 0, ESP_ERR_INVALID_ARG, TAG, "invalid argument");
+    const uint64_t reply_bitrate = (uint64_t)dshot_bitrate * 5 / 4;
+    ESP_RETURN_ON_FALSE(reply_bitrate > 0 && reply_bitrate <= resolution_hz, ESP_ERR_INVALID_ARG, TAG, "reply bit shorter than a tick");
+    decoder->bits_per_tick_q16 = (reply_bitrate << 16) / resolution_hz;
+    return ESP_OK;
+}
+
+esp_err_t IRAM_ATTR dshot_erpm_decode_gcr(uint32_t gcr, uint32_t *erpm)
+{
+    const uint32_t n0 = s_gcr_to_nibble[gcr & 0x1f];
+    const uint32_t n1 = s_gcr_to_nibble[(gcr >> 5) & 0x1f];
+    const uint32_t n2 = s_gcr_to_nibble[(gcr >> 10) & 0x1f];
+    const uint32_t n3 = s_gcr_to_nibble[(gcr >> 15) & 0x1f];
+    if ((n0 | n1 | n2 | n3) & 0xf0) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    const uint32_t value = n0 | (n1 << 4) | (n2 << 8) | (n3 << 12);
+    // checksum is inverted in bidirectional DShot, nibbles xor to 0xf
+    uint32_t csum = value ^ (value >> 8);
+    csum ^= csum >> 4;
+    if ((csum & 0xf) != 0xf) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    const uint32_t data = value >> 4;
+    if (data == DSHOT_ERPM_STOPPED) {
+        *erpm = 0;
+        return ESP_OK;
+    }
+    const uint32_t period_us = (data & 0x1ff) << (data >> 9);
+    *erpm = period_us ? (DSHOT_ERPM_US_PER_MIN + period_us / 2) / period_us : 0;
+    return ESP_OK;
+}
+
+esp_err_t IRAM_ATTR dshot_erpm_decode(const dshot_erpm_decoder_t *decoder, const uint32_t *items, size_t item_num, uint32_t *erpm)
+{
+    // every run of a level starts with a change, i.e. a 1 followed by 0s, the first one being the start bit
+    uint32_t raw = 0;
+    uint32_t bits = 0;
+    uint32_t level = 1;
+    size_t i = 0;
+    for (; i < item_num * 2 && bits < DSHOT_ERPM_REPLY_BITS; ++i) {
+        const uint32_t half = (items[i / 2] >> ((i & 1) * 16)) & 0xffff;
+        const uint32_t duration = half & 0x7fff;
+        if (duration == 0) {
+            break;
+        }
+        level = half >> 15;
+        if (bits == 0 && level) {
+            continue;   // idle before start bit
+        }
+        uint32_t run = (duration * decoder->bits_per_tick_q16 + 0x8000) >> 16;
+        if (run == 0) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (bits + run > DSHOT_ERPM_REPLY_BITS) {
+            // last high run merges into idle, a low one that long is not a reply
+            if (!level) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            run = DSHOT_ERPM_REPLY_BITS - bits;
+        }
+        raw = (raw << run) | (1u << (run - 1));
+        bits += run;
+    }
+    // only idle follows a reply, another low level means the capture holds more than one
+    for (; i < item_num * 2; ++i) {
+        const uint32_t half = (items[i / 2] >> ((i & 1) * 16)) & 0xffff;
+        if ((half & 0x7fff) == 0) {
+            break;
+        }
+        if (!(half >> 15)) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    // no run is longer than 3 bits, only the final high one can be missing from the capture
+    if (bits < DSHOT_ERPM_REPLY_BITS - 3) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (bits < DSHOT_ERPM_REPLY_BITS) {
+        const uint32_t run = DSHOT_ERPM_REPLY_BITS - bits;
+        raw = level ? raw << run : (raw << run) | (1u << (run - 1));
+    }
+    return dshot_erpm_decode_gcr(raw & 0xfffff, erpm);
+}
@@ -0,0 +1,57 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "dshot_frames.h"
+
+#define DSHOT_THROTTLE_POSITION     5u
+#define DSHOT_TELEMETRY_POSITION    4u
+#define NIBBLES_SIZE                4u
+#define DSHOT_NUMBER_OF_NIBBLES     3u
+
+uint16_t dshot_frames[DSHOT_VALUE_NUM * 2];
+static bool s_dshot_frames_ready = false;
+
+/**
+ * @brief Build the frame of a DShot value, in wire order
+ */
+static uint16_t dshot_encode_frame(uint16_t value, bool request_telemetry)
+{
+    /*
+     * Refer to https://github.com/PX4/PX4-Autopilot/blob/master/platforms/nuttx/src/px4/stm/stm32_common/dshot/dshot.c
+     */
+    uint16_t packet = 0;
+    uint16_t checksum = 0;
+    packet |= value << DSHOT_THROTTLE_POSITION;
+    packet |= ((uint16_t)request_telemetry & 0x01) << DSHOT_TELEMETRY_POSITION;
+
+    uint16_t csum_data = packet;
+    /* XOR checksum calculation */
+    csum_data >>= NIBBLES_SIZE;
+
+    for (unsigned i = 0; i < DSHOT_NUMBER_OF_NIBBLES; i++) {
+        checksum ^= (csum_data & 0x0F); // XOR data by nibbles
+        csum_data >>= NIBBLES_SIZE;
+    }
+
+    packet |= (checksum & 0x0F);
+
+    // endian convert
+    uint16_t out_buffer = 0x00;
+    out_buffer |= packet >> 8;
+    out_buffer |= packet << 8;
+    return out_buffer;
+}
+
+void dshot_frames_init(void)
+{
+    if (s_dshot_frames_ready) {
+        return;
+    }
+    for (uint32_t i = 0; i < DSHOT_VALUE_NUM * 2; ++i) {
+        dshot_frames[i] = dshot_encode_frame(i >> 1, i & 1);
+    }
+    s_dshot_frames_ready = true;
+}
@@ -0,0 +1,42 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Table of all DShot frames, looked up instead of computing the checksum on every update. Plain C without any IDF
+ * dependency, so that it can be built and checked on host.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DSHOT_VALUE_NUM             2048u   // 11 bits of throttle or command
+#define DSHOT_FRAME_CRC_MASK        0x0f00u // checksum bits of a frame in wire order
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Frames of all values, indexed by value << 1 | telemetry bit, see DSHOT_FRAME()
+ *
+ * A frame is the 16 bits packet byte swapped, so that its first byte in memory is sent first. Valid once
+ * dshot_frames_init() returned.
+ */
+extern uint16_t dshot_frames[DSHOT_VALUE_NUM * 2];
+
+// frame of a DShot value with telemetry bit, in wire order
+#define DSHOT_FRAME(value, telemetry)   dshot_frames[((uint32_t)(value) << 1) | ((telemetry) ? 1 : 0)]
+
+/**
+ * @brief Fill the frame table once, the same values are written should two instances be created concurrently
+ */
+void dshot_frames_init(void);
+
+#ifdef __cplusplus
+}
+#endif
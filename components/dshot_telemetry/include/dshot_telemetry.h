@@ -0,0 +1,141 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * KISS / BLHeli32 serial telemetry
+ *
+ * An ESC answers a DShot frame with the telemetry bit set by 10 bytes on its telemetry wire, 115200 8N1: temperature
+ * (C), voltage (10mV), current (10mA), consumption (mAh), eRPM / 100, all big endian, then CRC8 (poly 0x07) of the 9
+ * bytes before. ESCs of a group usually share one wire, so only one motor is asked at a time and the reply belongs to
+ * the motor last asked.
+ * Parsing works on received bytes, does not depend on any driver.
+ */
+
+#define DSHOT_TELEMETRY_FRAME_LEN       10
+#define DSHOT_TELEMETRY_BAUDRATE        115200
+#define DSHOT_TELEMETRY_MAX_MOTORS      8
+#define DSHOT_TELEMETRY_TIMEOUT_US      2000    // reply takes 870us on the wire, plus ESC latency
+
+typedef struct {
+    uint8_t temperature_c;      /*!< ESC temperature, C */
+    uint16_t voltage_cv;        /*!< Supply voltage, 10mV */
+    uint16_t current_ca;        /*!< Motor current, 10mA */
+    uint16_t consumption_mah;   /*!< Consumed since power up, mAh */
+    uint32_t erpm;              /*!< Electrical RPM */
+} dshot_telemetry_data_t;
+
+typedef struct {
+    uint8_t frame[DSHOT_TELEMETRY_FRAME_LEN];   /*!< Frame split across inputs, collected here */
+    uint8_t len;                /*!< Bytes of the frame collected */
+    uint8_t crc;                /*!< CRC8 of collected bytes */
+} dshot_telemetry_parser_t;
+
+typedef struct {
+    uint32_t frames;            /*!< Replies decoded */
+    uint32_t crc_errors;        /*!< Replies dropped for checksum mismatch */
+    uint32_t timeouts;          /*!< Requests without a whole reply in time */
+    uint32_t stray_bytes;       /*!< Bytes received while no reply was expected */
+} dshot_telemetry_stats_t;
+
+/* Round robin of requests over motors sharing a telemetry wire, with the latest reply of each */
+typedef struct {
+    dshot_telemetry_parser_t parser;
+    uint32_t motor_num;
+    uint32_t timeout_us;
+    uint32_t motor;             /*!< Motor asked last */
+    bool pending;               /*!< Its reply is still expected */
+    int64_t request_us;
+    uint32_t valid_mask;        /*!< Motors with a reply in data */
+    dshot_telemetry_data_t data[DSHOT_TELEMETRY_MAX_MOTORS];
+    dshot_telemetry_stats_t stats;
+} dshot_telemetry_t;
+
+/**
+ * @brief Drop bytes of a partial frame, next byte starts a frame
+ */
+void dshot_telemetry_parser_reset(dshot_telemetry_parser_t *parser);
+
+/**
+ * @brief Parse received bytes up to the end of next frame
+ *
+ * A frame lying whole in the input is decoded where it lies, only one split across inputs is collected in the parser.
+ * Call again with the remaining bytes until ESP_ERR_NOT_FOUND.
+ *
+ * @param parser: parser
+ * @param data: received bytes, moved past those consumed
+ * @param len: number of bytes at data, decreased by those consumed
+ * @param out: filled with the decoded frame on ESP_OK
+ *
+ * @return
+ *      ESP_OK: a frame was decoded
+ *      ESP_ERR_NOT_FOUND: all bytes consumed, no frame completed
+ *      ESP_ERR_INVALID_CRC: a frame completed with checksum mismatch, dropped
+ */
+esp_err_t dshot_telemetry_parse(dshot_telemetry_parser_t *parser, const uint8_t **data, size_t *len, dshot_telemetry_data_t *out);
+
+/**
+ * @brief Init round robin over motors sharing a telemetry wire
+ *
+ * @param telemetry: state to init
+ * @param motor_num: motors on the wire, index i being bit i of request masks
+ * @param timeout_us: time given to a reply before the next motor is asked. 0 for DSHOT_TELEMETRY_TIMEOUT_US
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: no motor or more than DSHOT_TELEMETRY_MAX_MOTORS
+ */
+esp_err_t dshot_telemetry_init(dshot_telemetry_t *telemetry, uint32_t motor_num, uint32_t timeout_us);
+
+/**
+ * @brief Pick the motor to ask for telemetry in next frame
+ *
+ * Call once per frame, after the bytes received so far are fed. The wire carries one reply at a time: nobody is asked
+ * while a reply is expected and not timed out.
+ *
+ * @param telemetry: state
+ * @param now_us: current time, us
+ *
+ * @return mask of the motor to set the telemetry bit for, e.g. as telemetry_mask of dshot_group_update(). 0 for none
+ */
+uint32_t dshot_telemetry_request(dshot_telemetry_t *telemetry, int64_t now_us);
+
+/**
+ * @brief Parse bytes received from the telemetry wire, storing a reply as that of the motor asked last
+ *
+ * @param telemetry: state
+ * @param data: received bytes
+ * @param len: number of bytes
+ */
+void dshot_telemetry_feed(dshot_telemetry_t *telemetry, const uint8_t *data, size_t len);
+
+/**
+ * @brief Get the latest reply of a motor
+ *
+ * @param telemetry: state
+ * @param motor: index of the motor
+ * @param data: filled with the reply
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: motor out of range
+ *      ESP_ERR_NOT_FOUND: no reply of the motor yet
+ */
+esp_err_t dshot_telemetry_get(const dshot_telemetry_t *telemetry, uint32_t motor, dshot_telemetry_data_t *data);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,90 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "dshot_telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uart_port_t uart_port;
+    gpio_num_t rx_gpio;         /*!< Telemetry wire of the ESCs */
+    uint32_t motor_num;         /*!< ESCs sharing the wire */
+    uint32_t timeout_us;        /*!< Time given to a reply. 0 for DSHOT_TELEMETRY_TIMEOUT_US */
+    int rx_buffer_size;         /*!< Ring buffer of the UART driver, bytes */
+} dshot_telemetry_uart_config_t;
+
+#define DSHOT_TELEMETRY_UART_CONFIG_DEFAULT(port, gpio, num)   \
+    {                                                       \
+        .uart_port = port,                                  \
+        .rx_gpio = gpio,                                    \
+        .motor_num = num,                                   \
+        .timeout_us = 0,                                    \
+        .rx_buffer_size = 256,                              \
+    }
+
+typedef struct dshot_telemetry_uart_s *dshot_telemetry_uart_handle_t;
+
+/**
+ * @brief Install UART driver on the telemetry wire, receive only
+ *
+ * Bytes are handed over to the driver ring buffer as soon as a frame worth is in the FIFO, or after one idle byte
+ * time, instead of the default 10, so that a reply is complete before next frame.
+ *
+ * @param config: reader configuration
+ * @param handle: filled with created handle
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: invalid configuration
+ *      ESP_ERR_NO_MEM: out of memory
+ */
+esp_err_t dshot_telemetry_uart_new(const dshot_telemetry_uart_config_t *config, dshot_telemetry_uart_handle_t *handle);
+
+/**
+ * @brief Uninstall UART driver and free the reader
+ */
+esp_err_t dshot_telemetry_uart_del(dshot_telemetry_uart_handle_t handle);
+
+/**
+ * @brief Parse what was received and pick the motor to ask in next frame
+ *
+ * Call once per frame from the task updating throttles, e.g.:
+ *      dshot_group_update(group, thrust, dshot_telemetry_uart_tick(telemetry));
+ * Never blocks.
+ *
+ * @param handle: reader
+ *
+ * @return mask of the motor to set the telemetry bit for, 0 for none
+ */
+uint32_t dshot_telemetry_uart_tick(dshot_telemetry_uart_handle_t handle);
+
+/**
+ * @brief Get the latest reply of a motor
+ *
+ * @note From the task calling dshot_telemetry_uart_tick()
+ *
+ * @return same as dshot_telemetry_get()
+ */
+esp_err_t dshot_telemetry_uart_get(dshot_telemetry_uart_handle_t handle, uint32_t motor, dshot_telemetry_data_t *data);
+
+/**
+ * @brief Get reply counters of the wire
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: null argument
+ */
+esp_err_t dshot_telemetry_uart_get_stats(dshot_telemetry_uart_handle_t handle, dshot_telemetry_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
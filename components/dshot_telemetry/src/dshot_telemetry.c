@@ -0,0 +1,149 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "esp_check.h"
+#include "dshot_telemetry.h"
+
+static const char *TAG = "DSHOT_TELEMETRY";
+
+#define DSHOT_TELEMETRY_CRC_POS     (DSHOT_TELEMETRY_FRAME_LEN - 1)
+
+/* CRC8, poly 0x07, of one byte */
+static const uint8_t s_crc8[256] = {
+    0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15, 0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d,
+    0x70, 0x77, 0x7e, 0x79, 0x6c, 0x6b, 0x62, 0x65, 0x48, 0x4f, 0x46, 0x41, 0x54, 0x53, 0x5a, 0x5d,
+    0xe0, 0xe7, 0xee, 0xe9, 0xfc, 0xfb, 0xf2, 0xf5, 0xd8, 0xdf, 0xd6, 0xd1, 0xc4, 0xc3, 0xca, 0xcd,
+    0x90, 0x97, 0x9e, 0x99, 0x8c, 0x8b, 0x82, 0x85, 0xa8, 0xaf, 0xa6, 0xa1, 0xb4, 0xb3, 0xba, 0xbd,
+    0xc7, 0xc0, 0xc9, 0xce, 0xdb, 0xdc, 0xd5, 0xd2, 0xff, 0xf8, 0xf1, 0xf6, 0xe3, 0xe4, 0xed, 0xea,
+    0xb7, 0xb0, 0xb9, 0xbe, 0xab, 0xac, 0xa5, 0xa2, 0x8f, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9d, 0x9a,
+    0x27, 0x20, 0x29, 0x2e, 0x3b, 0x3c, 0x35, 0x32, 0x1f, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0d, 0x0a,
+    0x57, 0x50, 0x59, 0x5e, 0x4b, 0x4c, 0x45, 0x42, 0x6f, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7d, 0x7a,
+    0x89, 0x8e, 0x87, 0x80, 0x95, 0x92, 0x9b, 0x9c, 0xb1, 0xb6, 0xbf, 0xb8, 0xad, 0xaa, 0xa3, 0xa4,
+    0xf9, 0xfe, 0xf7, 0xf0, 0xe5, 0xe2, 0xeb, 0xec, 0xc1, 0xc6, 0xcf, 0xc8, 0xdd, 0xda, 0xd3, 0xd4,
+    0x69, 0x6e, 0x67, 0x60, 0x75, 0x72, 0x7b, 0x7c, 0x51, 0x56, 0x5f, 0x58, 0x4d, 0x4a, 0x43, 0x44,
+    0x19, 0x1e, 0x17, 0x10, 0x05, 0x02, 0x0b, 0x0c, 0x21, 0x26, 0x2f, 0x28, 0x3d, 0x3a, 0x33, 0x34,
+    0x4e, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5c, 0x5b, 0x76, 0x71, 0x78, 0x7f, 0x6a, 0x6d, 0x64, 0x63,
+    0x3e, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2c, 0x2b, 0x06, 0x01, 0x08, 0x0f, 0x1a, 0x1d, 0x14, 0x13,
+    0xae, 0xa9, 0xa0, 0xa7, 0xb2, 0xb5, 0xbc, 0xbb, 0x96, 0x91, 0x98, 0x9f, 0x8a, 0x8d, 0x84, 0x83,
+    0xde, 0xd9, 0xd0, 0xd7, 0xc2, 0xc5, 0xcc, 0xcb, 0xe6, 0xe1, 0xe8, 0xef, 0xfa, 0xfd, 0xf4, 0xf3,
+};
+
+static inline uint16_t dshot_telemetry_be16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static esp_err_t dshot_telemetry_decode(const uint8_t *frame, uint8_t crc, dshot_telemetry_data_t *out)
+{
+    if (crc != frame[DSHOT_TELEMETRY_CRC_POS]) {
+        return ESP_ERR_INVALID_CRC;
+    }
+    out->temperature_c = frame[0];
+    out->voltage_cv = dshot_telemetry_be16(&frame[1]);
+    out->current_ca = dshot_telemetry_be16(&frame[3]);
+    out->consumption_mah = dshot_telemetry_be16(&frame[5]);
+    out->erpm = dshot_telemetry_be16(&frame[7]) * 100u;
+    return ESP_OK;
+}
+
+void dshot_telemetry_parser_reset(dshot_telemetry_parser_t *parser)
+{
+    parser->len = 0;
+    parser->crc = 0;
+}
+
+esp_err_t dshot_telemetry_parse(dshot_telemetry_parser_t *parser, const uint8_t **data, size_t *len, dshot_telemetry_data_t *out)
+{
+    const uint8_t *p = *data;
+    size_t remain = *len;
+    if (parser->len == 0 && remain >= DSHOT_TELEMETRY_FRAME_LEN) {
+        // whole frame in the input, decoded in place
+        uint8_t crc = 0;
+        for (int i = 0; i < DSHOT_TELEMETRY_CRC_POS; ++i) {
+            crc = s_crc8[crc ^ p[i]];
+        }
+        *data = p + DSHOT_TELEMETRY_FRAME_LEN;
+        *len = remain - DSHOT_TELEMETRY_FRAME_LEN;
+        return dshot_telemetry_decode(p, crc, out);
+    }
+    // frame split across inputs, collected byte by byte
+    while (remain > 0 && parser->len < DSHOT_TELEMETRY_FRAME_LEN) {
+        const uint8_t byte = *p++;
+        --remain;
+        if (parser->len < DSHOT_TELEMETRY_CRC_POS) {
+            parser->crc = s_crc8[parser->crc ^ byte];
+        }
+        parser->frame[parser->len++] = byte;
+    }
+    *data = p;
+    *len = remain;
+    if (parser->len < DSHOT_TELEMETRY_FRAME_LEN) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    const uint8_t crc = parser->crc;
+    dshot_telemetry_parser_reset(parser);
+    return dshot_telemetry_decode(parser->frame, crc, out);
+}
+
+esp_err_t dshot_telemetry_init(dshot_telemetry_t *telemetry, uint32_t motor_num, uint32_t timeout_us)
+{
+    ESP_RETURN_ON_FALSE(telemetry != NULL && motor_num > 0 && motor_num <= DSHOT_TELEMETRY_MAX_MOTORS, ESP_ERR_INVALID_ARG,
+                        TAG, "invalid argument");
+    memset(telemetry, 0, sizeof(dshot_telemetry_t));
+    telemetry->motor_num = motor_num;
+    telemetry->timeout_us = timeout_us ? timeout_us : DSHOT_TELEMETRY_TIMEOUT_US;
+    telemetry->motor = motor_num - 1;   // first request goes to motor 0
+    return ESP_OK;
+}
+
+uint32_t dshot_telemetry_request(dshot_telemetry_t *telemetry, int64_t now_us)
+{
+    if (telemetry->pending) {
+        if (now_us - telemetry->request_us < telemetry->timeout_us) {
+            return 0;
+        }
+        ++telemetry->stats.timeouts;
+    }
+    telemetry->motor = telemetry->motor + 1 < telemetry->motor_num ? telemetry->motor + 1 : 0;
+    telemetry->pending = true;
+    telemetry->request_us = now_us;
+    // whatever is left of a late reply must not shift the next one
+    dshot_telemetry_parser_reset(&telemetry->parser);
+    return 1u << telemetry->motor;
+}
+
+void dshot_telemetry_feed(dshot_telemetry_t *telemetry, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        if (!telemetry->pending) {
+            telemetry->stats.stray_bytes += len;
+            return;
+        }
+        const esp_err_t ret = dshot_telemetry_parse(&telemetry->parser, &data, &len, &telemetry->data[telemetry->motor]);
+        if (ret == ESP_ERR_NOT_FOUND) {
+            return;
+        }
+        if (ret == ESP_OK) {
+            telemetry->valid_mask |= 1u << telemetry->motor;
+            ++telemetry->stats.frames;
+        } else {
+            ++telemetry->stats.crc_errors;
+        }
+        telemetry->pending = false;
+    }
+}
+
+esp_err_t dshot_telemetry_get(const dshot_telemetry_t *telemetry, uint32_t motor, dshot_telemetry_data_t *data)
+{
+    ESP_RETURN_ON_FALSE(telemetry != NULL && data != NULL && motor < telemetry->motor_num, ESP_ERR_INVALID_ARG, TAG,
+                        "invalid argument");
+    if (!(telemetry->valid_mask & (1u << motor))) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    *data = telemetry->data[motor];
+    return ESP_OK;
+}
@@ -0,0 +1,95 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include "esp_check.h"
+#include "esp_timer.h"
+#include "dshot_telemetry_uart.h"
+
+static const char *TAG = "DSHOT_TELEMETRY_UART";
+
+#define DSHOT_TELEMETRY_UART_CHUNK      64      // bytes taken from the driver ring buffer at once
+
+struct dshot_telemetry_uart_s {
+    uart_port_t port;
+    dshot_telemetry_t telemetry;
+    uint8_t chunk[DSHOT_TELEMETRY_UART_CHUNK];
+};
+
+esp_err_t dshot_telemetry_uart_new(const dshot_telemetry_uart_config_t *config, dshot_telemetry_uart_handle_t *handle)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(config != NULL && handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    ESP_RETURN_ON_FALSE(config->uart_port < UART_NUM_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid uart port");
+    struct dshot_telemetry_uart_s *reader = calloc(1, sizeof(struct dshot_telemetry_uart_s));
+    ESP_RETURN_ON_FALSE(reader != NULL, ESP_ERR_NO_MEM, TAG, "no mem for telemetry reader");
+    ESP_GOTO_ON_ERROR(dshot_telemetry_init(&reader->telemetry, config->motor_num, config->timeout_us), err_free, TAG,
+                      "invalid motor number");
+    reader->port = config->uart_port;
+
+    const uart_config_t uart_conf = {
+        .baud_rate = DSHOT_TELEMETRY_BAUDRATE,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_APB,
+    };
+    ESP_GOTO_ON_ERROR(uart_driver_install(config->uart_port, config->rx_buffer_size, 0, 0, NULL, 0), err_free, TAG,
+                      "install uart driver failed");
+    ESP_GOTO_ON_ERROR(uart_param_config(config->uart_port, &uart_conf), err_uninstall, TAG, "config uart failed");
+    ESP_GOTO_ON_ERROR(uart_set_pin(config->uart_port, UART_PIN_NO_CHANGE, config->rx_gpio, UART_PIN_NO_CHANGE,
+                                   UART_PIN_NO_CHANGE), err_uninstall, TAG, "set uart pin failed");
+    ESP_GOTO_ON_ERROR(uart_set_rx_full_threshold(config->uart_port, DSHOT_TELEMETRY_FRAME_LEN), err_uninstall, TAG,
+                      "set rx threshold failed");
+    ESP_GOTO_ON_ERROR(uart_set_rx_timeout(config->uart_port, 1), err_uninstall, TAG, "set rx timeout failed");
+    *handle = reader;
+    return ESP_OK;
+
+err_uninstall:
+    uart_driver_delete(config->uart_port);
+err_free:
+    free(reader);
+    return ret;
+}
+
+esp_err_t dshot_telemetry_uart_del(dshot_telemetry_uart_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    uart_driver_delete(handle->port);
+    free(handle);
+    return ESP_OK;
+}
+
+uint32_t dshot_telemetry_uart_tick(dshot_telemetry_uart_handle_t handle)
+{
+    size_t available = 0;
+    uart_get_buffered_data_len(handle->port, &available);
+    while (available > 0) {
+        // the driver only hands bytes out by copy, frames are then parsed in place from the chunk
+        const size_t want = available < sizeof(handle->chunk) ? available : sizeof(handle->chunk);
+        const int got = uart_read_bytes(handle->port, handle->chunk, want, 0);
+        if (got <= 0) {
+            break;
+        }
+        dshot_telemetry_feed(&handle->telemetry, handle->chunk, got);
+        available = (size_t)got < available ? available - got : 0;
+    }
+    return dshot_telemetry_request(&handle->telemetry, esp_timer_get_time());
+}
+
+esp_err_t dshot_telemetry_uart_get(dshot_telemetry_uart_handle_t handle, uint32_t motor, dshot_telemetry_data_t *data)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    return dshot_telemetry_get(&handle->telemetry, motor, data);
+}
+
+esp_err_t dshot_telemetry_uart_get_stats(dshot_telemetry_uart_handle_t handle, dshot_telemetry_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    *stats = handle->telemetry.stats;
+    return ESP_OK;
+}
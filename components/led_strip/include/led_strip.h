@@ -18,6 +18,17 @@ extern "C" {
 */
 typedef struct led_strip_s led_strip_t;
 
+/**
+* @brief Layout of source pixels passed to led_strip_set_pixels()
+*
+*/
+typedef enum {
+    LED_PIXEL_FORMAT_RGB888,    /*!< 3 bytes per pixel: R, G, B */
+    LED_PIXEL_FORMAT_BGR888,    /*!< 3 bytes per pixel: B, G, R */
+    LED_PIXEL_FORMAT_RGBA8888,  /*!< 4 bytes per pixel: R, G, B, A. A is ignored */
+    LED_PIXEL_FORMAT_RGB565,    /*!< uint16_t per pixel in little endian, R at bits 15~11, no alignment required */
+} led_pixel_format_t;
+
 /**
 * @brief LED Strip Type
 *
@@ -31,6 +42,7 @@ typedef led_strip_t *led_strip_handle_t;
 struct led_strip_s {
     esp_err_t (*init)(led_strip_handle_t strip);
     esp_err_t (*set_pixel)(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue);
+    esp_err_t (*set_pixels)(led_strip_handle_t strip, uint32_t start, uint32_t count, const void *src, led_pixel_format_t format);
     esp_err_t (*refresh)(led_strip_handle_t strip, uint32_t timeout_ms);
     esp_err_t (*clear)(led_strip_handle_t strip, uint32_t timeout_ms);
     esp_err_t (*deinit)(led_strip_handle_t strip);
@@ -54,7 +66,7 @@ esp_err_t led_strip_init(led_strip_handle_t strip);
  *     - ESP_OK
  *     - ESP_FAIL
  */
-esp_err_t led_strip_denit(led_strip_handle_t strip);
+esp_err_t led_strip_deinit(led_strip_handle_t strip);
 
 /**
     * @brief Set RGB for a specific pixel
@@ -72,6 +84,22 @@ esp_err_t led_strip_denit(led_strip_handle_t strip);
     */
 esp_err_t led_strip_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue);
 
+/**
+    * @brief Set a run of pixels from a packed buffer
+    *
+    * @param strip: LED strip
+    * @param start: index of the first pixel to set
+    * @param count: number of pixels to set
+    * @param src: packed source pixels
+    * @param format: layout of src
+    *
+    * @return
+    *      - ESP_OK: Set pixels successfully
+    *      - ESP_ERR_INVALID_ARG: Set pixels failed because of invalid parameters
+    *      - ESP_FAIL: Set pixels failed because other error occurred
+    */
+esp_err_t led_strip_set_pixels(led_strip_handle_t strip, uint32_t start, uint32_t count, const void *src, led_pixel_format_t format);
+
 /**
     * @brief Refresh memory colors to LEDs
     *
@@ -0,0 +1,46 @@
+/*
+ * SPDX-FileCopyrightText: 2019-2021 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Handle of PWE LED strip, not part of public API. Only visible so that LED_STRIP_PWE_HANDLE_SIZE is its real size
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "led_strip.h"
+#include "pwe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    led_strip_t parent;
+    pwe_handle_t pwe_handle;
+    uint32_t strip_len;
+    uint32_t dirty_start;       // first pixel changed since last refresh
+    uint32_t dirty_end;         // one past the last pixel changed since last refresh, no change if <= dirty_start
+    bool encoded_valid;         // outgoing buffer of pwe_handle holds the whole strip
+    bool partial_encode;        // pwe_handle supports pwe_io_convert_range()
+    uint32_t outgoing_len;      // write-through mode: outgoing buffer length covering pixels [0, dirty_end)
+    bool write_through;
+    bool rmt_backend;           // pwe_handle can join RMT TX sync group
+    bool in_sync_group;         // joined RMT TX sync group by led_strip_group_refresh()
+    bool pending;               // prepared by led_strip_pwe_prepare(), to be started
+    bool pending_raw;           // pending transfer converts buffer on the fly instead of writing outgoing buffer
+    uint32_t pending_len;       // bits of buffer if pending_raw, otherwise outgoing buffer length
+    uint8_t brightness;
+    float gamma;
+    bool static_storage;        // created by led_strip_pwe_*_init_static(), not to be freed
+    uint8_t lut[256];           // brightness and gamma, applied by PWE while converting
+    uint8_t buffer[0];          // GRB of each pixel, not allocated in write-through mode
+} led_strip_pwe_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,9 +6,14 @@
 
 #pragma once
 
+#include "sdkconfig.h"
 #include "esp_err.h"
+#include "led_strip.h"
+#include "pwe_io_sim.h"
+#if !CONFIG_IDF_TARGET_LINUX
 #include "pwe_io_spi.h"
 #include "pwe_io_rmt.h"
+#endif
 
 #ifdef __cplusplus
 extern "C" {
@@ -16,6 +21,47 @@ extern "C" {
 
 typedef pwe_config_t led_strip_config;
 
+/**
+ * @brief Write-through mode, set in led_strip_config.flags
+ *
+ * led_strip_set_pixel() converts the pixel straight into the outgoing buffer of PWE backend and led_strip_refresh()
+ * only writes it out. No copy of pixel colors is kept, so the backend always allocates a full outgoing buffer.
+ */
+#define LED_STRIP_PWE_FLAG_WRITE_THROUGH    (1 << 16)
+
+/**
+ * @brief Storage taken by the strip handle itself, not counting pixel colors and PWE backend
+ */
+#define LED_STRIP_PWE_HANDLE_SIZE   sizeof(led_strip_pwe_t)
+
+/**
+ * @brief Storage taken by pixel colors, none in write-through mode
+ */
+#define LED_STRIP_PWE_COLOR_SIZE(led_num, flags)    (((flags) & LED_STRIP_PWE_FLAG_WRITE_THROUGH) ? 0 : (led_num) * 3)
+
+#if !CONFIG_IDF_TARGET_LINUX
+/**
+ * @brief Storage required by led_strip_pwe_rmt_init_static()
+ *
+ * @param led_num: MAX LED number
+ * @param flags: flags of led_strip_config
+ */
+#define LED_STRIP_PWE_RMT_STORAGE_SIZE(led_num, flags)                                          \
+    (PWE_STORAGE_ALIGN_UP(LED_STRIP_PWE_HANDLE_SIZE + LED_STRIP_PWE_COLOR_SIZE(led_num, flags)) + \
+     PWE_RMT_STORAGE_SIZE(((flags) & LED_STRIP_PWE_FLAG_WRITE_THROUGH) ? (led_num) * 24 : 0, flags))
+
+/**
+ * @brief Storage required by led_strip_pwe_spi_init_static()
+ *
+ * @param led_num: MAX LED number
+ * @param slots_per_bit: pwe_timing_t::slots_per_bit resolved for the configuration, 3 for WS2812 and 4 for SK6812
+ * @param flags: flags of led_strip_config
+ */
+#define LED_STRIP_PWE_SPI_STORAGE_SIZE(led_num, slots_per_bit, flags)                           \
+    (PWE_STORAGE_ALIGN_UP(LED_STRIP_PWE_HANDLE_SIZE + LED_STRIP_PWE_COLOR_SIZE(led_num, flags)) + \
+     PWE_SPI_STORAGE_SIZE((led_num) * 24, slots_per_bit, flags))
+#endif
+
 /**
 * @brief Default configuration for WS2812 LED strip
 *
@@ -50,6 +96,87 @@ typedef pwe_config_t led_strip_config;
         .TRST = 80000,              \
     }
 
+/**
+ * @brief Set global brightness of a strip created by this driver
+ *
+ * Applied while pixels are converted, colors set by led_strip_set_pixel() are kept untouched.
+ * Takes effect on next led_strip_refresh(). In write-through mode only pixels set afterwards are affected.
+ *
+ * @param strip: strip handle
+ * @param brightness: 0~255, 255 for full brightness
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t led_strip_pwe_set_brightness(led_strip_handle_t strip, uint8_t brightness);
+
+/**
+ * @brief Set gamma correction of a strip created by this driver
+ *
+ * Same as led_strip_pwe_set_brightness(), gamma is applied before brightness.
+ *
+ * @param strip: strip handle
+ * @param gamma: output = input ^ gamma on 0~1 scale, 1.0 to disable. 2.2 is common for WS2812
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t led_strip_pwe_set_gamma(led_strip_handle_t strip, float gamma);
+
+/**
+ * @brief Refresh several strips created by this driver at once
+ *
+ * Pixels of all strips are converted first, then all transmissions are started back to back and waited for.
+ * On targets with RMT TX sync (not ESP32), RMT based strips leave at the same time.
+ *
+ * @param strips: array of strip handles, each of them must not be refreshed by another task meanwhile
+ * @param num: number of strips
+ * @param timeout_ms: maximum time to wait for each strip
+ *
+ * @note RMT based strips send pixels straight from their color buffer, which must not be changed from ISR or
+ *       another task before this function returns
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_TIMEOUT
+ */
+esp_err_t led_strip_group_refresh(const led_strip_handle_t *strips, uint32_t num, uint32_t timeout_ms);
+
+/**
+ * @brief Install a new ws2812 driver on a simulated PWE interface, see pwe_new_sim_backend()
+ *
+ * @param led_conf: LED strip configuration
+ * @param led_num: MAX LED number
+ * @param sim_conf: simulation configuration
+ * @param strip: strip handle created
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t led_strip_new_pwe_sim(const led_strip_config *led_conf, uint16_t led_num, const pwe_io_sim_config_t *sim_conf, led_strip_handle_t *strip);
+
+/**
+ * @brief Delete a ws2812 driver created by led_strip_new_pwe_sim()
+ *
+ * @param strip: strip handle
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t led_strip_del_pwe_sim(led_strip_handle_t strip);
+
+/**
+ * @brief Get PWE interface a strip sends pixels through, such as to read back the waveform of a simulated one
+ *
+ * @param strip: strip handle
+ * @param pwe: filled with PWE handle
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t led_strip_pwe_get_handle(led_strip_handle_t strip, pwe_handle_t *pwe);
+
+#if !CONFIG_IDF_TARGET_LINUX
 /**
  * @brief Install a new ws2812 driver (based on RMT peripheral)
  *
@@ -72,6 +199,26 @@ esp_err_t led_strip_new_pwe_rmt(const led_strip_config *led_conf, uint16_t led_n
  */
 esp_err_t led_strip_del_pwe_rmt(led_strip_handle_t strip);
 
+/**
+ * @brief Install a new ws2812 driver (based on RMT peripheral) in caller provided storage, without allocating from heap
+ *
+ * Same as led_strip_new_pwe_rmt() otherwise. The storage must stay valid until led_strip_del_pwe_rmt() is called,
+ * which does not free it.
+ *
+ * @param led_conf: LED strip configuration
+ * @param led_num: MAX LED number
+ * @param rmt_conf: RMT periph configuration
+ * @param storage: memory for the strip and its PWE backend, aligned to PWE_STATIC_STORAGE_ALIGN
+ * @param storage_size: size of storage, at least LED_STRIP_PWE_RMT_STORAGE_SIZE(led_num, led_conf->flags)
+ * @param strip: strip handle created
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_SIZE: storage too small or misaligned
+ */
+esp_err_t led_strip_pwe_rmt_init_static(const led_strip_config *led_conf, uint16_t led_num, const rmt_config_t *rmt_conf,
+                                        void *storage, size_t storage_size, led_strip_handle_t *strip);
+
 /**
  * @brief Install a new ws2812 driver (based on SPI peripheral)
  *
@@ -94,6 +241,30 @@ esp_err_t led_strip_new_pwe_spi(const led_strip_config *led_conf, uint16_t led_n
  */
 esp_err_t led_strip_del_pwe_spi(led_strip_handle_t strip);
 
+/**
+ * @brief Install a new ws2812 driver (based on SPI peripheral) in caller provided storage, without allocating from heap
+ *
+ * Same as led_strip_new_pwe_spi() otherwise. The storage must stay valid until led_strip_del_pwe_spi() is called,
+ * which does not free it.
+ *
+ * @param led_conf: LED strip configuration
+ * @param led_num: MAX LED number
+ * @param spi_conf: SPI periph configuration
+ * @param storage: memory for the strip and its PWE backend, DMA capable and aligned to PWE_STATIC_STORAGE_ALIGN
+ * @param storage_size: size of storage, see LED_STRIP_PWE_SPI_STORAGE_SIZE()
+ * @param strip: strip handle created
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_SIZE: storage too small or misaligned
+ */
+esp_err_t led_strip_pwe_spi_init_static(const led_strip_config *led_conf, uint16_t led_num, const pwe_io_spi_config_t *spi_conf,
+                                        void *storage, size_t storage_size, led_strip_handle_t *strip);
+
+#endif // !CONFIG_IDF_TARGET_LINUX
+
 #ifdef __cplusplus
 }
 #endif
+
+#include "led_strip_private/led_strip_pwe_handle.h"
@@ -13,8 +13,6 @@
 #include "led_strip.h"
 #include "led_strip_pwe.h"
 #include "pwe.h"
-#include "pwe_io_rmt.h"
-#include "pwe_io_spi.h"
 
 typedef struct {
     led_strip_t parent;
@@ -39,6 +37,11 @@ esp_err_t led_strip_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t
     return strip->set_pixel(strip, index, red, green, blue);
 }
 
+esp_err_t led_strip_set_pixels(led_strip_handle_t strip, uint32_t start, uint32_t count, const void *src, led_pixel_format_t format)
+{
+    return strip->set_pixels(strip, start, count, src, format);
+}
+
 esp_err_t led_strip_refresh(led_strip_handle_t strip, uint32_t timeout_ms)
 {
     return strip->refresh(strip, timeout_ms);
@@ -6,142 +6,567 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <sys/cdefs.h>
 #include "esp_log.h"
 #include "esp_check.h"
 #include "esp_attr.h"
 #include "led_strip.h"
 #include "led_strip_pwe.h"
+#include "led_strip_private/led_strip_pwe_handle.h"
 #include "pwe.h"
-#include "pwe_io_rmt.h"
-#include "pwe_io_spi.h"
 
 static const char *TAG = "LED_STRIP_PWE";
 
-typedef struct {
-    led_strip_t parent;
-    pwe_handle_t pwe_handle;
-    uint32_t strip_len;
-    uint8_t buffer[0];
-} ws2812_t;
+#define LED_STRIP_PWE_BLIT_CHUNK    32  // pixels converted per step by set_pixels() in write-through mode
+
+static inline void led_strip_pwe_mark_dirty(led_strip_pwe_t *ws2812, uint32_t start, uint32_t end)
+{
+    ws2812->dirty_start = start < ws2812->dirty_start ? start : ws2812->dirty_start;
+    ws2812->dirty_end = end > ws2812->dirty_end ? end : ws2812->dirty_end;
+}
 
 
 static esp_err_t led_strip_pwe_init(led_strip_handle_t strip)
 {
     ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
-    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
     return pwe_init(ws2812->pwe_handle);
 }
 
 static esp_err_t led_strip_pwe_deinit(led_strip_handle_t strip)
 {
     ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
-    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
     return pwe_deinit(ws2812->pwe_handle);
 }
 
 static esp_err_t led_strip_pwe_set_pixel(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
 {
     ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
-    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
     ESP_RETURN_ON_FALSE(index < ws2812->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of the maximum number of leds");
     uint32_t start = index * 3;
     // In thr order of GRB
+    if (ws2812->buffer[start + 0] == (green & 0xFF) &&
+            ws2812->buffer[start + 1] == (red & 0xFF) &&
+            ws2812->buffer[start + 2] == (blue & 0xFF)) {
+        return ESP_OK;
+    }
     ws2812->buffer[start + 0] = green & 0xFF;
     ws2812->buffer[start + 1] = red & 0xFF;
     ws2812->buffer[start + 2] = blue & 0xFF;
+    led_strip_pwe_mark_dirty(ws2812, index, index + 1);
+    return ESP_OK;
+}
+
+/**
+ * @brief Convert count packed source pixels into GRB wire order
+ */
+static esp_err_t led_strip_pwe_convert_pixels(uint8_t *grb, const void *src, uint32_t count, led_pixel_format_t format)
+{
+    const uint8_t *psrc = (const uint8_t *)src;
+    switch (format) {
+    case LED_PIXEL_FORMAT_RGB888:
+        for (uint32_t i = 0; i < count; ++i, psrc += 3, grb += 3) {
+            grb[0] = psrc[1];
+            grb[1] = psrc[0];
+            grb[2] = psrc[2];
+        }
+        break;
+    case LED_PIXEL_FORMAT_BGR888:
+        for (uint32_t i = 0; i < count; ++i, psrc += 3, grb += 3) {
+            grb[0] = psrc[1];
+            grb[1] = psrc[2];
+            grb[2] = psrc[0];
+        }
+        break;
+    case LED_PIXEL_FORMAT_RGBA8888:
+        for (uint32_t i = 0; i < count; ++i, psrc += 4, grb += 3) {
+            grb[0] = psrc[1];
+            grb[1] = psrc[0];
+            grb[2] = psrc[2];
+        }
+        break;
+    case LED_PIXEL_FORMAT_RGB565:
+        // src is not necessarily 2 bytes aligned, e.g. in the middle of a write-through blit
+        for (uint32_t i = 0; i < count; ++i, psrc += 2, grb += 3) {
+            const uint16_t px = psrc[0] | (psrc[1] << 8);
+            const uint8_t r = (px >> 11) & 0x1f;
+            const uint8_t g = (px >> 5) & 0x3f;
+            const uint8_t b = px & 0x1f;
+            // replicate high bits into low bits so that full scale maps to 0xff
+            grb[0] = (g << 2) | (g >> 4);
+            grb[1] = (r << 3) | (r >> 2);
+            grb[2] = (b << 3) | (b >> 2);
+        }
+        break;
+    default:
+        ESP_RETURN_ON_FALSE(false, ESP_ERR_INVALID_ARG, TAG, "unknown pixel format");
+    }
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_pwe_set_pixels(led_strip_handle_t strip, uint32_t start, uint32_t count, const void *src, led_pixel_format_t format)
+{
+    ESP_RETURN_ON_FALSE(strip != NULL && src != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
+    ESP_RETURN_ON_FALSE(start <= ws2812->strip_len && count <= ws2812->strip_len - start, ESP_ERR_INVALID_ARG, TAG, "pixels out of the maximum number of leds");
+    ESP_RETURN_ON_ERROR(led_strip_pwe_convert_pixels(&ws2812->buffer[start * 3], src, count, format), TAG, "Failed to convert pixels");
+    led_strip_pwe_mark_dirty(ws2812, start, start + count);
+    return ESP_OK;
+}
+
+/**
+ * @brief Convert what changed since last refresh and record the transfer needed to show it
+ */
+static esp_err_t led_strip_pwe_prepare(led_strip_pwe_t *ws2812)
+{
+    ws2812->pending = false;
+    if (ws2812->dirty_end <= ws2812->dirty_start) {
+        // strip already shows the buffer
+        return ESP_OK;
+    }
+    ws2812->pending = true;
+    ws2812->pending_raw = false;
+    if (ws2812->write_through) {
+        // pixels are converted by set_pixel() already
+        ws2812->pending_len = ws2812->outgoing_len;
+        return ESP_OK;
+    }
+    /*
+     * Each LED consumes the first 24 bits it receives and passes the rest on, so pixels behind the last changed one
+     * keep what they latched before and do not need to be sent again.
+     */
+    uint32_t send_len = ws2812->dirty_end;
+    esp_err_t ret = ESP_OK;
+    if (ws2812->encoded_valid && ws2812->partial_encode) {
+        ret = pwe_io_convert_range(ws2812->pwe_handle, &ws2812->buffer[ws2812->dirty_start * 3], ws2812->dirty_start * 3 * 8,
+                                   (ws2812->dirty_end - ws2812->dirty_start) * 3 * 8, &ws2812->pending_len);
+        if (ret == ESP_ERR_NOT_SUPPORTED) {
+            ws2812->partial_encode = false;
+        } else {
+            ESP_RETURN_ON_ERROR(ret, TAG, "Failed to convert dirty pixels");
+            return ESP_OK;
+        }
+    }
+    if (ws2812->pwe_handle->max_payload_length == 0) {
+        ws2812->pending_raw = true;
+        ws2812->pending_len = send_len * 3 * 8;
+        return ESP_OK;
+    }
+    ESP_RETURN_ON_ERROR(pwe_io_convert_buffer(ws2812->pwe_handle, ws2812->buffer, send_len * 3 * 8, &ws2812->pending_len), TAG, "Failed to convert pixels");
+    // a buffered backend keeps the converted frame, which can be updated in place next time
+    ws2812->encoded_valid = send_len == ws2812->strip_len;
+    return ESP_OK;
+}
+
+/**
+ * @brief Start the transfer recorded by led_strip_pwe_prepare()
+ */
+static esp_err_t led_strip_pwe_start(led_strip_pwe_t *ws2812, bool async)
+{
+    if (!ws2812->pending) {
+        return ESP_OK;
+    }
+    if (ws2812->pending_raw) {
+        ESP_RETURN_ON_ERROR(async ? pwe_send_async(ws2812->pwe_handle, ws2812->buffer, ws2812->pending_len) :
+                            pwe_send(ws2812->pwe_handle, ws2812->buffer, ws2812->pending_len), TAG, "Failed to send pixels");
+    } else {
+        ESP_RETURN_ON_ERROR(async ? pwe_io_write_async(ws2812->pwe_handle, ws2812->pending_len) :
+                            pwe_io_write(ws2812->pwe_handle, ws2812->pending_len), TAG, "Failed to write out pixels");
+    }
+    ws2812->pending = false;
+    ws2812->dirty_start = ws2812->strip_len;
+    ws2812->dirty_end = 0;
+    ws2812->outgoing_len = 0;
     return ESP_OK;
 }
 
 static esp_err_t led_strip_pwe_refresh(led_strip_handle_t strip, uint32_t timeout_ms)
 {
     ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
-    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
-    return pwe_send(ws2812->pwe_handle, ws2812->buffer, ws2812->strip_len * 3 * 8);
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
+    ESP_RETURN_ON_ERROR(led_strip_pwe_prepare(ws2812), TAG, "Failed to prepare pixels");
+    return led_strip_pwe_start(ws2812, false);
 }
 
 static esp_err_t led_strip_pwe_clear(led_strip_handle_t strip, uint32_t timeout_ms)
 {
     ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
-    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
     // Write zero to turn off all leds
     memset(ws2812->buffer, 0, ws2812->strip_len * 3);
+    led_strip_pwe_mark_dirty(ws2812, 0, ws2812->strip_len);
     return led_strip_pwe_refresh(strip, timeout_ms);
 }
 
-esp_err_t led_strip_new_pwe_rmt(const led_strip_config *led_conf, uint16_t led_num, const rmt_config_t *rmt_conf, led_strip_handle_t *strip)
+/*
+ * Write-through mode: set_pixel() converts the pixel straight into the outgoing buffer of the backend, so refresh()
+ * only writes it out. There is no GRB copy of the strip.
+ */
+static esp_err_t led_strip_pwe_set_pixel_write_through(led_strip_handle_t strip, uint32_t index, uint32_t red, uint32_t green, uint32_t blue)
+{
+    ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
+    ESP_RETURN_ON_FALSE(index < ws2812->strip_len, ESP_ERR_INVALID_ARG, TAG, "index out of the maximum number of leds");
+    // In thr order of GRB
+    const uint8_t grb[3] = { green & 0xFF, red & 0xFF, blue & 0xFF };
+    uint32_t outgoing_buffer_len = 0;
+    ESP_RETURN_ON_ERROR(pwe_io_convert_range(ws2812->pwe_handle, grb, index * 3 * 8, 3 * 8, &outgoing_buffer_len), TAG, "Failed to convert pixel");
+    led_strip_pwe_mark_dirty(ws2812, index, index + 1);
+    ws2812->outgoing_len = outgoing_buffer_len > ws2812->outgoing_len ? outgoing_buffer_len : ws2812->outgoing_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_pwe_set_pixels_write_through(led_strip_handle_t strip, uint32_t start, uint32_t count, const void *src, led_pixel_format_t format)
+{
+    ESP_RETURN_ON_FALSE(strip != NULL && src != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
+    ESP_RETURN_ON_FALSE(start <= ws2812->strip_len && count <= ws2812->strip_len - start, ESP_ERR_INVALID_ARG, TAG, "pixels out of the maximum number of leds");
+    // convert through a small GRB chunk on stack, as there is no GRB copy of the strip
+    uint8_t grb[LED_STRIP_PWE_BLIT_CHUNK * 3];
+    const uint8_t bytes_per_pixel = format == LED_PIXEL_FORMAT_RGBA8888 ? 4 : format == LED_PIXEL_FORMAT_RGB565 ? 2 : 3;
+    const uint8_t *psrc = (const uint8_t *)src;
+    uint32_t outgoing_buffer_len = 0;
+    for (uint32_t done = 0; done < count;) {
+        uint32_t n = count - done < LED_STRIP_PWE_BLIT_CHUNK ? count - done : LED_STRIP_PWE_BLIT_CHUNK;
+        ESP_RETURN_ON_ERROR(led_strip_pwe_convert_pixels(grb, psrc + done * bytes_per_pixel, n, format), TAG, "Failed to convert pixels");
+        ESP_RETURN_ON_ERROR(pwe_io_convert_range(ws2812->pwe_handle, grb, (start + done) * 3 * 8, n * 3 * 8, &outgoing_buffer_len), TAG, "Failed to convert pixels");
+        done += n;
+    }
+    if (count > 0) {
+        led_strip_pwe_mark_dirty(ws2812, start, start + count);
+        ws2812->outgoing_len = outgoing_buffer_len > ws2812->outgoing_len ? outgoing_buffer_len : ws2812->outgoing_len;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_pwe_fill_black(led_strip_pwe_t *ws2812)
+{
+    static const uint8_t black[3] = { 0 };
+    uint32_t outgoing_buffer_len = 0;
+    for (uint32_t i = 0; i < ws2812->strip_len; ++i) {
+        ESP_RETURN_ON_ERROR(pwe_io_convert_range(ws2812->pwe_handle, black, i * 3 * 8, 3 * 8, &outgoing_buffer_len), TAG, "Failed to convert pixel");
+    }
+    led_strip_pwe_mark_dirty(ws2812, 0, ws2812->strip_len);
+    ws2812->outgoing_len = outgoing_buffer_len;
+    return ESP_OK;
+}
+
+static esp_err_t led_strip_pwe_clear_write_through(led_strip_handle_t strip, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
+    ESP_RETURN_ON_ERROR(led_strip_pwe_fill_black(ws2812), TAG, "Failed to clear pixels");
+    return led_strip_pwe_refresh(strip, timeout_ms);
+}
+
+static void led_strip_pwe_leave_sync_group(const led_strip_handle_t *strips, uint32_t num)
 {
+#if !CONFIG_IDF_TARGET_LINUX
+    for (uint32_t i = 0; i < num; ++i) {
+        led_strip_pwe_t *ws2812 = __containerof(strips[i], led_strip_pwe_t, parent);
+        if (ws2812->in_sync_group) {
+            pwe_rmt_remove_from_sync_group(ws2812->pwe_handle);
+            ws2812->in_sync_group = false;
+        }
+    }
+#endif
+}
+
+esp_err_t led_strip_group_refresh(const led_strip_handle_t *strips, uint32_t num, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(strips != NULL || num == 0, ESP_ERR_INVALID_ARG, TAG, "NULL strips");
     esp_err_t ret = ESP_OK;
-    ESP_RETURN_ON_FALSE(rmt_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL config");
+    uint32_t rmt_pending = 0;
+    // convert all members first, so that the transfers are started back to back
+    for (uint32_t i = 0; i < num; ++i) {
+        ESP_RETURN_ON_FALSE(strips[i] != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+        led_strip_pwe_t *ws2812 = __containerof(strips[i], led_strip_pwe_t, parent);
+        ESP_RETURN_ON_ERROR(led_strip_pwe_prepare(ws2812), TAG, "Failed to prepare pixels");
+        rmt_pending += ws2812->pending && ws2812->rmt_backend;
+    }
+    /*
+     * RMT channels in sync group wait until all of them are started, so only channels having something to send can
+     * join. Without TX sync support they are just started one after another.
+     */
+#if !CONFIG_IDF_TARGET_LINUX
+    for (uint32_t i = 0; i < num && rmt_pending > 1; ++i) {
+        led_strip_pwe_t *ws2812 = __containerof(strips[i], led_strip_pwe_t, parent);
+        if (ws2812->pending && ws2812->rmt_backend) {
+            if (pwe_rmt_add_to_sync_group(ws2812->pwe_handle) != ESP_OK) {
+                led_strip_pwe_leave_sync_group(strips, i);
+                break;
+            }
+            ws2812->in_sync_group = true;
+        }
+    }
+#endif
+    for (uint32_t i = 0; i < num && ret == ESP_OK; ++i) {
+        ret = led_strip_pwe_start(__containerof(strips[i], led_strip_pwe_t, parent), true);
+    }
+    // channels started so far are released if the group can not be completed
+    led_strip_pwe_leave_sync_group(strips, num);
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to start group transfer");
+    for (uint32_t i = 0; i < num; ++i) {
+        led_strip_pwe_t *ws2812 = __containerof(strips[i], led_strip_pwe_t, parent);
+        ESP_RETURN_ON_ERROR(pwe_wait_done(ws2812->pwe_handle, timeout_ms), TAG, "Failed to wait transfer done");
+    }
+    return ESP_OK;
+}
+
+static void led_strip_pwe_update_lut(led_strip_pwe_t *ws2812)
+{
+    for (uint32_t v = 0; v < 256; ++v) {
+        float x = v / 255.0f;
+        if (ws2812->gamma != 1.0f) {
+            x = powf(x, ws2812->gamma);
+        }
+        ws2812->lut[v] = (uint8_t)(x * ws2812->brightness + 0.5f);
+    }
+    bool identity = ws2812->brightness == 255 && ws2812->gamma == 1.0f;
+    pwe_set_byte_lut(ws2812->pwe_handle, identity ? NULL : ws2812->lut);
+    if (!ws2812->write_through) {
+        // colors are kept untouched, next refresh converts all of them with the new table
+        led_strip_pwe_mark_dirty(ws2812, 0, ws2812->strip_len);
+    }
+}
+
+esp_err_t led_strip_pwe_set_brightness(led_strip_handle_t strip, uint8_t brightness)
+{
     ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
+    ws2812->brightness = brightness;
+    led_strip_pwe_update_lut(ws2812);
+    return ESP_OK;
+}
+
+esp_err_t led_strip_pwe_set_gamma(led_strip_handle_t strip, float gamma)
+{
+    ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    ESP_RETURN_ON_FALSE(gamma > 0.0f, ESP_ERR_INVALID_ARG, TAG, "invalid gamma");
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
+    ws2812->gamma = gamma;
+    led_strip_pwe_update_lut(ws2812);
+    return ESP_OK;
+}
 
+static inline size_t led_strip_pwe_handle_size(const led_strip_config *led_conf, uint16_t led_num)
+{
     // 24 bits per led
-    uint32_t ws2812_size = sizeof(ws2812_t) + led_num * 3;
-    ws2812_t *ws2812 = calloc(1, sizeof(ws2812_t) + ws2812_size);
-    ESP_RETURN_ON_FALSE(ws2812 != NULL, ESP_ERR_NO_MEM, TAG, "Failed to alloc ws2812 handle");
+    return sizeof(led_strip_pwe_t) + ((led_conf->flags & LED_STRIP_PWE_FLAG_WRITE_THROUGH) ? 0 : led_num * 3);
+}
 
-    rmt_config_t rmt_config;
-    memcpy(&rmt_config, rmt_conf, sizeof(rmt_config_t));
-    rmt_config.clk_div = rmt_config.clk_div > 8 ? 8 : rmt_config.clk_div;   // minimum 10M
-    ESP_GOTO_ON_ERROR(pwe_new_rmt_backend(led_conf, &rmt_config, 0, &ws2812->pwe_handle), err, TAG, "Failed to create pwe_rmt backend");
+/**
+ * @brief Take the strip handle from the head of storage, or allocate it if storage is NULL
+ *
+ * @param pwe_storage: filled with what is left of storage for PWE backend, NULL if storage is NULL
+ * @param pwe_storage_size: filled with size of pwe_storage
+ */
+static esp_err_t led_strip_pwe_alloc(const led_strip_config *led_conf, uint16_t led_num, void *storage, size_t storage_size,
+                                     led_strip_pwe_t **ws2812, void **pwe_storage, size_t *pwe_storage_size)
+{
+    const size_t size = led_strip_pwe_handle_size(led_conf, led_num);
+    if (storage == NULL) {
+        *ws2812 = calloc(1, size);
+        ESP_RETURN_ON_FALSE(*ws2812 != NULL, ESP_ERR_NO_MEM, TAG, "Failed to alloc ws2812 handle");
+        *pwe_storage = NULL;
+        *pwe_storage_size = 0;
+        return ESP_OK;
+    }
+    const size_t offset = PWE_STORAGE_ALIGN_UP(size);
+    ESP_RETURN_ON_FALSE((uintptr_t)storage % PWE_STATIC_STORAGE_ALIGN == 0 && storage_size > offset, ESP_ERR_INVALID_SIZE,
+                        TAG, "storage must be more than %u bytes aligned to %d", (unsigned)offset, PWE_STATIC_STORAGE_ALIGN);
+    *ws2812 = memset(storage, 0, size);
+    (*ws2812)->static_storage = true;
+    *pwe_storage = (uint8_t *)storage + offset;
+    *pwe_storage_size = storage_size - offset;
+    return ESP_OK;
+}
 
+static void led_strip_pwe_free(led_strip_pwe_t *ws2812)
+{
+    if (!ws2812->static_storage) {
+        free(ws2812);
+    }
+}
+
+/**
+ * @brief Fill common fields after pwe_handle is created
+ */
+static esp_err_t led_strip_pwe_setup(led_strip_pwe_t *ws2812, const led_strip_config *led_conf, uint16_t led_num)
+{
     ws2812->strip_len = led_num;
+    // nothing has been sent yet, the whole strip is dirty
+    ws2812->dirty_start = 0;
+    ws2812->dirty_end = led_num;
+    ws2812->encoded_valid = false;
+    ws2812->partial_encode = true;
+    ws2812->outgoing_len = 0;
+    ws2812->write_through = led_conf->flags & LED_STRIP_PWE_FLAG_WRITE_THROUGH;
+    ws2812->pending = false;
+    ws2812->in_sync_group = false;
+    ws2812->brightness = 255;
+    ws2812->gamma = 1.0f;
 
     ws2812->parent.init = led_strip_pwe_init;
-    ws2812->parent.set_pixel = led_strip_pwe_set_pixel;
+    ws2812->parent.deinit = led_strip_pwe_deinit;
     ws2812->parent.refresh = led_strip_pwe_refresh;
+    if (led_conf->flags & LED_STRIP_PWE_FLAG_WRITE_THROUGH) {
+        ws2812->parent.set_pixel = led_strip_pwe_set_pixel_write_through;
+        ws2812->parent.set_pixels = led_strip_pwe_set_pixels_write_through;
+        ws2812->parent.clear = led_strip_pwe_clear_write_through;
+        // outgoing buffer starts with all pixels off, fails if backend cannot convert pixels in place
+        return led_strip_pwe_fill_black(ws2812);
+    }
+    ws2812->parent.set_pixel = led_strip_pwe_set_pixel;
+    ws2812->parent.set_pixels = led_strip_pwe_set_pixels;
     ws2812->parent.clear = led_strip_pwe_clear;
-    ws2812->parent.deinit = led_strip_pwe_deinit;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_pwe_get_handle(led_strip_handle_t strip, pwe_handle_t *pwe)
+{
+    ESP_RETURN_ON_FALSE(strip != NULL && pwe != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
+    *pwe = ws2812->pwe_handle;
+    return ESP_OK;
+}
+
+esp_err_t led_strip_new_pwe_sim(const led_strip_config *led_conf, uint16_t led_num, const pwe_io_sim_config_t *sim_conf, led_strip_handle_t *strip)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(led_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL config");
+    ESP_RETURN_ON_FALSE(sim_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL config");
+    ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+
+    led_strip_pwe_t *ws2812 = calloc(1, led_strip_pwe_handle_size(led_conf, led_num));
+    ESP_RETURN_ON_FALSE(ws2812 != NULL, ESP_ERR_NO_MEM, TAG, "Failed to alloc ws2812 handle");
+
+    ESP_GOTO_ON_ERROR(pwe_new_sim_backend(led_conf, sim_conf, led_num * 3 * 8, &ws2812->pwe_handle), err, TAG, "Failed to create pwe_sim backend");
+    ESP_GOTO_ON_ERROR(led_strip_pwe_setup(ws2812, led_conf, led_num), err_setup, TAG, "Failed to setup strip");
 
     *strip = &ws2812->parent;
     return ESP_OK;
+err_setup:
+    pwe_delete_sim_backend(ws2812->pwe_handle);
 err:
-    free(ws2812);
+    led_strip_pwe_free(ws2812);
     return ret;
 }
 
+esp_err_t led_strip_del_pwe_sim(led_strip_handle_t strip)
+{
+    ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
+    ESP_RETURN_ON_ERROR(pwe_delete_sim_backend(ws2812->pwe_handle), TAG, "Failed to delete pwe_sim backend");
+    led_strip_pwe_free(ws2812);
+    return ESP_OK;
+}
+
+#if !CONFIG_IDF_TARGET_LINUX
+static esp_err_t led_strip_pwe_create_rmt(const led_strip_config *led_conf, uint16_t led_num, const rmt_config_t *rmt_conf,
+                                          void *storage, size_t storage_size, led_strip_handle_t *strip)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(led_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL config");
+    ESP_RETURN_ON_FALSE(rmt_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL config");
+    ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+
+    led_strip_pwe_t *ws2812 = NULL;
+    void *pwe_storage = NULL;
+    size_t pwe_storage_size = 0;
+    ESP_RETURN_ON_ERROR(led_strip_pwe_alloc(led_conf, led_num, storage, storage_size, &ws2812, &pwe_storage, &pwe_storage_size),
+                        TAG, "Failed to create ws2812 handle");
+
+    rmt_config_t rmt_config;
+    memcpy(&rmt_config, rmt_conf, sizeof(rmt_config_t));
+    rmt_config.clk_div = rmt_config.clk_div > 8 ? 8 : rmt_config.clk_div;   // minimum 10M
+    // convert on the fly unless pixels are written through into outgoing buffer
+    uint32_t buffer_size = (led_conf->flags & LED_STRIP_PWE_FLAG_WRITE_THROUGH) ? led_num * 3 * 8 : 0;
+    ret = pwe_storage ? pwe_rmt_backend_init_static(led_conf, &rmt_config, buffer_size, pwe_storage, pwe_storage_size, &ws2812->pwe_handle) :
+          pwe_new_rmt_backend(led_conf, &rmt_config, buffer_size, &ws2812->pwe_handle);
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "Failed to create pwe_rmt backend");
+    ws2812->rmt_backend = true;
+    ESP_GOTO_ON_ERROR(led_strip_pwe_setup(ws2812, led_conf, led_num), err_setup, TAG, "Failed to setup strip");
+
+    *strip = &ws2812->parent;
+    return ESP_OK;
+err_setup:
+    pwe_delete_rmt_backend(ws2812->pwe_handle);
+err:
+    led_strip_pwe_free(ws2812);
+    return ret;
+}
+
+esp_err_t led_strip_new_pwe_rmt(const led_strip_config *led_conf, uint16_t led_num, const rmt_config_t *rmt_conf, led_strip_handle_t *strip)
+{
+    return led_strip_pwe_create_rmt(led_conf, led_num, rmt_conf, NULL, 0, strip);
+}
+
+esp_err_t led_strip_pwe_rmt_init_static(const led_strip_config *led_conf, uint16_t led_num, const rmt_config_t *rmt_conf,
+                                        void *storage, size_t storage_size, led_strip_handle_t *strip)
+{
+    ESP_RETURN_ON_FALSE(storage != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL storage");
+    return led_strip_pwe_create_rmt(led_conf, led_num, rmt_conf, storage, storage_size, strip);
+}
+
 esp_err_t led_strip_del_pwe_rmt(led_strip_handle_t strip)
 {
     ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
-    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
     ESP_RETURN_ON_ERROR(pwe_delete_rmt_backend(ws2812->pwe_handle), TAG, "Failed to delete pwe_rmt backend");
-    free(ws2812);
+    led_strip_pwe_free(ws2812);
     return ESP_OK;
 }
 
-esp_err_t led_strip_new_pwe_spi(const led_strip_config *led_conf, uint16_t led_num, const pwe_io_spi_config_t *spi_conf, led_strip_handle_t *strip)
+static esp_err_t led_strip_pwe_create_spi(const led_strip_config *led_conf, uint16_t led_num, const pwe_io_spi_config_t *spi_conf,
+                                          void *storage, size_t storage_size, led_strip_handle_t *strip)
 {
     esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(led_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL config");
     ESP_RETURN_ON_FALSE(spi_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL config");
     ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
 
-    // 24 bits per led
-    uint32_t ws2812_size = sizeof(ws2812_t) + led_num * 3;
-    ws2812_t *ws2812 = calloc(1, ws2812_size);
-    ESP_RETURN_ON_FALSE(ws2812 != NULL, ESP_ERR_NO_MEM, TAG, "Failed to alloc ws2812 handle");
+    led_strip_pwe_t *ws2812 = NULL;
+    void *pwe_storage = NULL;
+    size_t pwe_storage_size = 0;
+    ESP_RETURN_ON_ERROR(led_strip_pwe_alloc(led_conf, led_num, storage, storage_size, &ws2812, &pwe_storage, &pwe_storage_size),
+                        TAG, "Failed to create ws2812 handle");
 
-    ESP_GOTO_ON_ERROR(pwe_new_spi_backend(led_conf, spi_conf, ws2812_size * 8, &ws2812->pwe_handle), err, TAG, "Failed to create pwe_rmt backend");
-
-    ws2812->strip_len = led_num;
-
-    ws2812->parent.init = led_strip_pwe_init;
-    ws2812->parent.set_pixel = led_strip_pwe_set_pixel;
-    ws2812->parent.refresh = led_strip_pwe_refresh;
-    ws2812->parent.clear = led_strip_pwe_clear;
-    ws2812->parent.deinit = led_strip_pwe_deinit;
+    ret = pwe_storage ? pwe_spi_backend_init_static(led_conf, spi_conf, led_num * 3 * 8, pwe_storage, pwe_storage_size, &ws2812->pwe_handle) :
+          pwe_new_spi_backend(led_conf, spi_conf, led_num * 3 * 8, &ws2812->pwe_handle);
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "Failed to create pwe_spi backend");
+    ESP_GOTO_ON_ERROR(led_strip_pwe_setup(ws2812, led_conf, led_num), err_setup, TAG, "Failed to setup strip");
 
     *strip = &ws2812->parent;
     return ESP_OK;
+err_setup:
+    pwe_delete_spi_backend(ws2812->pwe_handle);
 err:
-    free(ws2812);
+    led_strip_pwe_free(ws2812);
     return ret;
 }
 
+esp_err_t led_strip_new_pwe_spi(const led_strip_config *led_conf, uint16_t led_num, const pwe_io_spi_config_t *spi_conf, led_strip_handle_t *strip)
+{
+    return led_strip_pwe_create_spi(led_conf, led_num, spi_conf, NULL, 0, strip);
+}
+
+esp_err_t led_strip_pwe_spi_init_static(const led_strip_config *led_conf, uint16_t led_num, const pwe_io_spi_config_t *spi_conf,
+                                        void *storage, size_t storage_size, led_strip_handle_t *strip)
+{
+    ESP_RETURN_ON_FALSE(storage != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL storage");
+    return led_strip_pwe_create_spi(led_conf, led_num, spi_conf, storage, storage_size, strip);
+}
+
 esp_err_t led_strip_del_pwe_spi(led_strip_handle_t strip)
 {
     ESP_RETURN_ON_FALSE(strip != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
-    ws2812_t *ws2812 = __containerof(strip, ws2812_t, parent);
+    led_strip_pwe_t *ws2812 = __containerof(strip, led_strip_pwe_t, parent);
     ESP_RETURN_ON_ERROR(pwe_delete_spi_backend(ws2812->pwe_handle), TAG, "Failed to delete pwe_rmt backend");
-    free(ws2812);
+    led_strip_pwe_free(ws2812);
     return ESP_OK;
 }
+#endif // !CONFIG_IDF_TARGET_LINUX
@@ -10,8 +10,15 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
+#include <sys/cdefs.h>
 #include "esp_err.h"
 
+// backends recover their handle from pwe_handle_t with it, newlib provides it but host libc does not
+#ifndef __containerof
+#define __containerof(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
 /*
  * Pulse Width Encoding
  *  |    T0H  T0L   T1H  T1L          TxH  TxL     TRST    TxH
@@ -44,12 +51,47 @@ typedef struct {
     uint32_t T1L_ACC;   /*<! T1L accept range */
     uint32_t T0H_ACC;   /*<! T0H accept range */
     uint32_t T0L_ACC;   /*<! T0L accept range */
+    uint32_t flags;     /*<! PWE_FLAG_x */
 } pwe_config_t;
 
+/**
+ * @brief Allocate two outgoing buffers, so that pwe_send_async() can convert next frame while current one is on the wire
+ */
+#define PWE_FLAG_DOUBLE_BUFFER      (1 << 0)
+
+/* Bits 16~31 of flags are left for drivers built on top of PWE */
+
+/**
+ * @brief Number of outgoing buffers a backend allocates for given flags
+ */
+#define PWE_BUFFER_NUM(flags)       (((flags) & PWE_FLAG_DOUBLE_BUFFER) ? 2 : 1)
+
+/*
+ * Storage passed to *_init_static() functions must be aligned to PWE_STATIC_STORAGE_ALIGN, e.g.
+ *
+ *     static uint8_t s_storage[PWE_RMT_STORAGE_SIZE(256, 0)] PWE_STATIC_STORAGE_ATTR;
+ *
+ * Sizes given by *_STORAGE_SIZE() macros are enough for any build, the exact size required is checked at runtime.
+ */
+#define PWE_STATIC_STORAGE_ALIGN    8
+#define PWE_STATIC_STORAGE_ATTR     __attribute__((aligned(PWE_STATIC_STORAGE_ALIGN)))
+#define PWE_STORAGE_ALIGN_UP(size)  (((size) + PWE_STATIC_STORAGE_ALIGN - 1) / PWE_STATIC_STORAGE_ALIGN * PWE_STATIC_STORAGE_ALIGN)
+
+/**
+ * @brief Callback invoked when a transmission is done
+ *
+ * @note Called from ISR context
+ */
+typedef void (*pwe_done_cb_t)(pwe_handle_t handle, void *user_ctx);
+
 typedef esp_err_t (*pwe_iodriver_init)(pwe_handle_t handle);
 typedef esp_err_t (*pwe_iodriver_on_the_fly_send)(pwe_handle_t handle, const void *data, uint32_t len);
+typedef esp_err_t (*pwe_iodriver_on_the_fly_send_async)(pwe_handle_t handle, const void *data, uint32_t len);
 typedef esp_err_t (*pwe_iodriver_convert_buffer)(pwe_handle_t handle, const void *data, uint32_t len, uint32_t *outgoing_buffer_len);
+typedef esp_err_t (*pwe_iodriver_convert_range)(pwe_handle_t handle, const void *data, uint32_t offset, uint32_t len, uint32_t *outgoing_buffer_len);
 typedef esp_err_t (*pwe_iodriver_write)(pwe_handle_t handle, uint32_t len);
+typedef esp_err_t (*pwe_iodriver_write_async)(pwe_handle_t handle, uint32_t len);
+typedef esp_err_t (*pwe_iodriver_wait_done)(pwe_handle_t handle, uint32_t timeout_ms);
 typedef esp_err_t (*pwe_iodriver_ensure_rst)(pwe_handle_t handle);
 typedef esp_err_t (*pwe_iodriver_deinit)(pwe_handle_t handle);
 
@@ -61,10 +103,18 @@ struct pwe_s {
     pwe_iodriver_init init;
     pwe_iodriver_deinit deinit;
     pwe_iodriver_on_the_fly_send on_the_fly_send;
+    pwe_iodriver_on_the_fly_send_async on_the_fly_send_async;
     pwe_iodriver_convert_buffer convert_buffer;
+    pwe_iodriver_convert_range convert_range;
     pwe_iodriver_write write;
+    pwe_iodriver_write_async write_async;
+    pwe_iodriver_wait_done wait_done;
     pwe_iodriver_ensure_rst ensure_rst;
     uint32_t max_payload_length;
+    pwe_done_cb_t done_cb;
+    void *done_cb_ctx;
+    const uint8_t *byte_lut;
+    const struct pwe_timing_s *timing;  /*!< Resolved by backend, see pwe_get_timing() */
 };
 
 /**
@@ -102,6 +152,68 @@ esp_err_t pwe_deinit(pwe_handle_t handle);
 */
 esp_err_t pwe_send(pwe_handle_t handle, const void *data, uint32_t len);
 
+/**
+ * @brief Send n bits of data with pwe without waiting for the transmission to finish
+ *
+ * Data is converted into the idle outgoing buffer first, then the call waits for the previous transmission (if any)
+ * plus TRST after it, and starts the new one. With PWE_FLAG_DOUBLE_BUFFER the conversion of frame N+1 overlaps the
+ * transmission of frame N.
+ *
+ * If PWE is created with zero length outgoing buffer, data is converted on the fly while being sent, so it must stay
+ * untouched until pwe_wait_done() returns. A runtime error is reported if driver cannot do this without blocking.
+ *
+ * @param handle: PWE handle
+ * @param data: data to be sent, can be reused once this function returns unless converted on the fly
+ * @param len: length to be sent, in bits
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_send_async(pwe_handle_t handle, const void *data, uint32_t len);
+
+/**
+ * @brief Wait until all pending transmissions are done
+ *
+ * @param handle: PWE handle
+ * @param timeout_ms: maximum time to wait
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_TIMEOUT
+ */
+esp_err_t pwe_wait_done(pwe_handle_t handle, uint32_t timeout_ms);
+
+/**
+ * @brief Register callback invoked each time a frame is done
+ *
+ * Not invoked for what pwe_ensure_rst() puts on the wire.
+ *
+ * @param handle: PWE handle
+ * @param cb: callback, NULL to unregister
+ * @param user_ctx: argument passed to callback
+ *
+ * @note Should be called before pwe_init()
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_register_done_callback(pwe_handle_t handle, pwe_done_cb_t cb, void *user_ctx);
+
+/**
+ * @brief Set a table every source byte is mapped through while being converted
+ *
+ * Lets users such as LED drivers apply brightness or gamma without an extra pass over their data.
+ *
+ * @param handle: PWE handle
+ * @param lut: 256 entries table, must stay valid while in use. NULL to disable
+ *
+ * @note In streaming mode the table is read from ISR context, so it must be placed in internal RAM
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_set_byte_lut(pwe_handle_t handle, const uint8_t *lut);
+
 /**
  * @brief Convert data and filling them to outgoing buffer(MSBit)
  *
@@ -119,6 +231,25 @@ esp_err_t pwe_send(pwe_handle_t handle, const void *data, uint32_t len);
  */
 esp_err_t pwe_io_convert_buffer(pwe_handle_t handle, const void *data, uint32_t len, uint32_t *outgoing_buffer_len);
 
+/**
+ * @brief Convert part of data into the matching position of outgoing buffer, leaving the rest of it untouched
+ *
+ * Used to update a previously converted frame in place. Only available when the encoded width of logical 0 and 1 is
+ * the same, so that the position of each bit in outgoing buffer is fixed.
+ *
+ * @param handle: PWE handle
+ * @param data: data to be converted, holding bits [offset, offset + len) of the frame
+ * @param offset: position of data in the frame, in bits, must be multiple of 8
+ * @param len: number of bits to be converted, must be multiple of 8
+ * @param outgoing_buffer_len: return length of outgoing buffer covering bits [0, offset + len)
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NOT_SUPPORTED: backend cannot update in place, or logical 0 and 1 are encoded with different width.
+ *                             Not logged, the caller is expected to fall back to pwe_io_convert_buffer()
+ */
+esp_err_t pwe_io_convert_range(pwe_handle_t handle, const void *data, uint32_t offset, uint32_t len, uint32_t *outgoing_buffer_len);
+
 /**
  * @brief Write out outgoing buffer
  *
@@ -132,6 +263,19 @@ esp_err_t pwe_io_convert_buffer(pwe_handle_t handle, const void *data, uint32_t
  */
 esp_err_t pwe_io_write(pwe_handle_t handle, uint32_t len);
 
+/**
+ * @brief Start writing out outgoing buffer without waiting for it to finish
+ *
+ * @param handle: PWE handle
+ * @param len: length of outgoing buffer to be sent, in bits
+ *
+ * @note Outgoing buffer must not be converted again until the transmission is done, see pwe_wait_done()
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_io_write_async(pwe_handle_t handle, uint32_t len);
+
 /**
  * @brief Delay a period defined by TRST
  *
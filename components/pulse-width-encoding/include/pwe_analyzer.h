@@ -0,0 +1,108 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "pwe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Timing-fidelity analyzer
+ *
+ * Decodes waveforms generated by a backend back into bits, checks them against the source data and measures how far
+ * each pulse is from the configured width. Works on any target including linux, nothing is sent.
+ */
+
+#define PWE_ANALYZER_HIST_BINS      32
+
+/**
+ * @brief Pulse kinds measured by the analyzer, index of pwe_analyzer_report_t::pulse
+ */
+typedef enum {
+    PWE_ANALYZER_T0H,
+    PWE_ANALYZER_T0L,
+    PWE_ANALYZER_T1H,
+    PWE_ANALYZER_T1L,
+    PWE_ANALYZER_PULSE_MAX,
+} pwe_analyzer_pulse_t;
+
+/**
+ * @brief Error distribution of one pulse kind, error = generated width - configured width
+ */
+typedef struct {
+    uint32_t count;
+    uint32_t out_of_range;                  /*!< Pulses whose absolute error is not below TxX_ACC */
+    int32_t min_error_ns;
+    int32_t max_error_ns;
+    int64_t sum_error_ns;
+    uint32_t bins[PWE_ANALYZER_HIST_BINS];  /*!< Bin i counts errors in [(i - BINS / 2) * bin_ns, (i - BINS / 2 + 1) * bin_ns),
+                                                 the first and last bins also count everything beyond them */
+} pwe_analyzer_hist_t;
+
+typedef struct {
+    uint32_t bin_ns;                        /*!< Width of histogram bins */
+    uint32_t bits;                          /*!< Bits decoded from the waveform */
+    uint32_t mismatches;                    /*!< Bits differing from the source data, missing and extra bits included */
+    uint64_t duration_ns;                   /*!< From the first rising edge to the end of the last bit */
+    uint32_t bitrate;                       /*!< Effective bitrate, bits per second */
+    pwe_analyzer_hist_t pulse[PWE_ANALYZER_PULSE_MAX];
+} pwe_analyzer_report_t;
+
+/**
+ * @brief Analyze a fixed rate sample stream, such as the outgoing buffer of SPI backend
+ *
+ * @param config: configuration the waveform was generated for
+ * @param samples: line level of each sample, MSBit of the first byte first
+ * @param sample_num: number of samples
+ * @param sample_hz: sample rate
+ * @param src: source data the waveform was generated from, MSBit first. NULL to skip round-trip check
+ * @param src_bits: number of bits in src
+ * @param bin_ns: width of histogram bins, 0 for 10ns
+ * @param report: filled with result
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG
+ */
+esp_err_t pwe_analyze_samples(const pwe_config_t *config, const uint8_t *samples, uint32_t sample_num, uint32_t sample_hz,
+                              const void *src, uint32_t src_bits, uint32_t bin_ns, pwe_analyzer_report_t *report);
+
+/**
+ * @brief Analyze RMT items, such as the outgoing buffer of RMT backend
+ *
+ * @param config: configuration the waveform was generated for
+ * @param items: rmt_item32_t::val of each item, an item with zero duration ends the waveform
+ * @param item_num: number of items
+ * @param tick_hz: RMT tick frequency which item durations count in
+ * @param src: source data the waveform was generated from, MSBit first. NULL to skip round-trip check
+ * @param src_bits: number of bits in src
+ * @param bin_ns: width of histogram bins, 0 for 10ns
+ * @param report: filled with result
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG
+ */
+esp_err_t pwe_analyze_items(const pwe_config_t *config, const uint32_t *items, uint32_t item_num, uint32_t tick_hz,
+                            const void *src, uint32_t src_bits, uint32_t bin_ns, pwe_analyzer_report_t *report);
+
+/**
+ * @brief Smallest distance between the error of any analyzed pulse and its TxX_ACC
+ *
+ * @param config: configuration passed to the analysis
+ * @param report: analysis result
+ *
+ * @return margin in ns, 0 or negative if some pulse is out of range
+ */
+int32_t pwe_analyzer_margin_ns(const pwe_config_t *config, const pwe_analyzer_report_t *report);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "soc/soc_caps.h"
+#include "pwe.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if SOC_LCD_I80_SUPPORTED
+
+#define PWE_IO_I2S_MAX_LANES    16
+
+typedef struct {
+    gpio_num_t gpio[PWE_IO_I2S_MAX_LANES];  /*!< Data line of each lane, the first lane_num are used */
+    uint8_t lane_num;                       /*!< 8 or 16 */
+    gpio_num_t wr_gpio;                     /*!< Sample clock driven by the LCD peripheral, a spare pin */
+    gpio_num_t dc_gpio;                     /*!< D/C line driven by the LCD peripheral, a spare pin */
+} pwe_io_i2s_config_t;
+
+/**
+ * @brief Create PWE interface with I2S peripheral in parallel (LCD) mode
+ *
+ * One DMA stream drives all lanes at once: each lane is a separate line, such as a LED strip, sharing the same timing.
+ *
+ * Data passed to pwe_send(), pwe_io_convert_buffer() and pwe_io_convert_range() holds lane_num blocks of
+ * UINTCEILDIV(len, 8) bytes back to back, block i for lane i. len is the number of bits of each lane.
+ *
+ * @param config: PWE configuration
+ * @param i2s_conf: I2S configuration
+ * @param buffer_size: maximum length that will be sent on each lane, bits. Streaming mode is not supported
+ * @param handle: filled with created handle
+ *
+ * @note TxH + TxL of logical 0 and 1 must resolve to the same number of samples, as all lanes share one sample clock
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: lane_num other than 8 or 16, or buffer_size 0
+ *      ESP_ERR_NOT_FOUND: timing cannot be resolved within TxX_ACC with equal widths of logical 0 and 1
+ */
+esp_err_t pwe_new_i2s_backend(const pwe_config_t *config, const pwe_io_i2s_config_t *i2s_conf, uint32_t buffer_size, pwe_handle_t *handle);
+
+/**
+ * @brief Delete I2S based PWE interface
+ *
+ * @param config: handle
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_delete_i2s_backend(pwe_handle_t handle);
+
+#endif // SOC_LCD_I80_SUPPORTED
+
+#ifdef __cplusplus
+}
+#endif
@@ -9,11 +9,66 @@
 #include "pwe.h"
 #include "driver/rmt.h"
 #include "driver/gpio.h"
+#include "esp_intr_alloc.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Storage taken by the handle itself, not counting outgoing buffers
+ */
+#define PWE_RMT_HANDLE_SIZE     sizeof(pwe_io_rmt_handle_t)
+
+/**
+ * @brief Storage required by pwe_rmt_backend_init_static()
+ *
+ * @param bits: buffer_size passed to it, 0 for streaming mode
+ * @param flags: flags of pwe_config_t
+ */
+#define PWE_RMT_STORAGE_SIZE(bits, flags)   (PWE_RMT_HANDLE_SIZE + PWE_BUFFER_NUM(flags) * (bits) * sizeof(rmt_item32_t))
+
+/**
+ * @brief Cost of the translator refilling RMT memory from ISR in streaming mode
+ */
+typedef struct {
+    uint32_t calls;                 /*!< Translator invocations */
+    uint32_t min_cycles;            /*!< Shortest invocation, CPU cycles */
+    uint32_t max_cycles;            /*!< Longest invocation, CPU cycles */
+    uint32_t avg_cycles;            /*!< Average invocation, CPU cycles */
+    uint32_t refill_items;          /*!< Smallest number of items requested at once, i.e. half of RMT memory */
+    uint32_t refill_deadline_ns;    /*!< Wire time of refill_items shortest bits, which max_cycles has to stay below */
+    uint32_t refill_misses;         /*!< Refills done after the hardware needed them, sending stale items instead */
+} pwe_rmt_translator_stats_t;
+
+/**
+ * @brief How the RMT driver is installed, see pwe_rmt_set_driver_config()
+ */
+typedef struct {
+    int intr_alloc_flags;       /*!< ESP_INTR_FLAG_x passed to rmt_driver_install(), 0 for default */
+    int core_id;                /*!< Core to install the driver on, thus to run its ISR, -1 for the core calling pwe_init() */
+    uint8_t max_mem_blocks;     /*!< Most RMT memory blocks to take, 0 to keep rmt_conf->mem_block_num */
+} pwe_io_rmt_driver_config_t;
+
+#define PWE_IO_RMT_DRIVER_CONFIG_DEFAULT()  \
+    {                                       \
+        .intr_alloc_flags = 0,              \
+        .core_id = -1,                      \
+        .max_mem_blocks = 0,                \
+    }
+
+/**
+ * @brief Keep the ISR away from Wi-Fi: IRAM safe at the highest level C handlers can take, on a core of choice,
+ *        with memory of up to 4 channels to refill less often and with more time to spare. Not for
+ *        pwe_rmt_start_continuous()
+ */
+#define PWE_IO_RMT_DRIVER_CONFIG_COEX(core)                             \
+    {                                                                   \
+        .intr_alloc_flags = ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL3,  \
+        .core_id = (core),                                              \
+        .max_mem_blocks = 4,                                            \
+    }
+
 /**
  * @brief Create PWE interface with RMT driver
  *
@@ -25,11 +80,172 @@ extern "C" {
  * @note The actual outgoing buffer size that is required by the driver differs.
  *       buffer_size should be the maximum bit count that later this driver can consume
  *
+ * @note rmt_conf->clk_div is kept if it resolves the timing within TxX_ACC, otherwise (or if 0) the most accurate
+ *       divider is chosen instead. See pwe_get_timing() for the result
+ *
+ * @note The first pwe_init() of a RMT interface takes over the TX end callback of the RMT driver, which is global. A
+ *       callback registered before is kept and still called for channels not driven by PWE. One registered after
+ *       replaces PWE's: do not call rmt_register_tx_end_callback() once a RMT interface is initialized
+ *
  * @return
- *      PWE instance or NULL
+ *      ESP_OK
+ *      ESP_ERR_NOT_FOUND: timing cannot be resolved within TxX_ACC at any divider
  */
 esp_err_t pwe_new_rmt_backend(const pwe_config_t *config, const rmt_config_t *rmt_conf, uint32_t buffer_size, pwe_handle_t *handle);
 
+/**
+ * @brief Create PWE interface with RMT driver in caller provided storage, without allocating from heap
+ *
+ * Same as pwe_new_rmt_backend() otherwise. The storage must stay valid until pwe_delete_rmt_backend() is called,
+ * which does not free it.
+ *
+ * @param config: PWE configuration
+ * @param rmt_conf: RMT configuration
+ * @param buffer_size: maximum length that will be sent, bits
+ * @param storage: memory for the handle and its outgoing buffers, aligned to PWE_STATIC_STORAGE_ALIGN
+ * @param storage_size: size of storage, at least PWE_RMT_STORAGE_SIZE(buffer_size, config->flags)
+ * @param handle: filled with created handle
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG
+ *      ESP_ERR_INVALID_SIZE: storage too small or misaligned
+ *      ESP_ERR_NOT_FOUND: timing cannot be resolved within TxX_ACC at any divider
+ */
+esp_err_t pwe_rmt_backend_init_static(const pwe_config_t *config, const rmt_config_t *rmt_conf, uint32_t buffer_size,
+                                      void *storage, size_t storage_size, pwe_handle_t *handle);
+
+/**
+ * @brief Add the channel of a RMT based PWE interface into the TX sync group
+ *
+ * Once in the group, a transmission does not start until all channels in the group have been started, so that
+ * several interfaces driven one after another by pwe_send_async() or pwe_io_write_async() leave at the same time.
+ * Every channel in the group has to be started, otherwise none of them is sent out.
+ *
+ * @param handle: handle created by pwe_new_rmt_backend(), must not be transmitting
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NOT_SUPPORTED: target has no RMT TX sync, e.g. ESP32
+ */
+esp_err_t pwe_rmt_add_to_sync_group(pwe_handle_t handle);
+
+/**
+ * @brief Remove the channel of a RMT based PWE interface from the TX sync group
+ *
+ * @param handle: handle created by pwe_new_rmt_backend()
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NOT_SUPPORTED: target has no RMT TX sync
+ */
+esp_err_t pwe_rmt_remove_from_sync_group(pwe_handle_t handle);
+
+/**
+ * @brief Get outgoing buffer filled by latest conversion, such as to check it with pwe_analyze_items()
+ *
+ * @param handle: handle created by pwe_new_rmt_backend(), not in streaming mode
+ * @param items: filled with outgoing buffer, one item per bit
+ * @param tick_hz: filled with RMT tick frequency which item durations count in
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_STATE: streaming mode
+ */
+esp_err_t pwe_rmt_get_outgoing_buffer(pwe_handle_t handle, const rmt_item32_t **items, uint32_t *tick_hz);
+
+/**
+ * @brief Set how the RMT driver is installed
+ *
+ * With buffer_size not 0, memory blocks are sized for the payload and its end marker to fit without refill, up to
+ * max_mem_blocks. In streaming mode all max_mem_blocks are taken, a refill then comes every half of the memory.
+ * Channels following this one lend their memory and must stay unused. Only memory of TX channels is taken, RX channels
+ * following them keep theirs on ESP32-S3 and ESP32-C3. On ESP32, Wi-Fi runs on core 0 by default.
+ *
+ * @param handle: handle created by pwe_new_rmt_backend(), reinstalled if already initialized
+ * @param driver_conf: driver configuration
+ *
+ * @note The driver shares one interrupt among all RMT channels, the first channel installed decides its flags and core
+ * @note With ESP_INTR_FLAG_IRAM, the done callback and the byte table must be in IRAM / internal RAM as well
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: core_id out of range
+ */
+esp_err_t pwe_rmt_set_driver_config(pwe_handle_t handle, const pwe_io_rmt_driver_config_t *driver_conf);
+
+/**
+ * @brief Get cost of the translator since creation or last pwe_rmt_reset_translator_stats()
+ *
+ * Translator only runs in streaming mode, i.e. buffer_size is 0. Cycles include ISR time spent in it only, not the
+ * RMT driver around it.
+ *
+ * @param handle: handle created by pwe_new_rmt_backend()
+ * @param stats: filled with statistics, all zero if translator has not run
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_rmt_get_translator_stats(pwe_handle_t handle, pwe_rmt_translator_stats_t *stats);
+
+/**
+ * @brief Clear translator statistics
+ *
+ * @param handle: handle created by pwe_new_rmt_backend()
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_rmt_reset_translator_stats(pwe_handle_t handle);
+
+/**
+ * @brief Give the data of next frame in continuous mode, see pwe_rmt_start_continuous()
+ *
+ * @note Called from the TX end interrupt, which is never IRAM safe in continuous mode. Data is converted before it
+ *       returns
+ *
+ * @return data of the frame, len bits passed to pwe_rmt_start_continuous()
+ */
+typedef const void *(*pwe_rmt_next_frame_cb_t)(pwe_handle_t handle, void *user_ctx);
+
+/**
+ * @brief Send frames back to back until stopped, without any task involved
+ *
+ * Each frame is followed by TRST in RMT memory, the next one is asked from next_cb and started from the TX end
+ * interrupt, so that frames are TRST plus interrupt latency apart. The done callback is still invoked for each frame.
+ *
+ * @param handle: handle created by pwe_new_rmt_backend(), initialized and not in streaming mode
+ * @param len: length of every frame, bits, up to buffer_size
+ * @param next_cb: gives data of each frame, the first one included
+ * @param user_ctx: argument passed to next_cb
+ *
+ * @note Other writes fail with ESP_ERR_INVALID_STATE until pwe_rmt_stop_continuous()
+ * @note Frames are written to RMT memory and started by legacy driver calls in flash, which cannot run while flash
+ *       cache is disabled: the driver must not be installed with ESP_INTR_FLAG_IRAM, by this channel nor by the one
+ *       which installed the shared RMT interrupt first
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: len out of outgoing buffer
+ *      ESP_ERR_INVALID_STATE: not initialized, or already running
+ *      ESP_ERR_INVALID_SIZE: frame and TRST do not fit RMT memory of the channel
+ *      ESP_ERR_NOT_SUPPORTED: TRST too long to be held in RMT memory, or driver configured with ESP_INTR_FLAG_IRAM
+ */
+esp_err_t pwe_rmt_start_continuous(pwe_handle_t handle, uint32_t len, pwe_rmt_next_frame_cb_t next_cb, void *user_ctx);
+
+/**
+ * @brief Stop continuous mode once the frame on the wire is finished
+ *
+ * @param handle: handle created by pwe_new_rmt_backend()
+ * @param timeout_ms: maximum time to wait for the last frame
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_STATE: not running, including stopped by a failed restart
+ *      ESP_ERR_TIMEOUT
+ */
+esp_err_t pwe_rmt_stop_continuous(pwe_handle_t handle, uint32_t timeout_ms);
+
 /**
  * @brief Delete RMT based PWE interface
  *
@@ -43,3 +259,5 @@ esp_err_t pwe_delete_rmt_backend(pwe_handle_t handle);
 #ifdef __cplusplus
 }
 #endif
+
+#include "pwe_private/pwe_io_rmt_handle.h"
@@ -0,0 +1,63 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_idf_version.h"
+
+/* Needs rmt_simple_encoder of the RMT TX driver, only from ESP-IDF v5.3 on */
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+
+#include "pwe.h"
+#include "driver/gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    gpio_num_t gpio;
+    uint32_t resolution_hz;         /*!< RMT tick frequency, must divide the source clock. 0 to pick the most accurate one */
+    size_t mem_block_symbols;       /*!< RMT memory, or DMA buffer with with_dma, in symbols. 0 for default */
+    size_t trans_queue_depth;       /*!< Transactions queued in the driver. 0 for default */
+    bool with_dma;                  /*!< Feed RMT by DMA, where SOC_RMT_SUPPORT_DMA */
+} pwe_io_rmt_tx_config_t;
+
+/**
+ * @brief Create PWE interface with RMT TX driver (rmt_new_tx_channel)
+ *
+ * Bits are turned into symbols by an encoder, from the ISR as RMT memory or DMA buffer drains in streaming mode, or
+ * into the outgoing buffer beforehand otherwise. TRST is sent by the same encoder, so pwe_ensure_rst() does not delay.
+ *
+ * @param config: PWE configuration
+ * @param tx_conf: RMT TX configuration
+ * @param buffer_size: maximum length that will be sent, bits. 0 to encode on the fly
+ * @param handle: filled with created handle
+ *
+ * @note Cannot be used in the same application as pwe_new_rmt_backend(), the two RMT drivers do not coexist
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NOT_SUPPORTED: with_dma on a target without RMT DMA
+ *      ESP_ERR_NOT_FOUND: timing cannot be resolved within TxX_ACC
+ */
+esp_err_t pwe_new_rmt_tx_backend(const pwe_config_t *config, const pwe_io_rmt_tx_config_t *tx_conf, uint32_t buffer_size, pwe_handle_t *handle);
+
+/**
+ * @brief Delete RMT TX based PWE interface
+ *
+ * @param handle: handle
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_delete_rmt_tx_backend(pwe_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "pwe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t resolution_ns;     /*!< Pulse widths are rounded to multiple of it like a real peripheral, 0 to keep them as configured */
+    uint32_t max_edges;         /*!< Capacity of recorded timeline, further edges are dropped. 0 for default */
+    bool invert;                /*!< Line idles high and every level is inverted, as RMT_CHANNEL_FLAGS_INVERT_SIG does */
+} pwe_io_sim_config_t;
+
+/**
+ * @brief One level change of the simulated output line
+ */
+typedef struct {
+    uint64_t time_ns;           /*!< Time since the timeline was cleared */
+    uint8_t level;
+} pwe_sim_edge_t;
+
+/**
+ * @brief Create PWE interface which records the generated waveform instead of driving any peripheral
+ *
+ * The output line starts idle at time 0, low unless inverted. Each write lays pulses out back to back starting at current time, or TRST
+ * after the end of the previous write if that is later, as real backends wait for it. Current time is then moved to
+ * the end of the pulses. Transmissions finish immediately, so done callback is invoked from the caller.
+ * Available on all targets including linux, to check encoders and protocols on host.
+ *
+ * @param config: PWE configuration
+ * @param sim_conf: simulation configuration
+ * @param buffer_size: maximum length that will be sent, bits. 0 to send on the fly
+ * @param handle: filled with created handle
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_new_sim_backend(const pwe_config_t *config, const pwe_io_sim_config_t *sim_conf, uint32_t buffer_size, pwe_handle_t *handle);
+
+/**
+ * @brief Delete simulated PWE interface
+ *
+ * @param handle: handle
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_delete_sim_backend(pwe_handle_t handle);
+
+/**
+ * @brief Get recorded edges
+ *
+ * @param handle: handle created by pwe_new_sim_backend()
+ * @param edges: filled with recorded edges, valid until next write or pwe_sim_clear()
+ * @param num: filled with number of recorded edges
+ * @param dropped: filled with number of edges dropped for lack of space, can be NULL
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_sim_get_edges(pwe_handle_t handle, const pwe_sim_edge_t **edges, uint32_t *num, uint32_t *dropped);
+
+/**
+ * @brief Let line idle for a while, such as the interval between two frames
+ *
+ * @param handle: handle created by pwe_new_sim_backend()
+ * @param ns: time to advance
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_sim_advance(pwe_handle_t handle, uint64_t ns);
+
+/**
+ * @brief Drop recorded edges and restart timeline from 0, next write starts right away
+ *
+ * @param handle: handle created by pwe_new_sim_backend()
+ *
+ * @return
+ *      ESP_OK
+ */
+esp_err_t pwe_sim_clear(pwe_handle_t handle);
+
+/**
+ * @brief Write recorded timeline into a Value Change Dump file, with 1ns timescale
+ *
+ * @param handle: handle created by pwe_new_sim_backend()
+ * @param path: file to be written
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_FAIL: cannot write file
+ */
+esp_err_t pwe_sim_export_vcd(pwe_handle_t handle, const char *path);
+
+#ifdef __cplusplus
+}
+#endif
@@ -14,9 +14,40 @@
 extern "C" {
 #endif
 
+/* Streaming mode keeps this many DMA chunks in a ring, must not exceed queue_size of the device */
+#define PWE_IO_SPI_STREAM_CHUNK_NUM     3
+#define PWE_IO_SPI_STREAM_CHUNK_SIZE    1024
+/* A symbol must fit into 8 slots, so that a source nibble is encoded into one word */
+#define PWE_IO_SPI_MAX_SLOTS_PER_BIT    8
+
+/**
+ * @brief Storage taken by the handle itself, not counting outgoing buffers
+ */
+#define PWE_SPI_HANDLE_SIZE     sizeof(pwe_io_spi_handle_t)
+
+/**
+ * @brief Storage required by pwe_spi_backend_init_static()
+ *
+ * @param bits: buffer_size passed to it
+ * @param slots_per_bit: pwe_timing_t::slots_per_bit resolved for the configuration, PWE_IO_SPI_MAX_SLOTS_PER_BIT for any
+ * @param flags: flags of pwe_config_t
+ */
+#define PWE_SPI_STORAGE_SIZE(bits, slots_per_bit, flags) \
+    (PWE_SPI_HANDLE_SIZE + PWE_BUFFER_NUM(flags) * (((bits) * (slots_per_bit) + 31) / 32 * 4))
+
+/**
+ * @brief Storage required by pwe_spi_backend_init_static() in streaming mode
+ *
+ * @param chunk_size: stream_chunk_size of pwe_io_spi_config_t, PWE_IO_SPI_STREAM_CHUNK_SIZE if it is left 0
+ */
+#define PWE_SPI_STREAM_STORAGE_SIZE(chunk_size) \
+    (PWE_SPI_HANDLE_SIZE + PWE_IO_SPI_STREAM_CHUNK_NUM * (((chunk_size) + 3) / 4 * 4))
+
 typedef struct {
     gpio_num_t gpio;
     spi_host_device_t spi_bus;
+    uint32_t stream_chunk_size;     /*!< Size of each DMA chunk in streaming mode, bytes. 0 for default */
+    uint32_t clock_speed_hz;        /*!< Use this SPI clock instead of deriving one from timing, Hz. 0 for default */
 } pwe_io_spi_config_t;
 
 /**
@@ -30,11 +61,58 @@ typedef struct {
  * @note The actual outgoing buffer size that is required by the driver differs.
  *       buffer_size should be the maximum bit count that later this driver can consume
  *
+ * @note Unless spi_conf->clock_speed_hz is set, the SPI clock is the APB divider taking the fewest slots per bit within
+ *       TxX_ACC. See pwe_get_timing() for the result
+ *
+ * @note With buffer_size set to 0 the driver works in streaming mode: data is converted into a small ring of DMA chunks
+ *       (spi_conf->stream_chunk_size each) while previous chunks are being sent, so DMA memory usage does not depend on
+ *       data length. Chunks are separate SPI transactions, the short idle gap between them extends the low phase of a bit.
+ *       A frame fitting in the ring is queued whole before its first chunk starts. A longer one relies on each chunk
+ *       being refilled before the ring drains: should the wire stay idle for TRST / 2 in the middle of a frame, which a
+ *       LED strip could take as the end of it, the frame is sent again from the start after TRST. pwe_send() gives
+ *       ESP_ERR_TIMEOUT if that happens three times in a row.
+ *
  * @return
- *      PWE instance or NULL
+ *      ESP_OK
+ *      ESP_ERR_NOT_FOUND: timing cannot be resolved within TxX_ACC
  */
 esp_err_t pwe_new_spi_backend(const pwe_config_t *config, const pwe_io_spi_config_t *spi_conf, uint32_t buffer_size, pwe_handle_t *handle);
 
+/**
+ * @brief Create PWE interface with SPI host driver in caller provided storage, without allocating from heap
+ *
+ * Same as pwe_new_spi_backend() otherwise. The storage must stay valid until pwe_delete_spi_backend() is called,
+ * which does not free it.
+ *
+ * @param config: PWE configuration
+ * @param spi_conf: SPI config
+ * @param buffer_size: maximum length that will be sent, bits. 0 for streaming mode
+ * @param storage: memory for the handle and its outgoing buffers, DMA capable and aligned to PWE_STATIC_STORAGE_ALIGN
+ * @param storage_size: size of storage, see PWE_SPI_STORAGE_SIZE() and PWE_SPI_STREAM_STORAGE_SIZE()
+ * @param handle: filled with created handle
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG
+ *      ESP_ERR_INVALID_SIZE: storage too small or misaligned
+ *      ESP_ERR_NOT_FOUND: timing cannot be resolved within TxX_ACC
+ */
+esp_err_t pwe_spi_backend_init_static(const pwe_config_t *config, const pwe_io_spi_config_t *spi_conf, uint32_t buffer_size,
+                                      void *storage, size_t storage_size, pwe_handle_t *handle);
+
+/**
+ * @brief Get outgoing buffer filled by latest conversion, such as to check it with pwe_analyze_samples()
+ *
+ * @param handle: handle created by pwe_new_spi_backend(), not in streaming mode
+ * @param samples: filled with outgoing buffer, MSBit of the first byte goes out first
+ * @param sample_hz: filled with SPI clock, each bit of samples lasts one clock
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_STATE: streaming mode
+ */
+esp_err_t pwe_spi_get_outgoing_buffer(pwe_handle_t handle, const uint8_t **samples, uint32_t *sample_hz);
+
 /**
  * @brief Delete SPI based PWE interface
  *
@@ -48,3 +126,5 @@ esp_err_t pwe_delete_spi_backend(pwe_handle_t handle);
 #ifdef __cplusplus
 }
 #endif
+
+#include "pwe_private/pwe_io_spi_handle.h"
@@ -0,0 +1,71 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Handle of RMT backend, not part of public API. Only visible so that PWE_RMT_HANDLE_SIZE is its real size
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "pwe_io_rmt.h"
+#include "pwe_timing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PWE_IO_RMT_CHAIN_RESET_ITEMS    4       // TRST of continuous mode, up to 7 durations of 0x7fff ticks
+
+typedef struct {
+    struct pwe_s base;
+    rmt_config_t rmt_conf;
+    uint32_t trst;
+    uint16_t t1h;
+    uint16_t t1l;
+    uint16_t t0h;
+    uint16_t t0l;
+    uint32_t bit_items[2];      // rmt_item32_t of logical 0 and 1, indexed by bit value
+    pwe_timing_t timing;
+    uint8_t stream_pad_bits;    // bits of the last source byte not to be sent in streaming mode
+    uint32_t stream_items;      // items handed to RMT memory so far in current streaming transmission
+    int64_t stream_start_us;    // end of the first fill, roughly when the hardware starts sending
+    uint32_t bit_ns;            // wire time of the shortest bit
+    pwe_io_rmt_driver_config_t driver_conf;
+    bool installed;
+    portMUX_TYPE stats_lock;
+    uint32_t stats_calls;       // translator statistics, see pwe_rmt_get_translator_stats()
+    uint32_t stats_min_cycles;
+    uint32_t stats_max_cycles;
+    uint32_t stats_min_items;
+    uint32_t stats_refill_misses;
+    uint64_t stats_total_cycles;
+    uint32_t buffer_size;       // items per outgoing buffer
+    uint8_t buffer_num;         // 2 with PWE_FLAG_DOUBLE_BUFFER, otherwise 1
+    uint8_t fill_index;         // outgoing buffer to be filled by next convert_buffer()
+    uint8_t ready_index;        // outgoing buffer holding latest converted data
+    uint8_t busy_index;         // outgoing buffer being sent, valid if tx_in_flight
+    bool tx_in_flight;
+    volatile bool rst_in_flight;    // low level item of ensure_rst being sent, its end is not reported to done_cb
+    volatile int64_t tx_done_us;    // end of the latest transmission, set from tx end callback
+    bool static_storage;        // created by pwe_rmt_backend_init_static(), not to be freed
+    /* continuous mode, see pwe_rmt_start_continuous() */
+    pwe_rmt_next_frame_cb_t volatile chain_cb;  // set while running, next frame is started from TX end interrupt
+    void *chain_ctx;
+    uint32_t chain_bits;
+    volatile bool chain_stop;
+    TaskHandle_t chain_waiter;  // notified once the last frame is done
+    uint8_t chain_reset_num;    // items in chain_reset, 0 if TRST does not fit
+    rmt_item32_t chain_reset[PWE_IO_RMT_CHAIN_RESET_ITEMS]; // TRST and end marker, following every frame
+    rmt_item32_t buffer[0];
+} pwe_io_rmt_handle_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,53 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Handle of SPI backend, not part of public API. Only visible so that PWE_SPI_HANDLE_SIZE is its real size
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_attr.h"
+#include "pwe_io_spi.h"
+#include "pwe_timing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    struct pwe_s base;
+    pwe_io_spi_config_t spi_conf;
+    spi_device_handle_t iohdl;
+    uint32_t sclk;
+    uint8_t t1h;
+    uint8_t t1l;
+    uint8_t t0h;
+    uint8_t t0l;
+    pwe_timing_t timing;
+    uint32_t trst;
+    uint32_t buffer_size;
+    uint32_t buffer_stride;         // bytes between two outgoing buffers, word aligned
+    uint8_t buffer_num;             // 2 with PWE_FLAG_DOUBLE_BUFFER, otherwise 1
+    uint8_t fill_index;             // outgoing buffer to be filled by next convert_buffer()
+    uint8_t ready_index;            // outgoing buffer holding latest converted data
+    uint8_t busy_index;             // outgoing buffer being sent, valid if trans_in_flight
+    uint8_t trans_in_flight;        // queued transactions whose result is not collected yet
+    uint32_t stream_chunk_src_bits; // source bits encoded into one chunk in streaming mode
+    spi_transaction_t *stream_last; // last chunk of the frame in streaming mode, the only one calling done_cb
+    volatile int64_t trans_done_us; // end of the latest transaction, set from post_cb
+    spi_transaction_t trans[PWE_IO_SPI_STREAM_CHUNK_NUM];
+    uint32_t nibble_pattern[16];    // encoded slots of each source nibble, right aligned, MSBit first on wire
+    uint8_t nibble_slots[16];       // number of valid slots in nibble_pattern
+    bool static_storage;            // created by pwe_spi_backend_init_static(), not to be freed
+    uint8_t buffer[0] WORD_ALIGNED_ATTR;
+} pwe_io_spi_handle_t;
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "pwe.h"
+#include "pwe_timing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * RMT symbol encoder
+ *
+ * Turns PWE bits into RMT symbols (rmt_symbol_word_t / rmt_item32_t layout: duration0, level0, duration1, level1),
+ * followed by TRST on request. Encoding resumes from any symbol already written, the way rmt_simple_encoder refills
+ * RMT memory or DMA buffer chunk by chunk, so the whole encoder state is the position in the transmission.
+ * Does not depend on any driver, works on any target including linux.
+ */
+
+#define PWE_RMT_SYMBOLS_DIV_MAX         256     // RMT group clock prescaler
+#define PWE_RMT_SYMBOLS_MAX_TICKS       0x7fff  // duration fields are 15 bits
+
+typedef struct {
+    uint32_t bit_symbols[2];    /*!< Symbols of logical 0 and 1 */
+    uint32_t reset_ticks;       /*!< TRST, ticks */
+    const uint8_t *byte_lut;    /*!< Every source byte is mapped through it if not NULL, see pwe_set_byte_lut() */
+    uint32_t payload_bits;      /*!< Length of current transmission, bits */
+    bool with_reset;            /*!< Append TRST after payload in current transmission */
+} pwe_rmt_symbols_t;
+
+/**
+ * @brief Resolve timing and fill symbols of logical 0 and 1
+ *
+ * @param symbols: encoder to init
+ * @param config: PWE configuration
+ * @param src_hz: RMT source clock
+ * @param resolution_hz: tick frequency to use, must divide src_hz. 0 to pick the most accurate one
+ * @param timing: filled with resolved timing, tick frequency being timing->clock_hz
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NOT_FOUND: timing cannot be resolved within TxX_ACC
+ */
+esp_err_t pwe_rmt_symbols_init(pwe_rmt_symbols_t *symbols, const pwe_config_t *config, uint32_t src_hz,
+                               uint32_t resolution_hz, pwe_timing_t *timing);
+
+/**
+ * @brief Number of symbols a whole transmission takes with current payload_bits and with_reset
+ */
+size_t pwe_rmt_symbols_total(const pwe_rmt_symbols_t *symbols);
+
+/**
+ * @brief Encode next part of current transmission
+ *
+ * Same contract as rmt_encode_simple_cb_t, so that it can be used as one directly.
+ *
+ * @param data: source data, payload_bits long, MSBit first
+ * @param symbols_written: symbols of the transmission already written
+ * @param symbols_free: room in out, symbols
+ * @param out: where to write symbols
+ * @param done: set once the transmission is fully written
+ *
+ * @return number of symbols written, 0 only if symbols_free is 0 or done
+ */
+size_t pwe_rmt_symbols_encode(const pwe_rmt_symbols_t *symbols, const uint8_t *data, size_t symbols_written,
+                              size_t symbols_free, uint32_t *out, bool *done);
+
+#ifdef __cplusplus
+}
+#endif
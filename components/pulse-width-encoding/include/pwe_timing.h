@@ -0,0 +1,92 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pwe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Timing solver
+ *
+ * Backends build pulses from whole periods of a clock divided from a source clock: SPI and I2S samples, RMT ticks.
+ * The solver goes through the dividers a backend can use and picks the one that keeps every pulse within its TxX_ACC
+ * with the fewest slots per bit, i.e. the smallest outgoing buffer, or the smallest error on request.
+ */
+
+/**
+ * @brief Tell whether the peripheral can divide its source clock by div, NULL if every divider in range can be used
+ */
+typedef bool (*pwe_timing_div_filter_t)(uint32_t div);
+
+/**
+ * @brief What a backend can do with its clock
+ */
+typedef struct {
+    uint32_t src_hz;                    /*!< Source clock, Hz */
+    uint32_t div_min;                   /*!< Smallest divider */
+    uint32_t div_max;                   /*!< Largest divider */
+    pwe_timing_div_filter_t div_filter; /*!< Rejects dividers the peripheral cannot produce, NULL to accept all */
+    uint32_t max_slots_per_bit;         /*!< Limit of TxH + TxL, 0 for none */
+    uint32_t max_slots_per_pulse;       /*!< Limit of each TxH and TxL, 0 for none */
+    bool equal_width;                   /*!< Logical 0 and 1 must take the same number of slots */
+    bool min_error;                     /*!< Prefer the smallest error over the fewest slots per bit */
+} pwe_timing_constraints_t;
+
+/**
+ * @brief Timing resolved by the solver
+ */
+typedef struct pwe_timing_s {
+    uint32_t div;                       /*!< Chosen divider */
+    uint32_t clock_hz;                  /*!< src_hz / div, rounded down */
+    uint32_t slots_per_bit;             /*!< Largest of T0H + T0L and T1H + T1L, slots */
+    uint32_t t1h;                       /*!< T1H, slots */
+    uint32_t t1l;                       /*!< T1L, slots */
+    uint32_t t0h;                       /*!< T0H, slots */
+    uint32_t t0l;                       /*!< T0L, slots */
+    int32_t t1h_error_ns;               /*!< Generated T1H - configured T1H, rounded to ns */
+    int32_t t1l_error_ns;
+    int32_t t0h_error_ns;
+    int32_t t0l_error_ns;
+} pwe_timing_t;
+
+/**
+ * @brief Find the divider and slot counts best matching config
+ *
+ * Every divider between constraints->div_min and div_max is considered, errors are computed exactly from
+ * src_hz / div without rounding the slot period. To use a fixed clock, set div_min and div_max to 1 and src_hz to it.
+ *
+ * @param config: PWE configuration
+ * @param constraints: what the backend can do
+ * @param timing: filled with result
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_INVALID_ARG: null argument or empty divider range
+ *      ESP_ERR_NOT_FOUND: no divider keeps all pulses within TxX_ACC under the constraints
+ */
+esp_err_t pwe_timing_solve(const pwe_config_t *config, const pwe_timing_constraints_t *constraints, pwe_timing_t *timing);
+
+/**
+ * @brief Get timing resolved by the backend of a PWE handle
+ *
+ * @param handle: PWE handle
+ * @param timing: filled with timing
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_NOT_SUPPORTED: backend does not resolve timing with a divided clock, e.g. simulated backend
+ */
+esp_err_t pwe_get_timing(pwe_handle_t handle, pwe_timing_t *timing);
+
+#ifdef __cplusplus
+}
+#endif
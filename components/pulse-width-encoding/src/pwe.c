@@ -5,6 +5,7 @@
  */
 
 #include "pwe.h"
+#include "pwe_priv.h"
 #include "esp_check.h"
 
 static const char *TAG = "PWE";
@@ -42,6 +43,42 @@ esp_err_t pwe_send(pwe_handle_t handle, const void *data, uint32_t len)
     return ESP_OK;
 }
 
+esp_err_t pwe_send_async(pwe_handle_t handle, const void *data, uint32_t len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    if (handle->max_payload_length == 0) {
+        ESP_RETURN_ON_FALSE(handle->on_the_fly_send_async != NULL, ESP_ERR_INVALID_STATE, TAG, "on_the_fly_send_async() not supported by driver");
+        return handle->on_the_fly_send_async(handle, data, len);
+    }
+    ESP_RETURN_ON_FALSE(len <= handle->max_payload_length, ESP_ERR_INVALID_ARG, TAG, "Insufficient buffer size");
+    uint32_t outgoing_buffer_size = 0;
+    ESP_RETURN_ON_ERROR(pwe_io_convert_buffer(handle, data, len, &outgoing_buffer_size), TAG, "Failed to fill outgoing buffer");
+    ESP_RETURN_ON_ERROR(pwe_io_write_async(handle, outgoing_buffer_size), TAG, "Failed to write out data");
+    return ESP_OK;
+}
+
+esp_err_t pwe_wait_done(pwe_handle_t handle, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    ESP_RETURN_ON_FALSE(handle->wait_done != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL wait_done implementation");
+    return handle->wait_done(handle, timeout_ms);
+}
+
+esp_err_t pwe_register_done_callback(pwe_handle_t handle, pwe_done_cb_t cb, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    handle->done_cb = cb;
+    handle->done_cb_ctx = user_ctx;
+    return ESP_OK;
+}
+
+esp_err_t pwe_set_byte_lut(pwe_handle_t handle, const uint8_t *lut)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    handle->byte_lut = lut;
+    return ESP_OK;
+}
+
 esp_err_t pwe_io_convert_buffer(pwe_handle_t handle, const void *data, uint32_t len, uint32_t *outgoing_buffer_len)
 {
     ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
@@ -50,6 +87,18 @@ esp_err_t pwe_io_convert_buffer(pwe_handle_t handle, const void *data, uint32_t
     return handle->convert_buffer(handle, data, len, outgoing_buffer_len);
 }
 
+esp_err_t pwe_io_convert_range(pwe_handle_t handle, const void *data, uint32_t offset, uint32_t len, uint32_t *outgoing_buffer_len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    if (handle->convert_range == NULL) {
+        // not an error, callers fall back to converting whole frames
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    ESP_RETURN_ON_FALSE(offset % 8 == 0 && len % 8 == 0, ESP_ERR_INVALID_ARG, TAG, "Range not byte aligned");
+    ESP_RETURN_ON_FALSE(offset + len <= handle->max_payload_length, ESP_ERR_INVALID_ARG, TAG, "Insufficient buffer size");
+    return handle->convert_range(handle, data, offset, len, outgoing_buffer_len);
+}
+
 esp_err_t pwe_io_write(pwe_handle_t handle, uint32_t len)
 {
     ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
@@ -57,6 +106,13 @@ esp_err_t pwe_io_write(pwe_handle_t handle, uint32_t len)
     return handle->write(handle, len);
 }
 
+esp_err_t pwe_io_write_async(pwe_handle_t handle, uint32_t len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL handle");
+    ESP_RETURN_ON_FALSE(handle->write_async != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL io_write_async implementation");
+    return handle->write_async(handle, len);
+}
+
 esp_err_t pwe_ensure_rst(pwe_handle_t handle)
 {
     ESP_RETURN_ON_FALSE(handle->ensure_rst != NULL, ESP_ERR_INVALID_ARG, TAG, "NULL ensure_rst implementation");
@@ -0,0 +1,200 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pwe_analyzer.h"
+#include "esp_check.h"
+
+static const char *TAG = "PWE_ANALYZER";
+
+#define PWE_ANALYZER_DEFAULT_BIN_NS     10
+
+typedef struct {
+    const pwe_config_t *config;
+    const uint8_t *src;
+    uint32_t src_bits;
+    pwe_analyzer_report_t *report;
+    uint64_t high_ps;           // accumulated high phase of current symbol
+    uint64_t low_ps;            // accumulated low phase of current symbol
+    uint64_t elapsed_ps;        // since the first rising edge
+} pwe_analyzer_ctx_t;
+
+static void pwe_analyzer_begin(pwe_analyzer_ctx_t *ctx, const pwe_config_t *config, const void *src, uint32_t src_bits,
+                               uint32_t bin_ns, pwe_analyzer_report_t *report)
+{
+    memset(report, 0, sizeof(pwe_analyzer_report_t));
+    report->bin_ns = bin_ns ? bin_ns : PWE_ANALYZER_DEFAULT_BIN_NS;
+    for (int i = 0; i < PWE_ANALYZER_PULSE_MAX; ++i) {
+        report->pulse[i].min_error_ns = INT32_MAX;
+        report->pulse[i].max_error_ns = INT32_MIN;
+    }
+    memset(ctx, 0, sizeof(pwe_analyzer_ctx_t));
+    ctx->config = config;
+    ctx->src = (const uint8_t *)src;
+    ctx->src_bits = src ? src_bits : 0;
+    ctx->report = report;
+}
+
+static void pwe_analyzer_record(pwe_analyzer_report_t *report, pwe_analyzer_pulse_t kind, uint64_t width_ps,
+                                uint32_t expected_ns, uint32_t acc_ns)
+{
+    pwe_analyzer_hist_t *hist = &report->pulse[kind];
+    // rounded to nearest ns
+    const int64_t error_ps = (int64_t)width_ps - (int64_t)expected_ns * 1000;
+    const int32_t error_ns = (int32_t)((error_ps >= 0 ? error_ps + 500 : error_ps - 500) / 1000);
+    ++hist->count;
+    hist->out_of_range += (uint32_t)abs(error_ns) >= acc_ns;
+    hist->min_error_ns = error_ns < hist->min_error_ns ? error_ns : hist->min_error_ns;
+    hist->max_error_ns = error_ns > hist->max_error_ns ? error_ns : hist->max_error_ns;
+    hist->sum_error_ns += error_ns;
+    // floor division, so that bins are evenly spaced across 0
+    int64_t bin = (error_ns >= 0 ? error_ns : error_ns - (int64_t)report->bin_ns + 1) / (int64_t)report->bin_ns;
+    bin += PWE_ANALYZER_HIST_BINS / 2;
+    bin = bin < 0 ? 0 : bin;
+    bin = bin >= PWE_ANALYZER_HIST_BINS ? PWE_ANALYZER_HIST_BINS - 1 : bin;
+    ++hist->bins[bin];
+}
+
+/**
+ * @brief Decode one high + low symbol into a bit, whichever of logical 0 and 1 it is closer to
+ */
+static void pwe_analyzer_symbol(pwe_analyzer_ctx_t *ctx)
+{
+    const pwe_config_t *config = ctx->config;
+    pwe_analyzer_report_t *report = ctx->report;
+    const int64_t high_ns = ctx->high_ps / 1000;
+    const int64_t low_ns = ctx->low_ps / 1000;
+    const int64_t d0 = llabs(high_ns - config->T0H) + llabs(low_ns - config->T0L);
+    const int64_t d1 = llabs(high_ns - config->T1H) + llabs(low_ns - config->T1L);
+    const bool bit = d1 < d0;
+    if (bit) {
+        pwe_analyzer_record(report, PWE_ANALYZER_T1H, ctx->high_ps, config->T1H, config->T1H_ACC);
+        pwe_analyzer_record(report, PWE_ANALYZER_T1L, ctx->low_ps, config->T1L, config->T1L_ACC);
+    } else {
+        pwe_analyzer_record(report, PWE_ANALYZER_T0H, ctx->high_ps, config->T0H, config->T0H_ACC);
+        pwe_analyzer_record(report, PWE_ANALYZER_T0L, ctx->low_ps, config->T0L, config->T0L_ACC);
+    }
+    if (report->bits < ctx->src_bits) {
+        const bool expected = ctx->src[report->bits / 8] & (0x80 >> (report->bits % 8));
+        report->mismatches += bit != expected;
+    } else if (ctx->src != NULL) {
+        ++report->mismatches;   // extra bit
+    }
+    ++report->bits;
+    ctx->elapsed_ps += ctx->high_ps + ctx->low_ps;
+    ctx->high_ps = 0;
+    ctx->low_ps = 0;
+}
+
+/**
+ * @brief Feed a run of constant level, symbols are cut at rising edges
+ */
+static void pwe_analyzer_feed(pwe_analyzer_ctx_t *ctx, bool level, uint64_t duration_ps)
+{
+    if (duration_ps == 0) {
+        return;
+    }
+    if (level) {
+        if (ctx->low_ps > 0) {
+            if (ctx->high_ps > 0) {
+                pwe_analyzer_symbol(ctx);
+            } else {
+                ctx->low_ps = 0;        // idle before the first bit
+            }
+        }
+        ctx->high_ps += duration_ps;
+    } else {
+        ctx->low_ps += duration_ps;
+    }
+}
+
+static void pwe_analyzer_end(pwe_analyzer_ctx_t *ctx)
+{
+    pwe_analyzer_report_t *report = ctx->report;
+    if (ctx->high_ps > 0) {
+        pwe_analyzer_symbol(ctx);
+    }
+    if (report->bits < ctx->src_bits) {
+        report->mismatches += ctx->src_bits - report->bits;     // missing bits
+    }
+    for (int i = 0; i < PWE_ANALYZER_PULSE_MAX; ++i) {
+        if (report->pulse[i].count == 0) {
+            report->pulse[i].min_error_ns = 0;
+            report->pulse[i].max_error_ns = 0;
+        }
+    }
+    report->duration_ns = ctx->elapsed_ps / 1000;
+    report->bitrate = ctx->elapsed_ps ? (uint32_t)((uint64_t)report->bits * 1000000000000ULL / ctx->elapsed_ps) : 0;
+}
+
+esp_err_t pwe_analyze_samples(const pwe_config_t *config, const uint8_t *samples, uint32_t sample_num, uint32_t sample_hz,
+                              const void *src, uint32_t src_bits, uint32_t bin_ns, pwe_analyzer_report_t *report)
+{
+    ESP_RETURN_ON_FALSE(config != NULL && samples != NULL && report != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    ESP_RETURN_ON_FALSE(sample_hz != 0, ESP_ERR_INVALID_ARG, TAG, "zero sample rate");
+    pwe_analyzer_ctx_t ctx;
+    pwe_analyzer_begin(&ctx, config, src, src_bits, bin_ns, report);
+    uint32_t run = 0;
+    bool level = false;
+    for (uint32_t i = 0; i < sample_num; ++i) {
+        const bool sample = samples[i / 8] & (0x80 >> (i % 8));
+        if (sample != level) {
+            pwe_analyzer_feed(&ctx, level, (uint64_t)run * 1000000000000ULL / sample_hz);
+            level = sample;
+            run = 0;
+        }
+        ++run;
+    }
+    pwe_analyzer_feed(&ctx, level, (uint64_t)run * 1000000000000ULL / sample_hz);
+    pwe_analyzer_end(&ctx);
+    return ESP_OK;
+}
+
+esp_err_t pwe_analyze_items(const pwe_config_t *config, const uint32_t *items, uint32_t item_num, uint32_t tick_hz,
+                            const void *src, uint32_t src_bits, uint32_t bin_ns, pwe_analyzer_report_t *report)
+{
+    ESP_RETURN_ON_FALSE(config != NULL && items != NULL && report != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    ESP_RETURN_ON_FALSE(tick_hz != 0, ESP_ERR_INVALID_ARG, TAG, "zero tick rate");
+    pwe_analyzer_ctx_t ctx;
+    pwe_analyzer_begin(&ctx, config, src, src_bits, bin_ns, report);
+    for (uint32_t i = 0; i < item_num; ++i) {
+        // duration0: bit 0~14, level0: bit 15, duration1: bit 16~30, level1: bit 31
+        const uint32_t duration0 = items[i] & 0x7fff;
+        const uint32_t duration1 = (items[i] >> 16) & 0x7fff;
+        if (duration0 == 0) {
+            break;
+        }
+        pwe_analyzer_feed(&ctx, items[i] & (1u << 15), (uint64_t)duration0 * 1000000000000ULL / tick_hz);
+        if (duration1 == 0) {
+            break;
+        }
+        pwe_analyzer_feed(&ctx, items[i] & (1u << 31), (uint64_t)duration1 * 1000000000000ULL / tick_hz);
+    }
+    pwe_analyzer_end(&ctx);
+    return ESP_OK;
+}
+
+int32_t pwe_analyzer_margin_ns(const pwe_config_t *config, const pwe_analyzer_report_t *report)
+{
+    const uint32_t acc[PWE_ANALYZER_PULSE_MAX] = {
+        [PWE_ANALYZER_T0H] = config->T0H_ACC,
+        [PWE_ANALYZER_T0L] = config->T0L_ACC,
+        [PWE_ANALYZER_T1H] = config->T1H_ACC,
+        [PWE_ANALYZER_T1L] = config->T1L_ACC,
+    };
+    int32_t margin = INT32_MAX;
+    for (int i = 0; i < PWE_ANALYZER_PULSE_MAX; ++i) {
+        const pwe_analyzer_hist_t *hist = &report->pulse[i];
+        if (hist->count == 0) {
+            continue;
+        }
+        const int32_t worst = -hist->min_error_ns > hist->max_error_ns ? -hist->min_error_ns : hist->max_error_ns;
+        const int32_t m = (int32_t)acc[i] - worst;
+        margin = m < margin ? m : margin;
+    }
+    return margin;
+}
@@ -0,0 +1,316 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_lcd_panel_io.h"
+#include "pwe_io_i2s.h"
+#include "pwe_timing.h"
+#include "pwe_priv.h"
+#include "pwe_transpose.h"
+#include "esp_check.h"
+
+static const char *TAG = "PWE_IO_I2S";
+
+/*
+ * I2S is driven in LCD mode through the i80 bus of esp_lcd: every sample clock puts one 8 or 16 bits sample onto the
+ * data lines, one bit per lane. A logical bit of all lanes takes slots_per_bit samples.
+ */
+#define PWE_IO_I2S_MAX_SLOTS_PER_BIT    8
+/* esp_lcd runs the i80 bus from 160MHz PLL pre-scaled by 2, pclk is an integer division of it */
+#define PWE_IO_I2S_SRC_CLK_HZ           (80 * 1000 * 1000)
+#define PWE_IO_I2S_CLK_DIV_MIN          2
+#define PWE_IO_I2S_CLK_DIV_MAX          64
+
+typedef struct {
+    struct pwe_s base;
+    pwe_io_i2s_config_t i2s_conf;
+    esp_lcd_i80_bus_handle_t bus;
+    esp_lcd_panel_io_handle_t io;
+    SemaphoreHandle_t done_sem;     // given by each finished transmission
+    uint32_t sclk;
+    uint8_t t1h;
+    uint8_t t1l;
+    uint8_t t0h;
+    uint8_t t0l;
+    pwe_timing_t timing;
+    uint8_t slots_per_bit;
+    uint8_t sample_size;            // bytes per sample, 1 for 8 lanes and 2 for 16 lanes
+    uint32_t trst;
+    uint32_t buffer_stride;         // bytes between two outgoing buffers, word aligned
+    uint8_t buffer_num;             // 2 with PWE_FLAG_DOUBLE_BUFFER, otherwise 1
+    uint8_t fill_index;             // outgoing buffer to be filled by next convert_buffer()
+    uint8_t ready_index;            // outgoing buffer holding latest converted data
+    uint8_t busy_index;             // outgoing buffer being sent, valid if trans_in_flight
+    bool trans_in_flight;
+    volatile int64_t trans_done_us; // end of the latest transaction, set from trans done callback
+    uint16_t slot_zero[PWE_IO_I2S_MAX_SLOTS_PER_BIT];  // lanes sending logical 0 are high in slot i if all ones
+    uint16_t slot_one[PWE_IO_I2S_MAX_SLOTS_PER_BIT];   // lanes sending logical 1 are high in slot i if all ones
+    uint8_t buffer[0] WORD_ALIGNED_ATTR;
+} pwe_io_i2s_handle_t;
+
+static inline uint8_t *pwe_io_i2s_get_buffer(pwe_io_i2s_handle_t *pwe_i2s, uint8_t index)
+{
+    return pwe_i2s->buffer + index * pwe_i2s->buffer_stride;
+}
+
+static bool IRAM_ATTR pwe_io_i2s_trans_done_cb(esp_lcd_panel_io_handle_t panel_io, void *user_ctx, void *event_data)
+{
+    pwe_io_i2s_handle_t *pwe_i2s = (pwe_io_i2s_handle_t *)user_ctx;
+    BaseType_t high_task_wakeup = pdFALSE;
+    pwe_i2s->trans_done_us = esp_timer_get_time();
+    xSemaphoreGiveFromISR(pwe_i2s->done_sem, &high_task_wakeup);
+    if (pwe_i2s->base.done_cb != NULL) {
+        pwe_i2s->base.done_cb(&pwe_i2s->base, pwe_i2s->base.done_cb_ctx);
+    }
+    return high_task_wakeup == pdTRUE;
+}
+
+static esp_err_t pwe_io_i2s_wait_trans(pwe_io_i2s_handle_t *pwe_i2s, TickType_t ticks_to_wait)
+{
+    if (pwe_i2s->trans_in_flight) {
+        ESP_RETURN_ON_FALSE(xSemaphoreTake(pwe_i2s->done_sem, ticks_to_wait) == pdTRUE, ESP_ERR_TIMEOUT, TAG, "wait I2S transaction timeout");
+        pwe_i2s->trans_in_flight = false;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Keep lanes low for TRST since the end of previous transaction, so that next frame is not taken as part of it
+ */
+static void pwe_io_i2s_wait_rst(pwe_io_i2s_handle_t *pwe_i2s)
+{
+    const int64_t idle_us = esp_timer_get_time() - pwe_i2s->trans_done_us;
+    const int64_t trst_us = UINTCEILDIV(pwe_i2s->trst, 1000);
+    if (idle_us < trst_us) {
+        esp_rom_delay_us(trst_us - idle_us);
+    }
+}
+
+static esp_err_t pwe_io_i2s_init(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    esp_err_t ret = ESP_OK;
+    pwe_io_i2s_handle_t *pwe_i2s = __containerof(handle, pwe_io_i2s_handle_t, base);
+    esp_lcd_i80_bus_config_t bus_config = {
+        .dc_gpio_num = pwe_i2s->i2s_conf.dc_gpio,
+        .wr_gpio_num = pwe_i2s->i2s_conf.wr_gpio,
+        .bus_width = pwe_i2s->i2s_conf.lane_num,
+        .max_transfer_bytes = pwe_i2s->buffer_stride,
+    };
+    for (uint8_t i = 0; i < pwe_i2s->i2s_conf.lane_num; ++i) {
+        bus_config.data_gpio_nums[i] = pwe_i2s->i2s_conf.gpio[i];
+    }
+    /*
+     * Command phase can not be skipped, it puts one all-zero sample in front of the frame, which only extends the
+     * reset period before it.
+     */
+    esp_lcd_panel_io_i80_config_t io_config = {
+        .cs_gpio_num = -1,
+        .pclk_hz = pwe_i2s->sclk,
+        .trans_queue_depth = 2,
+        .on_color_trans_done = pwe_io_i2s_trans_done_cb,
+        .user_ctx = pwe_i2s,
+        .lcd_cmd_bits = pwe_i2s->i2s_conf.lane_num,
+        .lcd_param_bits = pwe_i2s->i2s_conf.lane_num,
+    };
+    pwe_i2s->done_sem = xSemaphoreCreateBinary();
+    ESP_RETURN_ON_FALSE(pwe_i2s->done_sem != NULL, ESP_ERR_NO_MEM, TAG, "Failed to create semaphore");
+    ESP_GOTO_ON_ERROR(esp_lcd_new_i80_bus(&bus_config, &pwe_i2s->bus), err_bus, TAG, "Failed to create i80 bus");
+    ESP_GOTO_ON_ERROR(esp_lcd_new_panel_io_i80(pwe_i2s->bus, &io_config, &pwe_i2s->io), err_io, TAG, "Failed to create i80 io");
+    return ESP_OK;
+err_io:
+    esp_lcd_del_i80_bus(pwe_i2s->bus);
+err_bus:
+    vSemaphoreDelete(pwe_i2s->done_sem);
+    return ret;
+}
+
+static esp_err_t pwe_io_i2s_deinit(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_i2s_handle_t *pwe_i2s = __containerof(handle, pwe_io_i2s_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_i2s_wait_trans(pwe_i2s, portMAX_DELAY), TAG, "Failed to finish pending transaction");
+    ESP_RETURN_ON_ERROR(esp_lcd_panel_io_del(pwe_i2s->io), TAG, "Failed to delete i80 io");
+    ESP_RETURN_ON_ERROR(esp_lcd_del_i80_bus(pwe_i2s->bus), TAG, "Failed to delete i80 bus");
+    vSemaphoreDelete(pwe_i2s->done_sem);
+    return ESP_OK;
+}
+
+/**
+ * @brief Encode len bits of every lane into parallel samples
+ *
+ * @param src: lane i starts at src + i * lane_stride
+ * @param dest: first sample to be written
+ */
+static void pwe_io_i2s_encode(const pwe_io_i2s_handle_t *pwe_i2s, const uint8_t *src, uint32_t lane_stride, uint32_t len, uint8_t *dest)
+{
+    const uint8_t lane_num = pwe_i2s->i2s_conf.lane_num;
+    const uint8_t slots_per_bit = pwe_i2s->slots_per_bit;
+    const uint8_t *lut = pwe_i2s->base.byte_lut;
+    uint8_t *pdest8 = dest;
+    uint16_t *pdest16 = (uint16_t *)dest;
+    for (uint32_t byte = 0; byte < UINTCEILDIV(len, 8); ++byte) {
+        // masks of lanes sending logical 1, one per bit, MSBit first
+        uint16_t ones[8];
+        const uint32_t bits = len - byte * 8 < 8 ? len - byte * 8 : 8;
+        pwe_transpose_lanes(src + byte, lane_stride, lane_num, bits, lut, ones);
+        for (uint32_t k = 0; k < bits; ++k) {
+            for (uint8_t s = 0; s < slots_per_bit; ++s) {
+                const uint16_t sample = (pwe_i2s->slot_zero[s] & ~ones[k]) | (pwe_i2s->slot_one[s] & ones[k]);
+                if (lane_num > 8) {
+                    *pdest16++ = sample;
+                } else {
+                    *pdest8++ = sample;
+                }
+            }
+        }
+    }
+}
+
+static esp_err_t pwe_io_i2s_convert_buffer(pwe_handle_t handle, const void *data, uint32_t len, uint32_t *outgoing_buffer_len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_i2s_handle_t *pwe_i2s = __containerof(handle, pwe_io_i2s_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_i2s->base.max_payload_length >= len, ESP_ERR_INVALID_ARG, TAG, "len too big");
+    if (pwe_i2s->trans_in_flight && pwe_i2s->busy_index == pwe_i2s->fill_index) {
+        // never touch the buffer which is on the wire
+        ESP_RETURN_ON_ERROR(pwe_io_i2s_wait_trans(pwe_i2s, portMAX_DELAY), TAG, "Failed to finish pending transaction");
+    }
+    pwe_io_i2s_encode(pwe_i2s, data, UINTCEILDIV(len, 8), len, pwe_io_i2s_get_buffer(pwe_i2s, pwe_i2s->fill_index));
+    // in samples
+    *outgoing_buffer_len = len * pwe_i2s->slots_per_bit;
+    pwe_i2s->ready_index = pwe_i2s->fill_index;
+    pwe_i2s->fill_index = (pwe_i2s->fill_index + 1) % pwe_i2s->buffer_num;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_i2s_convert_range(pwe_handle_t handle, const void *data, uint32_t offset, uint32_t len, uint32_t *outgoing_buffer_len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_i2s_handle_t *pwe_i2s = __containerof(handle, pwe_io_i2s_handle_t, base);
+    if (pwe_i2s->trans_in_flight && pwe_i2s->busy_index == pwe_i2s->ready_index) {
+        ESP_RETURN_ON_ERROR(pwe_io_i2s_wait_trans(pwe_i2s, portMAX_DELAY), TAG, "Failed to finish pending transaction");
+    }
+    // every bit takes the same number of samples, update the latest converted frame in place
+    uint8_t *dest = pwe_io_i2s_get_buffer(pwe_i2s, pwe_i2s->ready_index) + offset * pwe_i2s->slots_per_bit * pwe_i2s->sample_size;
+    pwe_io_i2s_encode(pwe_i2s, data, len / 8, len, dest);
+    *outgoing_buffer_len = (offset + len) * pwe_i2s->slots_per_bit;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_i2s_write_async(pwe_handle_t handle, uint32_t len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_i2s_handle_t *pwe_i2s = __containerof(handle, pwe_io_i2s_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_i2s_wait_trans(pwe_i2s, portMAX_DELAY), TAG, "Failed to finish pending transaction");
+    pwe_io_i2s_wait_rst(pwe_i2s);
+    ESP_RETURN_ON_ERROR(esp_lcd_panel_io_tx_color(pwe_i2s->io, 0, pwe_io_i2s_get_buffer(pwe_i2s, pwe_i2s->ready_index),
+                                                  len * pwe_i2s->sample_size), TAG, "queue I2S samples failed");
+    pwe_i2s->busy_index = pwe_i2s->ready_index;
+    pwe_i2s->trans_in_flight = true;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_i2s_write(pwe_handle_t handle, uint32_t len)
+{
+    ESP_RETURN_ON_ERROR(pwe_io_i2s_write_async(handle, len), TAG, "Failed to start transaction");
+    pwe_io_i2s_handle_t *pwe_i2s = __containerof(handle, pwe_io_i2s_handle_t, base);
+    return pwe_io_i2s_wait_trans(pwe_i2s, portMAX_DELAY);
+}
+
+static esp_err_t pwe_io_i2s_wait_done(pwe_handle_t handle, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_i2s_handle_t *pwe_i2s = __containerof(handle, pwe_io_i2s_handle_t, base);
+    return pwe_io_i2s_wait_trans(pwe_i2s, pdMS_TO_TICKS(timeout_ms));
+}
+
+static esp_err_t pwe_io_i2s_ensure_rst(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_i2s_handle_t *pwe_i2s = __containerof(handle, pwe_io_i2s_handle_t, base);
+    uint32_t delay_us = pwe_i2s->trst / 1000;
+    delay_us = delay_us == 0 ? 1 : delay_us;
+    esp_rom_delay_us(delay_us);
+    return ESP_OK;
+}
+
+esp_err_t pwe_new_i2s_backend(const pwe_config_t *config, const pwe_io_i2s_config_t *i2s_conf, uint32_t buffer_size, pwe_handle_t *handle)
+{
+    ESP_RETURN_ON_FALSE(config != NULL, ESP_ERR_INVALID_ARG, TAG, "null config");
+    ESP_RETURN_ON_FALSE(i2s_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "null i2s config");
+    ESP_RETURN_ON_FALSE(i2s_conf->lane_num == 8 || i2s_conf->lane_num == 16, ESP_ERR_INVALID_ARG, TAG, "lane_num must be 8 or 16");
+    ESP_RETURN_ON_FALSE(buffer_size != 0, ESP_ERR_INVALID_ARG, TAG, "streaming mode not supported");
+
+    pwe_io_i2s_handle_t temp_conf;
+    temp_conf.trst = config->TRST;
+
+    // all lanes share one sample clock, so logical 0 and 1 must take the same number of samples
+    const pwe_timing_constraints_t constraints = {
+        .src_hz = PWE_IO_I2S_SRC_CLK_HZ,
+        .div_min = PWE_IO_I2S_CLK_DIV_MIN,
+        .div_max = PWE_IO_I2S_CLK_DIV_MAX,
+        .max_slots_per_bit = PWE_IO_I2S_MAX_SLOTS_PER_BIT,
+        .equal_width = true,
+    };
+    ESP_RETURN_ON_ERROR(pwe_timing_solve(config, &constraints, &temp_conf.timing), TAG, "Cannot resolve requested timing");
+    temp_conf.sclk = temp_conf.timing.clock_hz;
+    temp_conf.t1h = temp_conf.timing.t1h;
+    temp_conf.t1l = temp_conf.timing.t1l;
+    temp_conf.t0h = temp_conf.timing.t0h;
+    temp_conf.t0l = temp_conf.timing.t0l;
+    ESP_LOGD(TAG, "slot configuration: sclk=%u, t1h=%u, t1l=%u, t0h=%u, t0l=%u", temp_conf.sclk, temp_conf.t1h, temp_conf.t1l, temp_conf.t0h, temp_conf.t0l);
+    temp_conf.slots_per_bit = temp_conf.timing.slots_per_bit;
+    for (uint8_t s = 0; s < PWE_IO_I2S_MAX_SLOTS_PER_BIT; ++s) {
+        temp_conf.slot_zero[s] = s < temp_conf.t0h ? 0xffff : 0;
+        temp_conf.slot_one[s] = s < temp_conf.t1h ? 0xffff : 0;
+    }
+
+    // alloc memory at the end
+    temp_conf.sample_size = i2s_conf->lane_num / 8;
+    temp_conf.buffer_stride = UINTCEILDIV(buffer_size * temp_conf.slots_per_bit * temp_conf.sample_size, 4) * 4;
+    temp_conf.buffer_num = PWE_BUFFER_NUM(config->flags);
+    temp_conf.fill_index = 0;
+    temp_conf.ready_index = 0;
+    temp_conf.busy_index = 0;
+    temp_conf.trans_in_flight = false;
+    temp_conf.trans_done_us = 0;
+    ESP_LOGD(TAG, "Will allocate %u outgoing buffer with %u bytes", temp_conf.buffer_num, temp_conf.buffer_stride);
+    pwe_io_i2s_handle_t *pwe_i2s = heap_caps_calloc(1, sizeof(pwe_io_i2s_handle_t) + temp_conf.buffer_stride * temp_conf.buffer_num, MALLOC_CAP_DMA);
+    ESP_RETURN_ON_FALSE(pwe_i2s != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate pwe_io_i2s_handle_t");
+    memcpy(&temp_conf.i2s_conf, i2s_conf, sizeof(pwe_io_i2s_config_t));
+    memcpy(pwe_i2s, &temp_conf, sizeof(pwe_io_i2s_handle_t));
+    pwe_i2s->base.init = pwe_io_i2s_init;
+    pwe_i2s->base.deinit = pwe_io_i2s_deinit;
+    pwe_i2s->base.convert_buffer = pwe_io_i2s_convert_buffer;
+    pwe_i2s->base.convert_range = pwe_io_i2s_convert_range;
+    pwe_i2s->base.write = pwe_io_i2s_write;
+    pwe_i2s->base.write_async = pwe_io_i2s_write_async;
+    pwe_i2s->base.wait_done = pwe_io_i2s_wait_done;
+    pwe_i2s->base.on_the_fly_send = NULL;
+    pwe_i2s->base.on_the_fly_send_async = NULL;
+    pwe_i2s->base.ensure_rst = pwe_io_i2s_ensure_rst;
+    pwe_i2s->base.max_payload_length = buffer_size;
+    pwe_i2s->base.done_cb = NULL;
+    pwe_i2s->base.done_cb_ctx = NULL;
+    pwe_i2s->base.byte_lut = NULL;
+    pwe_i2s->base.timing = &pwe_i2s->timing;
+    *handle = &pwe_i2s->base;
+    return ESP_OK;
+}
+
+esp_err_t pwe_delete_i2s_backend(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_i2s_handle_t *pwe_i2s = __containerof(handle, pwe_io_i2s_handle_t, base);
+    heap_caps_free(pwe_i2s);
+    return ESP_OK;
+}
@@ -5,31 +5,95 @@
  */
 
 #include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_heap_caps.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "soc/soc_caps.h"
 #include "pwe_io_rmt.h"
+#include "pwe_private/pwe_io_rmt_handle.h"
+#include "pwe_timing.h"
+#include "pwe_priv.h"
 #include "esp_check.h"
 
 static const char *TAG = "PWE_IO_RMT";
 
-#define UINTROUNDDIV(divd, divor) ( ((divd) + ((divor) / 2)) / (divor) )
-#define UINTCEILDIV(divd, divor) ( ((divd) + (divor) - 1) / (divor) )
+#define PWE_IO_RMT_CLK_DIV_MAX      255
+#define PWE_IO_RMT_MAX_TICKS        0x7fff  // duration field of rmt_item32_t is 15 bits
+#define PWE_IO_RMT_INSTALL_STACK    3072
+#define PWE_IO_RMT_CHAIN_STOP_MS    10
 
-static inline uint32_t calc_aligned_error(uint32_t divided, uint32_t divisor)
+// rmt tx end callback is shared by all channels, dispatch it to the owner of the channel
+static pwe_io_rmt_handle_t *s_pwe_rmt_handles[RMT_CHANNEL_MAX];
+// callback registered before ours, still called for channels not driven by PWE
+static rmt_tx_end_callback_t s_pwe_rmt_prev_tx_end_cb;
+static bool s_pwe_rmt_tx_end_cb_registered;
+
+static inline rmt_item32_t *pwe_io_rmt_get_buffer(pwe_io_rmt_handle_t *pwe_rmt, uint8_t index)
 {
-    return abs((int)(divided - UINTROUNDDIV(divided, divisor) * divisor));
+    return pwe_rmt->buffer + index * pwe_rmt->buffer_size;
 }
 
-typedef struct {
-    struct pwe_s base;
-    rmt_config_t rmt_conf;
-    uint32_t trst;
-    uint16_t t1h;
-    uint16_t t1l;
-    uint16_t t0h;
-    uint16_t t0l;
-    rmt_item32_t buffer[0];
-    size_t _total_bits_to_send; // workaround: rmt translator only accept byte
-} pwe_io_rmt_handle_t;
+static void pwe_io_rmt_chain_isr(pwe_io_rmt_handle_t *pwe_rmt);
+
+static void IRAM_ATTR pwe_io_rmt_tx_end_cb(rmt_channel_t channel, void *arg)
+{
+    pwe_io_rmt_handle_t *pwe_rmt = s_pwe_rmt_handles[channel];
+    if (pwe_rmt == NULL) {
+        if (s_pwe_rmt_prev_tx_end_cb.function != NULL) {
+            s_pwe_rmt_prev_tx_end_cb.function(channel, s_pwe_rmt_prev_tx_end_cb.arg);
+        }
+        return;
+    }
+    pwe_rmt->tx_done_us = esp_timer_get_time();
+    if (pwe_rmt->rst_in_flight) {
+        // low level item of ensure_rst, not a frame of the user
+        pwe_rmt->rst_in_flight = false;
+        return;
+    }
+    if (pwe_rmt->base.done_cb != NULL) {
+        pwe_rmt->base.done_cb(&pwe_rmt->base, pwe_rmt->base.done_cb_ctx);
+    }
+    if (pwe_rmt->chain_cb != NULL) {
+        pwe_io_rmt_chain_isr(pwe_rmt);
+    }
+}
+
+static esp_err_t pwe_io_rmt_wait_tx(pwe_io_rmt_handle_t *pwe_rmt, TickType_t ticks_to_wait)
+{
+    if (pwe_rmt->tx_in_flight) {
+        ESP_RETURN_ON_ERROR(rmt_wait_tx_done(pwe_rmt->rmt_conf.channel, ticks_to_wait), TAG, "Failed to wait tx done");
+        pwe_rmt->tx_in_flight = false;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Keep line low for TRST since the end of previous transmission, so that next frame is not taken as part of it
+ */
+static void pwe_io_rmt_wait_rst(pwe_io_rmt_handle_t *pwe_rmt)
+{
+    const int64_t idle_us = esp_timer_get_time() - pwe_rmt->tx_done_us;
+    if (idle_us < pwe_rmt->trst) {
+        esp_rom_delay_us(pwe_rmt->trst - idle_us);
+    }
+}
+
+/**
+ * @brief Expand one byte into 8 items, MSBit first
+ */
+FORCE_INLINE_ATTR void pwe_io_rmt_expand_byte(const uint32_t bit_items[2], uint32_t byte, uint32_t *dest)
+{
+    dest[0] = bit_items[(byte >> 7) & 1];
+    dest[1] = bit_items[(byte >> 6) & 1];
+    dest[2] = bit_items[(byte >> 5) & 1];
+    dest[3] = bit_items[(byte >> 4) & 1];
+    dest[4] = bit_items[(byte >> 3) & 1];
+    dest[5] = bit_items[(byte >> 2) & 1];
+    dest[6] = bit_items[(byte >> 1) & 1];
+    dest[7] = bit_items[byte & 1];
+}
 
 /**
  * @brief Convert raw bit data in u8[] to RMT format.
@@ -54,8 +118,9 @@ static void IRAM_ATTR pwe_rmt_adapter(const void *src, rmt_item32_t *dest, size_
     /*
      * Implementation details:
      * - Must finish whole byte translate and must not leave a half-translated byte here, so that in the next call we can start from the first bit of src
-     * - Our stop condition is bit not byte so that a workaround (_total_bits_to_send) is here to let us compare with item_num.
+     * - Bytes are always expanded into 8 items, padding bits of the last one are dropped by reporting fewer items
      */
+    const uint32_t start = esp_cpu_get_ccount();
     pwe_io_rmt_handle_t *pwe_rmt;
     rmt_translator_get_context(item_num, (void **) &pwe_rmt);
     if (src == NULL || dest == NULL || pwe_rmt == NULL) {
@@ -63,95 +128,288 @@ static void IRAM_ATTR pwe_rmt_adapter(const void *src, rmt_item32_t *dest, size_
         *item_num = 0;
         return;
     }
-    const rmt_item32_t bit0 = {{{ pwe_rmt->t0h, 1, pwe_rmt->t0l, 0 }}}; //Logical 0
-    const rmt_item32_t bit1 = {{{ pwe_rmt->t1h, 1, pwe_rmt->t1l, 0 }}}; //Logical 1
-    size_t translated_byte_num = 0;
-    size_t translated_bit_num = 0;
     const size_t bytes_can_be_translated = wanted_num / 8; // ensure byte width align
-    /* calculate remain bits by: total_bits - (bytes_that_total_bits_consume - remain_bytes) * 8 */
-    size_t bits_remain_in_input = pwe_rmt->_total_bits_to_send - (UINTCEILDIV(pwe_rmt->_total_bits_to_send, 8) - src_size) * 8;
-    uint8_t *psrc = (uint8_t *)src;
-    rmt_item32_t *pdest = dest;
-    while (translated_byte_num < bytes_can_be_translated) { // not all bits are translated but can not do more
-        for (int i = 0; i < 8; i++) {
-            if (*psrc & (1 << (7 - i))) {
-                pdest->val =  bit1.val;
-            } else {
-                pdest->val =  bit0.val;
-            }
-            translated_bit_num++;
-            pdest++;
-            if (--bits_remain_in_input == 0) {  // the only termination point that all bits are translated
-                break;
-            }
+    const size_t byte_num = src_size < bytes_can_be_translated ? src_size : bytes_can_be_translated;
+    const uint8_t *psrc = src;
+    uint32_t *pdest = &dest->val;
+    const uint8_t *lut = pwe_rmt->base.byte_lut;
+    if (lut) {
+        for (size_t i = 0; i < byte_num; ++i, pdest += 8) {
+            pwe_io_rmt_expand_byte(pwe_rmt->bit_items, lut[psrc[i]], pdest);
         }
-        translated_byte_num++;
-        psrc++;
-        if (bits_remain_in_input == 0) {
-            break;
+    } else {
+        for (size_t i = 0; i < byte_num; ++i, pdest += 8) {
+            pwe_io_rmt_expand_byte(pwe_rmt->bit_items, psrc[i], pdest);
         }
     }
-    *translated_size = translated_byte_num;
-    *item_num = translated_bit_num;
+    *translated_size = byte_num;
+    *item_num = byte_num * 8 - (byte_num == src_size ? pwe_rmt->stream_pad_bits : 0);
+
+    const uint32_t cycles = esp_cpu_get_ccount() - start;
+    /*
+     * Items of this refill go out once all items before them are sent. If that time has passed the hardware wrapped
+     * around and sent stale memory instead. Exact when logical 0 and 1 take the same time, as every preset does.
+     */
+    const int64_t now_us = esp_timer_get_time();
+    bool missed = false;
+    if (pwe_rmt->stream_items == 0) {
+        pwe_rmt->stream_start_us = now_us;
+    } else {
+        missed = (uint64_t)(now_us - pwe_rmt->stream_start_us) * 1000 > (uint64_t)pwe_rmt->stream_items * pwe_rmt->bit_ns;
+    }
+    pwe_rmt->stream_items += *item_num;
+    portENTER_CRITICAL_ISR(&pwe_rmt->stats_lock);
+    pwe_rmt->stats_refill_misses += missed;
+    pwe_rmt->stats_min_cycles = cycles < pwe_rmt->stats_min_cycles ? cycles : pwe_rmt->stats_min_cycles;
+    pwe_rmt->stats_max_cycles = cycles > pwe_rmt->stats_max_cycles ? cycles : pwe_rmt->stats_max_cycles;
+    pwe_rmt->stats_min_items = wanted_num < pwe_rmt->stats_min_items ? wanted_num : pwe_rmt->stats_min_items;
+    pwe_rmt->stats_total_cycles += cycles;
+    ++pwe_rmt->stats_calls;
+    portEXIT_CRITICAL_ISR(&pwe_rmt->stats_lock);
 }
 
-static esp_err_t pwe_io_rmt_init(pwe_handle_t handle)
+static esp_err_t pwe_io_rmt_install(pwe_io_rmt_handle_t *pwe_rmt)
 {
-    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
     ESP_RETURN_ON_ERROR(rmt_config(&pwe_rmt->rmt_conf), TAG, "Failed to configure RMT");
-    ESP_RETURN_ON_ERROR(rmt_driver_install(pwe_rmt->rmt_conf.channel, 0, 0), TAG, "Failed to install RMT driver");
+    ESP_RETURN_ON_ERROR(rmt_driver_install(pwe_rmt->rmt_conf.channel, 0, pwe_rmt->driver_conf.intr_alloc_flags), TAG, "Failed to install RMT driver");
     ESP_RETURN_ON_ERROR(rmt_translator_init(pwe_rmt->rmt_conf.channel, pwe_rmt_adapter), TAG, "Failed to set translator");
     ESP_RETURN_ON_ERROR(rmt_translator_set_context(pwe_rmt->rmt_conf.channel, pwe_rmt), TAG, "Failed to set RMT context");
     return ESP_OK;
 }
 
+typedef struct {
+    pwe_io_rmt_handle_t *pwe_rmt;
+    bool install;
+    TaskHandle_t caller;
+    esp_err_t ret;
+} pwe_io_rmt_install_arg_t;
+
+static void pwe_io_rmt_install_task(void *arg)
+{
+    pwe_io_rmt_install_arg_t *install_arg = arg;
+    install_arg->ret = install_arg->install ? pwe_io_rmt_install(install_arg->pwe_rmt) :
+                       rmt_driver_uninstall(install_arg->pwe_rmt->rmt_conf.channel);
+    xTaskNotifyGive(install_arg->caller);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Install or uninstall driver on driver_conf.core_id, where its interrupt is allocated and freed
+ */
+static esp_err_t pwe_io_rmt_install_on_core(pwe_io_rmt_handle_t *pwe_rmt, bool install)
+{
+    const int core_id = pwe_rmt->driver_conf.core_id;
+    if (core_id < 0 || core_id == xPortGetCoreID()) {
+        return install ? pwe_io_rmt_install(pwe_rmt) : rmt_driver_uninstall(pwe_rmt->rmt_conf.channel);
+    }
+    pwe_io_rmt_install_arg_t install_arg = {
+        .pwe_rmt = pwe_rmt,
+        .install = install,
+        .caller = xTaskGetCurrentTaskHandle(),
+        .ret = ESP_FAIL,
+    };
+    ESP_RETURN_ON_FALSE(xTaskCreatePinnedToCore(pwe_io_rmt_install_task, "pwe_rmt_install", PWE_IO_RMT_INSTALL_STACK, &install_arg,
+                                                uxTaskPriorityGet(NULL), NULL, core_id) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "Failed to create install task");
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return install_arg.ret;
+}
+
+static esp_err_t pwe_io_rmt_init(pwe_handle_t handle)
+{
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_install_on_core(pwe_rmt, true), TAG, "Failed to install RMT driver");
+    pwe_rmt->installed = true;
+    s_pwe_rmt_handles[pwe_rmt->rmt_conf.channel] = pwe_rmt;
+    if (!s_pwe_rmt_tx_end_cb_registered) {
+        // registered once for all instances and kept, other channels still reach the callback it replaces
+        s_pwe_rmt_prev_tx_end_cb = rmt_register_tx_end_callback(pwe_io_rmt_tx_end_cb, NULL);
+        s_pwe_rmt_tx_end_cb_registered = true;
+    }
+    return ESP_OK;
+}
+
 static esp_err_t pwe_io_rmt_deinit(pwe_handle_t handle)
 {
     pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
-    ESP_RETURN_ON_ERROR(rmt_driver_uninstall(pwe_rmt->rmt_conf.channel), TAG, "Failed to uninstall RMT driver");
+    if (pwe_rmt->chain_cb != NULL) {
+        ESP_RETURN_ON_ERROR(pwe_rmt_stop_continuous(handle, PWE_IO_RMT_CHAIN_STOP_MS), TAG, "Failed to stop continuous output");
+    }
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_wait_tx(pwe_rmt, portMAX_DELAY), TAG, "Failed to finish pending transmission");
+    s_pwe_rmt_handles[pwe_rmt->rmt_conf.channel] = NULL;
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_install_on_core(pwe_rmt, false), TAG, "Failed to uninstall RMT driver");
+    pwe_rmt->installed = false;
     return ESP_OK;
 }
 
+/**
+ * @brief Expand len bits from src into one RMT item per bit
+ */
+static void IRAM_ATTR pwe_io_rmt_encode(const pwe_io_rmt_handle_t *pwe_rmt, const uint8_t *src, uint32_t len, rmt_item32_t *dest)
+{
+    const uint8_t *lut = pwe_rmt->base.byte_lut;
+    uint32_t *pdest = &dest[0].val;
+    for (uint32_t i = 0; i < len / 8; ++i, pdest += 8) {
+        pwe_io_rmt_expand_byte(pwe_rmt->bit_items, lut ? lut[src[i]] : src[i], pdest);
+    }
+    // remaining bits of the last partial byte, dest has no room for a whole byte
+    const uint32_t last_byte = (len % 8) ? (lut ? lut[src[len / 8]] : src[len / 8]) : 0;
+    for (uint32_t i = 0; i < len % 8; ++i) {
+        pdest[i] = pwe_rmt->bit_items[(last_byte >> (7 - i)) & 1];
+    }
+}
+
+/**
+ * @brief Start next frame of continuous mode: payload then TRST straight into RMT memory
+ *
+ * Driver calls below live in flash and log, so this never runs from an ISR installed with ESP_INTR_FLAG_IRAM
+ */
+static esp_err_t pwe_io_rmt_chain_next(pwe_io_rmt_handle_t *pwe_rmt)
+{
+    const rmt_channel_t channel = pwe_rmt->rmt_conf.channel;
+    rmt_item32_t *items = pwe_io_rmt_get_buffer(pwe_rmt, 0);
+    pwe_io_rmt_encode(pwe_rmt, pwe_rmt->chain_cb(&pwe_rmt->base, pwe_rmt->chain_ctx), pwe_rmt->chain_bits, items);
+    esp_err_t ret = rmt_fill_tx_items(channel, items, pwe_rmt->chain_bits, 0);
+    if (ret == ESP_OK) {
+        ret = rmt_fill_tx_items(channel, pwe_rmt->chain_reset, pwe_rmt->chain_reset_num, pwe_rmt->chain_bits);
+    }
+    if (ret == ESP_OK) {
+        ret = rmt_tx_start(channel, true);
+    }
+    return ret;
+}
+
+static void pwe_io_rmt_chain_isr(pwe_io_rmt_handle_t *pwe_rmt)
+{
+    if (!pwe_rmt->chain_stop && pwe_io_rmt_chain_next(pwe_rmt) == ESP_OK) {
+        return;
+    }
+    pwe_rmt->chain_cb = NULL;
+    if (pwe_rmt->chain_waiter != NULL) {
+        BaseType_t task_woken = pdFALSE;
+        vTaskNotifyGiveFromISR(pwe_rmt->chain_waiter, &task_woken);
+        if (task_woken == pdTRUE) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+/**
+ * @brief Lay TRST out as low level items, a duration left 0 ending the transmission
+ *
+ * @return number of items, 0 if TRST takes more than PWE_IO_RMT_CHAIN_RESET_ITEMS
+ */
+static uint8_t pwe_io_rmt_build_reset(uint32_t ticks, rmt_item32_t *items)
+{
+    ticks = ticks ? ticks : 1;
+    for (uint8_t num = 0; num < PWE_IO_RMT_CHAIN_RESET_ITEMS; ++num) {
+        const uint32_t duration0 = ticks < PWE_IO_RMT_MAX_TICKS ? ticks : PWE_IO_RMT_MAX_TICKS;
+        ticks -= duration0;
+        const uint32_t duration1 = ticks < PWE_IO_RMT_MAX_TICKS ? ticks : PWE_IO_RMT_MAX_TICKS;
+        ticks -= duration1;
+        const rmt_item32_t item = {{{ duration0, 0, duration1, 0 }}};
+        items[num] = item;
+        if (duration1 == 0) {
+            return num + 1;
+        }
+        if (ticks == 0 && num + 1 < PWE_IO_RMT_CHAIN_RESET_ITEMS) {
+            items[num + 1].val = 0;
+            return num + 2;
+        }
+    }
+    return 0;
+}
+
 static esp_err_t pwe_io_rmt_convert_buffer(pwe_handle_t handle, const void *data, uint32_t len, uint32_t *outgoing_buffer_len)
 {
     pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
     ESP_RETURN_ON_FALSE(pwe_rmt->base.max_payload_length >= len, ESP_ERR_INVALID_ARG, TAG, "len too big");
-    const rmt_item32_t bit0 = {{{ pwe_rmt->t0h, 1, pwe_rmt->t0l, 0 }}}; //Logical 0
-    const rmt_item32_t bit1 = {{{ pwe_rmt->t1h, 1, pwe_rmt->t1l, 0 }}}; //Logical 1
-    uint32_t bits_src_proceeded = 0;
-    while (bits_src_proceeded < len) {
-        uint32_t byte_offset = bits_src_proceeded / 8;
-        uint8_t bit_offset = (7 - bits_src_proceeded % 8);
-        if ((((uint8_t *)data)[byte_offset]) & (1 << bit_offset)) {
-            pwe_rmt->buffer[bits_src_proceeded].val = bit1.val;
-        } else {
-            pwe_rmt->buffer[bits_src_proceeded].val = bit0.val;
-        }
-        ++bits_src_proceeded;
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb == NULL, ESP_ERR_INVALID_STATE, TAG, "continuous output running");
+    if (pwe_rmt->tx_in_flight && pwe_rmt->busy_index == pwe_rmt->fill_index) {
+        // never touch the buffer which is on the wire
+        ESP_RETURN_ON_ERROR(pwe_io_rmt_wait_tx(pwe_rmt, portMAX_DELAY), TAG, "Failed to finish pending transmission");
+    }
+    pwe_io_rmt_encode(pwe_rmt, data, len, pwe_io_rmt_get_buffer(pwe_rmt, pwe_rmt->fill_index));
+    *outgoing_buffer_len = len;
+    pwe_rmt->ready_index = pwe_rmt->fill_index;
+    pwe_rmt->fill_index = (pwe_rmt->fill_index + 1) % pwe_rmt->buffer_num;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_rmt_convert_range(pwe_handle_t handle, const void *data, uint32_t offset, uint32_t len, uint32_t *outgoing_buffer_len)
+{
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb == NULL, ESP_ERR_INVALID_STATE, TAG, "continuous output running");
+    if (pwe_rmt->tx_in_flight && pwe_rmt->busy_index == pwe_rmt->ready_index) {
+        ESP_RETURN_ON_ERROR(pwe_io_rmt_wait_tx(pwe_rmt, portMAX_DELAY), TAG, "Failed to finish pending transmission");
     }
-    *outgoing_buffer_len = bits_src_proceeded;
+    // one item per bit, update the latest converted frame in place
+    pwe_io_rmt_encode(pwe_rmt, data, len, pwe_io_rmt_get_buffer(pwe_rmt, pwe_rmt->ready_index) + offset);
+    *outgoing_buffer_len = offset + len;
     return ESP_OK;
 }
 
 static esp_err_t pwe_io_rmt_write(pwe_handle_t handle, uint32_t len)
 {
     pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
-    ESP_RETURN_ON_ERROR(rmt_write_items(pwe_rmt->rmt_conf.channel, pwe_rmt->buffer, len, true), TAG, "Failed to write items");
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb == NULL, ESP_ERR_INVALID_STATE, TAG, "continuous output running");
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_wait_tx(pwe_rmt, portMAX_DELAY), TAG, "Failed to finish pending transmission");
+    pwe_io_rmt_wait_rst(pwe_rmt);
+    ESP_RETURN_ON_ERROR(rmt_write_items(pwe_rmt->rmt_conf.channel, pwe_io_rmt_get_buffer(pwe_rmt, pwe_rmt->ready_index), len, true), TAG, "Failed to write items");
     return ESP_OK;
 }
 
+static esp_err_t pwe_io_rmt_write_async(pwe_handle_t handle, uint32_t len)
+{
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb == NULL, ESP_ERR_INVALID_STATE, TAG, "continuous output running");
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_wait_tx(pwe_rmt, portMAX_DELAY), TAG, "Failed to finish pending transmission");
+    pwe_io_rmt_wait_rst(pwe_rmt);
+    ESP_RETURN_ON_ERROR(rmt_write_items(pwe_rmt->rmt_conf.channel, pwe_io_rmt_get_buffer(pwe_rmt, pwe_rmt->ready_index), len, false), TAG, "Failed to write items");
+    pwe_rmt->busy_index = pwe_rmt->ready_index;
+    pwe_rmt->tx_in_flight = true;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_rmt_wait_done(pwe_handle_t handle, uint32_t timeout_ms)
+{
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    return pwe_io_rmt_wait_tx(pwe_rmt, pdMS_TO_TICKS(timeout_ms));
+}
+
 static esp_err_t pwe_io_rmt_on_the_fly_send(pwe_handle_t handle, const void *data, uint32_t len)
 {
     pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
-    pwe_rmt->_total_bits_to_send = len; // workaround
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb == NULL, ESP_ERR_INVALID_STATE, TAG, "continuous output running");
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_wait_tx(pwe_rmt, portMAX_DELAY), TAG, "Failed to finish pending transmission");
+    pwe_io_rmt_wait_rst(pwe_rmt);
+    pwe_rmt->stream_pad_bits = (8 - len % 8) % 8;
+    pwe_rmt->stream_items = 0;
     rmt_write_sample(pwe_rmt->rmt_conf.channel, data, UINTCEILDIV(len, 8), true);
     return ESP_OK;
 }
 
+static esp_err_t pwe_io_rmt_on_the_fly_send_async(pwe_handle_t handle, const void *data, uint32_t len)
+{
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb == NULL, ESP_ERR_INVALID_STATE, TAG, "continuous output running");
+    // translator context is shared with the pending transmission
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_wait_tx(pwe_rmt, portMAX_DELAY), TAG, "Failed to finish pending transmission");
+    pwe_io_rmt_wait_rst(pwe_rmt);
+    pwe_rmt->stream_pad_bits = (8 - len % 8) % 8;
+    pwe_rmt->stream_items = 0;
+    ESP_RETURN_ON_ERROR(rmt_write_sample(pwe_rmt->rmt_conf.channel, data, UINTCEILDIV(len, 8), false), TAG, "Failed to write sample");
+    pwe_rmt->tx_in_flight = true;
+    return ESP_OK;
+}
+
 static esp_err_t pwe_io_spi_ensure_rst(pwe_handle_t handle)
 {
     ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
     pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb == NULL, ESP_ERR_INVALID_STATE, TAG, "continuous output running");
+    // end of a pending frame must still reach done_cb
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_wait_tx(pwe_rmt, portMAX_DELAY), TAG, "Failed to finish pending transmission");
     // first make sure output is low
     rmt_item32_t rmt_item = {
         .duration0 = 1,
@@ -159,60 +417,266 @@ static esp_err_t pwe_io_spi_ensure_rst(pwe_handle_t handle)
         .level0 = 0,
         .level1 = 0,
     };
+    pwe_rmt->rst_in_flight = true;
     rmt_write_items(pwe_rmt->rmt_conf.channel, &rmt_item, 1, true);
     // then delay
     esp_rom_delay_us(pwe_rmt->trst);
     return ESP_OK;
 }
 
-esp_err_t pwe_new_rmt_backend(const pwe_config_t *config, const rmt_config_t *rmt_conf, uint32_t buffer_size, pwe_handle_t *handle)
+static void pwe_io_rmt_reset_stats(pwe_io_rmt_handle_t *pwe_rmt)
+{
+    portENTER_CRITICAL(&pwe_rmt->stats_lock);
+    pwe_rmt->stats_calls = 0;
+    pwe_rmt->stats_min_cycles = UINT32_MAX;
+    pwe_rmt->stats_max_cycles = 0;
+    pwe_rmt->stats_min_items = UINT32_MAX;
+    pwe_rmt->stats_refill_misses = 0;
+    pwe_rmt->stats_total_cycles = 0;
+    portEXIT_CRITICAL(&pwe_rmt->stats_lock);
+}
+
+/**
+ * @brief Create the handle in storage, or allocate it if storage is NULL
+ */
+static esp_err_t pwe_io_rmt_create(const pwe_config_t *config, const rmt_config_t *rmt_conf, uint32_t buffer_size,
+                                   void *storage, size_t storage_size, pwe_handle_t *handle)
 {
     ESP_RETURN_ON_FALSE(config != NULL, ESP_ERR_INVALID_ARG, TAG, "null config");
     ESP_RETURN_ON_FALSE(rmt_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "null config");
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
 
-    uint32_t RMT_BASE_CLK_HZ = APB_CLK_FREQ / rmt_conf->clk_div;
-    uint32_t ITEM_MIN_STEP_NS = 1000000000 / RMT_BASE_CLK_HZ;
-    uint32_t ITEM_MAX_PERIOD_NS = ITEM_MIN_STEP_NS * 0x7fff;
-    // check if pulse can be presented with current clk
-    ESP_RETURN_ON_FALSE(config->T1H <= ITEM_MAX_PERIOD_NS &&
-                        config->T1L <= ITEM_MAX_PERIOD_NS &&
-                        config->T0H <= ITEM_MAX_PERIOD_NS &&
-                        config->T0L <= ITEM_MAX_PERIOD_NS,
-                        ESP_ERR_INVALID_ARG, TAG, "TxH/TxL upper overflow: suggest increasing rmt clk_div");
-    ESP_RETURN_ON_FALSE(calc_aligned_error(config->T1H, ITEM_MIN_STEP_NS) < config->T1H_ACC &&
-                        calc_aligned_error(config->T1L, ITEM_MIN_STEP_NS) < config->T1L_ACC &&
-                        calc_aligned_error(config->T0H, ITEM_MIN_STEP_NS) < config->T0H_ACC &&
-                        calc_aligned_error(config->T0L, ITEM_MIN_STEP_NS) < config->T0L_ACC,
-                        ESP_ERR_INVALID_ARG, TAG, "TxH/TxL bad resolution: suggest decreasing rmt clk_div");
-
-    pwe_io_rmt_handle_t *pwe_rmt = malloc(sizeof(pwe_io_rmt_handle_t) + buffer_size * sizeof(rmt_item32_t));
-    ESP_RETURN_ON_FALSE(pwe_rmt != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate pwe_io_rmt_handle_t");
+    // keep clk_div of the caller if it works, otherwise pick the most accurate one
+    pwe_timing_constraints_t constraints = {
+        .src_hz = APB_CLK_FREQ,
+        .div_min = rmt_conf->clk_div ? rmt_conf->clk_div : 1,
+        .div_max = rmt_conf->clk_div ? rmt_conf->clk_div : PWE_IO_RMT_CLK_DIV_MAX,
+        .max_slots_per_pulse = PWE_IO_RMT_MAX_TICKS,
+        .min_error = true,
+    };
+    pwe_timing_t timing;
+    if (pwe_timing_solve(config, &constraints, &timing) != ESP_OK) {
+        constraints.div_min = 1;
+        constraints.div_max = PWE_IO_RMT_CLK_DIV_MAX;
+        ESP_RETURN_ON_ERROR(pwe_timing_solve(config, &constraints, &timing), TAG, "Cannot resolve requested timing");
+        ESP_LOGW(TAG, "clk_div %u cannot resolve requested timing, using %u", rmt_conf->clk_div, timing.div);
+    }
+
+    uint8_t buffer_num = PWE_BUFFER_NUM(config->flags);
+    const size_t size = sizeof(pwe_io_rmt_handle_t) + buffer_num * buffer_size * sizeof(rmt_item32_t);
+    pwe_io_rmt_handle_t *pwe_rmt = NULL;
+    if (storage != NULL) {
+        ESP_RETURN_ON_FALSE(pwe_storage_fits(storage, storage_size, size), ESP_ERR_INVALID_SIZE, TAG,
+                            "storage must be %u bytes aligned to %d", (unsigned)size, PWE_STATIC_STORAGE_ALIGN);
+        pwe_rmt = memset(storage, 0, size);
+    } else {
+        pwe_rmt = malloc(size);
+        ESP_RETURN_ON_FALSE(pwe_rmt != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate pwe_io_rmt_handle_t");
+    }
+    pwe_rmt->static_storage = storage != NULL;
+    pwe_rmt->buffer_size = buffer_size;
+    pwe_rmt->buffer_num = buffer_num;
+    pwe_rmt->fill_index = 0;
+    pwe_rmt->ready_index = 0;
+    pwe_rmt->busy_index = 0;
+    pwe_rmt->tx_in_flight = false;
+    pwe_rmt->rst_in_flight = false;
+    pwe_rmt->tx_done_us = 0;
+    pwe_rmt->chain_cb = NULL;
+    pwe_rmt->chain_stop = false;
+    pwe_rmt->chain_waiter = NULL;
+    pwe_rmt->chain_reset_num = pwe_io_rmt_build_reset((uint64_t)config->TRST * timing.clock_hz / 1000000000ULL, pwe_rmt->chain_reset);
     // convert from ns to us
     pwe_rmt->trst = config->TRST / 1000;
     pwe_rmt->trst = pwe_rmt->trst == 0 ? 1 : pwe_rmt->trst;
     // fill the calculated TxX
-    pwe_rmt->t1h = UINTROUNDDIV(config->T1H, ITEM_MIN_STEP_NS);
-    pwe_rmt->t1l = UINTROUNDDIV(config->T1L, ITEM_MIN_STEP_NS);
-    pwe_rmt->t0h = UINTROUNDDIV(config->T0H, ITEM_MIN_STEP_NS);
-    pwe_rmt->t0l = UINTROUNDDIV(config->T0L, ITEM_MIN_STEP_NS);
+    pwe_rmt->t1h = timing.t1h;
+    pwe_rmt->t1l = timing.t1l;
+    pwe_rmt->t0h = timing.t0h;
+    pwe_rmt->t0l = timing.t0l;
+    const rmt_item32_t bit0 = {{{ pwe_rmt->t0h, 1, pwe_rmt->t0l, 0 }}}; //Logical 0
+    const rmt_item32_t bit1 = {{{ pwe_rmt->t1h, 1, pwe_rmt->t1l, 0 }}}; //Logical 1
+    pwe_rmt->bit_items[0] = bit0.val;
+    pwe_rmt->bit_items[1] = bit1.val;
+    spinlock_initialize(&pwe_rmt->stats_lock);
+    pwe_io_rmt_reset_stats(pwe_rmt);
+    memcpy(&pwe_rmt->timing, &timing, sizeof(pwe_timing_t));
 
     memcpy(&pwe_rmt->rmt_conf, rmt_conf, sizeof(rmt_config_t));
+    pwe_rmt->rmt_conf.clk_div = timing.div;
+    const uint32_t bit_ticks = timing.t1h + timing.t1l < timing.t0h + timing.t0l ? timing.t1h + timing.t1l : timing.t0h + timing.t0l;
+    pwe_rmt->bit_ns = (uint64_t)bit_ticks * timing.div * 1000000000ULL / APB_CLK_FREQ;
+    pwe_rmt->driver_conf = (pwe_io_rmt_driver_config_t)PWE_IO_RMT_DRIVER_CONFIG_DEFAULT();
+    pwe_rmt->installed = false;
 
     pwe_rmt->base.init = pwe_io_rmt_init;
     pwe_rmt->base.deinit = pwe_io_rmt_deinit;
     pwe_rmt->base.convert_buffer = pwe_io_rmt_convert_buffer;
+    pwe_rmt->base.convert_range = pwe_io_rmt_convert_range;
     pwe_rmt->base.write = pwe_io_rmt_write;
+    pwe_rmt->base.write_async = pwe_io_rmt_write_async;
+    pwe_rmt->base.wait_done = pwe_io_rmt_wait_done;
     pwe_rmt->base.on_the_fly_send = pwe_io_rmt_on_the_fly_send;
+    pwe_rmt->base.on_the_fly_send_async = pwe_io_rmt_on_the_fly_send_async;
     pwe_rmt->base.ensure_rst = pwe_io_spi_ensure_rst;
     pwe_rmt->base.max_payload_length = buffer_size;
+    pwe_rmt->base.done_cb = NULL;
+    pwe_rmt->base.done_cb_ctx = NULL;
+    pwe_rmt->base.byte_lut = NULL;
+    pwe_rmt->base.timing = &pwe_rmt->timing;
     *handle = &pwe_rmt->base;
     return ESP_OK;
 }
 
+esp_err_t pwe_new_rmt_backend(const pwe_config_t *config, const rmt_config_t *rmt_conf, uint32_t buffer_size, pwe_handle_t *handle)
+{
+    return pwe_io_rmt_create(config, rmt_conf, buffer_size, NULL, 0, handle);
+}
+
+esp_err_t pwe_rmt_backend_init_static(const pwe_config_t *config, const rmt_config_t *rmt_conf, uint32_t buffer_size,
+                                      void *storage, size_t storage_size, pwe_handle_t *handle)
+{
+    ESP_RETURN_ON_FALSE(storage != NULL, ESP_ERR_INVALID_ARG, TAG, "null storage");
+    return pwe_io_rmt_create(config, rmt_conf, buffer_size, storage, storage_size, handle);
+}
+
+esp_err_t pwe_rmt_add_to_sync_group(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    return rmt_add_channel_to_group(pwe_rmt->rmt_conf.channel);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t pwe_rmt_remove_from_sync_group(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+#if SOC_RMT_SUPPORT_TX_SYNCHRO
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    return rmt_remove_channel_from_group(pwe_rmt->rmt_conf.channel);
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+esp_err_t pwe_rmt_get_outgoing_buffer(pwe_handle_t handle, const rmt_item32_t **items, uint32_t *tick_hz)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL && items != NULL && tick_hz != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_rmt->buffer_size != 0, ESP_ERR_INVALID_STATE, TAG, "no outgoing buffer in streaming mode");
+    *items = pwe_io_rmt_get_buffer(pwe_rmt, pwe_rmt->ready_index);
+    *tick_hz = APB_CLK_FREQ / pwe_rmt->rmt_conf.clk_div;
+    return ESP_OK;
+}
+
+esp_err_t pwe_rmt_set_driver_config(pwe_handle_t handle, const pwe_io_rmt_driver_config_t *driver_conf)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL && driver_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    ESP_RETURN_ON_FALSE(driver_conf->core_id >= -1 && driver_conf->core_id < portNUM_PROCESSORS, ESP_ERR_INVALID_ARG, TAG, "invalid core_id");
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    const rmt_channel_t channel = pwe_rmt->rmt_conf.channel;
+    uint8_t mem_block_num = pwe_rmt->rmt_conf.mem_block_num;
+    if (driver_conf->max_mem_blocks) {
+        // payload plus end marker without any refill if possible, otherwise as much as allowed for fewer refills
+        const uint32_t blocks_for_payload = UINTCEILDIV(pwe_rmt->buffer_size + 1, SOC_RMT_MEM_WORDS_PER_CHANNEL);
+        // TX channels come first in a group, memory of RX only channels following them (S3, C3) cannot be taken
+        const uint32_t blocks_available =
+            channel < SOC_RMT_TX_CANDIDATES_PER_GROUP ? SOC_RMT_TX_CANDIDATES_PER_GROUP - channel : 1;
+        mem_block_num = driver_conf->max_mem_blocks < blocks_available ? driver_conf->max_mem_blocks : blocks_available;
+        if (pwe_rmt->buffer_size != 0 && blocks_for_payload < mem_block_num) {
+            mem_block_num = blocks_for_payload;
+        }
+    }
+    const bool installed = pwe_rmt->installed;
+    if (installed) {
+        ESP_RETURN_ON_ERROR(pwe_io_rmt_deinit(handle), TAG, "Failed to uninstall RMT driver");
+    }
+    pwe_rmt->rmt_conf.mem_block_num = mem_block_num;
+    memcpy(&pwe_rmt->driver_conf, driver_conf, sizeof(pwe_io_rmt_driver_config_t));
+    ESP_LOGD(TAG, "channel %d: %u memory blocks, interrupt flags 0x%x on core %d", channel, mem_block_num,
+             driver_conf->intr_alloc_flags, driver_conf->core_id);
+    if (installed) {
+        ESP_RETURN_ON_ERROR(pwe_io_rmt_init(handle), TAG, "Failed to reinstall RMT driver");
+    }
+    return ESP_OK;
+}
+
+esp_err_t pwe_rmt_get_translator_stats(pwe_handle_t handle, pwe_rmt_translator_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL && stats != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    portENTER_CRITICAL(&pwe_rmt->stats_lock);
+    const uint32_t calls = pwe_rmt->stats_calls;
+    const uint64_t total_cycles = pwe_rmt->stats_total_cycles;
+    stats->calls = calls;
+    stats->min_cycles = calls ? pwe_rmt->stats_min_cycles : 0;
+    stats->max_cycles = pwe_rmt->stats_max_cycles;
+    stats->refill_items = calls ? pwe_rmt->stats_min_items : 0;
+    stats->refill_misses = pwe_rmt->stats_refill_misses;
+    portEXIT_CRITICAL(&pwe_rmt->stats_lock);
+    stats->avg_cycles = calls ? total_cycles / calls : 0;
+    // the refilled half has to be ready before the other half is sent out, shortest bits make it the tightest
+    stats->refill_deadline_ns = stats->refill_items * pwe_rmt->bit_ns;
+    return ESP_OK;
+}
+
+esp_err_t pwe_rmt_reset_translator_stats(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_rmt_reset_stats(__containerof(handle, pwe_io_rmt_handle_t, base));
+    return ESP_OK;
+}
+
+esp_err_t pwe_rmt_start_continuous(pwe_handle_t handle, uint32_t len, pwe_rmt_next_frame_cb_t next_cb, void *user_ctx)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL && next_cb != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_rmt->installed, ESP_ERR_INVALID_STATE, TAG, "not initialized");
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb == NULL, ESP_ERR_INVALID_STATE, TAG, "continuous output running");
+    ESP_RETURN_ON_FALSE(!(pwe_rmt->driver_conf.intr_alloc_flags & ESP_INTR_FLAG_IRAM), ESP_ERR_NOT_SUPPORTED, TAG,
+                        "frames cannot be restarted from an IRAM ISR");
+    ESP_RETURN_ON_FALSE(len > 0 && len <= pwe_rmt->buffer_size, ESP_ERR_INVALID_ARG, TAG, "len out of outgoing buffer");
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_reset_num > 0, ESP_ERR_NOT_SUPPORTED, TAG, "TRST too long for RMT memory");
+    ESP_RETURN_ON_FALSE(len + pwe_rmt->chain_reset_num <= pwe_rmt->rmt_conf.mem_block_num * SOC_RMT_MEM_WORDS_PER_CHANNEL,
+                        ESP_ERR_INVALID_SIZE, TAG, "frame and TRST do not fit RMT memory");
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_wait_tx(pwe_rmt, portMAX_DELAY), TAG, "Failed to finish pending transmission");
+    pwe_rmt->chain_ctx = user_ctx;
+    pwe_rmt->chain_bits = len;
+    pwe_rmt->chain_stop = false;
+    pwe_rmt->chain_waiter = NULL;
+    pwe_rmt->chain_cb = next_cb;
+    // first frame from here, each following one from the end of the previous one
+    esp_err_t ret = pwe_io_rmt_chain_next(pwe_rmt);
+    if (ret != ESP_OK) {
+        pwe_rmt->chain_cb = NULL;
+    }
+    return ret;
+}
+
+esp_err_t pwe_rmt_stop_continuous(pwe_handle_t handle, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb != NULL, ESP_ERR_INVALID_STATE, TAG, "continuous output not running");
+    pwe_rmt->chain_waiter = xTaskGetCurrentTaskHandle();
+    pwe_rmt->chain_stop = true;
+    // end of the frame on the wire clears chain_cb instead of starting another one
+    while (pwe_rmt->chain_cb != NULL && ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)) > 0) {
+    }
+    pwe_rmt->chain_waiter = NULL;
+    ESP_RETURN_ON_FALSE(pwe_rmt->chain_cb == NULL, ESP_ERR_TIMEOUT, TAG, "last frame not done");
+    return ESP_OK;
+}
+
 esp_err_t pwe_delete_rmt_backend(pwe_handle_t handle)
 {
     ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
     pwe_io_rmt_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_handle_t, base);
-    free(pwe_rmt);
+    if (!pwe_rmt->static_storage) {
+        free(pwe_rmt);
+    }
     return ESP_OK;
 }
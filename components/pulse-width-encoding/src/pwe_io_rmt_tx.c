@@ -0,0 +1,315 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "pwe_io_rmt_tx.h"
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 3, 0)
+
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_clk_tree.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "soc/soc_caps.h"
+#include "driver/rmt_tx.h"
+#include "pwe_rmt_symbols.h"
+#include "pwe_timing.h"
+#include "pwe_priv.h"
+#include "esp_check.h"
+
+static const char *TAG = "PWE_IO_RMT_TX";
+
+#define PWE_IO_RMT_TX_DMA_SYMBOLS       1024
+#define PWE_IO_RMT_TX_QUEUE_DEPTH       4
+
+typedef struct {
+    struct pwe_s base;
+    pwe_io_rmt_tx_config_t tx_conf;
+    rmt_channel_handle_t channel;
+    rmt_encoder_handle_t stream_encoder;    // encodes source bits from ISR, also sends TRST
+    rmt_encoder_handle_t copy_encoder;      // sends outgoing buffer as is
+    pwe_rmt_symbols_t symbols;              // state of stream_encoder, not to be changed while it is in use
+    pwe_timing_t timing;
+    uint32_t trst_us;           // TRST kept between two frames, rounded up
+    uint32_t buffer_size;       // symbols per outgoing buffer
+    uint8_t buffer_num;         // 2 with PWE_FLAG_DOUBLE_BUFFER, otherwise 1
+    uint8_t fill_index;         // outgoing buffer to be filled by next convert_buffer()
+    uint8_t ready_index;        // outgoing buffer holding latest converted data
+    uint8_t busy_index;         // outgoing buffer being sent, valid if tx_in_flight
+    bool tx_in_flight;
+    volatile bool rst_in_flight;    // TRST only transmission of ensure_rst, its end is not reported to done_cb
+    volatile int64_t tx_done_us;    // end of the latest transmission, set from done callback
+    uint8_t rst_dummy;          // payload of the TRST only transmission, never read
+    uint32_t buffer[0];
+} pwe_io_rmt_tx_handle_t;
+
+static inline uint32_t *pwe_io_rmt_tx_get_buffer(pwe_io_rmt_tx_handle_t *pwe_rmt, uint8_t index)
+{
+    return pwe_rmt->buffer + index * pwe_rmt->buffer_size;
+}
+
+static size_t IRAM_ATTR pwe_io_rmt_tx_encode_cb(const void *data, size_t data_size, size_t symbols_written, size_t symbols_free,
+                                                rmt_symbol_word_t *symbols, bool *done, void *arg)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = arg;
+    return pwe_rmt_symbols_encode(&pwe_rmt->symbols, data, symbols_written, symbols_free, &symbols->val, done);
+}
+
+static bool IRAM_ATTR pwe_io_rmt_tx_done_cb(rmt_channel_handle_t channel, const rmt_tx_done_event_data_t *edata, void *user_ctx)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = user_ctx;
+    pwe_rmt->tx_done_us = esp_timer_get_time();
+    if (pwe_rmt->rst_in_flight) {
+        pwe_rmt->rst_in_flight = false;
+        return false;
+    }
+    if (pwe_rmt->base.done_cb != NULL) {
+        pwe_rmt->base.done_cb(&pwe_rmt->base, pwe_rmt->base.done_cb_ctx);
+    }
+    return false;
+}
+
+static esp_err_t pwe_io_rmt_tx_wait_tx(pwe_io_rmt_tx_handle_t *pwe_rmt, int timeout_ms)
+{
+    if (pwe_rmt->tx_in_flight) {
+        ESP_RETURN_ON_ERROR(rmt_tx_wait_all_done(pwe_rmt->channel, timeout_ms), TAG, "Failed to wait tx done");
+        pwe_rmt->tx_in_flight = false;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Keep line low for TRST since the end of previous transmission, so that next frame is not taken as part of it
+ */
+static void pwe_io_rmt_tx_wait_rst(pwe_io_rmt_tx_handle_t *pwe_rmt)
+{
+    const int64_t idle_us = esp_timer_get_time() - pwe_rmt->tx_done_us;
+    if (idle_us < pwe_rmt->trst_us) {
+        esp_rom_delay_us(pwe_rmt->trst_us - idle_us);
+    }
+}
+
+/**
+ * @brief Send len bits of data, plus TRST if with_reset, through stream encoder
+ */
+static esp_err_t pwe_io_rmt_tx_stream(pwe_io_rmt_tx_handle_t *pwe_rmt, const void *data, uint32_t len, bool with_reset)
+{
+    // encoder state belongs to the pending transmission
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_tx_wait_tx(pwe_rmt, -1), TAG, "Failed to finish pending transmission");
+    if (len != 0) {
+        pwe_io_rmt_tx_wait_rst(pwe_rmt);
+    }
+    pwe_rmt->rst_in_flight = len == 0;
+    pwe_rmt->symbols.byte_lut = pwe_rmt->base.byte_lut;
+    pwe_rmt->symbols.payload_bits = len;
+    pwe_rmt->symbols.with_reset = with_reset;
+    const rmt_transmit_config_t transmit_conf = {
+        .loop_count = 0,
+    };
+    // driver does not take empty payload, TRST alone is sent with a dummy byte which is never read
+    ESP_RETURN_ON_ERROR(rmt_transmit(pwe_rmt->channel, pwe_rmt->stream_encoder, len ? data : &pwe_rmt->rst_dummy,
+                                     len ? UINTCEILDIV(len, 8) : 1, &transmit_conf), TAG, "Failed to transmit");
+    pwe_rmt->tx_in_flight = true;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_rmt_tx_init(pwe_handle_t handle)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    esp_err_t ret = ESP_OK;
+    const rmt_tx_channel_config_t channel_conf = {
+        .gpio_num = pwe_rmt->tx_conf.gpio,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = pwe_rmt->timing.clock_hz,
+        .mem_block_symbols = pwe_rmt->tx_conf.mem_block_symbols,
+        .trans_queue_depth = pwe_rmt->tx_conf.trans_queue_depth,
+        .flags.with_dma = pwe_rmt->tx_conf.with_dma,
+    };
+    ESP_RETURN_ON_ERROR(rmt_new_tx_channel(&channel_conf, &pwe_rmt->channel), TAG, "Failed to create RMT TX channel");
+    const rmt_simple_encoder_config_t stream_conf = {
+        .callback = pwe_io_rmt_tx_encode_cb,
+        .arg = pwe_rmt,
+        .min_chunk_size = 1,    // resumes from any symbol
+    };
+    ESP_GOTO_ON_ERROR(rmt_new_simple_encoder(&stream_conf, &pwe_rmt->stream_encoder), err_stream, TAG, "Failed to create encoder");
+    const rmt_copy_encoder_config_t copy_conf = {};
+    ESP_GOTO_ON_ERROR(rmt_new_copy_encoder(&copy_conf, &pwe_rmt->copy_encoder), err_copy, TAG, "Failed to create copy encoder");
+    const rmt_tx_event_callbacks_t cbs = {
+        .on_trans_done = pwe_io_rmt_tx_done_cb,
+    };
+    ESP_GOTO_ON_ERROR(rmt_tx_register_event_callbacks(pwe_rmt->channel, &cbs, pwe_rmt), err_enable, TAG, "Failed to register callback");
+    ESP_GOTO_ON_ERROR(rmt_enable(pwe_rmt->channel), err_enable, TAG, "Failed to enable RMT channel");
+    return ESP_OK;
+
+err_enable:
+    rmt_del_encoder(pwe_rmt->copy_encoder);
+err_copy:
+    rmt_del_encoder(pwe_rmt->stream_encoder);
+err_stream:
+    rmt_del_channel(pwe_rmt->channel);
+    pwe_rmt->channel = NULL;
+    return ret;
+}
+
+static esp_err_t pwe_io_rmt_tx_deinit(pwe_handle_t handle)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_tx_wait_tx(pwe_rmt, -1), TAG, "Failed to finish pending transmission");
+    ESP_RETURN_ON_ERROR(rmt_disable(pwe_rmt->channel), TAG, "Failed to disable RMT channel");
+    ESP_RETURN_ON_ERROR(rmt_del_encoder(pwe_rmt->copy_encoder), TAG, "Failed to delete copy encoder");
+    ESP_RETURN_ON_ERROR(rmt_del_encoder(pwe_rmt->stream_encoder), TAG, "Failed to delete encoder");
+    ESP_RETURN_ON_ERROR(rmt_del_channel(pwe_rmt->channel), TAG, "Failed to delete RMT channel");
+    pwe_rmt->channel = NULL;
+    return ESP_OK;
+}
+
+/**
+ * @brief Encode len bits from src into dest with the settings of the stream encoder, without touching its state
+ */
+static void pwe_io_rmt_tx_encode(pwe_io_rmt_tx_handle_t *pwe_rmt, const void *src, uint32_t len, uint32_t *dest)
+{
+    pwe_rmt_symbols_t symbols = pwe_rmt->symbols;
+    symbols.byte_lut = pwe_rmt->base.byte_lut;
+    symbols.payload_bits = len;
+    symbols.with_reset = false;
+    bool done = false;
+    pwe_rmt_symbols_encode(&symbols, src, 0, len, dest, &done);
+}
+
+static esp_err_t pwe_io_rmt_tx_convert_buffer(pwe_handle_t handle, const void *data, uint32_t len, uint32_t *outgoing_buffer_len)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_rmt->base.max_payload_length >= len, ESP_ERR_INVALID_ARG, TAG, "len too big");
+    if (pwe_rmt->tx_in_flight && pwe_rmt->busy_index == pwe_rmt->fill_index) {
+        // never touch the buffer which is on the wire
+        ESP_RETURN_ON_ERROR(pwe_io_rmt_tx_wait_tx(pwe_rmt, -1), TAG, "Failed to finish pending transmission");
+    }
+    pwe_io_rmt_tx_encode(pwe_rmt, data, len, pwe_io_rmt_tx_get_buffer(pwe_rmt, pwe_rmt->fill_index));
+    *outgoing_buffer_len = len;
+    pwe_rmt->ready_index = pwe_rmt->fill_index;
+    pwe_rmt->fill_index = (pwe_rmt->fill_index + 1) % pwe_rmt->buffer_num;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_rmt_tx_convert_range(pwe_handle_t handle, const void *data, uint32_t offset, uint32_t len, uint32_t *outgoing_buffer_len)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    if (pwe_rmt->tx_in_flight && pwe_rmt->busy_index == pwe_rmt->ready_index) {
+        ESP_RETURN_ON_ERROR(pwe_io_rmt_tx_wait_tx(pwe_rmt, -1), TAG, "Failed to finish pending transmission");
+    }
+    // one symbol per bit, update the latest converted frame in place
+    pwe_io_rmt_tx_encode(pwe_rmt, data, len, pwe_io_rmt_tx_get_buffer(pwe_rmt, pwe_rmt->ready_index) + offset);
+    *outgoing_buffer_len = offset + len;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_rmt_tx_write_async(pwe_handle_t handle, uint32_t len)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_tx_wait_tx(pwe_rmt, -1), TAG, "Failed to finish pending transmission");
+    pwe_io_rmt_tx_wait_rst(pwe_rmt);
+    const rmt_transmit_config_t transmit_conf = {
+        .loop_count = 0,
+    };
+    ESP_RETURN_ON_ERROR(rmt_transmit(pwe_rmt->channel, pwe_rmt->copy_encoder, pwe_io_rmt_tx_get_buffer(pwe_rmt, pwe_rmt->ready_index),
+                                     len * sizeof(uint32_t), &transmit_conf), TAG, "Failed to transmit");
+    pwe_rmt->busy_index = pwe_rmt->ready_index;
+    pwe_rmt->tx_in_flight = true;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_rmt_tx_write(pwe_handle_t handle, uint32_t len)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_tx_write_async(handle, len), TAG, "Failed to write");
+    return pwe_io_rmt_tx_wait_tx(pwe_rmt, -1);
+}
+
+static esp_err_t pwe_io_rmt_tx_wait_done(pwe_handle_t handle, uint32_t timeout_ms)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    return pwe_io_rmt_tx_wait_tx(pwe_rmt, timeout_ms);
+}
+
+static esp_err_t pwe_io_rmt_tx_on_the_fly_send(pwe_handle_t handle, const void *data, uint32_t len)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_tx_stream(pwe_rmt, data, len, false), TAG, "Failed to send");
+    return pwe_io_rmt_tx_wait_tx(pwe_rmt, -1);
+}
+
+static esp_err_t pwe_io_rmt_tx_on_the_fly_send_async(pwe_handle_t handle, const void *data, uint32_t len)
+{
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    return pwe_io_rmt_tx_stream(pwe_rmt, data, len, false);
+}
+
+static esp_err_t pwe_io_rmt_tx_ensure_rst(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    // TRST is a low symbol on the wire right after previous transmission, instead of a delay on CPU
+    ESP_RETURN_ON_ERROR(pwe_io_rmt_tx_stream(pwe_rmt, NULL, 0, true), TAG, "Failed to send TRST");
+    return pwe_io_rmt_tx_wait_tx(pwe_rmt, -1);
+}
+
+esp_err_t pwe_new_rmt_tx_backend(const pwe_config_t *config, const pwe_io_rmt_tx_config_t *tx_conf, uint32_t buffer_size, pwe_handle_t *handle)
+{
+    ESP_RETURN_ON_FALSE(config != NULL, ESP_ERR_INVALID_ARG, TAG, "null config");
+    ESP_RETURN_ON_FALSE(tx_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "null config");
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+#if !SOC_RMT_SUPPORT_DMA
+    ESP_RETURN_ON_FALSE(!tx_conf->with_dma, ESP_ERR_NOT_SUPPORTED, TAG, "RMT DMA not supported on this target");
+#endif
+
+    uint32_t src_hz = 0;
+    ESP_RETURN_ON_ERROR(esp_clk_tree_src_get_freq_hz((soc_module_clk_t)RMT_CLK_SRC_DEFAULT, ESP_CLK_TREE_SRC_FREQ_PRECISION_CACHED, &src_hz),
+                        TAG, "Failed to get RMT source clock");
+    pwe_rmt_symbols_t symbols;
+    pwe_timing_t timing;
+    ESP_RETURN_ON_ERROR(pwe_rmt_symbols_init(&symbols, config, src_hz, tx_conf->resolution_hz, &timing), TAG, "Cannot resolve requested timing");
+
+    uint8_t buffer_num = PWE_BUFFER_NUM(config->flags);
+    pwe_io_rmt_tx_handle_t *pwe_rmt = calloc(1, sizeof(pwe_io_rmt_tx_handle_t) + buffer_num * buffer_size * sizeof(uint32_t));
+    ESP_RETURN_ON_FALSE(pwe_rmt != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate pwe_io_rmt_tx_handle_t");
+    memcpy(&pwe_rmt->tx_conf, tx_conf, sizeof(pwe_io_rmt_tx_config_t));
+    if (pwe_rmt->tx_conf.mem_block_symbols == 0) {
+        pwe_rmt->tx_conf.mem_block_symbols = tx_conf->with_dma ? PWE_IO_RMT_TX_DMA_SYMBOLS : SOC_RMT_MEM_WORDS_PER_CHANNEL;
+    }
+    if (pwe_rmt->tx_conf.trans_queue_depth == 0) {
+        pwe_rmt->tx_conf.trans_queue_depth = PWE_IO_RMT_TX_QUEUE_DEPTH;
+    }
+    memcpy(&pwe_rmt->symbols, &symbols, sizeof(pwe_rmt_symbols_t));
+    memcpy(&pwe_rmt->timing, &timing, sizeof(pwe_timing_t));
+    pwe_rmt->trst_us = UINTCEILDIV(config->TRST, 1000);
+    pwe_rmt->buffer_size = buffer_size;
+    pwe_rmt->buffer_num = buffer_num;
+
+    pwe_rmt->base.init = pwe_io_rmt_tx_init;
+    pwe_rmt->base.deinit = pwe_io_rmt_tx_deinit;
+    pwe_rmt->base.convert_buffer = pwe_io_rmt_tx_convert_buffer;
+    pwe_rmt->base.convert_range = pwe_io_rmt_tx_convert_range;
+    pwe_rmt->base.write = pwe_io_rmt_tx_write;
+    pwe_rmt->base.write_async = pwe_io_rmt_tx_write_async;
+    pwe_rmt->base.wait_done = pwe_io_rmt_tx_wait_done;
+    pwe_rmt->base.on_the_fly_send = pwe_io_rmt_tx_on_the_fly_send;
+    pwe_rmt->base.on_the_fly_send_async = pwe_io_rmt_tx_on_the_fly_send_async;
+    pwe_rmt->base.ensure_rst = pwe_io_rmt_tx_ensure_rst;
+    pwe_rmt->base.max_payload_length = buffer_size;
+    pwe_rmt->base.timing = &pwe_rmt->timing;
+    *handle = &pwe_rmt->base;
+    return ESP_OK;
+}
+
+esp_err_t pwe_delete_rmt_tx_backend(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_rmt_tx_handle_t *pwe_rmt = __containerof(handle, pwe_io_rmt_tx_handle_t, base);
+    free(pwe_rmt);
+    return ESP_OK;
+}
+
+#endif
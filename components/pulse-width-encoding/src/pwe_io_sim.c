@@ -0,0 +1,247 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "pwe_io_sim.h"
+#include "pwe_priv.h"
+#include "esp_check.h"
+
+static const char *TAG = "PWE_IO_SIM";
+
+#define PWE_IO_SIM_DEFAULT_MAX_EDGES    65536
+
+typedef struct {
+    struct pwe_s base;
+    uint32_t t1h;
+    uint32_t t1l;
+    uint32_t t0h;
+    uint32_t t0l;
+    uint32_t trst;
+    uint8_t idle_level;
+    uint64_t now_ns;
+    uint64_t frame_end_ns;      // end of last frame, next one starts TRST later at the earliest
+    bool frame_sent;            // since the timeline was cleared
+    uint32_t edge_num;
+    uint32_t max_edges;
+    uint32_t dropped;
+    pwe_sim_edge_t *edges;
+    uint8_t buffer[0];          // outgoing buffer holds source bits as they are, after byte_lut
+} pwe_io_sim_handle_t;
+
+static inline uint32_t pwe_io_sim_round(uint32_t ns, uint32_t resolution_ns)
+{
+    return resolution_ns ? UINTROUNDDIV(ns, resolution_ns) * resolution_ns : ns;
+}
+
+static void pwe_io_sim_push_edge(pwe_io_sim_handle_t *pwe_sim, uint8_t level)
+{
+    if (pwe_sim->edge_num == pwe_sim->max_edges) {
+        ++pwe_sim->dropped;
+        return;
+    }
+    pwe_sim->edges[pwe_sim->edge_num].time_ns = pwe_sim->now_ns;
+    pwe_sim->edges[pwe_sim->edge_num].level = level ^ pwe_sim->idle_level;
+    ++pwe_sim->edge_num;
+}
+
+/**
+ * @brief Lay out len bits of src as pulses from current time on, MSBit first
+ *
+ * Like the other backends, a frame waits until the line has been low for TRST since the previous one.
+ */
+static void pwe_io_sim_emit(pwe_io_sim_handle_t *pwe_sim, const uint8_t *src, uint32_t len, const uint8_t *lut)
+{
+    if (pwe_sim->frame_sent && pwe_sim->now_ns < pwe_sim->frame_end_ns + pwe_sim->trst) {
+        pwe_sim->now_ns = pwe_sim->frame_end_ns + pwe_sim->trst;
+    }
+    for (uint32_t i = 0; i < len; ++i) {
+        const uint8_t byte = lut ? lut[src[i / 8]] : src[i / 8];
+        const bool bit = byte & (0x80 >> (i % 8));
+        pwe_io_sim_push_edge(pwe_sim, 1);
+        pwe_sim->now_ns += bit ? pwe_sim->t1h : pwe_sim->t0h;
+        pwe_io_sim_push_edge(pwe_sim, 0);
+        pwe_sim->now_ns += bit ? pwe_sim->t1l : pwe_sim->t0l;
+    }
+    pwe_sim->frame_end_ns = pwe_sim->now_ns;
+    pwe_sim->frame_sent = true;
+}
+
+static esp_err_t pwe_io_sim_init(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_sim_deinit(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_sim_convert_buffer(pwe_handle_t handle, const void *data, uint32_t len, uint32_t *outgoing_buffer_len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    const uint8_t *src = (const uint8_t *)data;
+    const uint8_t *lut = pwe_sim->base.byte_lut;
+    for (uint32_t i = 0; i < UINTCEILDIV(len, 8); ++i) {
+        pwe_sim->buffer[i] = lut ? lut[src[i]] : src[i];
+    }
+    *outgoing_buffer_len = len;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_sim_convert_range(pwe_handle_t handle, const void *data, uint32_t offset, uint32_t len, uint32_t *outgoing_buffer_len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    const uint8_t *src = (const uint8_t *)data;
+    const uint8_t *lut = pwe_sim->base.byte_lut;
+    for (uint32_t i = 0; i < len / 8; ++i) {
+        pwe_sim->buffer[offset / 8 + i] = lut ? lut[src[i]] : src[i];
+    }
+    *outgoing_buffer_len = offset + len;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_sim_write(pwe_handle_t handle, uint32_t len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    pwe_io_sim_emit(pwe_sim, pwe_sim->buffer, len, NULL);
+    if (pwe_sim->base.done_cb != NULL) {
+        pwe_sim->base.done_cb(handle, pwe_sim->base.done_cb_ctx);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_sim_wait_done(pwe_handle_t handle, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_sim_on_the_fly_send(pwe_handle_t handle, const void *data, uint32_t len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    pwe_io_sim_emit(pwe_sim, data, len, pwe_sim->base.byte_lut);
+    if (pwe_sim->base.done_cb != NULL) {
+        pwe_sim->base.done_cb(handle, pwe_sim->base.done_cb_ctx);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_sim_ensure_rst(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    pwe_sim->now_ns += pwe_sim->trst;
+    return ESP_OK;
+}
+
+esp_err_t pwe_new_sim_backend(const pwe_config_t *config, const pwe_io_sim_config_t *sim_conf, uint32_t buffer_size, pwe_handle_t *handle)
+{
+    ESP_RETURN_ON_FALSE(config != NULL, ESP_ERR_INVALID_ARG, TAG, "null config");
+    ESP_RETURN_ON_FALSE(sim_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "null sim config");
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+
+    pwe_io_sim_handle_t *pwe_sim = calloc(1, sizeof(pwe_io_sim_handle_t) + UINTCEILDIV(buffer_size, 8));
+    ESP_RETURN_ON_FALSE(pwe_sim != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate pwe_io_sim_handle_t");
+    pwe_sim->max_edges = sim_conf->max_edges ? sim_conf->max_edges : PWE_IO_SIM_DEFAULT_MAX_EDGES;
+    pwe_sim->edges = malloc(pwe_sim->max_edges * sizeof(pwe_sim_edge_t));
+    if (pwe_sim->edges == NULL) {
+        free(pwe_sim);
+        ESP_LOGE(TAG, "Failed to allocate edge timeline");
+        return ESP_ERR_NO_MEM;
+    }
+    pwe_sim->t1h = pwe_io_sim_round(config->T1H, sim_conf->resolution_ns);
+    pwe_sim->t1l = pwe_io_sim_round(config->T1L, sim_conf->resolution_ns);
+    pwe_sim->t0h = pwe_io_sim_round(config->T0H, sim_conf->resolution_ns);
+    pwe_sim->t0l = pwe_io_sim_round(config->T0L, sim_conf->resolution_ns);
+    pwe_sim->trst = config->TRST;
+    pwe_sim->idle_level = sim_conf->invert ? 1 : 0;
+
+    pwe_sim->base.init = pwe_io_sim_init;
+    pwe_sim->base.deinit = pwe_io_sim_deinit;
+    pwe_sim->base.convert_buffer = pwe_io_sim_convert_buffer;
+    pwe_sim->base.convert_range = pwe_io_sim_convert_range;
+    pwe_sim->base.write = pwe_io_sim_write;
+    pwe_sim->base.write_async = pwe_io_sim_write;       // finished once laid out
+    pwe_sim->base.wait_done = pwe_io_sim_wait_done;
+    pwe_sim->base.on_the_fly_send = pwe_io_sim_on_the_fly_send;
+    pwe_sim->base.on_the_fly_send_async = pwe_io_sim_on_the_fly_send;
+    pwe_sim->base.ensure_rst = pwe_io_sim_ensure_rst;
+    pwe_sim->base.max_payload_length = buffer_size;
+    pwe_sim->base.done_cb = NULL;
+    pwe_sim->base.done_cb_ctx = NULL;
+    pwe_sim->base.byte_lut = NULL;
+    pwe_sim->base.timing = NULL;
+    *handle = &pwe_sim->base;
+    return ESP_OK;
+}
+
+esp_err_t pwe_delete_sim_backend(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    free(pwe_sim->edges);
+    free(pwe_sim);
+    return ESP_OK;
+}
+
+esp_err_t pwe_sim_get_edges(pwe_handle_t handle, const pwe_sim_edge_t **edges, uint32_t *num, uint32_t *dropped)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL && edges != NULL && num != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    *edges = pwe_sim->edges;
+    *num = pwe_sim->edge_num;
+    if (dropped != NULL) {
+        *dropped = pwe_sim->dropped;
+    }
+    return ESP_OK;
+}
+
+esp_err_t pwe_sim_advance(pwe_handle_t handle, uint64_t ns)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    pwe_sim->now_ns += ns;
+    return ESP_OK;
+}
+
+esp_err_t pwe_sim_clear(pwe_handle_t handle)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    pwe_sim->now_ns = 0;
+    pwe_sim->frame_sent = false;
+    pwe_sim->edge_num = 0;
+    pwe_sim->dropped = 0;
+    return ESP_OK;
+}
+
+esp_err_t pwe_sim_export_vcd(pwe_handle_t handle, const char *path)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL && path != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    pwe_io_sim_handle_t *pwe_sim = __containerof(handle, pwe_io_sim_handle_t, base);
+    FILE *f = fopen(path, "w");
+    ESP_RETURN_ON_FALSE(f != NULL, ESP_FAIL, TAG, "Failed to open %s", path);
+    fprintf(f, "$timescale 1ns $end\n");
+    fprintf(f, "$scope module pwe $end\n$var wire 1 ! out $end\n$upscope $end\n$enddefinitions $end\n");
+    fprintf(f, "$dumpvars\n%u!\n$end\n", pwe_sim->idle_level);
+    for (uint32_t i = 0; i < pwe_sim->edge_num; ++i) {
+        fprintf(f, "#%" PRIu64 "\n%u!\n", pwe_sim->edges[i].time_ns, pwe_sim->edges[i].level);
+    }
+    // close the last pulse so that viewers show it completely
+    fprintf(f, "#%" PRIu64 "\n", pwe_sim->now_ns);
+    esp_err_t ret = ferror(f) ? ESP_FAIL : ESP_OK;
+    fclose(f);
+    ESP_RETURN_ON_FALSE(ret == ESP_OK, ESP_FAIL, TAG, "Failed to write %s", path);
+    return ESP_OK;
+}
@@ -8,69 +8,105 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "soc/soc.h"
+#include "soc/soc_memory_layout.h"
 #include "pwe_io_spi.h"
+#include "pwe_private/pwe_io_spi_handle.h"
+#include "pwe_timing.h"
+#include "pwe_priv.h"
 #include "esp_check.h"
 
 static const char *TAG = "PWE_IO_SPI";
 
-#define UINTROUNDDIV(divd, divor) ( ((divd) + ((divor) / 2)) / (divor) )
-#define UINTCEILDIV(divd, divor) ( ((divd) + (divor) - 1) / (divor) )
-
-static inline uint32_t calc_aligned_error(uint32_t divided, uint32_t divisor)
-{
-    return abs((int)(divided - UINTROUNDDIV(divided, divisor) * divisor));
-}
-
-static uint32_t find_suitable_factor(uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint16_t range)
-{
-    uint32_t min_val = a < b ? a : b;
-    min_val = min_val < c ? min_val : c;
-    min_val = min_val < d ? min_val : d;
-    uint32_t max_val = a > b ? a : b;
-    min_val = max_val > c ? max_val : c;
-    min_val = max_val > d ? max_val : d;
-    uint32_t current_factor = 0;
-    uint16_t current_error = range + 1;
-    uint16_t current_multiple = 0;
-    for (uint32_t num = min_val + range - 1; num > 1; --num) {
-        uint16_t a_align_err = calc_aligned_error(a, num);
-        uint16_t b_align_err = calc_aligned_error(b, num);
-        uint16_t c_align_err = calc_aligned_error(c, num);
-        uint16_t d_align_err = calc_aligned_error(d, num);
-        uint32_t max_align_err = a_align_err > b_align_err ? a_align_err : b_align_err;
-        max_align_err = max_align_err > c_align_err ? max_align_err : c_align_err;
-        max_align_err = max_align_err > d_align_err ? max_align_err : d_align_err;
-        if (max_align_err < range) {
-            uint16_t temp_multiple = UINTROUNDDIV(max_val, num);
-            if (temp_multiple > 4) {
-                // stop here, as following results are not practical to use
-                break;
-            }
-            // only update the 'best' result if there is significant reduced error but without increasing multiple too much
-            if ((max_align_err < current_error && current_multiple <= temp_multiple) ||
-                    (max_align_err < current_error / 2 && temp_multiple > current_multiple)) {
-                current_factor = num;
-                current_error = max_align_err;
-                current_multiple = temp_multiple;
+#define PWE_IO_SPI_CLK_DIV_PRE_MAX      8192
+#define PWE_IO_SPI_CLK_DIV_N_MAX        64
+#define PWE_IO_SPI_STREAM_RESTART_MAX   2       // frame restarts after a late refill before giving up
+
+/**
+ * @brief Build nibble lookup table from resolved slot configuration
+ *
+ * Each source nibble maps to at most 4 * max_slots_per_bit slots, which fits into one word as long as a single
+ * symbol takes no more than 8 slots.
+ */
+static void pwe_io_spi_build_lut(pwe_io_spi_handle_t *pwe_spi)
+{
+    const uint32_t sym1 = ((1u << pwe_spi->t1h) - 1) << pwe_spi->t1l;
+    const uint32_t sym0 = ((1u << pwe_spi->t0h) - 1) << pwe_spi->t0l;
+    const uint8_t sym1_slots = pwe_spi->t1h + pwe_spi->t1l;
+    const uint8_t sym0_slots = pwe_spi->t0h + pwe_spi->t0l;
+    for (uint32_t nibble = 0; nibble < 16; ++nibble) {
+        uint32_t pattern = 0;
+        uint8_t slots = 0;
+        for (int i = 3; i >= 0; --i) {
+            if (nibble & (1 << i)) {
+                pattern = (pattern << sym1_slots) | sym1;
+                slots += sym1_slots;
+            } else {
+                pattern = (pattern << sym0_slots) | sym0;
+                slots += sym0_slots;
             }
         }
+        pwe_spi->nibble_pattern[nibble] = pattern;
+        pwe_spi->nibble_slots[nibble] = slots;
+    }
+}
+
+/**
+ * @brief SPI clock is APB divided by pre (1~8192) * n (2~64), or APB itself
+ */
+static bool pwe_io_spi_div_achievable(uint32_t div)
+{
+    if (div == 1) {
+        return true;
+    }
+    for (uint32_t n = 2; n <= PWE_IO_SPI_CLK_DIV_N_MAX; ++n) {
+        if (div % n == 0 && div / n <= PWE_IO_SPI_CLK_DIV_PRE_MAX) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static inline uint8_t *pwe_io_spi_get_buffer(pwe_io_spi_handle_t *pwe_spi, uint8_t index)
+{
+    return pwe_spi->buffer + index * pwe_spi->buffer_stride;
+}
+
+static void IRAM_ATTR pwe_io_spi_post_cb(spi_transaction_t *t)
+{
+    pwe_handle_t handle = (pwe_handle_t)t->user;
+    pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
+    pwe_spi->trans_done_us = esp_timer_get_time();
+    if (pwe_spi->stream_chunk_src_bits != 0 && t != pwe_spi->stream_last) {
+        return;
+    }
+    if (handle->done_cb != NULL) {
+        handle->done_cb(handle, handle->done_cb_ctx);
     }
-    return current_factor;
 }
 
-typedef struct {
-    struct pwe_s base;
-    pwe_io_spi_config_t spi_conf;
-    spi_device_handle_t iohdl;
-    uint32_t sclk;
-    uint8_t t1h;
-    uint8_t t1l;
-    uint8_t t0h;
-    uint8_t t0l;
-    uint32_t trst;
-    uint32_t buffer_size;
-    uint8_t buffer[0];
-} pwe_io_spi_handle_t;
+static esp_err_t pwe_io_spi_wait_trans(pwe_io_spi_handle_t *pwe_spi, TickType_t ticks_to_wait)
+{
+    spi_transaction_t *t = NULL;
+    while (pwe_spi->trans_in_flight > 0) {
+        ESP_RETURN_ON_ERROR(spi_device_get_trans_result(pwe_spi->iohdl, &t, ticks_to_wait), TAG, "wait SPI transaction failed");
+        --pwe_spi->trans_in_flight;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief Keep line low for TRST since the end of previous transaction, so that next frame is not taken as part of it
+ */
+static void pwe_io_spi_wait_rst(pwe_io_spi_handle_t *pwe_spi)
+{
+    const int64_t idle_us = esp_timer_get_time() - pwe_spi->trans_done_us;
+    const int64_t trst_us = UINTCEILDIV(pwe_spi->trst, 1000);
+    if (idle_us < trst_us) {
+        esp_rom_delay_us(trst_us - idle_us);
+    }
+}
 
 static esp_err_t pwe_io_spi_init(pwe_handle_t handle)
 {
@@ -82,7 +118,7 @@ static esp_err_t pwe_io_spi_init(pwe_handle_t handle)
         .sclk_io_num = -1,
         .quadwp_io_num = -1,
         .quadhd_io_num = -1,
-        .max_transfer_sz = UINTCEILDIV(pwe_spi->base.max_payload_length, 8),
+        .max_transfer_sz = pwe_spi->buffer_stride,    // one outgoing buffer or one streaming chunk
     };
     spi_device_interface_config_t devcfg = {
         .command_bits = 0,
@@ -93,6 +129,7 @@ static esp_err_t pwe_io_spi_init(pwe_handle_t handle)
         .mode = 0,
         .spics_io_num = -1,
         .queue_size = 4,
+        .post_cb = pwe_io_spi_post_cb,
     };
     ESP_RETURN_ON_ERROR(spi_bus_initialize(pwe_spi->spi_conf.spi_bus, &buscfg, SPI_DMA_CH_AUTO), TAG, "Failed to initialize spi_bus");
     ESP_RETURN_ON_ERROR(spi_bus_add_device(pwe_spi->spi_conf.spi_bus, &devcfg, &pwe_spi->iohdl), TAG, "Failed to add spi device");
@@ -103,49 +140,102 @@ static esp_err_t pwe_io_spi_deinit(pwe_handle_t handle)
 {
     ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
     pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_spi_wait_trans(pwe_spi, portMAX_DELAY), TAG, "Failed to finish pending transaction");
     ESP_RETURN_ON_ERROR(spi_bus_remove_device(pwe_spi->iohdl), TAG, "Failed to remove spi device");
     ESP_RETURN_ON_ERROR(spi_bus_free(pwe_spi->spi_conf.spi_bus), TAG, "Failed to free spi bus");
     return ESP_OK;
 }
 
+/*
+ * Append n slots to the accumulator and flush one big-endian word to *pdest once 32 slots are collected.
+ * acc keeps at most 31 pending slots before appending, so 32 more slots always fit into 64 bits.
+ */
+#define PWE_SPI_PUSH_SLOTS(acc, acc_slots, pdest, pattern, n)           \
+    do {                                                                \
+        (acc) = ((acc) << (n)) | (pattern);                             \
+        (acc_slots) += (n);                                             \
+        if ((acc_slots) >= 32) {                                        \
+            (acc_slots) -= 32;                                          \
+            *(pdest)++ = __builtin_bswap32((uint32_t)((acc) >> (acc_slots))); \
+        }                                                               \
+    } while (0)
+
+/**
+ * @brief Encode len bits from src into buffer, starting at slot_offset
+ *
+ * buffer must be word aligned and slot_offset must be multiple of 8, slots in front of slot_offset are kept.
+ *
+ * @return slot position right after the last written slot
+ */
+static uint32_t pwe_io_spi_encode(const pwe_io_spi_handle_t *pwe_spi, const uint8_t *src, uint32_t len, uint8_t *buffer, uint32_t slot_offset)
+{
+    uint32_t *pdest = (uint32_t *)(buffer + slot_offset / 32 * 4);
+    uint64_t acc = 0;
+    uint32_t acc_slots = slot_offset % 32;
+    // reload leading bytes of the first word, they are written back together with the first full word
+    for (uint32_t i = 0; i < acc_slots / 8; ++i) {
+        acc = (acc << 8) | ((uint8_t *)pdest)[i];
+    }
+    const uint8_t *lut = pwe_spi->base.byte_lut;
+    // whole bytes, two table lookups each
+    for (uint32_t i = 0; i < len / 8; ++i) {
+        const uint8_t byte = lut ? lut[src[i]] : src[i];
+        const uint8_t hi = byte >> 4;
+        const uint8_t lo = byte & 0x0f;
+        PWE_SPI_PUSH_SLOTS(acc, acc_slots, pdest, pwe_spi->nibble_pattern[hi], pwe_spi->nibble_slots[hi]);
+        PWE_SPI_PUSH_SLOTS(acc, acc_slots, pdest, pwe_spi->nibble_pattern[lo], pwe_spi->nibble_slots[lo]);
+    }
+    // remaining bits of the last partial byte, input MSBit first
+    const uint8_t last_byte = (len % 8) ? (lut ? lut[src[len / 8]] : src[len / 8]) : 0;
+    for (uint32_t i = 0; i < len % 8; ++i) {
+        // nibble 0b1111 and 0b0000 are made of 4 identical symbols, pick the last one
+        const uint8_t nibble = (last_byte & (0x80 >> i)) ? 0x0f : 0x00;
+        const uint8_t sym_slots = pwe_spi->nibble_slots[nibble] / 4;
+        PWE_SPI_PUSH_SLOTS(acc, acc_slots, pdest, pwe_spi->nibble_pattern[nibble] & ((1u << sym_slots) - 1), sym_slots);
+    }
+    // flush pending slots byte by byte, unused slots of the last byte are written as low level
+    uint8_t *ptail = (uint8_t *)pdest;
+    if (acc_slots > 0) {
+        const uint32_t tail = (uint32_t)(acc << (32 - acc_slots));
+        for (uint32_t i = 0; i < UINTCEILDIV(acc_slots, 8); ++i) {
+            ptail[i] = tail >> (24 - i * 8);
+        }
+    }
+    return (ptail - buffer) * 8 + acc_slots;
+}
+
 static esp_err_t pwe_io_spi_convert_buffer(pwe_handle_t handle, const void *data, uint32_t len, uint32_t *outgoing_buffer_len)
 {
     ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
     pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
     ESP_RETURN_ON_FALSE(pwe_spi->base.max_payload_length >= len, ESP_ERR_INVALID_ARG, TAG, "len too big");
-    memset(pwe_spi->buffer, 0, UINTCEILDIV(pwe_spi->buffer_size, 8));
-    uint32_t bits_src_proceeded = 0;
-    uint8_t overflow_byte = 0x00;
-    uint32_t bit_offset_dest = 0;
-    uint32_t byte_offset_dest = 0;
-    while (bits_src_proceeded < len) {
-        uint32_t bit_offset_src = bits_src_proceeded % 8;
-        uint32_t byte_offset_src = bits_src_proceeded / 8;
-        bool src_bit_val = ((uint8_t *)data)[byte_offset_src] & (1 << (7 - bit_offset_src)); // input MSBit first
-        uint16_t temp_buffer = (pwe_spi->buffer[byte_offset_dest] << 8);
-        if (bit_offset_dest >= 8) { // overflow detected, switch to next byte
-            temp_buffer = overflow_byte << 8;
-            bit_offset_dest %= 8;
-            ++byte_offset_dest;
-        }
-        if (src_bit_val) {
-            temp_buffer |= (uint16_t)(((uint8_t)(0xff << (8 - pwe_spi->t1h)) << 8) >> bit_offset_dest);
-            bit_offset_dest += pwe_spi->t1h;
-            temp_buffer &= ~(uint16_t)(((uint8_t)(0xff << (8 - pwe_spi->t1l)) << 8) >> bit_offset_dest);
-            bit_offset_dest += pwe_spi->t1l;
-        } else {
-            temp_buffer |= (uint16_t)(((uint8_t)(0xff << (8 - pwe_spi->t0h)) << 8) >> bit_offset_dest);
-            bit_offset_dest += pwe_spi->t0h;
-            temp_buffer &= ~(uint16_t)(((uint8_t)(0xff << (8 - pwe_spi->t0l)) << 8) >> bit_offset_dest);
-            bit_offset_dest += pwe_spi->t0l;
-        }
-        pwe_spi->buffer[byte_offset_dest] = ((uint8_t *)(&temp_buffer))[1];
-        overflow_byte = ((uint8_t *)(&temp_buffer))[0];
-        ++bits_src_proceeded;
+    if (pwe_spi->trans_in_flight > 0 && pwe_spi->busy_index == pwe_spi->fill_index) {
+        // never touch the buffer which is on the wire
+        ESP_RETURN_ON_ERROR(pwe_io_spi_wait_trans(pwe_spi, portMAX_DELAY), TAG, "Failed to finish pending transaction");
     }
-    uint32_t bits_dest_filled = byte_offset_dest * 8 + bit_offset_dest;
+    uint32_t bits_dest_filled = pwe_io_spi_encode(pwe_spi, data, len, pwe_io_spi_get_buffer(pwe_spi, pwe_spi->fill_index), 0);
     ESP_LOGD(TAG, "bits_dest_filled: %u", bits_dest_filled);
     *outgoing_buffer_len = bits_dest_filled;
+    pwe_spi->ready_index = pwe_spi->fill_index;
+    pwe_spi->fill_index = (pwe_spi->fill_index + 1) % pwe_spi->buffer_num;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_spi_convert_range(pwe_handle_t handle, const void *data, uint32_t offset, uint32_t len, uint32_t *outgoing_buffer_len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
+    const uint8_t sym_slots = pwe_spi->nibble_slots[0x00] / 4;
+    if (sym_slots != pwe_spi->nibble_slots[0x0f] / 4) {
+        // logical 0 and 1 differ in width, not an error either, see pwe_io_convert_range()
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (pwe_spi->trans_in_flight > 0 && pwe_spi->busy_index == pwe_spi->ready_index) {
+        ESP_RETURN_ON_ERROR(pwe_io_spi_wait_trans(pwe_spi, portMAX_DELAY), TAG, "Failed to finish pending transaction");
+    }
+    // update the latest converted frame in place
+    *outgoing_buffer_len = pwe_io_spi_encode(pwe_spi, data, len,
+                                             pwe_io_spi_get_buffer(pwe_spi, pwe_spi->ready_index), offset * sym_slots);
     return ESP_OK;
 }
 
@@ -153,15 +243,129 @@ static esp_err_t pwe_io_spi_write(pwe_handle_t handle, uint32_t len)
 {
     ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
     pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_spi_wait_trans(pwe_spi, portMAX_DELAY), TAG, "Failed to finish pending transaction");
+    pwe_io_spi_wait_rst(pwe_spi);
     spi_transaction_t t;
     memset(&t, 0, sizeof(t));
     t.length = len;
-    t.tx_buffer = pwe_spi->buffer;
+    t.tx_buffer = pwe_io_spi_get_buffer(pwe_spi, pwe_spi->ready_index);
     t.rx_buffer = NULL;
+    t.user = handle;
     ESP_RETURN_ON_ERROR(spi_device_transmit(pwe_spi->iohdl, &t), TAG, "transmit SPI samples failed");
     return ESP_OK;
 }
 
+static esp_err_t pwe_io_spi_write_async(pwe_handle_t handle, uint32_t len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
+    // previous frame must be finished and followed by TRST, otherwise both are taken as one frame
+    ESP_RETURN_ON_ERROR(pwe_io_spi_wait_trans(pwe_spi, portMAX_DELAY), TAG, "Failed to finish pending transaction");
+    pwe_io_spi_wait_rst(pwe_spi);
+    spi_transaction_t *t = &pwe_spi->trans[pwe_spi->ready_index];
+    memset(t, 0, sizeof(spi_transaction_t));
+    t->length = len;
+    t->tx_buffer = pwe_io_spi_get_buffer(pwe_spi, pwe_spi->ready_index);
+    t->rx_buffer = NULL;
+    t->user = handle;
+    ESP_RETURN_ON_ERROR(spi_device_queue_trans(pwe_spi->iohdl, t, portMAX_DELAY), TAG, "queue SPI samples failed");
+    pwe_spi->busy_index = pwe_spi->ready_index;
+    pwe_spi->trans_in_flight = 1;
+    return ESP_OK;
+}
+
+static esp_err_t pwe_io_spi_wait_done(pwe_handle_t handle, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
+    return pwe_io_spi_wait_trans(pwe_spi, pdMS_TO_TICKS(timeout_ms));
+}
+
+static esp_err_t pwe_io_spi_ensure_rst(pwe_handle_t handle);
+
+/**
+ * @brief Encode next chunk of a streamed frame into the ring, not queued yet
+ */
+static void pwe_io_spi_stream_encode(pwe_io_spi_handle_t *pwe_spi, uint8_t chunk, const uint8_t **psrc, uint32_t *bits_remain)
+{
+    const uint32_t bits = *bits_remain < pwe_spi->stream_chunk_src_bits ? *bits_remain : pwe_spi->stream_chunk_src_bits;
+    uint8_t *buffer = pwe_io_spi_get_buffer(pwe_spi, chunk);
+    spi_transaction_t *t = &pwe_spi->trans[chunk];
+    memset(t, 0, sizeof(spi_transaction_t));
+    t->length = pwe_io_spi_encode(pwe_spi, *psrc, bits, buffer, 0);
+    t->tx_buffer = buffer;
+    t->rx_buffer = NULL;
+    t->user = &pwe_spi->base;
+    if (bits == *bits_remain) {
+        pwe_spi->stream_last = t;
+    }
+    *psrc += bits / 8;
+    *bits_remain -= bits;
+}
+
+static esp_err_t pwe_io_spi_stream_queue(pwe_io_spi_handle_t *pwe_spi, uint8_t chunk)
+{
+    ESP_RETURN_ON_ERROR(spi_device_queue_trans(pwe_spi->iohdl, &pwe_spi->trans[chunk], portMAX_DELAY), TAG, "queue SPI samples failed");
+    ++pwe_spi->trans_in_flight;
+    return ESP_OK;
+}
+
+/**
+ * @brief Send a frame through the chunk ring
+ *
+ * @return
+ *      ESP_OK
+ *      ESP_ERR_TIMEOUT: a chunk was refilled too late, the wire stayed idle in the middle of the frame
+ */
+static esp_err_t pwe_io_spi_stream_frame(pwe_io_spi_handle_t *pwe_spi, const uint8_t *psrc, uint32_t len)
+{
+    spi_transaction_t *t = NULL;
+    uint32_t bits_remain = len;
+    uint8_t chunk = 0;
+    // the ring is filled before the first chunk starts, so a frame fitting in it goes out with driver gaps only
+    while (bits_remain > 0 && chunk < pwe_spi->buffer_num) {
+        pwe_io_spi_stream_encode(pwe_spi, chunk++, &psrc, &bits_remain);
+    }
+    for (uint8_t i = 0; i < chunk; ++i) {
+        ESP_RETURN_ON_ERROR(pwe_io_spi_stream_queue(pwe_spi, i), TAG, "queue SPI samples failed");
+    }
+    chunk %= pwe_spi->buffer_num;
+    const int64_t max_gap_us = pwe_spi->trst / 2000;
+    while (bits_remain > 0) {
+        // ring is full, the oldest queued chunk is the one to be refilled next
+        ESP_RETURN_ON_ERROR(spi_device_get_trans_result(pwe_spi->iohdl, &t, portMAX_DELAY), TAG, "wait SPI transaction failed");
+        --pwe_spi->trans_in_flight;
+        pwe_io_spi_stream_encode(pwe_spi, chunk, &psrc, &bits_remain);
+        while (pwe_spi->trans_in_flight > 0 && spi_device_get_trans_result(pwe_spi->iohdl, &t, 0) == ESP_OK) {
+            --pwe_spi->trans_in_flight;
+        }
+        if (pwe_spi->trans_in_flight == 0 && esp_timer_get_time() - pwe_spi->trans_done_us > max_gap_us) {
+            // wire went idle for close to TRST, what follows could be taken as the start of a new frame
+            return ESP_ERR_TIMEOUT;
+        }
+        ESP_RETURN_ON_ERROR(pwe_io_spi_stream_queue(pwe_spi, chunk), TAG, "queue SPI samples failed");
+        chunk = (chunk + 1) % pwe_spi->buffer_num;
+    }
+    return pwe_io_spi_wait_trans(pwe_spi, portMAX_DELAY);
+}
+
+static esp_err_t pwe_io_spi_on_the_fly_send(pwe_handle_t handle, const void *data, uint32_t len)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
+    pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
+    ESP_RETURN_ON_ERROR(pwe_io_spi_wait_trans(pwe_spi, portMAX_DELAY), TAG, "Failed to finish pending transaction");
+    pwe_io_spi_wait_rst(pwe_spi);
+    esp_err_t ret = pwe_io_spi_stream_frame(pwe_spi, data, len);
+    for (int restart = 0; ret == ESP_ERR_TIMEOUT && restart < PWE_IO_SPI_STREAM_RESTART_MAX; ++restart) {
+        // part of the frame may have been latched, make sure of it and send the whole frame again
+        ESP_LOGW(TAG, "chunk refilled too late, frame restarted");
+        pwe_io_spi_ensure_rst(handle);
+        ret = pwe_io_spi_stream_frame(pwe_spi, data, len);
+    }
+    ESP_RETURN_ON_ERROR(ret, TAG, "Failed to stream frame");
+    return ESP_OK;
+}
+
 static esp_err_t pwe_io_spi_ensure_rst(pwe_handle_t handle)
 {
     ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
@@ -172,51 +376,124 @@ static esp_err_t pwe_io_spi_ensure_rst(pwe_handle_t handle)
     return ESP_OK;
 }
 
-esp_err_t pwe_new_spi_backend(const pwe_config_t *config, const pwe_io_spi_config_t *spi_conf, uint32_t buffer_size, pwe_handle_t *handle)
+/**
+ * @brief Create the handle in storage, or allocate it from DMA capable heap if storage is NULL
+ */
+static esp_err_t pwe_io_spi_create(const pwe_config_t *config, const pwe_io_spi_config_t *spi_conf, uint32_t buffer_size,
+                                   void *storage, size_t storage_size, pwe_handle_t *handle)
 {
     ESP_RETURN_ON_FALSE(config != NULL, ESP_ERR_INVALID_ARG, TAG, "null config");
+    ESP_RETURN_ON_FALSE(spi_conf != NULL, ESP_ERR_INVALID_ARG, TAG, "null spi config");
+    ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
 
     pwe_io_spi_handle_t temp_conf;
     temp_conf.trst = config->TRST;
 
-    // calc required pulse width pattern at first
-    uint32_t accepted_range = (config->T1H_ACC + config->T1L_ACC + config->T0H_ACC + config->T0L_ACC) / 4;
-    uint32_t period_per_slot_ns = find_suitable_factor(config->T1H, config->T1L, config->T0H, config->T0L, accepted_range);
-    ESP_LOGD(TAG, "period_per_slot_ns: %u", period_per_slot_ns);
-    ESP_RETURN_ON_FALSE(period_per_slot_ns != 0, ESP_ERR_INVALID_ARG, TAG, "Cannot resolve requested timing");
-    // calc sclk
-    temp_conf.sclk = 1000000000 / period_per_slot_ns;
-    temp_conf.t1h = UINTROUNDDIV(config->T1H, period_per_slot_ns);
-    temp_conf.t1l = UINTROUNDDIV(config->T1L, period_per_slot_ns);
-    temp_conf.t0h = UINTROUNDDIV(config->T0H, period_per_slot_ns);
-    temp_conf.t0l = UINTROUNDDIV(config->T0L, period_per_slot_ns);
-    ESP_LOGD(TAG, "slot configuration: t1h=%u, t1l=%u, t0h=%u, t0l=%u", temp_conf.t1h, temp_conf.t1l, temp_conf.t0h, temp_conf.t0l);
+    pwe_timing_constraints_t constraints = {
+        .src_hz = APB_CLK_FREQ,
+        .div_min = 1,
+        .div_max = PWE_IO_SPI_CLK_DIV_PRE_MAX * PWE_IO_SPI_CLK_DIV_N_MAX,
+        .div_filter = pwe_io_spi_div_achievable,
+        .max_slots_per_bit = PWE_IO_SPI_MAX_SLOTS_PER_BIT,
+    };
+    if (spi_conf->clock_speed_hz != 0) {
+        // fixed clock, each pulse is rounded to whole slots of it
+        constraints.src_hz = spi_conf->clock_speed_hz;
+        constraints.div_max = 1;
+        constraints.div_filter = NULL;
+    }
+    ESP_RETURN_ON_ERROR(pwe_timing_solve(config, &constraints, &temp_conf.timing), TAG, "Cannot resolve requested timing");
+    temp_conf.sclk = temp_conf.timing.clock_hz;
+    temp_conf.t1h = temp_conf.timing.t1h;
+    temp_conf.t1l = temp_conf.timing.t1l;
+    temp_conf.t0h = temp_conf.timing.t0h;
+    temp_conf.t0l = temp_conf.timing.t0l;
+    ESP_LOGD(TAG, "slot configuration: sclk=%u, t1h=%u, t1l=%u, t0h=%u, t0l=%u", temp_conf.sclk, temp_conf.t1h, temp_conf.t1l, temp_conf.t0h, temp_conf.t0l);
 
     // alloc memory at the end
-    uint16_t max_slots_per_bit = (temp_conf.t0h + temp_conf.t0l > temp_conf.t1h + temp_conf.t1l) ?
-                                 temp_conf.t0h + temp_conf.t0l :
-                                 temp_conf.t1h + temp_conf.t1l;
-    temp_conf.buffer_size = max_slots_per_bit * buffer_size;
-    ESP_LOGD(TAG, "Will allocate outgoing buffer with %u bits, =%u bytes", temp_conf.buffer_size, UINTCEILDIV(temp_conf.buffer_size, 8));
-    pwe_io_spi_handle_t *pwe_spi = heap_caps_calloc(1, sizeof(pwe_io_spi_handle_t) + UINTCEILDIV(temp_conf.buffer_size, 8), MALLOC_CAP_DMA);
-    ESP_RETURN_ON_FALSE(pwe_spi != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate pwe_io_spi_handle_t");
+    uint16_t max_slots_per_bit = temp_conf.timing.slots_per_bit;
+    if (buffer_size != 0) {
+        temp_conf.buffer_size = max_slots_per_bit * buffer_size;
+        temp_conf.buffer_stride = UINTCEILDIV(temp_conf.buffer_size, 32) * 4;
+        temp_conf.buffer_num = PWE_BUFFER_NUM(config->flags);
+        temp_conf.stream_chunk_src_bits = 0;
+    } else {
+        // streaming mode: a ring of small chunks, each of them holds whole source bytes
+        uint32_t chunk_size = spi_conf->stream_chunk_size ? spi_conf->stream_chunk_size : PWE_IO_SPI_STREAM_CHUNK_SIZE;
+        ESP_RETURN_ON_FALSE(chunk_size >= max_slots_per_bit, ESP_ERR_INVALID_ARG, TAG, "stream_chunk_size too small");
+        temp_conf.buffer_stride = UINTCEILDIV(chunk_size, 4) * 4;
+        temp_conf.buffer_size = temp_conf.buffer_stride * 8;
+        temp_conf.buffer_num = PWE_IO_SPI_STREAM_CHUNK_NUM;
+        temp_conf.stream_chunk_src_bits = temp_conf.buffer_stride / max_slots_per_bit * 8;
+    }
+    temp_conf.fill_index = 0;
+    temp_conf.ready_index = 0;
+    temp_conf.busy_index = 0;
+    temp_conf.trans_in_flight = 0;
+    temp_conf.trans_done_us = 0;
+    ESP_LOGD(TAG, "Will allocate %u outgoing buffer with %u bits, =%u bytes", temp_conf.buffer_num, temp_conf.buffer_size, temp_conf.buffer_stride);
+    const size_t size = sizeof(pwe_io_spi_handle_t) + temp_conf.buffer_stride * temp_conf.buffer_num;
+    pwe_io_spi_handle_t *pwe_spi = NULL;
+    if (storage != NULL) {
+        ESP_RETURN_ON_FALSE(pwe_storage_fits(storage, storage_size, size), ESP_ERR_INVALID_SIZE, TAG,
+                            "storage must be %u bytes aligned to %d", (unsigned)size, PWE_STATIC_STORAGE_ALIGN);
+        ESP_RETURN_ON_FALSE(esp_ptr_dma_capable(storage), ESP_ERR_INVALID_ARG, TAG, "storage must be DMA capable");
+        pwe_spi = memset(storage, 0, size);
+    } else {
+        pwe_spi = heap_caps_calloc(1, size, MALLOC_CAP_DMA);
+        ESP_RETURN_ON_FALSE(pwe_spi != NULL, ESP_ERR_NO_MEM, TAG, "Failed to allocate pwe_io_spi_handle_t");
+    }
+    temp_conf.static_storage = storage != NULL;
     memcpy(&temp_conf.spi_conf, spi_conf, sizeof(pwe_io_spi_config_t));
     memcpy(pwe_spi, &temp_conf, sizeof(pwe_io_spi_handle_t));
+    pwe_io_spi_build_lut(pwe_spi);
     pwe_spi->base.init = pwe_io_spi_init;
     pwe_spi->base.deinit = pwe_io_spi_deinit;
     pwe_spi->base.convert_buffer = pwe_io_spi_convert_buffer;
+    pwe_spi->base.convert_range = pwe_io_spi_convert_range;
     pwe_spi->base.write = pwe_io_spi_write;
-    pwe_spi->base.on_the_fly_send = NULL;
+    pwe_spi->base.write_async = pwe_io_spi_write_async;
+    pwe_spi->base.wait_done = pwe_io_spi_wait_done;
+    pwe_spi->base.on_the_fly_send = pwe_io_spi_on_the_fly_send;
+    pwe_spi->base.on_the_fly_send_async = NULL;    // stream ring is refilled by the caller
     pwe_spi->base.ensure_rst = pwe_io_spi_ensure_rst;
     pwe_spi->base.max_payload_length = buffer_size;
+    pwe_spi->base.done_cb = NULL;
+    pwe_spi->base.done_cb_ctx = NULL;
+    pwe_spi->base.byte_lut = NULL;
+    pwe_spi->base.timing = &pwe_spi->timing;
     *handle = &pwe_spi->base;
     return ESP_OK;
 }
 
+esp_err_t pwe_new_spi_backend(const pwe_config_t *config, const pwe_io_spi_config_t *spi_conf, uint32_t buffer_size, pwe_handle_t *handle)
+{
+    return pwe_io_spi_create(config, spi_conf, buffer_size, NULL, 0, handle);
+}
+
+esp_err_t pwe_spi_backend_init_static(const pwe_config_t *config, const pwe_io_spi_config_t *spi_conf, uint32_t buffer_size,
+                                      void *storage, size_t storage_size, pwe_handle_t *handle)
+{
+    ESP_RETURN_ON_FALSE(storage != NULL, ESP_ERR_INVALID_ARG, TAG, "null storage");
+    return pwe_io_spi_create(config, spi_conf, buffer_size, storage, storage_size, handle);
+}
+
+esp_err_t pwe_spi_get_outgoing_buffer(pwe_handle_t handle, const uint8_t **samples, uint32_t *sample_hz)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL && samples != NULL && sample_hz != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
+    ESP_RETURN_ON_FALSE(pwe_spi->stream_chunk_src_bits == 0, ESP_ERR_INVALID_STATE, TAG, "no outgoing buffer in streaming mode");
+    *samples = pwe_io_spi_get_buffer(pwe_spi, pwe_spi->ready_index);
+    *sample_hz = pwe_spi->sclk;
+    return ESP_OK;
+}
+
 esp_err_t pwe_delete_spi_backend(pwe_handle_t handle)
 {
     ESP_RETURN_ON_FALSE(handle != NULL, ESP_ERR_INVALID_ARG, TAG, "null handle");
     pwe_io_spi_handle_t *pwe_spi = __containerof(handle, pwe_io_spi_handle_t, base);
-    heap_caps_free(pwe_spi);
+    if (!pwe_spi->static_storage) {
+        heap_caps_free(pwe_spi);
+    }
     return ESP_OK;
 }
@@ -0,0 +1,35 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Helpers shared by PWE backends, not part of public API
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "pwe.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UINTROUNDDIV(divd, divor) ( ((divd) + ((divor) / 2)) / (divor) )
+#define UINTCEILDIV(divd, divor) ( ((divd) + (divor) - 1) / (divor) )
+
+/**
+ * @brief Check storage passed to *_init_static() functions is aligned and large enough
+ */
+static inline bool pwe_storage_fits(const void *storage, size_t storage_size, size_t required)
+{
+    return storage != NULL && (uintptr_t)storage % PWE_STATIC_STORAGE_ALIGN == 0 && storage_size >= required;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,100 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "esp_attr.h"
+#include "pwe_rmt_symbols.h"
+#include "pwe_priv.h"
+#include "esp_check.h"
+
+static const char *TAG = "PWE_RMT_SYMBOLS";
+
+#define PWE_RMT_SYMBOLS_RESET_TICKS_PER_SYMBOL  (2 * PWE_RMT_SYMBOLS_MAX_TICKS)
+
+static inline uint32_t pwe_rmt_symbols_make(uint32_t duration0, uint32_t level0, uint32_t duration1, uint32_t level1)
+{
+    return duration0 | (level0 << 15) | (duration1 << 16) | (level1 << 31);
+}
+
+esp_err_t pwe_rmt_symbols_init(pwe_rmt_symbols_t *symbols, const pwe_config_t *config, uint32_t src_hz,
+                               uint32_t resolution_hz, pwe_timing_t *timing)
+{
+    ESP_RETURN_ON_FALSE(symbols != NULL && config != NULL && timing != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    ESP_RETURN_ON_FALSE(resolution_hz == 0 || (resolution_hz <= src_hz && src_hz % resolution_hz == 0), ESP_ERR_INVALID_ARG,
+                        TAG, "resolution must divide source clock");
+    const uint32_t div = resolution_hz ? src_hz / resolution_hz : 0;
+    const pwe_timing_constraints_t constraints = {
+        .src_hz = src_hz,
+        .div_min = div ? div : 1,
+        .div_max = div ? div : PWE_RMT_SYMBOLS_DIV_MAX,
+        .max_slots_per_pulse = PWE_RMT_SYMBOLS_MAX_TICKS,
+        .min_error = true,
+    };
+    esp_err_t ret = pwe_timing_solve(config, &constraints, timing);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    symbols->bit_symbols[0] = pwe_rmt_symbols_make(timing->t0h, 1, timing->t0l, 0);
+    symbols->bit_symbols[1] = pwe_rmt_symbols_make(timing->t1h, 1, timing->t1l, 0);
+    symbols->reset_ticks = (uint64_t)config->TRST * timing->clock_hz / 1000000000ULL;
+    symbols->byte_lut = NULL;
+    symbols->payload_bits = 0;
+    symbols->with_reset = false;
+    return ESP_OK;
+}
+
+static inline size_t pwe_rmt_symbols_reset_num(const pwe_rmt_symbols_t *symbols)
+{
+    return symbols->with_reset ? UINTCEILDIV(symbols->reset_ticks, PWE_RMT_SYMBOLS_RESET_TICKS_PER_SYMBOL) : 0;
+}
+
+size_t pwe_rmt_symbols_total(const pwe_rmt_symbols_t *symbols)
+{
+    return symbols->payload_bits + pwe_rmt_symbols_reset_num(symbols);
+}
+
+size_t IRAM_ATTR pwe_rmt_symbols_encode(const pwe_rmt_symbols_t *symbols, const uint8_t *data, size_t symbols_written,
+                                        size_t symbols_free, uint32_t *out, bool *done)
+{
+    const uint32_t *bit_symbols = symbols->bit_symbols;
+    const uint8_t *lut = symbols->byte_lut;
+    const size_t payload_bits = symbols->payload_bits;
+    size_t pos = symbols_written;
+    uint32_t *pout = out;
+    uint32_t *const end = out + symbols_free;
+
+    // payload, whole bytes while aligned and there is room, bit by bit otherwise
+    while (pos < payload_bits && pout < end) {
+        if (pos % 8 == 0 && payload_bits - pos >= 8 && end - pout >= 8) {
+            const uint32_t byte = lut ? lut[data[pos / 8]] : data[pos / 8];
+            pout[0] = bit_symbols[(byte >> 7) & 1];
+            pout[1] = bit_symbols[(byte >> 6) & 1];
+            pout[2] = bit_symbols[(byte >> 5) & 1];
+            pout[3] = bit_symbols[(byte >> 4) & 1];
+            pout[4] = bit_symbols[(byte >> 3) & 1];
+            pout[5] = bit_symbols[(byte >> 2) & 1];
+            pout[6] = bit_symbols[(byte >> 1) & 1];
+            pout[7] = bit_symbols[byte & 1];
+            pout += 8;
+            pos += 8;
+        } else {
+            const uint32_t byte = lut ? lut[data[pos / 8]] : data[pos / 8];
+            *pout++ = bit_symbols[(byte >> (7 - pos % 8)) & 1];
+            ++pos;
+        }
+    }
+    // TRST, low level split over as many symbols as needed, none of the durations can be 0 which ends transmission
+    const size_t total = payload_bits + pwe_rmt_symbols_reset_num(symbols);
+    while (pos < total && pout < end) {
+        const uint32_t remain = symbols->reset_ticks - (pos - payload_bits) * PWE_RMT_SYMBOLS_RESET_TICKS_PER_SYMBOL;
+        const uint32_t ticks = remain < PWE_RMT_SYMBOLS_RESET_TICKS_PER_SYMBOL ? remain : PWE_RMT_SYMBOLS_RESET_TICKS_PER_SYMBOL;
+        const uint32_t duration0 = (ticks + 1) / 2;
+        const uint32_t duration1 = ticks - duration0 ? ticks - duration0 : 1;
+        *pout++ = pwe_rmt_symbols_make(duration0, 0, duration1, 0);
+        ++pos;
+    }
+    *done = pos >= total;
+    return pout - out;
+}
@@ -0,0 +1,154 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "pwe_timing.h"
+#include "esp_check.h"
+
+static const char *TAG = "PWE_TIMING";
+
+#define PWE_TIMING_NS_PER_S     1000000000ULL
+
+enum {
+    PWE_TIMING_T1H,
+    PWE_TIMING_T1L,
+    PWE_TIMING_T0H,
+    PWE_TIMING_T0L,
+    PWE_TIMING_PULSE_MAX,
+};
+
+/**
+ * @brief Resolve all pulses at src_hz / div
+ *
+ * Errors are kept multiplied by src_hz, so that they are exact whatever the slot period is.
+ *
+ * @return worst error relative to TxX_ACC in permille, or -1 if some pulse cannot be resolved
+ */
+static int32_t pwe_timing_eval(const uint32_t ns[PWE_TIMING_PULSE_MAX], const uint32_t acc[PWE_TIMING_PULSE_MAX],
+                               const pwe_timing_constraints_t *constraints, uint32_t div, pwe_timing_t *timing)
+{
+    const uint64_t src_hz = constraints->src_hz;
+    uint32_t slots[PWE_TIMING_PULSE_MAX];
+    int32_t error_ns[PWE_TIMING_PULSE_MAX];
+    int32_t worst = 0;
+    for (int i = 0; i < PWE_TIMING_PULSE_MAX; ++i) {
+        const uint64_t scaled_ns = ns[i] * src_hz;
+        slots[i] = (scaled_ns + div * PWE_TIMING_NS_PER_S / 2) / (div * PWE_TIMING_NS_PER_S);
+        if (slots[i] == 0 || (constraints->max_slots_per_pulse && slots[i] > constraints->max_slots_per_pulse)) {
+            return -1;
+        }
+        const int64_t diff = (int64_t)((uint64_t)slots[i] * div * PWE_TIMING_NS_PER_S) - (int64_t)scaled_ns;
+        const uint64_t abs_diff = diff < 0 ? -diff : diff;
+        if (abs_diff >= acc[i] * src_hz) {
+            return -1;
+        }
+        error_ns[i] = (int32_t)((diff < 0 ? diff - (int64_t)src_hz / 2 : diff + (int64_t)src_hz / 2) / (int64_t)src_hz);
+        const int32_t permille = abs_diff * 1000 / (acc[i] * src_hz);
+        worst = permille > worst ? permille : worst;
+    }
+    const uint32_t slots1 = slots[PWE_TIMING_T1H] + slots[PWE_TIMING_T1L];
+    const uint32_t slots0 = slots[PWE_TIMING_T0H] + slots[PWE_TIMING_T0L];
+    if (constraints->equal_width && slots1 != slots0) {
+        return -1;
+    }
+    timing->slots_per_bit = slots1 > slots0 ? slots1 : slots0;
+    if (constraints->max_slots_per_bit && timing->slots_per_bit > constraints->max_slots_per_bit) {
+        return -1;
+    }
+    timing->div = div;
+    timing->clock_hz = constraints->src_hz / div;
+    timing->t1h = slots[PWE_TIMING_T1H];
+    timing->t1l = slots[PWE_TIMING_T1L];
+    timing->t0h = slots[PWE_TIMING_T0H];
+    timing->t0l = slots[PWE_TIMING_T0L];
+    timing->t1h_error_ns = error_ns[PWE_TIMING_T1H];
+    timing->t1l_error_ns = error_ns[PWE_TIMING_T1L];
+    timing->t0h_error_ns = error_ns[PWE_TIMING_T0H];
+    timing->t0l_error_ns = error_ns[PWE_TIMING_T0L];
+    return worst;
+}
+
+/**
+ * @brief Smallest divider that may fit width ns into max_slots slots, dividers below it need more slots
+ */
+static uint32_t pwe_timing_div_lower_bound(uint32_t ns, uint32_t acc, uint32_t max_slots, uint64_t src_hz)
+{
+    if (max_slots == 0 || ns <= acc) {
+        return 0;
+    }
+    return (ns - acc) * src_hz / (max_slots * PWE_TIMING_NS_PER_S);
+}
+
+esp_err_t pwe_timing_solve(const pwe_config_t *config, const pwe_timing_constraints_t *constraints, pwe_timing_t *timing)
+{
+    ESP_RETURN_ON_FALSE(config != NULL && constraints != NULL && timing != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    ESP_RETURN_ON_FALSE(constraints->src_hz != 0 && constraints->div_min != 0 && constraints->div_min <= constraints->div_max,
+                        ESP_ERR_INVALID_ARG, TAG, "bad divider range");
+    const uint32_t ns[PWE_TIMING_PULSE_MAX] = { config->T1H, config->T1L, config->T0H, config->T0L };
+    const uint32_t acc[PWE_TIMING_PULSE_MAX] = { config->T1H_ACC, config->T1L_ACC, config->T0H_ACC, config->T0L_ACC };
+    const uint64_t src_hz = constraints->src_hz;
+
+    // the slot period has to be shorter than the shortest pulse plus its tolerance
+    uint64_t div_hi = constraints->div_max;
+    for (int i = 0; i < PWE_TIMING_PULSE_MAX; ++i) {
+        const uint64_t hi = ((ns[i] + acc[i]) * src_hz - 1) / PWE_TIMING_NS_PER_S;
+        div_hi = hi < div_hi ? hi : div_hi;
+    }
+    // and long enough not to exceed slot limits
+    uint64_t div_lo = constraints->div_min;
+    const uint32_t lo[] = {
+        pwe_timing_div_lower_bound(config->T1H + config->T1L, config->T1H_ACC + config->T1L_ACC, constraints->max_slots_per_bit, src_hz),
+        pwe_timing_div_lower_bound(config->T0H + config->T0L, config->T0H_ACC + config->T0L_ACC, constraints->max_slots_per_bit, src_hz),
+        pwe_timing_div_lower_bound(config->T1H, config->T1H_ACC, constraints->max_slots_per_pulse, src_hz),
+        pwe_timing_div_lower_bound(config->T1L, config->T1L_ACC, constraints->max_slots_per_pulse, src_hz),
+        pwe_timing_div_lower_bound(config->T0H, config->T0H_ACC, constraints->max_slots_per_pulse, src_hz),
+        pwe_timing_div_lower_bound(config->T0L, config->T0L_ACC, constraints->max_slots_per_pulse, src_hz),
+    };
+    for (size_t i = 0; i < sizeof(lo) / sizeof(lo[0]); ++i) {
+        div_lo = lo[i] > div_lo ? lo[i] : div_lo;
+    }
+
+    bool found = false;
+    int32_t best_error = 0;
+    for (uint64_t div = div_lo; div <= div_hi; ++div) {
+        if (constraints->div_filter != NULL && !constraints->div_filter(div)) {
+            continue;
+        }
+        pwe_timing_t candidate;
+        const int32_t error = pwe_timing_eval(ns, acc, constraints, div, &candidate);
+        if (error < 0) {
+            continue;
+        }
+        bool better = !found;
+        if (found && constraints->min_error) {
+            better = error < best_error || (error == best_error && candidate.slots_per_bit < timing->slots_per_bit);
+        } else if (found) {
+            better = candidate.slots_per_bit < timing->slots_per_bit ||
+                     (candidate.slots_per_bit == timing->slots_per_bit && error < best_error);
+        }
+        if (better) {
+            memcpy(timing, &candidate, sizeof(pwe_timing_t));
+            best_error = error;
+            found = true;
+        }
+    }
+    if (!found) {
+        // not an error for callers trying several constraints, they report it
+        return ESP_ERR_NOT_FOUND;
+    }
+    ESP_LOGD(TAG, "div=%u clock=%uHz slots t1h=%u t1l=%u t0h=%u t0l=%u, error t1h=%d t1l=%d t0h=%d t0l=%d ns",
+             timing->div, timing->clock_hz, timing->t1h, timing->t1l, timing->t0h, timing->t0l,
+             timing->t1h_error_ns, timing->t1l_error_ns, timing->t0h_error_ns, timing->t0l_error_ns);
+    return ESP_OK;
+}
+
+esp_err_t pwe_get_timing(pwe_handle_t handle, pwe_timing_t *timing)
+{
+    ESP_RETURN_ON_FALSE(handle != NULL && timing != NULL, ESP_ERR_INVALID_ARG, TAG, "null argument");
+    ESP_RETURN_ON_FALSE(handle->timing != NULL, ESP_ERR_NOT_SUPPORTED, TAG, "backend has no resolved timing");
+    memcpy(timing, handle->timing, sizeof(pwe_timing_t));
+    return ESP_OK;
+}
@@ -0,0 +1,65 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "pwe_transpose.h"
+
+void pwe_transpose_8x8(const uint8_t *src, uint32_t stride, uint8_t dst[8])
+{
+    /*
+     * Hacker's Delight transpose8, rows loaded in reverse lane order so that lane i ends up on bit i.
+     * x holds lanes 7~4 and y holds lanes 3~0, one byte per lane, MSByte first.
+     */
+    uint32_t x = ((uint32_t)src[7 * stride] << 24) | ((uint32_t)src[6 * stride] << 16) |
+                 ((uint32_t)src[5 * stride] << 8) | src[4 * stride];
+    uint32_t y = ((uint32_t)src[3 * stride] << 24) | ((uint32_t)src[2 * stride] << 16) |
+                 ((uint32_t)src[1 * stride] << 8) | src[0];
+    uint32_t t;
+    // swap 1x1 blocks inside each 2x2 block
+    t = (x ^ (x >> 7)) & 0x00AA00AA;
+    x = x ^ t ^ (t << 7);
+    t = (y ^ (y >> 7)) & 0x00AA00AA;
+    y = y ^ t ^ (t << 7);
+    // swap 2x2 blocks inside each 4x4 block
+    t = (x ^ (x >> 14)) & 0x0000CCCC;
+    x = x ^ t ^ (t << 14);
+    t = (y ^ (y >> 14)) & 0x0000CCCC;
+    y = y ^ t ^ (t << 14);
+    // swap 4x4 blocks
+    t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+    y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+    x = t;
+    dst[0] = x >> 24;
+    dst[1] = x >> 16;
+    dst[2] = x >> 8;
+    dst[3] = x;
+    dst[4] = y >> 24;
+    dst[5] = y >> 16;
+    dst[6] = y >> 8;
+    dst[7] = y;
+}
+
+void pwe_transpose_lanes(const uint8_t *src, uint32_t lane_stride, uint32_t lane_num, uint32_t len, const uint8_t *lut,
+                         uint16_t *masks)
+{
+    for (uint32_t byte = 0; byte * 8 < len; ++byte) {
+        // gather one byte of every lane, then transpose 8 lanes at a time
+        uint8_t column[PWE_TRANSPOSE_MAX_LANES] = { 0 };
+        for (uint32_t lane = 0; lane < lane_num; ++lane) {
+            const uint8_t v = src[lane * lane_stride + byte];
+            column[lane] = lut ? lut[v] : v;
+        }
+        uint8_t mask_lo[8];
+        uint8_t mask_hi[8] = { 0 };
+        pwe_transpose_8x8(column, 1, mask_lo);
+        if (lane_num > 8) {
+            pwe_transpose_8x8(column + 8, 1, mask_hi);
+        }
+        const uint32_t bits = len - byte * 8 < 8 ? len - byte * 8 : 8;
+        for (uint32_t k = 0; k < bits; ++k) {
+            masks[byte * 8 + k] = mask_lo[k] | (mask_hi[k] << 8);
+        }
+    }
+}
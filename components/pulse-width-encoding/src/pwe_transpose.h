@@ -0,0 +1,53 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Bit matrix transpose used by parallel output backends. Plain C without any IDF dependency, so that it can be built
+ * and checked on host.
+ */
+
+#include <stdint.h>
+
+#define PWE_TRANSPOSE_MAX_LANES     16
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Transpose 8 lanes of one byte each into 8 parallel samples
+ *
+ * lane[i] = src[i * stride]
+ * dst[k] bit i = lane[i] bit (7 - k)
+ *
+ * So dst[0] holds the MSBit of every lane, which is the first one on the wire, with lane i on data line i.
+ *
+ * @param src: byte of lane 0
+ * @param stride: distance between bytes of two adjacent lanes
+ * @param dst: 8 samples
+ */
+void pwe_transpose_8x8(const uint8_t *src, uint32_t stride, uint8_t dst[8]);
+
+/**
+ * @brief Turn len bits of up to 16 lanes into one mask of lanes per bit
+ *
+ * masks[k] bit i = bit k of lane i, bit 0 of a lane being the MSBit of its first byte
+ *
+ * @param src: first byte of lane 0, lane i starts at src + i * lane_stride
+ * @param lane_stride: distance between first bytes of two adjacent lanes
+ * @param lane_num: 1 ~ PWE_TRANSPOSE_MAX_LANES, bits of lanes above are cleared
+ * @param len: bits of each lane
+ * @param lut: table every source byte is mapped through, NULL for none
+ * @param masks: len masks
+ */
+void pwe_transpose_lanes(const uint8_t *src, uint32_t lane_stride, uint32_t lane_num, uint32_t len, const uint8_t *lut,
+                         uint16_t *masks);
+
+#ifdef __cplusplus
+}
+#endif
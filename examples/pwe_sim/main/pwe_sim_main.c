@@ -0,0 +1,67 @@
+/* PWE simulation example
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#include <stdio.h>
+#include "esp_log.h"
+#include "led_strip.h"
+#include "led_strip_pwe.h"
+#include "dshot.h"
+#include "pwe_io_sim.h"
+
+static const char *TAG = "example";
+
+#define EXAMPLE_LED_NUM         (8)
+#define EXAMPLE_DSHOT_THROTTLE  (1000)
+
+static void example_report(pwe_handle_t pwe, const char *vcd_path)
+{
+    const pwe_sim_edge_t *edges = NULL;
+    uint32_t edge_num = 0;
+    uint32_t dropped = 0;
+    ESP_ERROR_CHECK(pwe_sim_get_edges(pwe, &edges, &edge_num, &dropped));
+    ESP_LOGI(TAG, "%s: %u edges, %u dropped, last edge at %llu ns", vcd_path, edge_num, dropped,
+             edge_num ? (unsigned long long)edges[edge_num - 1].time_ns : 0ULL);
+    ESP_ERROR_CHECK(pwe_sim_export_vcd(pwe, vcd_path));
+}
+
+void app_main(void)
+{
+    // WS2812 strip, pulse widths rounded to 100ns as a 10MHz RMT channel would do
+    led_strip_config strip_config = PWE_WS2812_CONFIG;
+    pwe_io_sim_config_t sim_config = {
+        .resolution_ns = 100,
+    };
+    led_strip_handle_t strip = NULL;
+    ESP_ERROR_CHECK(led_strip_new_pwe_sim(&strip_config, EXAMPLE_LED_NUM, &sim_config, &strip));
+    ESP_ERROR_CHECK(led_strip_init(strip));
+    for (int i = 0; i < EXAMPLE_LED_NUM; i++) {
+        ESP_ERROR_CHECK(led_strip_set_pixel(strip, i, i * 32, 255 - i * 32, 0x55));
+    }
+    ESP_ERROR_CHECK(led_strip_refresh(strip, 100));
+    pwe_handle_t pwe = NULL;
+    ESP_ERROR_CHECK(led_strip_pwe_get_handle(strip, &pwe));
+    example_report(pwe, "led_strip.vcd");
+    ESP_ERROR_CHECK(led_strip_deinit(strip));
+    ESP_ERROR_CHECK(led_strip_del_pwe_sim(strip));
+
+    // two DShot600 frames with the minimal gap in between
+    pwe_config_t dshot_config = PWE_DSHOT600_CONFIG;
+    pwe_io_sim_config_t dshot_sim_config = {
+        .resolution_ns = 0,
+    };
+    dshot_handle_t dshot = NULL;
+    ESP_ERROR_CHECK(dshot_new_pwe_sim(&dshot_config, &dshot_sim_config, &dshot));
+    ESP_ERROR_CHECK(dshot_update(dshot, EXAMPLE_DSHOT_THROTTLE, false));
+    ESP_ERROR_CHECK(dshot_send(dshot));
+    ESP_ERROR_CHECK(dshot_get_pwe_handle(dshot, &pwe));
+    ESP_ERROR_CHECK(pwe_ensure_rst(pwe));
+    ESP_ERROR_CHECK(dshot_update(dshot, EXAMPLE_DSHOT_THROTTLE, true));
+    ESP_ERROR_CHECK(dshot_send(dshot));
+    example_report(pwe, "dshot.vcd");
+    ESP_ERROR_CHECK(dshot_del_pwe_sim(dshot));
+}
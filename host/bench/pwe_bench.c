@@ -0,0 +1,752 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Throughput benchmark of encoders and refresh paths, with driver calls stubbed out.
+ *
+ * Each result is printed to stdout as one JSON object per line:
+ *   {"case":"spi_convert_buffer","preset":"WS2812","leds":24,"bits":576,"status":"ESP_OK",
+ *    "ns_per_op":..,"ns_per_bit":..,"ns_per_led":..,"alloc_bytes":..,"peak_stack":..}
+ *
+ * ns_per_op is the best of BENCH_ROUNDS rounds, each round lasts at least BENCH_ROUND_NS. ns_per_led is 0 for DShot.
+ * alloc_bytes is the heap taken by the handle(s) the case creates, as malloc_usable_size() reports.
+ * peak_stack is the stack used by one operation, on top of what an empty operation takes.
+ * rmt_adapter adds "isr":{..} from pwe_rmt_get_translator_stats(), cycles being host nanoseconds.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <malloc.h>
+#include <pthread.h>
+#include "esp_err.h"
+#include "pwe.h"
+#include "pwe_io_rmt.h"
+#include "pwe_io_spi.h"
+#include "pwe_rmt_symbols.h"
+#include "led_strip.h"
+#include "led_strip_pwe.h"
+#include "dshot.h"
+#include "dshot_erpm.h"
+#include "dshot_telemetry.h"
+#include "pwe_reference.h"
+
+#define BENCH_ROUNDS            5
+#define BENCH_ROUND_NS          (2 * 1000 * 1000)
+#define BENCH_STACK_SIZE        (256 * 1024)
+#define BENCH_STACK_PATTERN     0xa5
+#define BENCH_RMT_CLK_DIV       4
+#define BENCH_SPI_HOST          SPI2_HOST
+#define BENCH_GPIO              18
+#define BENCH_DSHOT_MOTORS      4
+#define BENCH_ERPM_RESOLUTION   10000000    // capture resolution of dshot replies
+#define BENCH_ERPM_CAPTURES     64
+#define BENCH_ERPM_ITEMS        12          // a reply has at most 21 runs
+#define BENCH_TELEMETRY_FRAMES  64          // every 16th with a wrong checksum
+
+typedef struct {
+    const char *name;
+    pwe_config_t config;
+    bool led;               // LED strip preset, payload is swept over LED counts. Otherwise one DShot frame
+} bench_preset_t;
+
+typedef struct {
+    const bench_preset_t *preset;
+    uint32_t led_num;
+    uint32_t bits;          // payload of one operation
+    uint8_t *data;
+    uint32_t counter;
+    pwe_handle_t pwe;
+    led_strip_handle_t strip;
+    dshot_handle_t dshot;
+    dshot_handle_t motors[BENCH_DSHOT_MOTORS];
+    dshot_group_handle_t dshot_group;
+    pwe_rmt_symbols_t symbols;
+    uint32_t *symbol_mem;
+    dshot_erpm_decoder_t erpm_decoder;
+    uint32_t *erpm_expected;
+    dshot_telemetry_t telemetry;
+    dshot_telemetry_data_t *telemetry_expected;
+    pwe_timing_t timing;
+    uint8_t *ref_buffer;    // output of the reference encoders
+    size_t ref_buffer_size;
+    char extra[192];        // more JSON fields of the case, filled by teardown
+} bench_ctx_t;
+
+typedef struct {
+    const char *name;
+    bool led_only;          // needs a LED strip preset
+    bool dshot_only;        // needs a DShot preset
+    esp_err_t (*setup)(bench_ctx_t *ctx);
+    esp_err_t (*run)(bench_ctx_t *ctx);
+    void (*teardown)(bench_ctx_t *ctx);
+} bench_case_t;
+
+static const bench_preset_t s_presets[] = {
+    { "WS2812", PWE_WS2812_CONFIG, true },
+    { "SK6812", PWE_SK6812_CONFIG, true },
+    { "DShot150", PWE_DSHOT150_CONFIG, false },
+    { "DShot300", PWE_DSHOT300_CONFIG, false },
+    { "DShot600", PWE_DSHOT600_CONFIG, false },
+    { "DShot1200", PWE_DSHOT1200_CONFIG, false },
+};
+
+static const uint32_t s_led_nums[] = { 24, 100, 1000, 10000 };
+
+static const rmt_config_t s_rmt_config = RMT_DEFAULT_CONFIG_TX(BENCH_GPIO, RMT_CHANNEL_0);
+
+static const pwe_io_spi_config_t s_spi_config = {
+    .gpio = BENCH_GPIO,
+    .spi_bus = BENCH_SPI_HOST,
+};
+
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* allocations are routed here by the linker (--wrap), see CMakeLists.txt */
+
+static size_t s_heap_used;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = __real_malloc(size);
+    s_heap_used += ptr ? malloc_usable_size(ptr) : 0;
+    return ptr;
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    void *ptr = __real_calloc(n, size);
+    s_heap_used += ptr ? malloc_usable_size(ptr) : 0;
+    return ptr;
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    size_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+    void *new_ptr = __real_realloc(ptr, size);
+    if (new_ptr != NULL || size == 0) {
+        s_heap_used = s_heap_used - old_size + (new_ptr ? malloc_usable_size(new_ptr) : 0);
+    }
+    return new_ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+    s_heap_used -= ptr ? malloc_usable_size(ptr) : 0;
+    __real_free(ptr);
+}
+
+static rmt_config_t bench_rmt_config(void)
+{
+    rmt_config_t config = s_rmt_config;
+    config.clk_div = BENCH_RMT_CLK_DIV;
+    return config;
+}
+
+/* pwe_io_spi_convert_buffer */
+
+static esp_err_t bench_spi_convert_setup(bench_ctx_t *ctx)
+{
+    return pwe_new_spi_backend(&ctx->preset->config, &s_spi_config, ctx->bits, &ctx->pwe);
+}
+
+static esp_err_t bench_convert_run(bench_ctx_t *ctx)
+{
+    uint32_t len = 0;
+    return pwe_io_convert_buffer(ctx->pwe, ctx->data, ctx->bits, &len);
+}
+
+static void bench_spi_teardown(bench_ctx_t *ctx)
+{
+    pwe_delete_spi_backend(ctx->pwe);
+}
+
+/* bit by bit encoder SPI backend used to have, same clock as spi_convert_buffer */
+
+static esp_err_t bench_spi_reference_setup(bench_ctx_t *ctx)
+{
+    esp_err_t ret = bench_spi_convert_setup(ctx);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = pwe_get_timing(ctx->pwe, &ctx->timing);
+    ctx->ref_buffer_size = ctx->bits * ctx->timing.slots_per_bit / 8 + 2;
+    ctx->ref_buffer = malloc(ctx->ref_buffer_size);
+    return ret == ESP_OK && ctx->ref_buffer == NULL ? ESP_ERR_NO_MEM : ret;
+}
+
+static esp_err_t bench_spi_reference_run(bench_ctx_t *ctx)
+{
+    pwe_ref_spi_encode(&ctx->timing, ctx->data, ctx->bits, ctx->ref_buffer, ctx->ref_buffer_size);
+    return ESP_OK;
+}
+
+static void bench_spi_reference_teardown(bench_ctx_t *ctx)
+{
+    free(ctx->ref_buffer);
+    bench_spi_teardown(ctx);
+}
+
+/* pwe_io_rmt_convert_buffer */
+
+static esp_err_t bench_rmt_convert_setup(bench_ctx_t *ctx)
+{
+    rmt_config_t config = bench_rmt_config();
+    return pwe_new_rmt_backend(&ctx->preset->config, &config, ctx->bits, &ctx->pwe);
+}
+
+static void bench_rmt_teardown(bench_ctx_t *ctx)
+{
+    pwe_delete_rmt_backend(ctx->pwe);
+}
+
+/* bit by bit conversion RMT backend used to have, same clock as rmt_convert_buffer */
+
+static esp_err_t bench_rmt_reference_setup(bench_ctx_t *ctx)
+{
+    esp_err_t ret = bench_rmt_convert_setup(ctx);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = pwe_get_timing(ctx->pwe, &ctx->timing);
+    ctx->ref_buffer_size = ctx->bits * sizeof(rmt_item32_t);
+    ctx->ref_buffer = malloc(ctx->ref_buffer_size);
+    return ret == ESP_OK && ctx->ref_buffer == NULL ? ESP_ERR_NO_MEM : ret;
+}
+
+static esp_err_t bench_rmt_reference_run(bench_ctx_t *ctx)
+{
+    pwe_ref_rmt_convert(&ctx->timing, ctx->data, ctx->bits, (rmt_item32_t *)ctx->ref_buffer);
+    return ESP_OK;
+}
+
+static void bench_rmt_reference_teardown(bench_ctx_t *ctx)
+{
+    free(ctx->ref_buffer);
+    bench_rmt_teardown(ctx);
+}
+
+/* pwe_rmt_adapter, fed by stubbed rmt_write_sample() */
+
+static esp_err_t bench_rmt_adapter_setup(bench_ctx_t *ctx)
+{
+    rmt_config_t config = bench_rmt_config();
+    esp_err_t ret = pwe_new_rmt_backend(&ctx->preset->config, &config, 0, &ctx->pwe);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = pwe_init(ctx->pwe);
+    if (ret != ESP_OK) {
+        pwe_delete_rmt_backend(ctx->pwe);
+    }
+    return ret;
+}
+
+static esp_err_t bench_send_run(bench_ctx_t *ctx)
+{
+    return pwe_send(ctx->pwe, ctx->data, ctx->bits);
+}
+
+static void bench_rmt_adapter_teardown(bench_ctx_t *ctx)
+{
+    pwe_rmt_translator_stats_t stats;
+    ESP_ERROR_CHECK(pwe_rmt_get_translator_stats(ctx->pwe, &stats));
+    snprintf(ctx->extra, sizeof(ctx->extra), ",\"isr\":{\"calls\":%" PRIu32 ",\"min_cycles\":%" PRIu32 ",\"max_cycles\":%"
+             PRIu32 ",\"avg_cycles\":%" PRIu32 ",\"refill_items\":%" PRIu32 ",\"refill_deadline_ns\":%" PRIu32 ",\"refill_misses\":%" PRIu32 "}",
+             stats.calls, stats.min_cycles, stats.max_cycles, stats.avg_cycles, stats.refill_items, stats.refill_deadline_ns,
+             stats.refill_misses);
+    pwe_deinit(ctx->pwe);
+    pwe_delete_rmt_backend(ctx->pwe);
+}
+
+/* pwe_rmt_symbols_encode, refilling half of RMT memory at a time as RMT TX backend does from ISR */
+
+#define BENCH_SYMBOLS_CHUNK     (SOC_RMT_MEM_WORDS_PER_CHANNEL / 2)
+
+static esp_err_t bench_rmt_symbols_setup(bench_ctx_t *ctx)
+{
+    pwe_timing_t timing;
+    esp_err_t ret = pwe_rmt_symbols_init(&ctx->symbols, &ctx->preset->config, APB_CLK_FREQ, 0, &timing);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ctx->symbols.payload_bits = ctx->bits;
+    ctx->symbol_mem = malloc(BENCH_SYMBOLS_CHUNK * sizeof(uint32_t));
+    return ctx->symbol_mem ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+static esp_err_t bench_rmt_symbols_run(bench_ctx_t *ctx)
+{
+    size_t written = 0;
+    bool done = false;
+    while (!done) {
+        written += pwe_rmt_symbols_encode(&ctx->symbols, ctx->data, written, BENCH_SYMBOLS_CHUNK, ctx->symbol_mem, &done);
+    }
+    return ESP_OK;
+}
+
+static void bench_rmt_symbols_teardown(bench_ctx_t *ctx)
+{
+    free(ctx->symbol_mem);
+}
+
+/* led_strip_pwe refresh path */
+
+static esp_err_t bench_strip_rmt_setup(bench_ctx_t *ctx)
+{
+    rmt_config_t config = bench_rmt_config();
+    esp_err_t ret = led_strip_new_pwe_rmt(&ctx->preset->config, ctx->led_num, &config, &ctx->strip);
+    if (ret == ESP_OK && (ret = led_strip_init(ctx->strip)) != ESP_OK) {
+        led_strip_del_pwe_rmt(ctx->strip);
+    }
+    return ret;
+}
+
+static esp_err_t bench_strip_spi_setup(bench_ctx_t *ctx)
+{
+    esp_err_t ret = led_strip_new_pwe_spi(&ctx->preset->config, ctx->led_num, &s_spi_config, &ctx->strip);
+    if (ret == ESP_OK && (ret = led_strip_init(ctx->strip)) != ESP_OK) {
+        led_strip_del_pwe_spi(ctx->strip);
+    }
+    return ret;
+}
+
+// a whole new frame each time, refresh skips pixels which did not change
+static esp_err_t bench_strip_refresh_run(bench_ctx_t *ctx)
+{
+    esp_err_t ret = led_strip_set_pixels(ctx->strip, 0, ctx->led_num, ctx->data, LED_PIXEL_FORMAT_RGB888);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return led_strip_refresh(ctx->strip, 100);
+}
+
+static void bench_strip_rmt_teardown(bench_ctx_t *ctx)
+{
+    led_strip_deinit(ctx->strip);
+    led_strip_del_pwe_rmt(ctx->strip);
+}
+
+static void bench_strip_spi_teardown(bench_ctx_t *ctx)
+{
+    led_strip_deinit(ctx->strip);
+    led_strip_del_pwe_spi(ctx->strip);
+}
+
+/* dshot_update */
+
+static esp_err_t bench_dshot_rmt_setup(bench_ctx_t *ctx)
+{
+    rmt_config_t config = bench_rmt_config();
+    return dshot_new_pwe_rmt(&ctx->preset->config, &config, &ctx->dshot);
+}
+
+static esp_err_t bench_dshot_update_run(bench_ctx_t *ctx)
+{
+    ctx->counter = (ctx->counter + 1) % 2001;
+    return dshot_update(ctx->dshot, ctx->counter, false);
+}
+
+static esp_err_t bench_dshot_tick_run(bench_ctx_t *ctx)
+{
+    esp_err_t ret = bench_dshot_update_run(ctx);
+    return ret == ESP_OK ? dshot_send(ctx->dshot) : ret;
+}
+
+static void bench_dshot_rmt_teardown(bench_ctx_t *ctx)
+{
+    dshot_del_pwe_rmt(ctx->dshot);
+}
+
+/* continuous mode, the work done in RMT TX end interrupt to chain next frame */
+
+static esp_err_t bench_dshot_continuous_setup(bench_ctx_t *ctx)
+{
+    esp_err_t ret = bench_dshot_rmt_setup(ctx);
+    if (ret == ESP_OK) {
+        ret = dshot_start_continuous(ctx->dshot);
+    }
+    return ret;
+}
+
+static esp_err_t bench_dshot_continuous_run(bench_ctx_t *ctx)
+{
+    esp_err_t ret = bench_dshot_update_run(ctx);
+    host_rmt_finish_tx(s_rmt_config.channel);
+    return ret;
+}
+
+static void bench_dshot_continuous_teardown(bench_ctx_t *ctx)
+{
+    dshot_timing_stats_t stats;
+    dshot_get_timing_stats(ctx->dshot, &stats);
+    snprintf(ctx->extra, sizeof(ctx->extra), ",\"stop\":\"%s\",\"frames\":%" PRIu32,
+             esp_err_to_name(dshot_stop(ctx->dshot)), stats.frames);
+    dshot_del_pwe_rmt(ctx->dshot);
+}
+
+/* dshot_group_update + dshot_group_send, one tick of a quad */
+
+static esp_err_t bench_dshot_group_setup(bench_ctx_t *ctx)
+{
+    rmt_config_t config = bench_rmt_config();
+    esp_err_t ret = ESP_OK;
+    for (int i = 0; i < BENCH_DSHOT_MOTORS && ret == ESP_OK; ++i) {
+        config.channel = RMT_CHANNEL_0 + i;
+        config.gpio_num = BENCH_GPIO + i;
+        ret = dshot_new_pwe_rmt(&ctx->preset->config, &config, &ctx->motors[i]);
+    }
+    ctx->bits = BENCH_DSHOT_MOTORS * 16;
+    return ret == ESP_OK ? dshot_group_new(ctx->motors, BENCH_DSHOT_MOTORS, &ctx->dshot_group) : ret;
+}
+
+static esp_err_t bench_dshot_group_run(bench_ctx_t *ctx)
+{
+    uint16_t thrust[BENCH_DSHOT_MOTORS];
+    ctx->counter = (ctx->counter + 1) % 2001;
+    for (int i = 0; i < BENCH_DSHOT_MOTORS; ++i) {
+        thrust[i] = (ctx->counter + i) % 2001;
+    }
+    esp_err_t ret = dshot_group_update(ctx->dshot_group, thrust, 0);
+    return ret == ESP_OK ? dshot_group_send(ctx->dshot_group) : ret;
+}
+
+static void bench_dshot_group_teardown(bench_ctx_t *ctx)
+{
+    if (ctx->dshot_group != NULL) {
+        dshot_group_del(ctx->dshot_group);
+    }
+    for (int i = 0; i < BENCH_DSHOT_MOTORS; ++i) {
+        if (ctx->motors[i] != NULL) {
+            dshot_del_pwe_rmt(ctx->motors[i]);
+        }
+    }
+}
+
+/* dshot_erpm_decode of RMT captures of ESC replies, with pulse widths off by up to 1/4 bit */
+
+static const uint8_t s_bench_gcr[16] = {
+    0x19, 0x1b, 0x12, 0x13, 0x1d, 0x15, 0x16, 0x17, 0x1a, 0x09, 0x0a, 0x0b, 0x1e, 0x0d, 0x0e, 0x0f,
+};
+
+/**
+ * @brief Build the capture of a reply the way RMT RX records it, returns eRPM it holds
+ */
+static uint32_t bench_erpm_capture(uint32_t period_us, uint32_t bit_ticks, uint32_t seed, uint32_t *items)
+{
+    uint32_t data = 0x0fff;
+    uint32_t erpm = 0;
+    if (period_us != 0) {
+        uint32_t exp = 0;
+        while ((period_us >> exp) > 0x1ff) {
+            ++exp;
+        }
+        data = (exp << 9) | (period_us >> exp);
+        const uint32_t period = (period_us >> exp) << exp;
+        erpm = (60000000 + period / 2) / period;
+    }
+    const uint32_t value = (data << 4) | (~(data ^ (data >> 4) ^ (data >> 8)) & 0xf);
+    uint32_t gcr = 0;
+    for (int i = 3; i >= 0; --i) {
+        gcr = (gcr << 5) | s_bench_gcr[(value >> (i * 4)) & 0xf];
+    }
+    // runs of levels, the start bit going low, a 1 in GCR flipping the level
+    uint32_t halves[DSHOT_ERPM_REPLY_BITS + 1];
+    uint32_t half_num = 0;
+    uint32_t level = 0;
+    uint32_t run = 1;
+    for (int i = 19; i >= 0; --i) {
+        if ((gcr >> i) & 1) {
+            halves[half_num++] = (level << 15) | run;
+            level ^= 1;
+            run = 0;
+        }
+        ++run;
+    }
+    halves[half_num++] = (level << 15) | run;
+    for (uint32_t i = 0; i < half_num; ++i) {
+        seed = seed * 1103515245 + 12345;
+        const int32_t error = (int32_t)((seed >> 16) % (bit_ticks / 2 + 1)) - (int32_t)(bit_ticks / 4);
+        const uint32_t run_bits = halves[i] & 0x7fff;
+        halves[i] = (halves[i] & 0x8000) | (uint32_t)((int32_t)(run_bits * bit_ticks) + error);
+    }
+    // last run goes high into idle: RMT either ends right there, or records it as long as the idle threshold
+    if (level == 0) {
+        halves[half_num++] = 0x8000 | (seed & 1 ? 0 : 5 * bit_ticks);
+    } else if (seed & 1) {
+        halves[half_num - 1] = 0x8000 | (5 * bit_ticks);
+    }
+    memset(items, 0, BENCH_ERPM_ITEMS * sizeof(uint32_t));
+    for (uint32_t i = 0; i < half_num; ++i) {
+        items[i / 2] |= halves[i] << ((i & 1) * 16);
+    }
+    return erpm;
+}
+
+static esp_err_t bench_erpm_setup(bench_ctx_t *ctx)
+{
+    const uint32_t bitrate = 1000000000 / (ctx->preset->config.T0H + ctx->preset->config.T0L);
+    const uint32_t bit_ticks = (uint64_t)BENCH_ERPM_RESOLUTION * 4 / 5 / bitrate;
+    ctx->bits = DSHOT_ERPM_REPLY_BITS;
+    ctx->symbol_mem = calloc(BENCH_ERPM_CAPTURES, BENCH_ERPM_ITEMS * sizeof(uint32_t));
+    ctx->erpm_expected = calloc(BENCH_ERPM_CAPTURES, sizeof(uint32_t));
+    if (ctx->symbol_mem == NULL || ctx->erpm_expected == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint32_t i = 0; i < BENCH_ERPM_CAPTURES; ++i) {
+        const uint32_t period_us = i == 0 ? 0 : 20 + i * i * 15;    // up to 0x1ff << 7, the longest period
+        ctx->erpm_expected[i] = bench_erpm_capture(period_us, bit_ticks, i * 2654435761u, &ctx->symbol_mem[i * BENCH_ERPM_ITEMS]);
+    }
+    return dshot_erpm_decoder_init(&ctx->erpm_decoder, BENCH_ERPM_RESOLUTION, bitrate);
+}
+
+static esp_err_t bench_erpm_run(bench_ctx_t *ctx)
+{
+    const uint32_t i = ctx->counter++ % BENCH_ERPM_CAPTURES;
+    uint32_t erpm = 0;
+    esp_err_t ret = dshot_erpm_decode(&ctx->erpm_decoder, &ctx->symbol_mem[i * BENCH_ERPM_ITEMS], BENCH_ERPM_ITEMS, &erpm);
+    return ret == ESP_OK && erpm != ctx->erpm_expected[i] ? ESP_ERR_INVALID_RESPONSE : ret;
+}
+
+static void bench_erpm_teardown(bench_ctx_t *ctx)
+{
+    free(ctx->symbol_mem);
+    free(ctx->erpm_expected);
+}
+
+/* dshot_telemetry of KISS replies, 4 motors on one wire asked in turn, each reply arriving in two reads */
+
+static void bench_telemetry_frame(uint32_t i, uint8_t *frame, dshot_telemetry_data_t *expected)
+{
+    const uint16_t fields[4] = { 1480 + i, i * 37, i * 11, i * 97 };
+    frame[0] = 30 + i;
+    for (int f = 0; f < 4; ++f) {
+        frame[1 + f * 2] = fields[f] >> 8;
+        frame[2 + f * 2] = fields[f] & 0xff;
+    }
+    uint8_t crc = 0;
+    for (int b = 0; b < DSHOT_TELEMETRY_FRAME_LEN - 1; ++b) {
+        crc ^= frame[b];
+        for (int k = 0; k < 8; ++k) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    frame[DSHOT_TELEMETRY_FRAME_LEN - 1] = i % 16 == 15 ? crc ^ 0x5a : crc;
+    expected->temperature_c = frame[0];
+    expected->voltage_cv = fields[0];
+    expected->current_ca = fields[1];
+    expected->consumption_mah = fields[2];
+    expected->erpm = fields[3] * 100u;
+}
+
+static esp_err_t bench_telemetry_setup(bench_ctx_t *ctx)
+{
+    ctx->bits = DSHOT_TELEMETRY_FRAME_LEN * 8;
+    free(ctx->data);
+    ctx->data = malloc(BENCH_TELEMETRY_FRAMES * DSHOT_TELEMETRY_FRAME_LEN);
+    ctx->telemetry_expected = calloc(BENCH_TELEMETRY_FRAMES, sizeof(dshot_telemetry_data_t));
+    if (ctx->data == NULL || ctx->telemetry_expected == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint32_t i = 0; i < BENCH_TELEMETRY_FRAMES; ++i) {
+        bench_telemetry_frame(i, &ctx->data[i * DSHOT_TELEMETRY_FRAME_LEN], &ctx->telemetry_expected[i]);
+    }
+    return dshot_telemetry_init(&ctx->telemetry, BENCH_DSHOT_MOTORS, 0);
+}
+
+static esp_err_t bench_telemetry_run(bench_ctx_t *ctx)
+{
+    const uint32_t i = ctx->counter % BENCH_TELEMETRY_FRAMES;
+    const uint32_t motor = ctx->counter % BENCH_DSHOT_MOTORS;
+    const int64_t now_us = (int64_t)ctx->counter++ * 1000;
+    if (dshot_telemetry_request(&ctx->telemetry, now_us) != (1u << motor)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // split anywhere, 0 and 10 leaving the frame whole
+    const uint8_t *frame = &ctx->data[i * DSHOT_TELEMETRY_FRAME_LEN];
+    const size_t split = (i * 7) % (DSHOT_TELEMETRY_FRAME_LEN + 1);
+    const uint32_t crc_errors = ctx->telemetry.stats.crc_errors;
+    dshot_telemetry_feed(&ctx->telemetry, frame, split);
+    dshot_telemetry_feed(&ctx->telemetry, frame + split, DSHOT_TELEMETRY_FRAME_LEN - split);
+    if (i % 16 == 15) {
+        return ctx->telemetry.stats.crc_errors == crc_errors + 1 ? ESP_OK : ESP_ERR_INVALID_CRC;
+    }
+    dshot_telemetry_data_t data;
+    const dshot_telemetry_data_t *expected = &ctx->telemetry_expected[i];
+    esp_err_t ret = dshot_telemetry_get(&ctx->telemetry, motor, &data);
+    if (ret == ESP_OK && (data.temperature_c != expected->temperature_c || data.voltage_cv != expected->voltage_cv ||
+                          data.current_ca != expected->current_ca || data.consumption_mah != expected->consumption_mah ||
+                          data.erpm != expected->erpm)) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+    return ret;
+}
+
+static void bench_telemetry_teardown(bench_ctx_t *ctx)
+{
+    free(ctx->telemetry_expected);
+}
+
+static const bench_case_t s_cases[] = {
+    { "spi_convert_buffer", false, false, bench_spi_convert_setup, bench_convert_run, bench_spi_teardown },
+    { "spi_convert_reference", false, false, bench_spi_reference_setup, bench_spi_reference_run, bench_spi_reference_teardown },
+    { "rmt_convert_buffer", false, false, bench_rmt_convert_setup, bench_convert_run, bench_rmt_teardown },
+    { "rmt_convert_reference", false, false, bench_rmt_reference_setup, bench_rmt_reference_run, bench_rmt_reference_teardown },
+    { "rmt_adapter", false, false, bench_rmt_adapter_setup, bench_send_run, bench_rmt_adapter_teardown },
+    { "rmt_symbols", false, false, bench_rmt_symbols_setup, bench_rmt_symbols_run, bench_rmt_symbols_teardown },
+    { "led_strip_refresh_rmt", true, false, bench_strip_rmt_setup, bench_strip_refresh_run, bench_strip_rmt_teardown },
+    { "led_strip_refresh_spi", true, false, bench_strip_spi_setup, bench_strip_refresh_run, bench_strip_spi_teardown },
+    { "dshot_update", false, true, bench_dshot_rmt_setup, bench_dshot_update_run, bench_dshot_rmt_teardown },
+    { "dshot_tick", false, true, bench_dshot_rmt_setup, bench_dshot_tick_run, bench_dshot_rmt_teardown },
+    { "dshot_continuous", false, true, bench_dshot_continuous_setup, bench_dshot_continuous_run, bench_dshot_continuous_teardown },
+    { "dshot_group_tick", false, true, bench_dshot_group_setup, bench_dshot_group_run, bench_dshot_group_teardown },
+    { "dshot_erpm_decode", false, true, bench_erpm_setup, bench_erpm_run, bench_erpm_teardown },
+    { "dshot_telemetry", false, true, bench_telemetry_setup, bench_telemetry_run, bench_telemetry_teardown },
+};
+
+/* stack usage: run once on a painted stack, then look for the deepest byte that was touched */
+
+typedef struct {
+    const bench_case_t *bench;
+    bench_ctx_t *ctx;
+} bench_stack_arg_t;
+
+static void *bench_stack_entry(void *arg)
+{
+    bench_stack_arg_t *stack_arg = (bench_stack_arg_t *)arg;
+    if (stack_arg->bench != NULL) {
+        stack_arg->bench->run(stack_arg->ctx);
+    }
+    return NULL;
+}
+
+static size_t bench_stack_used(const bench_case_t *bench, bench_ctx_t *ctx)
+{
+    static uint8_t *stack = NULL;
+    if (stack == NULL) {
+        stack = aligned_alloc(64, BENCH_STACK_SIZE);
+        ESP_ERROR_CHECK(stack == NULL ? ESP_ERR_NO_MEM : ESP_OK);
+    }
+    memset(stack, BENCH_STACK_PATTERN, BENCH_STACK_SIZE);
+    pthread_attr_t attr;
+    pthread_t thread;
+    bench_stack_arg_t arg = {
+        .bench = bench,
+        .ctx = ctx,
+    };
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, BENCH_STACK_SIZE);
+    if (pthread_create(&thread, &attr, bench_stack_entry, &arg) != 0) {
+        pthread_attr_destroy(&attr);
+        return 0;
+    }
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+    size_t untouched = 0;
+    while (untouched < BENCH_STACK_SIZE && stack[untouched] == BENCH_STACK_PATTERN) {
+        ++untouched;
+    }
+    return BENCH_STACK_SIZE - untouched;
+}
+
+static uint64_t bench_time_ns_per_op(const bench_case_t *bench, bench_ctx_t *ctx, esp_err_t *status)
+{
+    // find a repeat count that makes one round long enough
+    uint32_t repeat = 1;
+    uint64_t elapsed = 0;
+    while (true) {
+        uint64_t start = bench_now_ns();
+        for (uint32_t i = 0; i < repeat; ++i) {
+            *status = bench->run(ctx);
+        }
+        elapsed = bench_now_ns() - start;
+        if (*status != ESP_OK || elapsed >= BENCH_ROUND_NS || repeat >= (1u << 24)) {
+            break;
+        }
+        repeat *= 2;
+    }
+    uint64_t best = elapsed / repeat;
+    for (int round = 1; round < BENCH_ROUNDS && *status == ESP_OK; ++round) {
+        uint64_t start = bench_now_ns();
+        for (uint32_t i = 0; i < repeat; ++i) {
+            bench->run(ctx);
+        }
+        elapsed = (bench_now_ns() - start) / repeat;
+        best = elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+static void bench_run_one(const bench_case_t *bench, const bench_preset_t *preset, uint32_t led_num, size_t stack_base)
+{
+    bench_ctx_t ctx = {
+        .preset = preset,
+        .led_num = led_num,
+        .bits = preset->led ? led_num * 3 * 8 : 16,
+    };
+    ctx.data = malloc(ctx.bits / 8);
+    ESP_ERROR_CHECK(ctx.data == NULL ? ESP_ERR_NO_MEM : ESP_OK);
+    for (uint32_t i = 0; i < ctx.bits / 8; ++i) {
+        ctx.data[i] = (uint8_t)(i * 37 + 11);
+    }
+
+    size_t heap_before = s_heap_used;
+    esp_err_t status = bench->setup(&ctx);
+    size_t alloc_bytes = s_heap_used - heap_before;
+    uint64_t ns_per_op = 0;
+    size_t peak_stack = 0;
+    if (status == ESP_OK) {
+        ns_per_op = bench_time_ns_per_op(bench, &ctx, &status);
+        size_t stack_used = bench_stack_used(bench, &ctx);
+        peak_stack = stack_used > stack_base ? stack_used - stack_base : 0;
+        bench->teardown(&ctx);
+    }
+    printf("{\"case\":\"%s\",\"preset\":\"%s\",\"leds\":%" PRIu32 ",\"bits\":%" PRIu32 ",\"status\":\"%s\","
+           "\"ns_per_op\":%" PRIu64 ",\"ns_per_bit\":%.3f,\"ns_per_led\":%.3f,\"alloc_bytes\":%zu,\"peak_stack\":%zu%s}\n",
+           bench->name, preset->name, preset->led ? led_num : 0, ctx.bits, esp_err_to_name(status),
+           ns_per_op, (double)ns_per_op / ctx.bits, preset->led ? (double)ns_per_op / led_num : 0.0, alloc_bytes,
+           peak_stack, ctx.extra);
+    fflush(stdout);
+    free(ctx.data);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    size_t stack_base = bench_stack_used(NULL, NULL);
+
+    for (size_t c = 0; c < sizeof(s_cases) / sizeof(s_cases[0]); ++c) {
+        const bench_case_t *bench = &s_cases[c];
+        if (filter != NULL && strstr(bench->name, filter) == NULL) {
+            continue;
+        }
+        for (size_t p = 0; p < sizeof(s_presets) / sizeof(s_presets[0]); ++p) {
+            const bench_preset_t *preset = &s_presets[p];
+            if ((bench->led_only && !preset->led) || (bench->dshot_only && preset->led)) {
+                continue;
+            }
+            if (!preset->led) {
+                bench_run_one(bench, preset, 0, stack_base);
+                continue;
+            }
+            for (size_t n = 0; n < sizeof(s_led_nums) / sizeof(s_led_nums[0]); ++n) {
+                bench_run_one(bench, preset, s_led_nums[n], stack_base);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,647 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Stand-ins for the parts of ESP-IDF used by the components, so that they run on host with driver calls stubbed out.
+ * No waveform is generated, each transmission is finished before the call returns.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/rmt.h"
+#include "driver/spi_master.h"
+#include "driver/timer.h"
+#include "driver/gpio.h"
+#include "driver/uart.h"
+#include "freertos/ringbuf.h"
+
+#ifndef __containerof
+#define __containerof(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
+#define HOST_RMT_MEM_ITEMS      SOC_RMT_MEM_WORDS_PER_CHANNEL
+#define HOST_RMT_GROUP_ITEMS    (SOC_RMT_CHANNELS_PER_GROUP * HOST_RMT_MEM_ITEMS)
+#define HOST_SPI_QUEUE_SIZE     8
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:
+        return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:
+        return "ESP_ERR_INVALID_CRC";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+/* esp_timer */
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    if (create_args == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_timer_handle_t timer = calloc(1, sizeof(struct esp_timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->args = *create_args;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    return timer != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    return timer != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    free(timer);
+    return ESP_OK;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* FreeRTOS */
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = {
+        .tv_sec = ticks / 1000,
+        .tv_nsec = (ticks % 1000) * 1000000L,
+    };
+    nanosleep(&ts, NULL);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *created_task, BaseType_t core_id)
+{
+    // no other thread to run it, tasks run to completion right away
+    if (created_task != NULL) {
+        *created_task = NULL;
+    }
+    fn(arg);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return NULL;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+    return 1;
+}
+
+static uint32_t s_task_notify;
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    ++s_task_notify;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higher_priority_task_woken)
+{
+    ++s_task_notify;
+    if (higher_priority_task_woken != NULL) {
+        *higher_priority_task_woken = pdFALSE;
+    }
+}
+
+static void host_rmt_finish_all(void);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    if (ticks > 0) {
+        // time passes while blocked, hardware gets done with what it was sending
+        host_rmt_finish_all();
+    }
+    uint32_t count = s_task_notify;
+    s_task_notify = clear_on_exit ? 0 : (count ? count - 1 : 0);
+    return count;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return calloc(1, sizeof(struct host_semaphore));
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    buffer->count = 1;
+    return buffer;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    free(sem);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    // nobody else can give it meanwhile
+    if (sem->count == 0) {
+        return pdFALSE;
+    }
+    sem->count = 0;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    if (sem->count) {
+        return pdFALSE;
+    }
+    sem->count = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *higher_prio_task_woken)
+{
+    if (higher_prio_task_woken != NULL) {
+        *higher_prio_task_woken = pdFALSE;
+    }
+    return xSemaphoreGive(sem);
+}
+
+/* Timer group, configured but never counting */
+
+static bool s_timer_inited[TIMER_GROUP_MAX][TIMER_MAX];
+
+static bool host_timer_valid(timer_group_t group_num, timer_idx_t timer_num)
+{
+    return group_num < TIMER_GROUP_MAX && timer_num < TIMER_MAX;
+}
+
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config)
+{
+    if (!host_timer_valid(group_num, timer_num) || config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_timer_inited[group_num][timer_num] = true;
+    return ESP_OK;
+}
+
+esp_err_t timer_deinit(timer_group_t group_num, timer_idx_t timer_num)
+{
+    if (!host_timer_valid(group_num, timer_num) || !s_timer_inited[group_num][timer_num]) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_timer_inited[group_num][timer_num] = false;
+    return ESP_OK;
+}
+
+static esp_err_t host_timer_check(timer_group_t group_num, timer_idx_t timer_num)
+{
+    return host_timer_valid(group_num, timer_num) && s_timer_inited[group_num][timer_num] ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val)
+{
+    return host_timer_check(group_num, timer_num);
+}
+
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value)
+{
+    return host_timer_check(group_num, timer_num);
+}
+
+esp_err_t timer_enable_intr(timer_group_t group_num, timer_idx_t timer_num)
+{
+    return host_timer_check(group_num, timer_num);
+}
+
+esp_err_t timer_isr_callback_add(timer_group_t group_num, timer_idx_t timer_num, timer_isr_t isr_handler, void *arg, int intr_alloc_flags)
+{
+    return host_timer_check(group_num, timer_num);
+}
+
+esp_err_t timer_isr_callback_remove(timer_group_t group_num, timer_idx_t timer_num)
+{
+    return host_timer_check(group_num, timer_num);
+}
+
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num)
+{
+    return host_timer_check(group_num, timer_num);
+}
+
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num)
+{
+    return host_timer_check(group_num, timer_num);
+}
+
+/* RMT */
+
+typedef struct {
+    bool installed;
+    sample_to_rmt_t translator;
+    void *tx_context;
+    size_t tx_len_rem;      // translator finds its channel from the address of item_num, as the driver does
+    bool tx_started;        // by rmt_tx_start(), not finished yet
+    bool tx_held;           // by host_rmt_hold_tx(), not finished by a blocked task
+    rmt_item32_t mem[HOST_RMT_GROUP_ITEMS];
+} host_rmt_channel_t;
+
+static host_rmt_channel_t s_rmt_channels[RMT_CHANNEL_MAX];
+static uint8_t s_rmt_mem_blocks[RMT_CHANNEL_MAX];
+static rmt_tx_end_callback_t s_rmt_tx_end_callback;
+
+static void host_rmt_tx_end(rmt_channel_t channel)
+{
+    if (s_rmt_tx_end_callback.function != NULL) {
+        s_rmt_tx_end_callback.function(channel, s_rmt_tx_end_callback.arg);
+    }
+}
+
+esp_err_t rmt_config(const rmt_config_t *rmt_param)
+{
+    if (rmt_param == NULL || rmt_param->channel >= RMT_CHANNEL_MAX || rmt_param->clk_div == 0 ||
+            rmt_param->mem_block_num == 0 || rmt_param->channel + rmt_param->mem_block_num > SOC_RMT_CHANNELS_PER_GROUP) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_rmt_mem_blocks[rmt_param->channel] = rmt_param->mem_block_num;
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags)
+{
+    if (channel >= RMT_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_rmt_channels[channel].installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    memset(&s_rmt_channels[channel], 0, sizeof(host_rmt_channel_t));
+    s_rmt_channels[channel].installed = true;
+    return ESP_OK;
+}
+
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel)
+{
+    if (channel >= RMT_CHANNEL_MAX || !s_rmt_channels[channel].installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_rmt_channels[channel].installed = false;
+    return ESP_OK;
+}
+
+esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t fn)
+{
+    if (channel >= RMT_CHANNEL_MAX || fn == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_rmt_channels[channel].translator = fn;
+    return ESP_OK;
+}
+
+esp_err_t rmt_translator_set_context(rmt_channel_t channel, void *context)
+{
+    if (channel >= RMT_CHANNEL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_rmt_channels[channel].tx_context = context;
+    return ESP_OK;
+}
+
+esp_err_t rmt_translator_get_context(const size_t *item_num, void **context)
+{
+    if (item_num == NULL || context == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_rmt_channel_t *ch = __containerof(item_num, host_rmt_channel_t, tx_len_rem);
+    *context = ch->tx_context;
+    return ESP_OK;
+}
+
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t *rmt_item, int item_num, bool wait_tx_done)
+{
+    if (channel >= RMT_CHANNEL_MAX || rmt_item == NULL || item_num <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_rmt_tx_end(channel);
+    return ESP_OK;
+}
+
+esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t src_size, bool wait_tx_done)
+{
+    if (channel >= RMT_CHANNEL_MAX || src == NULL || src_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    host_rmt_channel_t *ch = &s_rmt_channels[channel];
+    if (!ch->installed || ch->translator == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // whole RMT memory is filled first, then refilled half by half
+    const size_t mem_items = s_rmt_mem_blocks[channel] * HOST_RMT_MEM_ITEMS;
+    size_t wanted_num = mem_items;
+    while (src_size > 0) {
+        size_t translated_size = 0;
+        ch->translator(src, ch->mem, src_size, wanted_num, &translated_size, &ch->tx_len_rem);
+        if (translated_size == 0) {
+            break;
+        }
+        src += translated_size;
+        src_size -= translated_size;
+        wanted_num = mem_items / 2;
+    }
+    host_rmt_tx_end(channel);
+    return ESP_OK;
+}
+
+esp_err_t rmt_fill_tx_items(rmt_channel_t channel, const rmt_item32_t *item, uint16_t item_num, uint16_t mem_offset)
+{
+    if (channel >= RMT_CHANNEL_MAX || item == NULL || item_num == 0 ||
+            mem_offset + item_num > s_rmt_mem_blocks[channel] * HOST_RMT_MEM_ITEMS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(&s_rmt_channels[channel].mem[mem_offset], item, item_num * sizeof(rmt_item32_t));
+    return ESP_OK;
+}
+
+esp_err_t rmt_tx_start(rmt_channel_t channel, bool tx_idx_rst)
+{
+    if (channel >= RMT_CHANNEL_MAX || !s_rmt_channels[channel].installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    s_rmt_channels[channel].tx_started = true;
+    return ESP_OK;
+}
+
+void host_rmt_finish_tx(rmt_channel_t channel)
+{
+    if (channel < RMT_CHANNEL_MAX && s_rmt_channels[channel].tx_started) {
+        s_rmt_channels[channel].tx_started = false;
+        host_rmt_tx_end(channel);
+    }
+}
+
+void host_rmt_hold_tx(rmt_channel_t channel, bool hold)
+{
+    if (channel < RMT_CHANNEL_MAX) {
+        s_rmt_channels[channel].tx_held = hold;
+    }
+}
+
+static void host_rmt_finish_all(void)
+{
+    for (int channel = 0; channel < RMT_CHANNEL_MAX; ++channel) {
+        if (!s_rmt_channels[channel].tx_held) {
+            host_rmt_finish_tx(channel);
+        }
+    }
+}
+
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time)
+{
+    return channel < RMT_CHANNEL_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+rmt_tx_end_callback_t rmt_register_tx_end_callback(rmt_tx_end_fn_t function, void *arg)
+{
+    rmt_tx_end_callback_t previous = s_rmt_tx_end_callback;
+    s_rmt_tx_end_callback.function = function;
+    s_rmt_tx_end_callback.arg = arg;
+    return previous;
+}
+
+esp_err_t rmt_set_gpio(rmt_channel_t channel, rmt_mode_t mode, gpio_num_t gpio_num, bool invert_signal)
+{
+    return channel < RMT_CHANNEL_MAX && mode < RMT_MODE_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+struct host_ringbuf {
+    rmt_channel_t channel;
+};
+
+static struct host_ringbuf s_rmt_ringbufs[RMT_CHANNEL_MAX];
+
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool rx_idx_rst)
+{
+    return channel < RMT_CHANNEL_MAX && s_rmt_channels[channel].installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t rmt_rx_stop(rmt_channel_t channel)
+{
+    return channel < RMT_CHANNEL_MAX && s_rmt_channels[channel].installed ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t *buf_handle)
+{
+    if (channel >= RMT_CHANNEL_MAX || buf_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    s_rmt_ringbufs[channel].channel = channel;
+    *buf_handle = &s_rmt_ringbufs[channel];
+    return ESP_OK;
+}
+
+/* Ring buffer, always empty */
+
+void *xRingbufferReceive(RingbufHandle_t ringbuf, size_t *item_size, TickType_t ticks)
+{
+    *item_size = 0;
+    return NULL;
+}
+
+void vRingbufferReturnItem(RingbufHandle_t ringbuf, void *item)
+{
+}
+
+/* GPIO */
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, gpio_mode_t mode)
+{
+    return gpio_num >= 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_pullup_en(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+/* UART, nothing is ever received */
+
+static bool s_uart_installed[UART_NUM_MAX];
+
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t *uart_queue, int intr_alloc_flags)
+{
+    if (uart_num >= UART_NUM_MAX || rx_buffer_size <= 128) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (s_uart_installed[uart_num]) {
+        return ESP_FAIL;
+    }
+    s_uart_installed[uart_num] = true;
+    return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+    if (uart_num < UART_NUM_MAX) {
+        s_uart_installed[uart_num] = false;
+    }
+    return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t uart_num, const uart_config_t *uart_config)
+{
+    return uart_num < UART_NUM_MAX && uart_config->baud_rate > 0 ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_set_pin(uart_port_t uart_num, int tx_io_num, int rx_io_num, int rts_io_num, int cts_io_num)
+{
+    return uart_num < UART_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_set_rx_full_threshold(uart_port_t uart_num, int threshold)
+{
+    return uart_num < UART_NUM_MAX && s_uart_installed[uart_num] ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t uart_set_rx_timeout(uart_port_t uart_num, const uint8_t tout_thresh)
+{
+    return uart_num < UART_NUM_MAX && s_uart_installed[uart_num] ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t uart_get_buffered_data_len(uart_port_t uart_num, size_t *size)
+{
+    *size = 0;
+    return uart_num < UART_NUM_MAX && s_uart_installed[uart_num] ? ESP_OK : ESP_FAIL;
+}
+
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+    return uart_num < UART_NUM_MAX && s_uart_installed[uart_num] ? 0 : -1;
+}
+
+/* SPI master */
+
+struct spi_device_t {
+    spi_device_interface_config_t config;
+    spi_transaction_t *queue[HOST_SPI_QUEUE_SIZE];
+    uint32_t queue_head;
+    uint32_t queue_len;
+};
+
+esp_err_t spi_bus_initialize(spi_host_device_t host_id, const spi_bus_config_t *bus_config, spi_common_dma_t dma_chan)
+{
+    return bus_config != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t spi_bus_free(spi_host_device_t host_id)
+{
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t host_id, const spi_device_interface_config_t *dev_config, spi_device_handle_t *handle)
+{
+    if (dev_config == NULL || handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    spi_device_handle_t dev = calloc(1, sizeof(struct spi_device_t));
+    if (dev == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    dev->config = *dev_config;
+    *handle = dev;
+    return ESP_OK;
+}
+
+esp_err_t spi_bus_remove_device(spi_device_handle_t handle)
+{
+    if (handle == NULL || handle->queue_len != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    free(handle);
+    return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *trans_desc, TickType_t ticks_to_wait)
+{
+    if (handle == NULL || trans_desc == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->queue_len == HOST_SPI_QUEUE_SIZE) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (handle->config.post_cb != NULL) {
+        handle->config.post_cb(trans_desc);
+    }
+    handle->queue[(handle->queue_head + handle->queue_len) % HOST_SPI_QUEUE_SIZE] = trans_desc;
+    ++handle->queue_len;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **trans_desc, TickType_t ticks_to_wait)
+{
+    if (handle == NULL || trans_desc == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (handle->queue_len == 0) {
+        return ESP_ERR_TIMEOUT;
+    }
+    *trans_desc = handle->queue[handle->queue_head];
+    handle->queue_head = (handle->queue_head + 1) % HOST_SPI_QUEUE_SIZE;
+    --handle->queue_len;
+    return ESP_OK;
+}
+
+esp_err_t spi_device_transmit(spi_device_handle_t handle, spi_transaction_t *trans_desc)
+{
+    spi_transaction_t *done = NULL;
+    esp_err_t ret = spi_device_queue_trans(handle, trans_desc, portMAX_DELAY);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return spi_device_get_trans_result(handle, &done, portMAX_DELAY);
+}
@@ -0,0 +1,163 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+#include "esp_intr_alloc.h"
+#include "soc/soc.h"
+#include "soc/soc_caps.h"
+#include "driver/gpio.h"
+
+typedef enum {
+    RMT_CHANNEL_0,
+    RMT_CHANNEL_1,
+    RMT_CHANNEL_2,
+    RMT_CHANNEL_3,
+    RMT_CHANNEL_4,
+    RMT_CHANNEL_5,
+    RMT_CHANNEL_6,
+    RMT_CHANNEL_7,
+    RMT_CHANNEL_MAX
+} rmt_channel_t;
+
+typedef enum {
+    RMT_MODE_TX,
+    RMT_MODE_RX,
+    RMT_MODE_MAX
+} rmt_mode_t;
+
+typedef struct {
+    union {
+        struct {
+            uint32_t duration0 : 15;
+            uint32_t level0 : 1;
+            uint32_t duration1 : 15;
+            uint32_t level1 : 1;
+        };
+        uint32_t val;
+    };
+} rmt_item32_t;
+
+typedef enum {
+    RMT_IDLE_LEVEL_LOW,
+    RMT_IDLE_LEVEL_HIGH,
+    RMT_IDLE_LEVEL_MAX,
+} rmt_idle_level_t;
+
+#define RMT_CHANNEL_FLAGS_AWARE_DFS     (1 << 0)
+#define RMT_CHANNEL_FLAGS_INVERT_SIG    (1 << 1)
+
+typedef struct {
+    uint32_t carrier_freq_hz;
+    int carrier_level;
+    int idle_level;
+    uint8_t carrier_duty_percent;
+    uint32_t loop_count;
+    bool carrier_en;
+    bool loop_en;
+    bool idle_output_en;
+} rmt_tx_config_t;
+
+typedef struct {
+    uint16_t idle_threshold;
+    uint8_t filter_ticks_thresh;
+    bool filter_en;
+    bool rm_carrier;
+    uint32_t carrier_freq_hz;
+    uint8_t carrier_duty_percent;
+    int carrier_level;
+} rmt_rx_config_t;
+
+typedef struct {
+    rmt_mode_t rmt_mode;
+    rmt_channel_t channel;
+    gpio_num_t gpio_num;
+    uint8_t clk_div;
+    uint8_t mem_block_num;
+    uint32_t flags;
+    union {
+        rmt_tx_config_t tx_config;
+        rmt_rx_config_t rx_config;
+    };
+} rmt_config_t;
+
+#define RMT_DEFAULT_CONFIG_TX(gpio, channel_id)     \
+    {                                               \
+        .rmt_mode = RMT_MODE_TX,                    \
+        .channel = channel_id,                      \
+        .gpio_num = gpio,                           \
+        .clk_div = 80,                              \
+        .mem_block_num = 1,                         \
+        .flags = 0,                                 \
+        .tx_config = {                              \
+            .carrier_freq_hz = 38000,               \
+            .carrier_level = 1,                     \
+            .idle_level = 0,                        \
+            .carrier_duty_percent = 33,             \
+            .loop_count = 0,                        \
+            .carrier_en = false,                    \
+            .loop_en = false,                       \
+            .idle_output_en = true,                 \
+        }                                           \
+    }
+
+#define RMT_DEFAULT_CONFIG_RX(gpio, channel_id)     \
+    {                                               \
+        .rmt_mode = RMT_MODE_RX,                    \
+        .channel = channel_id,                      \
+        .gpio_num = gpio,                           \
+        .clk_div = 80,                              \
+        .mem_block_num = 1,                         \
+        .flags = 0,                                 \
+        .rx_config = {                              \
+            .idle_threshold = 12000,                \
+            .filter_ticks_thresh = 100,             \
+            .filter_en = true,                      \
+            .rm_carrier = false,                    \
+            .carrier_freq_hz = 38000,               \
+            .carrier_duty_percent = 33,             \
+            .carrier_level = 1,                     \
+        }                                           \
+    }
+
+typedef void (*sample_to_rmt_t)(const void *src, rmt_item32_t *dest, size_t src_size, size_t wanted_num,
+                                size_t *translated_size, size_t *item_num);
+
+typedef void (*rmt_tx_end_fn_t)(rmt_channel_t channel, void *arg);
+
+typedef struct {
+    rmt_tx_end_fn_t function;
+    void *arg;
+} rmt_tx_end_callback_t;
+
+/*
+ * Nothing leaves the host: writes complete immediately. rmt_write_sample() still feeds the samples through the
+ * translator in chunks of RMT memory size, the way the driver refills RMT memory from its ISR.
+ */
+esp_err_t rmt_config(const rmt_config_t *rmt_param);
+esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rx_buf_size, int intr_alloc_flags);
+esp_err_t rmt_driver_uninstall(rmt_channel_t channel);
+esp_err_t rmt_translator_init(rmt_channel_t channel, sample_to_rmt_t fn);
+esp_err_t rmt_translator_set_context(rmt_channel_t channel, void *context);
+esp_err_t rmt_translator_get_context(const size_t *item_num, void **context);
+esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t *rmt_item, int item_num, bool wait_tx_done);
+esp_err_t rmt_write_sample(rmt_channel_t channel, const uint8_t *src, size_t src_size, bool wait_tx_done);
+esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait_time);
+rmt_tx_end_callback_t rmt_register_tx_end_callback(rmt_tx_end_fn_t function, void *arg);
+esp_err_t rmt_set_gpio(rmt_channel_t channel, rmt_mode_t mode, gpio_num_t gpio_num, bool invert_signal);
+/* Started by hand, a transmission lasts until host_rmt_finish_tx(), or until a task blocks on a notification */
+esp_err_t rmt_fill_tx_items(rmt_channel_t channel, const rmt_item32_t *item, uint16_t item_num, uint16_t mem_offset);
+esp_err_t rmt_tx_start(rmt_channel_t channel, bool tx_idx_rst);
+/* Host only: end the transmission started by rmt_tx_start(), the way TX end interrupt comes */
+void host_rmt_finish_tx(rmt_channel_t channel);
+/* Host only: keep a started transmission running while a task blocks, as if the line hung, until released */
+void host_rmt_hold_tx(rmt_channel_t channel, bool hold);
+/* Nothing is ever received on host */
+esp_err_t rmt_rx_start(rmt_channel_t channel, bool rx_idx_rst);
+esp_err_t rmt_rx_stop(rmt_channel_t channel);
+esp_err_t rmt_get_ringbuf_handle(rmt_channel_t channel, RingbufHandle_t *buf_handle);
@@ -0,0 +1,66 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "esp_attr.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define portMAX_DELAY           ((TickType_t)0xffffffff)
+#define portTICK_PERIOD_MS      1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portYIELD_FROM_ISR()    do {} while (0)
+#define portNUM_PROCESSORS      2
+#define configMAX_PRIORITIES    25
+#define xPortGetCoreID()        0
+
+/* Single threaded host, locks only have to keep the code compiling */
+typedef struct {
+    uint32_t owner;
+    uint32_t count;
+} spinlock_t;
+
+typedef spinlock_t portMUX_TYPE;
+
+#define SPINLOCK_WAIT_FOREVER           (-1)
+#define portMUX_INITIALIZER_UNLOCKED    {0, 0}
+#define portENTER_CRITICAL(mux)         (void)(mux)
+#define portEXIT_CRITICAL(mux)          (void)(mux)
+#define portENTER_CRITICAL_ISR(mux)     (void)(mux)
+#define portEXIT_CRITICAL_ISR(mux)      (void)(mux)
+#define portENTER_CRITICAL_SAFE(mux)    (void)(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     (void)(mux)
+
+static inline void spinlock_initialize(spinlock_t *lock)
+{
+    lock->owner = 0;
+    lock->count = 0;
+}
+
+static inline bool spinlock_acquire(spinlock_t *lock, int32_t timeout)
+{
+    (void)timeout;
+    ++lock->count;
+    return true;
+}
+
+static inline void spinlock_release(spinlock_t *lock)
+{
+    --lock->count;
+}
+
+static inline void esp_rom_delay_us(uint32_t us)
+{
+    (void)us;
+}
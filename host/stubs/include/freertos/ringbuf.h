@@ -0,0 +1,15 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_ringbuf *RingbufHandle_t;
+
+void *xRingbufferReceive(RingbufHandle_t ringbuf, size_t *item_size, TickType_t ticks);
+void vRingbufferReturnItem(RingbufHandle_t ringbuf, void *item);
@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host build of the components, behaves like an ESP32 without any peripheral attached */
+
+#pragma once
+
+#define CONFIG_IDF_TARGET           "host"
+#define CONFIG_IDF_TARGET_LINUX     0
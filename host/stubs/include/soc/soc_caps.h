@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/* Same capabilities as ESP32: no RMT TX sync group */
+#define SOC_RMT_CHANNELS_PER_GROUP  8
+#define SOC_RMT_TX_CANDIDATES_PER_GROUP 8
+#define SOC_RMT_MEM_WORDS_PER_CHANNEL   64
@@ -0,0 +1,15 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+// any host memory can be handed to the stubbed SPI driver
+static inline bool esp_ptr_dma_capable(const void *p)
+{
+    return true;
+}
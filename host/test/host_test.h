@@ -0,0 +1,49 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Minimal assertions of host tests, one test program per source file:
+ *
+ *     TEST_CHECK(len == expected, "len %u", len);
+ *     ...
+ *     return TEST_RESULT();
+ *
+ * A failed check is reported on stderr and the run goes on, TEST_RESULT() gives the exit code: 0 if all checks passed.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+static unsigned s_test_checks;
+static unsigned s_test_failures;
+
+#define TEST_CHECK(cond, fmt, ...)                                                          \
+    do {                                                                                \
+        ++s_test_checks;                                                                \
+        if (!(cond)) {                                                                  \
+            ++s_test_failures;                                                          \
+            fprintf(stderr, "%s:%d: check failed: %s: " fmt "\n", __FILE__, __LINE__, #cond, ##__VA_ARGS__); \
+        }                                                                               \
+    } while (0)
+
+#define TEST_RESULT()   test_result(__FILE__)
+
+static inline int test_result(const char *file)
+{
+    fprintf(stderr, "%s: %u checks, %u failed\n", file, s_test_checks, s_test_failures);
+    return s_test_failures == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Deterministic pseudo-random numbers, so that a failure can be reproduced
+ */
+static inline uint32_t test_rand(uint32_t *state)
+{
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 8;
+}
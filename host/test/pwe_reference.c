@@ -0,0 +1,67 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+#include <string.h>
+#include "pwe_reference.h"
+
+uint32_t pwe_ref_spi_encode(const pwe_timing_t *timing, const uint8_t *src, uint32_t len, uint8_t *buffer, size_t buffer_size)
+{
+    memset(buffer, 0, buffer_size);
+    uint32_t bits_src_proceeded = 0;
+    uint8_t overflow_byte = 0x00;
+    uint32_t bit_offset_dest = 0;
+    uint32_t byte_offset_dest = 0;
+    while (bits_src_proceeded < len) {
+        uint32_t bit_offset_src = bits_src_proceeded % 8;
+        uint32_t byte_offset_src = bits_src_proceeded / 8;
+        bool src_bit_val = src[byte_offset_src] & (1 << (7 - bit_offset_src)); // input MSBit first
+        uint16_t temp_buffer = (buffer[byte_offset_dest] << 8);
+        if (bit_offset_dest >= 8) { // overflow detected, switch to next byte
+            temp_buffer = overflow_byte << 8;
+            bit_offset_dest %= 8;
+            ++byte_offset_dest;
+        }
+        if (src_bit_val) {
+            temp_buffer |= (uint16_t)(((uint8_t)(0xff << (8 - timing->t1h)) << 8) >> bit_offset_dest);
+            bit_offset_dest += timing->t1h;
+            temp_buffer &= ~(uint16_t)(((uint8_t)(0xff << (8 - timing->t1l)) << 8) >> bit_offset_dest);
+            bit_offset_dest += timing->t1l;
+        } else {
+            temp_buffer |= (uint16_t)(((uint8_t)(0xff << (8 - timing->t0h)) << 8) >> bit_offset_dest);
+            bit_offset_dest += timing->t0h;
+            temp_buffer &= ~(uint16_t)(((uint8_t)(0xff << (8 - timing->t0l)) << 8) >> bit_offset_dest);
+            bit_offset_dest += timing->t0l;
+        }
+        // current byte is the high half of the 16 bits window, the low half spills into next one
+        buffer[byte_offset_dest] = temp_buffer >> 8;
+        overflow_byte = temp_buffer & 0xff;
+        ++bits_src_proceeded;
+    }
+    // the old loop ended here and lost the slots the last bit spilled into next byte, while counting them
+    if (bit_offset_dest > 8) {
+        buffer[byte_offset_dest + 1] = overflow_byte;
+    }
+    return byte_offset_dest * 8 + bit_offset_dest;
+}
+
+uint32_t pwe_ref_rmt_convert(const pwe_timing_t *timing, const uint8_t *src, uint32_t len, rmt_item32_t *items)
+{
+    const rmt_item32_t bit0 = {{{ timing->t0h, 1, timing->t0l, 0 }}}; //Logical 0
+    const rmt_item32_t bit1 = {{{ timing->t1h, 1, timing->t1l, 0 }}}; //Logical 1
+    uint32_t bits_src_proceeded = 0;
+    while (bits_src_proceeded < len) {
+        uint32_t byte_offset = bits_src_proceeded / 8;
+        uint8_t bit_offset = (7 - bits_src_proceeded % 8);
+        if (src[byte_offset] & (1 << bit_offset)) {
+            items[bits_src_proceeded].val = bit1.val;
+        } else {
+            items[bits_src_proceeded].val = bit0.val;
+        }
+        ++bits_src_proceeded;
+    }
+    return bits_src_proceeded;
+}
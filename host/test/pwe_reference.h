@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Encoders as they were before being optimized, one source bit at a time. Host tests check the backends against them
+ * bit for bit, pwe_bench times them next to the backends.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "driver/rmt.h"
+#include "pwe_timing.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Encode len bits of src into SPI samples, the bit by bit loop SPI backend used to have
+ *
+ * Except for the end of the frame: slots of the last bit crossing a byte boundary were dropped, they are kept here.
+ *
+ * @param timing: slots of each pulse, none of them longer than 8
+ * @param src: source bits, MSBit first
+ * @param len: number of source bits
+ * @param buffer: filled with samples, MSBit first. Slots past the end of the frame are cleared
+ * @param buffer_size: size of buffer, at least len * slots_per_bit / 8 + 2 bytes
+ *
+ * @return number of slots written
+ */
+uint32_t pwe_ref_spi_encode(const pwe_timing_t *timing, const uint8_t *src, uint32_t len, uint8_t *buffer, size_t buffer_size);
+
+/**
+ * @brief Convert len bits of src into RMT items, the bit by bit loop RMT backend used to have
+ *
+ * @param timing: ticks of each pulse
+ * @param src: source bits, MSBit first
+ * @param len: number of source bits
+ * @param items: filled with one item per bit
+ *
+ * @return number of items written
+ */
+uint32_t pwe_ref_rmt_convert(const pwe_timing_t *timing, const uint8_t *src, uint32_t len, rmt_item32_t *items);
+
+#ifdef __cplusplus
+}
+#endif
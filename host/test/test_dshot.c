@@ -0,0 +1,251 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * DShot frames sent on the simulated backend, decoded back from the recorded waveform and checked against packets
+ * built here bit by bit: every throttle with and without telemetry bit, checksum of normal and inverted checksum of
+ * bidirectional DShot on an inverted line, pulse widths and TRST between frames, queued commands repeated with
+ * telemetry bit and followed by motor stop before throttle resumes, frames of a group, all or none of its commands
+ * queued, dshot_send() and dshot_queue_command() refused for its motors. Continuous output of an RMT stub channel
+ * whose last frame does not end: dshot_stop() times out and the motor stays busy until a retried stop succeeds.
+ */
+
+#include "dshot.h"
+#include "host_test.h"
+#include "test_sim.h"
+
+#define TEST_FRAME_BITS     16
+#define TEST_MAX_FRAMES     16
+
+static const pwe_config_t s_conf = PWE_DSHOT600_CONFIG;
+
+// 11 bits of value, telemetry bit, 4 bits of checksum: XOR of the three nibbles above it, inverted if bidirectional
+static uint32_t test_packet(uint32_t value, bool telemetry, bool bidirectional)
+{
+    const uint32_t data = (value << 1) | (telemetry ? 1 : 0);
+    uint32_t crc = 0;
+    for (uint32_t nibble = 0; nibble < 3; ++nibble) {
+        crc ^= (data >> (nibble * 4)) & 0xf;
+    }
+    if (bidirectional) {
+        crc = ~crc & 0xf;
+    }
+    return (data << 4) | crc;
+}
+
+/**
+ * @brief Decode all frames sent since last clear, checking that each of them is a complete packet
+ */
+static uint32_t test_decode(dshot_handle_t dshot, bool bidirectional, uint32_t *packets, uint64_t *start_ns)
+{
+    pwe_handle_t pwe = NULL;
+    uint8_t bits[TEST_MAX_FRAMES * TEST_FRAME_BITS];
+    test_sim_frame_t frames[TEST_MAX_FRAMES];
+    dshot_get_pwe_handle(dshot, &pwe);
+    const uint32_t num = test_sim_decode(pwe, &s_conf, bidirectional, bits, sizeof(bits), frames, TEST_MAX_FRAMES);
+    for (uint32_t i = 0; i < num; ++i) {
+        TEST_CHECK(frames[i].bits == TEST_FRAME_BITS, "frame %u: %u bits", i, frames[i].bits);
+        packets[i] = test_sim_bits_value(&bits[frames[i].first_bit], TEST_FRAME_BITS);
+        if (start_ns != NULL) {
+            start_ns[i] = frames[i].start_ns;
+        }
+    }
+    return num;
+}
+
+static void test_throttle(bool bidirectional)
+{
+    const pwe_io_sim_config_t sim_conf = { 0 };
+    dshot_handle_t dshot = NULL;
+    pwe_handle_t pwe = NULL;
+    esp_err_t ret = bidirectional ? dshot_new_pwe_sim_bidir(&s_conf, &sim_conf, &dshot) :
+                    dshot_new_pwe_sim(&s_conf, &sim_conf, &dshot);
+    TEST_CHECK(ret == ESP_OK, "create: %d", ret);
+    if (ret != ESP_OK) {
+        return;
+    }
+    dshot_get_pwe_handle(dshot, &pwe);
+
+    // nothing updated yet: motor stop
+    dshot_send(dshot);
+    uint32_t packets[TEST_MAX_FRAMES];
+    uint32_t num = test_decode(dshot, bidirectional, packets, NULL);
+    TEST_CHECK(num == 1 && packets[0] == test_packet(0, false, bidirectional), "bidir %d initial frame", bidirectional);
+
+    for (uint32_t thrust = 0; thrust <= 2000; ++thrust) {
+        const uint32_t value = thrust == 0 ? 0 : thrust + 47;
+        pwe_sim_clear(pwe);
+        for (uint32_t telemetry = 0; telemetry < 2; ++telemetry) {
+            TEST_CHECK(dshot_update(dshot, thrust, telemetry) == ESP_OK, "thrust %u", thrust);
+            TEST_CHECK(dshot_send(dshot) == ESP_OK, "thrust %u", thrust);
+        }
+        num = test_decode(dshot, bidirectional, packets, NULL);
+        TEST_CHECK(num == 2, "bidir %d thrust %u: %u frames", bidirectional, thrust, num);
+        for (uint32_t telemetry = 0; telemetry < 2 && telemetry < num; ++telemetry) {
+            const uint32_t expected = test_packet(value, telemetry, bidirectional);
+            TEST_CHECK(packets[telemetry] == expected, "bidir %d thrust %u telemetry %u: %04x, expected %04x",
+                       bidirectional, thrust, telemetry, packets[telemetry], expected);
+        }
+    }
+    TEST_CHECK(dshot_update(dshot, 2001, false) == ESP_ERR_INVALID_ARG, "thrust out of range");
+    TEST_CHECK(dshot_del_pwe_sim(dshot) == ESP_OK, "delete");
+}
+
+static void test_gap(void)
+{
+    const pwe_io_sim_config_t sim_conf = { 0 };
+    dshot_handle_t dshot = NULL;
+    pwe_handle_t pwe = NULL;
+    TEST_CHECK(dshot_new_pwe_sim(&s_conf, &sim_conf, &dshot) == ESP_OK, "create");
+    dshot_get_pwe_handle(dshot, &pwe);
+
+    // back to back sends wait for TRST, a send after a long idle starts right away
+    dshot_update(dshot, 1000, false);
+    dshot_send(dshot);
+    dshot_send(dshot);
+    pwe_sim_advance(pwe, 1000000);
+    dshot_send(dshot);
+    uint32_t packets[TEST_MAX_FRAMES];
+    uint64_t start_ns[TEST_MAX_FRAMES];
+    const uint32_t num = test_decode(dshot, false, packets, start_ns);
+    TEST_CHECK(num == 3, "%u frames", num);
+    if (num == 3) {
+        uint64_t frame_ns = 0;
+        for (uint32_t bit = 0; bit < TEST_FRAME_BITS; ++bit) {
+            const bool one = packets[0] & (0x8000 >> bit);
+            frame_ns += one ? s_conf.T1H + s_conf.T1L : s_conf.T0H + s_conf.T0L;
+        }
+        TEST_CHECK(start_ns[0] == 0, "first frame at %" PRIu64 "ns", start_ns[0]);
+        TEST_CHECK(start_ns[1] == frame_ns + s_conf.TRST, "second frame at %" PRIu64 "ns", start_ns[1]);
+        TEST_CHECK(start_ns[2] == start_ns[1] + frame_ns + 1000000, "frame after idle at %" PRIu64 "ns", start_ns[2]);
+    }
+    dshot_del_pwe_sim(dshot);
+}
+
+static void test_commands(bool bidirectional)
+{
+    const pwe_io_sim_config_t sim_conf = { 0 };
+    dshot_handle_t dshot = NULL;
+    TEST_CHECK((bidirectional ? dshot_new_pwe_sim_bidir(&s_conf, &sim_conf, &dshot) :
+                dshot_new_pwe_sim(&s_conf, &sim_conf, &dshot)) == ESP_OK, "create");
+
+    dshot_update(dshot, 1000, false);
+    TEST_CHECK(dshot_queue_command(dshot, DShot_cmd_spin_direction_1, 3, 2) == ESP_OK, "queue");
+    TEST_CHECK(dshot_queue_command(dshot, DShot_cmd_save_settings, 2, 0) == ESP_OK, "queue");
+    TEST_CHECK(dshot_queue_command(dshot, DShot_cmd_MIN_throttle, 1, 0) == ESP_ERR_INVALID_ARG, "not a command");
+    TEST_CHECK(dshot_queue_command(dshot, DShot_cmd_beacon1, 0, 0) == ESP_ERR_INVALID_ARG, "no repeat");
+    uint32_t pending = 0;
+    dshot_get_commands_pending(dshot, &pending);
+    TEST_CHECK(pending == 2, "%u pending", pending);
+
+    const uint32_t expected[] = {
+        test_packet(DShot_cmd_spin_direction_1, true, bidirectional),
+        test_packet(DShot_cmd_spin_direction_1, true, bidirectional),
+        test_packet(DShot_cmd_spin_direction_1, true, bidirectional),
+        test_packet(DShot_cmd_motor_stop, false, bidirectional),
+        test_packet(DShot_cmd_motor_stop, false, bidirectional),
+        test_packet(DShot_cmd_save_settings, true, bidirectional),
+        test_packet(DShot_cmd_save_settings, true, bidirectional),
+        test_packet(1047, false, bidirectional),
+        test_packet(1047, false, bidirectional),
+    };
+    const uint32_t expected_num = sizeof(expected) / sizeof(expected[0]);
+    for (uint32_t i = 0; i < expected_num; ++i) {
+        dshot_send(dshot);
+    }
+    uint32_t packets[TEST_MAX_FRAMES];
+    const uint32_t num = test_decode(dshot, bidirectional, packets, NULL);
+    TEST_CHECK(num == expected_num, "bidir %d: %u frames", bidirectional, num);
+    for (uint32_t i = 0; i < num && i < expected_num; ++i) {
+        TEST_CHECK(packets[i] == expected[i], "bidir %d frame %u: %04x, expected %04x", bidirectional, i, packets[i],
+                   expected[i]);
+    }
+    dshot_get_commands_pending(dshot, &pending);
+    TEST_CHECK(pending == 0, "%u pending", pending);
+    dshot_del_pwe_sim(dshot);
+}
+
+static void test_group_member(void)
+{
+    const pwe_io_sim_config_t sim_conf = { 0 };
+    dshot_handle_t motors[2] = { NULL };
+    dshot_group_handle_t group = NULL;
+    for (uint32_t i = 0; i < 2; ++i) {
+        TEST_CHECK(dshot_new_pwe_sim(&s_conf, &sim_conf, &motors[i]) == ESP_OK, "create");
+    }
+    TEST_CHECK(dshot_group_new(motors, 2, &group) == ESP_OK, "group");
+    // the group alone sends frames and queues commands of its motors
+    TEST_CHECK(dshot_send(motors[0]) == ESP_ERR_INVALID_STATE, "send of a motor in group");
+    TEST_CHECK(dshot_queue_command(motors[0], DShot_cmd_beacon1, 1, 0) == ESP_ERR_INVALID_STATE, "command in group");
+    const uint16_t thrust[2] = { 500, 1500 };
+    TEST_CHECK(dshot_group_update(group, thrust, 0x2) == ESP_OK, "group update");
+    TEST_CHECK(dshot_group_send(group) == ESP_OK, "group send");
+    for (uint32_t i = 0; i < 2; ++i) {
+        uint32_t packets[TEST_MAX_FRAMES] = { 0 };
+        const uint32_t num = test_decode(motors[i], false, packets, NULL);
+        const uint32_t expected = test_packet(thrust[i] + 47, i == 1, false);
+        TEST_CHECK(num == 1 && packets[0] == expected, "motor %u: %u frames, %04x, expected %04x", i, num, packets[0],
+                   expected);
+    }
+    // all or none: queue of motor 1 full, nothing queued for motor 0
+    for (uint32_t i = 0; i < DSHOT_CMD_QUEUE_LEN; ++i) {
+        TEST_CHECK(dshot_group_queue_command(group, 0x2, DShot_cmd_beacon1, 1, 0) == ESP_OK, "group command %u", i);
+    }
+    TEST_CHECK(dshot_group_queue_command(group, 0x3, DShot_cmd_beacon2, 1, 0) == ESP_ERR_NO_MEM, "queue full");
+    uint32_t pending[2] = { 0 };
+    dshot_get_commands_pending(motors[0], &pending[0]);
+    dshot_get_commands_pending(motors[1], &pending[1]);
+    TEST_CHECK(pending[0] == 0 && pending[1] == DSHOT_CMD_QUEUE_LEN, "pending %u %u", pending[0], pending[1]);
+    TEST_CHECK(dshot_group_del(group) == ESP_OK, "group delete");
+    TEST_CHECK(dshot_send(motors[0]) == ESP_OK, "send once out of group");
+    for (uint32_t i = 0; i < 2; ++i) {
+        dshot_del_pwe_sim(motors[i]);
+    }
+}
+
+static void test_continuous_stop(void)
+{
+    const rmt_config_t rmt_conf = RMT_DEFAULT_CONFIG_TX(4, RMT_CHANNEL_0);
+    const pwe_io_sim_config_t sim_conf = { 0 };
+    dshot_handle_t dshot = NULL;
+    dshot_handle_t other = NULL;
+    dshot_group_handle_t group = NULL;
+    TEST_CHECK(dshot_new_pwe_rmt(&s_conf, &rmt_conf, &dshot) == ESP_OK, "create");
+    TEST_CHECK(dshot_new_pwe_sim(&s_conf, &sim_conf, &other) == ESP_OK, "create");
+    TEST_CHECK(dshot_start_continuous(dshot) == ESP_OK, "start continuous");
+
+    // frame on the wire never ends: output still running after the stop timed out, nothing else may drive the motor
+    host_rmt_hold_tx(rmt_conf.channel, true);
+    TEST_CHECK(dshot_stop(dshot) == ESP_ERR_TIMEOUT, "stop of a hung output");
+    const dshot_output_config_t output_conf = DSHOT_OUTPUT_CONFIG_DEFAULT(1000);
+    TEST_CHECK(dshot_start_with_config(dshot, &output_conf) == ESP_ERR_INVALID_STATE, "periodic output after timeout");
+    TEST_CHECK(dshot_start_continuous(dshot) == ESP_ERR_INVALID_STATE, "continuous output after timeout");
+    TEST_CHECK(dshot_send(dshot) == ESP_ERR_INVALID_STATE, "send after timeout");
+    const dshot_handle_t motors[2] = { dshot, other };
+    TEST_CHECK(dshot_group_new(motors, 2, &group) == ESP_ERR_INVALID_STATE, "group after timeout");
+    TEST_CHECK(dshot_send(other) == ESP_OK, "other motor left out of the refused group");
+
+    // stop retried once the frame ends, then the motor is free again
+    host_rmt_hold_tx(rmt_conf.channel, false);
+    TEST_CHECK(dshot_stop(dshot) == ESP_OK, "retried stop");
+    TEST_CHECK(dshot_send(dshot) == ESP_OK, "send after stop");
+    TEST_CHECK(dshot_start_continuous(dshot) == ESP_OK, "restart");
+    TEST_CHECK(dshot_stop(dshot) == ESP_OK, "stop");
+    TEST_CHECK(dshot_del_pwe_rmt(dshot) == ESP_OK, "delete");
+    dshot_del_pwe_sim(other);
+}
+
+int main(void)
+{
+    test_throttle(false);
+    test_throttle(true);
+    test_gap();
+    test_commands(false);
+    test_commands(true);
+    test_group_member();
+    test_continuous_stop();
+    return TEST_RESULT();
+}
@@ -0,0 +1,249 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * eRPM decoder of bidirectional DShot against replies worked out by hand, captured the way RMT RX records them with
+ * pulse widths off by up to 1/4 bit, and captures to be rejected: bad checksum, codes not in GCR, too short and too
+ * long captures.
+ */
+
+#include <string.h>
+#include "dshot_erpm.h"
+#include "host_test.h"
+
+#define TEST_RESOLUTION_HZ  15000000
+#define TEST_BITRATE        600000      // DShot600, replies at 750kbit/s
+#define TEST_BIT_TICKS      20
+#define TEST_MAX_HALVES     32
+
+// duration | level << 15, one half of a RMT item
+#define TEST_HALF(level, ticks)     (((uint32_t)(level) << 15) | (uint32_t)(ticks))
+
+typedef struct {
+    uint32_t gcr;       // 20 GCR bits of the reply, start bit removed
+    uint32_t erpm;
+} test_reply_t;
+
+/*
+ * data 0x064 (period 100us), checksum 0xd: nibbles 0 6 4 d, GCR 11001 10110 11101 01101
+ * data 0xfff (stopped), checksum 0x0: nibbles f f f 0, GCR 01111 01111 01111 11001
+ * data 0x938 (period 312 << 4 = 4992us), checksum 0xd: nibbles 9 3 8 d, GCR 01001 10011 11010 01101
+ * data 0x001 (period 1us), checksum 0xe: nibbles 0 0 1 e, GCR 11001 11001 11011 11110
+ */
+static const test_reply_t s_replies[] = {
+    { 0xcdbad, 600000 },
+    { 0x7bdf9, 0 },
+    { 0x4cf4d, 12019 },
+    { 0xce76e, 60000000 },
+};
+
+/**
+ * @brief Lay the reply out as level runs: start bit going low, every 1 of GCR flipping the level
+ *
+ * @param lead_ticks: idle high in front of the start bit, 0 for none
+ * @param jitter: ticks added to even runs and taken from odd ones
+ * @param idle_ticks: idle high after the reply before the capture ends, 0 if it ends right with the reply
+ *
+ * @return number of halves
+ */
+static uint32_t test_reply_halves(uint32_t gcr, uint32_t lead_ticks, int32_t jitter, uint32_t idle_ticks, uint32_t *halves)
+{
+    uint32_t num = 0;
+    if (lead_ticks) {
+        halves[num++] = TEST_HALF(1, lead_ticks);
+    }
+    uint32_t level = 0;
+    uint32_t run = 1;
+    for (int i = 19; i >= 0; --i) {
+        if ((gcr >> i) & 1) {
+            halves[num] = TEST_HALF(level, run * TEST_BIT_TICKS + (num % 2 ? -jitter : jitter));
+            ++num;
+            level ^= 1;
+            run = 0;
+        }
+        ++run;
+    }
+    halves[num] = TEST_HALF(level, run * TEST_BIT_TICKS + (num % 2 ? -jitter : jitter));
+    ++num;
+    if (idle_ticks) {
+        if (level) {
+            halves[num - 1] += idle_ticks;
+        } else {
+            halves[num++] = TEST_HALF(1, idle_ticks);
+        }
+    }
+    return num;
+}
+
+/**
+ * @brief Pack halves into RMT items, the capture ending with a zero duration
+ *
+ * @return number of items
+ */
+static size_t test_pack(const uint32_t *halves, uint32_t num, uint32_t *items)
+{
+    memset(items, 0, TEST_MAX_HALVES / 2 * sizeof(uint32_t));
+    for (uint32_t i = 0; i < num; ++i) {
+        items[i / 2] |= halves[i] << ((i & 1) * 16);
+    }
+    return num / 2 + 1;
+}
+
+static void test_init(dshot_erpm_decoder_t *decoder)
+{
+    TEST_CHECK(dshot_erpm_decoder_init(decoder, TEST_RESOLUTION_HZ, TEST_BITRATE) == ESP_OK, "init");
+}
+
+static void test_decoder_init(void)
+{
+    dshot_erpm_decoder_t decoder;
+    test_init(&decoder);
+    TEST_CHECK(decoder.bits_per_tick_q16 == 65536 / TEST_BIT_TICKS, "bits per tick %u", decoder.bits_per_tick_q16);
+    // a reply bit shorter than a tick cannot be captured
+    TEST_CHECK(dshot_erpm_decoder_init(&decoder, 700000, TEST_BITRATE) == ESP_ERR_INVALID_ARG, "resolution too low");
+    TEST_CHECK(dshot_erpm_decoder_init(&decoder, TEST_RESOLUTION_HZ, 0) == ESP_ERR_INVALID_ARG, "no bitrate");
+}
+
+static void test_gcr(void)
+{
+    for (size_t r = 0; r < sizeof(s_replies) / sizeof(s_replies[0]); ++r) {
+        uint32_t erpm = 1;
+        TEST_CHECK(dshot_erpm_decode_gcr(s_replies[r].gcr, &erpm) == ESP_OK, "reply %zu", r);
+        TEST_CHECK(erpm == s_replies[r].erpm, "reply %zu: eRPM %u", r, erpm);
+    }
+}
+
+/**
+ * @brief Valid captures, with and without idle around the reply, pulses off by up to 1/4 bit
+ */
+static void test_valid(void)
+{
+    static const int32_t jitters[] = { 0, TEST_BIT_TICKS / 4, -TEST_BIT_TICKS / 4 };
+    dshot_erpm_decoder_t decoder;
+    test_init(&decoder);
+    for (size_t r = 0; r < sizeof(s_replies) / sizeof(s_replies[0]); ++r) {
+        for (size_t j = 0; j < sizeof(jitters) / sizeof(jitters[0]); ++j) {
+            for (uint32_t lead = 0; lead <= 1; ++lead) {
+                for (uint32_t idle = 0; idle <= 1; ++idle) {
+                    uint32_t halves[TEST_MAX_HALVES];
+                    uint32_t items[TEST_MAX_HALVES / 2];
+                    const uint32_t num = test_reply_halves(s_replies[r].gcr, lead * 3 * TEST_BIT_TICKS, jitters[j],
+                                                           idle * 5 * TEST_BIT_TICKS, halves);
+                    const size_t item_num = test_pack(halves, num, items);
+                    uint32_t erpm = 1;
+                    const esp_err_t ret = dshot_erpm_decode(&decoder, items, item_num, &erpm);
+                    TEST_CHECK(ret == ESP_OK, "reply %zu, jitter %d, lead %u, idle %u: %s", r, jitters[j], lead, idle,
+                               esp_err_to_name(ret));
+                    TEST_CHECK(erpm == s_replies[r].erpm, "reply %zu, jitter %d, lead %u, idle %u: eRPM %u", r,
+                               jitters[j], lead, idle, erpm);
+                }
+            }
+        }
+    }
+}
+
+static esp_err_t test_decode_gcr_capture(const dshot_erpm_decoder_t *decoder, uint32_t gcr)
+{
+    uint32_t halves[TEST_MAX_HALVES];
+    uint32_t items[TEST_MAX_HALVES / 2];
+    const uint32_t num = test_reply_halves(gcr, 0, 0, 5 * TEST_BIT_TICKS, halves);
+    uint32_t erpm = 0;
+    return dshot_erpm_decode(decoder, items, test_pack(halves, num, items), &erpm);
+}
+
+static void test_bad_crc(void)
+{
+    dshot_erpm_decoder_t decoder;
+    test_init(&decoder);
+    // 0x064d with checksum 0xc instead of 0xd, the last quintet being 11110
+    const uint32_t gcr = 0xcdbbe;
+    uint32_t erpm = 0;
+    TEST_CHECK(dshot_erpm_decode_gcr(gcr, &erpm) == ESP_ERR_INVALID_CRC, "GCR");
+    TEST_CHECK(test_decode_gcr_capture(&decoder, gcr) == ESP_ERR_INVALID_CRC, "capture");
+    // every single bit flipped is caught, either as checksum or as GCR error
+    for (int bit = 0; bit < 20; ++bit) {
+        const esp_err_t ret = dshot_erpm_decode_gcr(s_replies[0].gcr ^ (1u << bit), &erpm);
+        TEST_CHECK(ret == ESP_ERR_INVALID_CRC || ret == ESP_ERR_INVALID_RESPONSE, "bit %d flipped: %s", bit,
+                   esp_err_to_name(ret));
+    }
+}
+
+static void test_bad_gcr(void)
+{
+    dshot_erpm_decoder_t decoder;
+    test_init(&decoder);
+    // 11111 and 00000 are no GCR codes
+    const uint32_t gcr_ones = (s_replies[0].gcr & 0x7fff) | (0x1f << 15);
+    const uint32_t gcr_zeros = (s_replies[0].gcr & ~0x3e0) | (0x00 << 5);
+    uint32_t erpm = 0;
+    TEST_CHECK(dshot_erpm_decode_gcr(gcr_ones, &erpm) == ESP_ERR_INVALID_RESPONSE, "11111");
+    TEST_CHECK(dshot_erpm_decode_gcr(gcr_zeros, &erpm) == ESP_ERR_INVALID_RESPONSE, "00000");
+    TEST_CHECK(test_decode_gcr_capture(&decoder, gcr_ones) == ESP_ERR_INVALID_RESPONSE, "11111 capture");
+}
+
+static void test_short(void)
+{
+    dshot_erpm_decoder_t decoder;
+    test_init(&decoder);
+    uint32_t halves[TEST_MAX_HALVES];
+    uint32_t items[TEST_MAX_HALVES / 2];
+    uint32_t erpm = 0;
+    const uint32_t num = test_reply_halves(s_replies[0].gcr, 0, 0, 0, halves);
+    test_pack(halves, num, items);
+    TEST_CHECK(dshot_erpm_decode(&decoder, items, 0, &erpm) == ESP_ERR_INVALID_SIZE, "empty");
+    // capture cut in the middle of the reply, by item count or by a zero duration
+    TEST_CHECK(dshot_erpm_decode(&decoder, items, 3, &erpm) == ESP_ERR_INVALID_SIZE, "3 items");
+    TEST_CHECK(dshot_erpm_decode(&decoder, items, test_pack(halves, 6, items), &erpm) == ESP_ERR_INVALID_SIZE, "6 halves");
+    // only idle captured
+    halves[0] = TEST_HALF(1, 30 * TEST_BIT_TICKS);
+    TEST_CHECK(dshot_erpm_decode(&decoder, items, test_pack(halves, 1, items), &erpm) == ESP_ERR_INVALID_SIZE, "idle");
+    // a glitch shorter than half a bit
+    const uint32_t glitch_num = test_reply_halves(s_replies[0].gcr, 0, 0, 0, halves);
+    halves[2] = TEST_HALF(0, TEST_BIT_TICKS / 4);
+    TEST_CHECK(dshot_erpm_decode(&decoder, items, test_pack(halves, glitch_num, items), &erpm) == ESP_ERR_INVALID_SIZE,
+               "glitch");
+}
+
+static void test_long(void)
+{
+    dshot_erpm_decoder_t decoder;
+    test_init(&decoder);
+    uint32_t halves[TEST_MAX_HALVES];
+    uint32_t items[TEST_MAX_HALVES / 2];
+    uint32_t erpm = 0;
+    // line pulled low again after the reply, e.g. a second reply in the same capture
+    for (uint32_t r = 0; r < sizeof(s_replies) / sizeof(s_replies[0]); ++r) {
+        uint32_t num = test_reply_halves(s_replies[r].gcr, 0, 0, 5 * TEST_BIT_TICKS, halves);
+        halves[num++] = TEST_HALF(0, TEST_BIT_TICKS);
+        halves[num++] = TEST_HALF(1, 5 * TEST_BIT_TICKS);
+        TEST_CHECK(dshot_erpm_decode(&decoder, items, test_pack(halves, num, items), &erpm) == ESP_ERR_INVALID_SIZE,
+                   "reply %u followed by a pulse", r);
+    }
+    // low level lasting longer than a reply
+    halves[0] = TEST_HALF(0, 25 * TEST_BIT_TICKS);
+    halves[1] = TEST_HALF(1, 5 * TEST_BIT_TICKS);
+    TEST_CHECK(dshot_erpm_decode(&decoder, items, test_pack(halves, 2, items), &erpm) == ESP_ERR_INVALID_SIZE, "stuck low");
+    // runs adding up past the end of the reply with a low one
+    uint32_t num = test_reply_halves(s_replies[0].gcr, 0, 0, 0, halves);
+    if ((halves[num - 1] >> 15) == 0) {
+        halves[num - 1] += 4 * TEST_BIT_TICKS;
+    } else {
+        halves[num - 1] = TEST_HALF(0, 4 * TEST_BIT_TICKS);
+    }
+    TEST_CHECK(dshot_erpm_decode(&decoder, items, test_pack(halves, num, items), &erpm) == ESP_ERR_INVALID_SIZE, "long low run");
+}
+
+int main(void)
+{
+    test_decoder_init();
+    test_gcr();
+    test_valid();
+    test_bad_crc();
+    test_bad_gcr();
+    test_short();
+    test_long();
+    return TEST_RESULT();
+}
@@ -0,0 +1,46 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Every entry of the DShot frame table against the packet built here bit by bit, 2048 values with and without
+ * telemetry bit, as sent by normal DShot and once XORed with DSHOT_FRAME_CRC_MASK as bidirectional DShot sends it.
+ */
+
+#include "dshot_frames.h"
+#include "host_test.h"
+
+// 11 bits of value, telemetry bit, 4 bits of checksum: XOR of the three nibbles above it, inverted if bidirectional
+static uint16_t test_packet(uint32_t value, bool telemetry, bool bidirectional)
+{
+    const uint32_t data = (value << 1) | (telemetry ? 1 : 0);
+    uint32_t crc = 0;
+    for (uint32_t bit = 0; bit < 12; ++bit) {
+        crc ^= ((data >> bit) & 1) << (bit % 4);
+    }
+    if (bidirectional) {
+        crc ^= 0xf;
+    }
+    return (uint16_t)((data << 4) | crc);
+}
+
+int main(void)
+{
+    dshot_frames_init();
+    for (uint32_t value = 0; value < DSHOT_VALUE_NUM; ++value) {
+        for (uint32_t telemetry = 0; telemetry < 2; ++telemetry) {
+            for (uint32_t bidirectional = 0; bidirectional < 2; ++bidirectional) {
+                const uint16_t frame = DSHOT_FRAME(value, telemetry) ^ (bidirectional ? DSHOT_FRAME_CRC_MASK : 0);
+                // first byte in memory goes out first
+                const uint8_t *bytes = (const uint8_t *)&frame;
+                const uint16_t packet = (uint16_t)((bytes[0] << 8) | bytes[1]);
+                const uint16_t expected = test_packet(value, telemetry, bidirectional);
+                TEST_CHECK(packet == expected, "value %u telemetry %u bidir %u: %04x, expected %04x", value, telemetry,
+                           bidirectional, packet, expected);
+            }
+        }
+    }
+    return TEST_RESULT();
+}
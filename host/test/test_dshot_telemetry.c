@@ -0,0 +1,228 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * KISS / BLHeli32 telemetry parser against frames built with a bitwise CRC8: frames split across reads at every
+ * position, bad checksums, stray bytes in front of a reply, and resynchronisation after a corrupt frame.
+ */
+
+#include <string.h>
+#include "dshot_telemetry.h"
+#include "host_test.h"
+
+#define TEST_MOTORS     4
+#define TEST_TIMEOUT_US 2000
+
+static uint8_t test_crc8(const uint8_t *data, size_t len)
+{
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 0x80 ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Lay a reply out as the ESC sends it, big endian fields then CRC8
+ */
+static void test_frame(const dshot_telemetry_data_t *data, uint8_t *frame)
+{
+    frame[0] = data->temperature_c;
+    frame[1] = data->voltage_cv >> 8;
+    frame[2] = data->voltage_cv & 0xff;
+    frame[3] = data->current_ca >> 8;
+    frame[4] = data->current_ca & 0xff;
+    frame[5] = data->consumption_mah >> 8;
+    frame[6] = data->consumption_mah & 0xff;
+    frame[7] = (data->erpm / 100) >> 8;
+    frame[8] = (data->erpm / 100) & 0xff;
+    frame[9] = test_crc8(frame, DSHOT_TELEMETRY_FRAME_LEN - 1);
+}
+
+static bool test_data_equal(const dshot_telemetry_data_t *a, const dshot_telemetry_data_t *b)
+{
+    return a->temperature_c == b->temperature_c && a->voltage_cv == b->voltage_cv && a->current_ca == b->current_ca &&
+           a->consumption_mah == b->consumption_mah && a->erpm == b->erpm;
+}
+
+static const dshot_telemetry_data_t s_data[] = {
+    { .temperature_c = 42, .voltage_cv = 1620, .current_ca = 1234, .consumption_mah = 321, .erpm = 1234500 },
+    { .temperature_c = 0, .voltage_cv = 0, .current_ca = 0, .consumption_mah = 0, .erpm = 0 },
+    { .temperature_c = 255, .voltage_cv = 0xffff, .current_ca = 0xffff, .consumption_mah = 0xffff, .erpm = 6553500 },
+};
+
+/**
+ * @brief Bitwise CRC8 checked on a known value, then a whole frame decoded in place
+ */
+static void test_crc_reference(void)
+{
+    static const uint8_t one = 0x01;
+    TEST_CHECK(test_crc8(&one, 1) == 0x07, "CRC8 of 0x01: %02x", test_crc8(&one, 1));
+    uint8_t frame[DSHOT_TELEMETRY_FRAME_LEN];
+    test_frame(&s_data[0], frame);
+    dshot_telemetry_parser_t parser;
+    dshot_telemetry_parser_reset(&parser);
+    const uint8_t *p = frame;
+    size_t len = sizeof(frame);
+    dshot_telemetry_data_t out;
+    TEST_CHECK(dshot_telemetry_parse(&parser, &p, &len, &out) == ESP_OK, "whole frame");
+    TEST_CHECK(len == 0 && p == frame + sizeof(frame), "consumed %zu", sizeof(frame) - len);
+    TEST_CHECK(test_data_equal(&out, &s_data[0]), "fields");
+}
+
+/**
+ * @brief Frames split into two reads at every position, and fed byte by byte
+ */
+static void test_split(void)
+{
+    for (size_t d = 0; d < sizeof(s_data) / sizeof(s_data[0]); ++d) {
+        uint8_t frame[DSHOT_TELEMETRY_FRAME_LEN];
+        test_frame(&s_data[d], frame);
+        for (size_t split = 1; split < DSHOT_TELEMETRY_FRAME_LEN; ++split) {
+            dshot_telemetry_parser_t parser;
+            dshot_telemetry_parser_reset(&parser);
+            dshot_telemetry_data_t out;
+            const uint8_t *p = frame;
+            size_t len = split;
+            TEST_CHECK(dshot_telemetry_parse(&parser, &p, &len, &out) == ESP_ERR_NOT_FOUND, "data %zu, split %zu: first",
+                       d, split);
+            TEST_CHECK(len == 0, "data %zu, split %zu: first part left %zu", d, split, len);
+            len = DSHOT_TELEMETRY_FRAME_LEN - split;
+            TEST_CHECK(dshot_telemetry_parse(&parser, &p, &len, &out) == ESP_OK, "data %zu, split %zu: second", d, split);
+            TEST_CHECK(test_data_equal(&out, &s_data[d]), "data %zu, split %zu: fields", d, split);
+        }
+
+        dshot_telemetry_t telemetry;
+        TEST_CHECK(dshot_telemetry_init(&telemetry, TEST_MOTORS, TEST_TIMEOUT_US) == ESP_OK, "init");
+        TEST_CHECK(dshot_telemetry_request(&telemetry, 0) == 1u << 0, "request motor 0");
+        for (size_t i = 0; i < DSHOT_TELEMETRY_FRAME_LEN; ++i) {
+            dshot_telemetry_feed(&telemetry, &frame[i], 1);
+        }
+        dshot_telemetry_data_t out;
+        TEST_CHECK(dshot_telemetry_get(&telemetry, 0, &out) == ESP_OK, "data %zu: byte by byte", d);
+        TEST_CHECK(test_data_equal(&out, &s_data[d]), "data %zu: byte by byte fields", d);
+        TEST_CHECK(telemetry.stats.frames == 1 && telemetry.stats.crc_errors == 0, "data %zu: stats", d);
+    }
+}
+
+/**
+ * @brief Any corrupted byte is caught by CRC8, and the reply of the motor is not replaced
+ */
+static void test_bad_crc(void)
+{
+    uint8_t frame[DSHOT_TELEMETRY_FRAME_LEN];
+    test_frame(&s_data[0], frame);
+    for (size_t pos = 0; pos < DSHOT_TELEMETRY_FRAME_LEN; ++pos) {
+        dshot_telemetry_parser_t parser;
+        dshot_telemetry_parser_reset(&parser);
+        uint8_t bad[DSHOT_TELEMETRY_FRAME_LEN];
+        memcpy(bad, frame, sizeof(bad));
+        bad[pos] ^= 0x10;
+        dshot_telemetry_data_t out;
+        const uint8_t *p = bad;
+        size_t len = sizeof(bad);
+        TEST_CHECK(dshot_telemetry_parse(&parser, &p, &len, &out) == ESP_ERR_INVALID_CRC, "byte %zu, whole", pos);
+        TEST_CHECK(len == 0, "byte %zu: dropped frame consumed", pos);
+        // split on the same byte
+        p = bad;
+        len = pos ? pos : 1;
+        dshot_telemetry_parse(&parser, &p, &len, &out);
+        len = sizeof(bad) - (pos ? pos : 1);
+        TEST_CHECK(dshot_telemetry_parse(&parser, &p, &len, &out) == ESP_ERR_INVALID_CRC, "byte %zu, split", pos);
+    }
+
+    // a single motor on the wire is asked every round
+    dshot_telemetry_t telemetry;
+    TEST_CHECK(dshot_telemetry_init(&telemetry, 1, TEST_TIMEOUT_US) == ESP_OK, "init");
+    TEST_CHECK(dshot_telemetry_request(&telemetry, 0) == 1u << 0, "request motor 0");
+    dshot_telemetry_feed(&telemetry, frame, sizeof(frame));
+    TEST_CHECK(dshot_telemetry_request(&telemetry, 100) == 1u << 0, "motor 0 asked again");
+    uint8_t bad[DSHOT_TELEMETRY_FRAME_LEN];
+    test_frame(&s_data[1], bad);
+    bad[DSHOT_TELEMETRY_FRAME_LEN - 1] ^= 0xff;
+    dshot_telemetry_feed(&telemetry, bad, sizeof(bad));
+    dshot_telemetry_data_t out;
+    TEST_CHECK(dshot_telemetry_get(&telemetry, 0, &out) == ESP_OK && test_data_equal(&out, &s_data[0]),
+               "reply kept after a corrupt one");
+    TEST_CHECK(telemetry.stats.crc_errors == 1 && telemetry.stats.frames == 1, "stats %u crc errors, %u frames",
+               telemetry.stats.crc_errors, telemetry.stats.frames);
+    TEST_CHECK(!telemetry.pending, "corrupt reply ends the request");
+}
+
+/**
+ * @brief Bytes while nobody is asked are counted and dropped, they never become part of a reply
+ */
+static void test_stray(void)
+{
+    static const uint8_t noise[] = { 0x55, 0xaa, 0x00, 0xff, 0x12 };
+    uint8_t frame[DSHOT_TELEMETRY_FRAME_LEN];
+    test_frame(&s_data[0], frame);
+    dshot_telemetry_t telemetry;
+    TEST_CHECK(dshot_telemetry_init(&telemetry, TEST_MOTORS, TEST_TIMEOUT_US) == ESP_OK, "init");
+    dshot_telemetry_feed(&telemetry, noise, sizeof(noise));
+    TEST_CHECK(telemetry.stats.stray_bytes == sizeof(noise), "stray %u", telemetry.stats.stray_bytes);
+    dshot_telemetry_data_t out;
+    TEST_CHECK(dshot_telemetry_get(&telemetry, 0, &out) == ESP_ERR_NOT_FOUND, "no reply yet");
+
+    TEST_CHECK(dshot_telemetry_request(&telemetry, 0) == 1u << 0, "request motor 0");
+    dshot_telemetry_feed(&telemetry, frame, sizeof(frame));
+    TEST_CHECK(dshot_telemetry_get(&telemetry, 0, &out) == ESP_OK && test_data_equal(&out, &s_data[0]),
+               "reply after stray bytes");
+    // what follows the reply is stray as well
+    dshot_telemetry_feed(&telemetry, noise, 2);
+    TEST_CHECK(telemetry.stats.stray_bytes == sizeof(noise) + 2, "stray after reply %u", telemetry.stats.stray_bytes);
+    TEST_CHECK(telemetry.stats.frames == 1 && telemetry.stats.crc_errors == 0, "stats");
+}
+
+/**
+ * @brief A reply shifted by a stray leading byte fails, the next request starts from a clean parser
+ */
+static void test_resync(void)
+{
+    uint8_t frames[2][DSHOT_TELEMETRY_FRAME_LEN];
+    test_frame(&s_data[0], frames[0]);
+    test_frame(&s_data[2], frames[1]);
+    dshot_telemetry_t telemetry;
+    TEST_CHECK(dshot_telemetry_init(&telemetry, TEST_MOTORS, TEST_TIMEOUT_US) == ESP_OK, "init");
+
+    // motor 0: a glitch byte in front of the reply, all of it in one read
+    TEST_CHECK(dshot_telemetry_request(&telemetry, 0) == 1u << 0, "request motor 0");
+    uint8_t shifted[DSHOT_TELEMETRY_FRAME_LEN + 1] = { 0xf0 };
+    memcpy(&shifted[1], frames[0], DSHOT_TELEMETRY_FRAME_LEN);
+    dshot_telemetry_feed(&telemetry, shifted, sizeof(shifted));
+    TEST_CHECK(telemetry.stats.crc_errors == 1, "shifted reply %u crc errors", telemetry.stats.crc_errors);
+    TEST_CHECK(telemetry.stats.stray_bytes == 1, "last byte of shifted reply is stray, %u", telemetry.stats.stray_bytes);
+
+    // motor 1: the glitch byte and the first part of a reply, which times out
+    TEST_CHECK(dshot_telemetry_request(&telemetry, 100) == 1u << 1, "request motor 1");
+    dshot_telemetry_feed(&telemetry, shifted, 6);
+    TEST_CHECK(dshot_telemetry_request(&telemetry, 200) == 0, "motor 1 still expected");
+    TEST_CHECK(dshot_telemetry_request(&telemetry, 100 + TEST_TIMEOUT_US) == 1u << 2, "request motor 2 after timeout");
+    TEST_CHECK(telemetry.stats.timeouts == 1, "timeouts %u", telemetry.stats.timeouts);
+
+    // motor 2: its reply is not shifted by the partial one left in the parser
+    dshot_telemetry_feed(&telemetry, frames[1], 4);
+    dshot_telemetry_feed(&telemetry, &frames[1][4], DSHOT_TELEMETRY_FRAME_LEN - 4);
+    dshot_telemetry_data_t out;
+    TEST_CHECK(dshot_telemetry_get(&telemetry, 2, &out) == ESP_OK && test_data_equal(&out, &s_data[2]), "motor 2 reply");
+    TEST_CHECK(dshot_telemetry_get(&telemetry, 0, &out) == ESP_ERR_NOT_FOUND, "no reply of motor 0");
+    TEST_CHECK(dshot_telemetry_get(&telemetry, 1, &out) == ESP_ERR_NOT_FOUND, "no reply of motor 1");
+    TEST_CHECK(telemetry.stats.frames == 1 && telemetry.valid_mask == 1u << 2, "stats %u frames, mask %x",
+               telemetry.stats.frames, telemetry.valid_mask);
+}
+
+int main(void)
+{
+    test_crc_reference();
+    test_split();
+    test_bad_crc();
+    test_stray();
+    test_resync();
+    return TEST_RESULT();
+}
@@ -0,0 +1,437 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * LED strips on the simulated backend, waveform decoded back into bytes and checked against GRB bytes built here from
+ * the colors set: whole strip refreshed with WS2812 and SK6812 timing, no frame when nothing changed, every pixel
+ * format of led_strip_set_pixels() read from an unaligned source, in buffered and write-through mode, refresh after
+ * a change sending pixels up to the last changed one only, write-through strip sending the same waveform as a
+ * buffered one, bytes sent under known brightness and gamma pairs, group refresh starting members one after another
+ * when RMT TX sync group cannot be joined (host has the capabilities of ESP32).
+ */
+
+#include <string.h>
+#include "led_strip.h"
+#include "led_strip_pwe.h"
+#include "host_test.h"
+#include "test_sim.h"
+
+#define TEST_LED_NUM        64
+#define TEST_MAX_FRAMES     4
+
+typedef struct {
+    uint32_t num;                   // frames decoded
+    uint32_t len[TEST_MAX_FRAMES];  // bytes of each frame
+    uint8_t bytes[TEST_MAX_FRAMES][TEST_LED_NUM * 3];
+} test_frames_t;
+
+static led_strip_handle_t test_strip_new(const pwe_config_t *conf, uint32_t flags)
+{
+    led_strip_config strip_conf = *conf;
+    strip_conf.flags |= flags;
+    const pwe_io_sim_config_t sim_conf = { 0 };
+    led_strip_handle_t strip = NULL;
+    esp_err_t ret = led_strip_new_pwe_sim(&strip_conf, TEST_LED_NUM, &sim_conf, &strip);
+    TEST_CHECK(ret == ESP_OK, "create: %d", ret);
+    if (ret == ESP_OK) {
+        TEST_CHECK(led_strip_init(strip) == ESP_OK, "init");
+    }
+    return strip;
+}
+
+static void test_strip_del(led_strip_handle_t strip)
+{
+    TEST_CHECK(led_strip_deinit(strip) == ESP_OK, "deinit");
+    TEST_CHECK(led_strip_del_pwe_sim(strip) == ESP_OK, "delete");
+}
+
+/**
+ * @brief Decode frames sent since last clear into bytes, which must be whole
+ */
+static void test_decode(led_strip_handle_t strip, const pwe_config_t *conf, test_frames_t *out)
+{
+    static uint8_t bits[TEST_MAX_FRAMES * TEST_LED_NUM * 24];
+    test_sim_frame_t frames[TEST_MAX_FRAMES];
+    pwe_handle_t pwe = NULL;
+    led_strip_pwe_get_handle(strip, &pwe);
+    out->num = test_sim_decode(pwe, conf, false, bits, sizeof(bits), frames, TEST_MAX_FRAMES);
+    for (uint32_t i = 0; i < out->num; ++i) {
+        TEST_CHECK(frames[i].bits % 8 == 0 && frames[i].bits <= TEST_LED_NUM * 24, "frame %u: %u bits", i,
+                   frames[i].bits);
+        out->len[i] = frames[i].bits / 8;
+        for (uint32_t byte = 0; byte < out->len[i] && byte < TEST_LED_NUM * 3; ++byte) {
+            out->bytes[i][byte] = test_sim_bits_value(&bits[frames[i].first_bit + byte * 8], 8);
+        }
+    }
+}
+
+static void test_clear(led_strip_handle_t strip)
+{
+    pwe_handle_t pwe = NULL;
+    led_strip_pwe_get_handle(strip, &pwe);
+    pwe_sim_clear(pwe);
+}
+
+static void test_set_grb(led_strip_handle_t strip, uint8_t *grb, uint32_t index, uint32_t rgb)
+{
+    grb[index * 3 + 0] = (uint8_t)(rgb >> 8);
+    grb[index * 3 + 1] = (uint8_t)(rgb >> 16);
+    grb[index * 3 + 2] = (uint8_t)rgb;
+    TEST_CHECK(led_strip_set_pixel(strip, index, (rgb >> 16) & 0xff, (rgb >> 8) & 0xff, rgb & 0xff) == ESP_OK, "set");
+}
+
+/**
+ * @brief Refresh and check that the one frame sent holds the first pixels of grb, no frame at all for 0 pixels
+ */
+static void test_refresh_expect(led_strip_handle_t strip, const pwe_config_t *conf, const uint8_t *grb, uint32_t pixels)
+{
+    test_frames_t frames;
+    test_clear(strip);
+    TEST_CHECK(led_strip_refresh(strip, 100) == ESP_OK, "refresh");
+    test_decode(strip, conf, &frames);
+    if (pixels == 0) {
+        TEST_CHECK(frames.num == 0, "%u frames without change", frames.num);
+        return;
+    }
+    TEST_CHECK(frames.num == 1 && frames.len[0] == pixels * 3, "%u frames, %u bytes, expected %u pixels", frames.num,
+               frames.len[0], pixels);
+    TEST_CHECK(frames.num == 1 && memcmp(frames.bytes[0], grb, frames.len[0]) == 0, "pixels differ");
+}
+
+static void test_refresh(const pwe_config_t *conf, uint32_t *seed)
+{
+    led_strip_handle_t strip = test_strip_new(conf, 0);
+    uint8_t grb[TEST_LED_NUM * 3];
+    for (uint32_t i = 0; i < TEST_LED_NUM; ++i) {
+        test_set_grb(strip, grb, i, test_rand(seed));
+    }
+    test_refresh_expect(strip, conf, grb, TEST_LED_NUM);
+
+    // nothing changed, nothing sent
+    test_refresh_expect(strip, conf, grb, 0);
+    test_strip_del(strip);
+}
+
+static void test_dirty_range(const pwe_config_t *conf, uint32_t *seed)
+{
+    led_strip_handle_t strip = test_strip_new(conf, 0);
+    uint8_t grb[TEST_LED_NUM * 3];
+    for (uint32_t i = 0; i < TEST_LED_NUM; ++i) {
+        test_set_grb(strip, grb, i, test_rand(seed) | 1);
+    }
+    test_refresh_expect(strip, conf, grb, TEST_LED_NUM);
+
+    // one pixel changed: pixels behind it keep what they latched and are not sent
+    test_set_grb(strip, grb, 20, test_rand(seed) & ~1u);
+    test_refresh_expect(strip, conf, grb, 21);
+    // range spans from the first to the last changed pixel, re-encoded in place
+    test_set_grb(strip, grb, 40, test_rand(seed) & ~1u);
+    test_set_grb(strip, grb, 5, test_rand(seed) & ~1u);
+    test_refresh_expect(strip, conf, grb, 41);
+    // pixel set to the color it has is no change
+    test_set_grb(strip, grb, 50, (grb[50 * 3 + 1] << 16) | (grb[50 * 3] << 8) | grb[50 * 3 + 2]);
+    test_refresh_expect(strip, conf, grb, 0);
+    // last pixel changed: whole strip, earlier partial encodes kept in the outgoing buffer
+    test_set_grb(strip, grb, TEST_LED_NUM - 1, test_rand(seed) & ~1u);
+    test_refresh_expect(strip, conf, grb, TEST_LED_NUM);
+    test_strip_del(strip);
+}
+
+/**
+ * @brief Check that two strips recorded the same edges, up to the number of edges of the first one
+ */
+static void test_same_edges(led_strip_handle_t strip, led_strip_handle_t other, bool whole, const char *step)
+{
+    pwe_handle_t pwe[2] = { NULL };
+    const pwe_sim_edge_t *edges[2] = { NULL };
+    uint32_t num[2] = { 0 };
+    led_strip_pwe_get_handle(strip, &pwe[0]);
+    led_strip_pwe_get_handle(other, &pwe[1]);
+    for (uint32_t i = 0; i < 2; ++i) {
+        pwe_sim_get_edges(pwe[i], &edges[i], &num[i], NULL);
+    }
+    TEST_CHECK(num[0] > 0 && (whole ? num[0] == num[1] : num[0] <= num[1]), "%s: %u edges against %u", step, num[0],
+               num[1]);
+    for (uint32_t i = 0; i < num[0] && i < num[1]; ++i) {
+        if (edges[0][i].time_ns != edges[1][i].time_ns || edges[0][i].level != edges[1][i].level) {
+            TEST_CHECK(false, "%s: edge %u differs", step, i);
+            break;
+        }
+    }
+}
+
+static void test_write_through(const pwe_config_t *conf, uint32_t *seed)
+{
+    // strips[0] buffered, strips[1] write-through, given the same calls
+    led_strip_handle_t strips[2] = { test_strip_new(conf, 0), test_strip_new(conf, LED_STRIP_PWE_FLAG_WRITE_THROUGH) };
+    uint8_t grb[TEST_LED_NUM * 3];
+    uint8_t rgb[TEST_LED_NUM * 3];
+    for (uint32_t i = 0; i < sizeof(rgb); ++i) {
+        rgb[i] = (uint8_t)test_rand(seed);
+    }
+    for (uint32_t s = 0; s < 2; ++s) {
+        test_clear(strips[s]);
+        for (uint32_t i = 0; i < TEST_LED_NUM / 2; ++i) {
+            test_set_grb(strips[s], grb, i, (rgb[i * 3] << 16) | (rgb[i * 3 + 1] << 8) | rgb[i * 3 + 2]);
+        }
+        TEST_CHECK(led_strip_set_pixels(strips[s], TEST_LED_NUM / 2, TEST_LED_NUM / 2, &rgb[TEST_LED_NUM / 2 * 3],
+                                        LED_PIXEL_FORMAT_RGB888) == ESP_OK, "set pixels");
+        TEST_CHECK(led_strip_refresh(strips[s], 100) == ESP_OK, "refresh");
+    }
+    test_same_edges(strips[0], strips[1], true, "whole strip");
+
+    // buffered strip stops at the last change, write-through one sends all pixels: the same waveform up to there
+    for (uint32_t s = 0; s < 2; ++s) {
+        test_clear(strips[s]);
+        test_set_grb(strips[s], grb, 10, 0x123456);
+        TEST_CHECK(led_strip_refresh(strips[s], 100) == ESP_OK, "refresh");
+    }
+    test_same_edges(strips[0], strips[1], false, "one pixel changed");
+
+    for (uint32_t s = 0; s < 2; ++s) {
+        test_clear(strips[s]);
+        TEST_CHECK(led_strip_clear(strips[s], 100) == ESP_OK, "clear");
+    }
+    test_same_edges(strips[0], strips[1], true, "cleared");
+    test_frames_t frames;
+    test_decode(strips[1], conf, &frames);
+    memset(grb, 0, sizeof(grb));
+    TEST_CHECK(frames.num == 1 && frames.len[0] == sizeof(grb) && memcmp(frames.bytes[0], grb, sizeof(grb)) == 0,
+               "cleared: %u frames", frames.num);
+    test_strip_del(strips[0]);
+    test_strip_del(strips[1]);
+}
+
+#define TEST_LEVEL_NUM  7
+
+static const uint8_t s_levels[TEST_LEVEL_NUM] = { 0, 1, 16, 64, 128, 200, 255 };
+
+/*
+ * s_levels sent with brightness and gamma, worked out as round((v / 255) ^ gamma * brightness):
+ * 1.0, 128: 0 0.502 8.03 32.13 64.25 100.39 128
+ * 2.2, 128: 0 0.0006 0.29 6.12 28.10 75.00 128
+ * 2.2, 255: 0 0.0013 0.58 12.18 55.98 149.42 255
+ */
+static const struct {
+    uint8_t brightness;
+    float gamma;
+    uint8_t levels[TEST_LEVEL_NUM];
+} s_corrections[] = {
+    { 255, 1.0f, { 0, 1, 16, 64, 128, 200, 255 } },
+    { 128, 1.0f, { 0, 1, 8, 32, 64, 100, 128 } },
+    { 128, 2.2f, { 0, 0, 0, 6, 28, 75, 128 } },
+    { 255, 2.2f, { 0, 0, 1, 12, 56, 149, 255 } },
+    { 255, 1.0f, { 0, 1, 16, 64, 128, 200, 255 } },
+};
+
+/**
+ * @brief Set the first pixels to all levels on each channel, and fill grb with what is expected on the wire
+ */
+static void test_set_levels(led_strip_handle_t strip, const uint8_t *levels, uint8_t *grb)
+{
+    memset(grb, 0, TEST_LED_NUM * 3);
+    for (uint32_t i = 0; i < TEST_LEVEL_NUM; ++i) {
+        const uint32_t r = (i + 0) % TEST_LEVEL_NUM;
+        const uint32_t g = (i + 1) % TEST_LEVEL_NUM;
+        const uint32_t b = (i + 2) % TEST_LEVEL_NUM;
+        if (strip != NULL) {
+            TEST_CHECK(led_strip_set_pixel(strip, i, s_levels[r], s_levels[g], s_levels[b]) == ESP_OK, "set");
+        }
+        grb[i * 3 + 0] = levels[g];
+        grb[i * 3 + 1] = levels[r];
+        grb[i * 3 + 2] = levels[b];
+    }
+}
+
+static void test_brightness_gamma(const pwe_config_t *conf)
+{
+    uint8_t grb[TEST_LED_NUM * 3];
+    // buffered: colors are kept, each change is applied to the whole strip on next refresh
+    led_strip_handle_t strip = test_strip_new(conf, 0);
+    for (uint32_t i = 0; i < sizeof(s_corrections) / sizeof(s_corrections[0]); ++i) {
+        test_set_levels(i == 0 ? strip : NULL, s_corrections[i].levels, grb);
+        TEST_CHECK(led_strip_pwe_set_brightness(strip, s_corrections[i].brightness) == ESP_OK, "brightness");
+        TEST_CHECK(led_strip_pwe_set_gamma(strip, s_corrections[i].gamma) == ESP_OK, "gamma");
+        test_refresh_expect(strip, conf, grb, TEST_LED_NUM);
+    }
+    TEST_CHECK(led_strip_pwe_set_gamma(strip, 0.0f) == ESP_ERR_INVALID_ARG, "gamma 0");
+    test_strip_del(strip);
+
+    // write-through: applied to pixels set afterwards only
+    strip = test_strip_new(conf, LED_STRIP_PWE_FLAG_WRITE_THROUGH);
+    TEST_CHECK(led_strip_pwe_set_brightness(strip, 128) == ESP_OK, "brightness");
+    TEST_CHECK(led_strip_pwe_set_gamma(strip, 2.2f) == ESP_OK, "gamma");
+    test_set_levels(strip, s_corrections[2].levels, grb);
+    TEST_CHECK(led_strip_pwe_set_brightness(strip, 255) == ESP_OK, "brightness");
+    test_refresh_expect(strip, conf, grb, TEST_LED_NUM);
+    test_strip_del(strip);
+}
+
+static void test_group_refresh(const pwe_config_t *conf, uint32_t *seed)
+{
+    // simulated strips never join a sync group: every member sends what changed, unchanged ones nothing
+    led_strip_handle_t strips[3];
+    uint8_t grb[3][TEST_LED_NUM * 3];
+    for (uint32_t s = 0; s < 3; ++s) {
+        strips[s] = test_strip_new(conf, 0);
+        for (uint32_t i = 0; i < TEST_LED_NUM; ++i) {
+            test_set_grb(strips[s], grb[s], i, test_rand(seed) | 1);
+        }
+    }
+    const uint32_t pixels[2][3] = { { TEST_LED_NUM, TEST_LED_NUM, TEST_LED_NUM }, { 0, 8, 0 } };
+    for (uint32_t round = 0; round < 2; ++round) {
+        if (round == 1) {
+            test_set_grb(strips[1], grb[1], 7, test_rand(seed) & ~1u);
+        }
+        for (uint32_t s = 0; s < 3; ++s) {
+            test_clear(strips[s]);
+        }
+        TEST_CHECK(led_strip_group_refresh(strips, 3, 100) == ESP_OK, "group refresh");
+        for (uint32_t s = 0; s < 3; ++s) {
+            test_frames_t frames;
+            const uint32_t len = pixels[round][s] * 3;
+            test_decode(strips[s], conf, &frames);
+            TEST_CHECK(frames.num == (len != 0 ? 1 : 0), "round %u strip %u: %u frames", round, s, frames.num);
+            TEST_CHECK(frames.num == 0 || (frames.len[0] == len && memcmp(frames.bytes[0], grb[s], len) == 0),
+                       "round %u strip %u: %u bytes, expected %u", round, s, frames.len[0], len);
+        }
+    }
+
+    // two RMT strips try to join the sync group, which ESP32 does not have: all members are started one by one
+    const rmt_config_t rmt_conf[2] = { RMT_DEFAULT_CONFIG_TX(4, RMT_CHANNEL_0), RMT_DEFAULT_CONFIG_TX(5, RMT_CHANNEL_1) };
+    led_strip_handle_t mixed[3] = { NULL, NULL, strips[0] };
+    uint8_t rmt_grb[TEST_LED_NUM * 3];
+    for (uint32_t s = 0; s < 2; ++s) {
+        TEST_CHECK(led_strip_new_pwe_rmt(conf, TEST_LED_NUM, &rmt_conf[s], &mixed[s]) == ESP_OK, "rmt strip");
+        TEST_CHECK(led_strip_init(mixed[s]) == ESP_OK, "init");
+        test_set_grb(mixed[s], rmt_grb, 0, test_rand(seed));
+    }
+    test_set_grb(strips[0], grb[0], TEST_LED_NUM - 1, test_rand(seed) & ~1u);
+    test_clear(strips[0]);
+    TEST_CHECK(led_strip_group_refresh(mixed, 3, 100) == ESP_OK, "mixed group refresh");
+    for (uint32_t s = 0; s < 3; ++s) {
+        const led_strip_pwe_t *ws2812 = __containerof(mixed[s], led_strip_pwe_t, parent);
+        TEST_CHECK(ws2812->rmt_backend == (s < 2), "strip %u: backend", s);
+        TEST_CHECK(!ws2812->in_sync_group && !ws2812->pending && ws2812->dirty_end <= ws2812->dirty_start,
+                   "strip %u: sync group %d, pending %d, dirty %u~%u", s, ws2812->in_sync_group, ws2812->pending,
+                   ws2812->dirty_start, ws2812->dirty_end);
+    }
+    test_frames_t frames;
+    test_decode(strips[0], conf, &frames);
+    TEST_CHECK(frames.num == 1 && frames.len[0] == sizeof(grb[0]) && memcmp(frames.bytes[0], grb[0], sizeof(grb[0])) == 0,
+               "simulated member of mixed group: %u frames", frames.num);
+    for (uint32_t s = 0; s < 2; ++s) {
+        TEST_CHECK(led_strip_deinit(mixed[s]) == ESP_OK, "deinit");
+        TEST_CHECK(led_strip_del_pwe_rmt(mixed[s]) == ESP_OK, "delete");
+    }
+
+    TEST_CHECK(led_strip_group_refresh(NULL, 0, 100) == ESP_OK, "empty group");
+    TEST_CHECK(led_strip_group_refresh(NULL, 1, 100) == ESP_ERR_INVALID_ARG, "NULL strips");
+    for (uint32_t s = 0; s < 3; ++s) {
+        test_strip_del(strips[s]);
+    }
+}
+
+// 5 or 6 bits channel to 8 bits, high bits repeated below so that full scale is 0xff
+static uint8_t test_expand(uint32_t value, uint32_t bits)
+{
+    return (uint8_t)((value << (8 - bits)) | (value >> (2 * bits - 8)));
+}
+
+/**
+ * @brief GRB bytes of a source pixel, worked out from the layout documented for each format
+ */
+static void test_pixel_grb(const uint8_t *src, led_pixel_format_t format, uint8_t *grb)
+{
+    switch (format) {
+    case LED_PIXEL_FORMAT_RGB888:
+    case LED_PIXEL_FORMAT_RGBA8888:
+        grb[0] = src[1];
+        grb[1] = src[0];
+        grb[2] = src[2];
+        break;
+    case LED_PIXEL_FORMAT_BGR888:
+        grb[0] = src[1];
+        grb[1] = src[2];
+        grb[2] = src[0];
+        break;
+    case LED_PIXEL_FORMAT_RGB565: {
+        // little endian: low byte first
+        const uint32_t px = src[0] + src[1] * 256u;
+        grb[0] = test_expand((px >> 5) & 0x3f, 6);
+        grb[1] = test_expand(px >> 11, 5);
+        grb[2] = test_expand(px & 0x1f, 5);
+        break;
+    }
+    }
+}
+
+static void test_set_pixels(const pwe_config_t *conf, uint32_t flags, uint32_t *seed)
+{
+    static const struct {
+        led_pixel_format_t format;
+        uint32_t size;
+    } s_formats[] = {
+        { LED_PIXEL_FORMAT_RGB888, 3 },
+        { LED_PIXEL_FORMAT_BGR888, 3 },
+        { LED_PIXEL_FORMAT_RGBA8888, 4 },
+        { LED_PIXEL_FORMAT_RGB565, 2 },
+    };
+    // more than one write-through blit, leaving pixels off on both ends
+    const uint32_t start = 3;
+    const uint32_t count = TEST_LED_NUM - 7;
+    for (uint32_t f = 0; f < sizeof(s_formats) / sizeof(s_formats[0]); ++f) {
+        const led_pixel_format_t format = s_formats[f].format;
+        led_strip_handle_t strip = test_strip_new(conf, flags);
+        // one byte off, so that no pixel of any format is aligned
+        uint8_t src[TEST_LED_NUM * 4 + 1];
+        for (uint32_t i = 0; i < sizeof(src); ++i) {
+            src[i] = (uint8_t)test_rand(seed);
+        }
+        uint8_t grb[TEST_LED_NUM * 3] = { 0 };
+        for (uint32_t i = 0; i < count; ++i) {
+            test_pixel_grb(&src[1 + i * s_formats[f].size], format, &grb[(start + i) * 3]);
+        }
+        TEST_CHECK(led_strip_set_pixels(strip, start, count, &src[1], format) == ESP_OK, "format %d", format);
+        TEST_CHECK(led_strip_refresh(strip, 100) == ESP_OK, "refresh");
+        test_frames_t frames;
+        test_decode(strip, conf, &frames);
+        TEST_CHECK(frames.num == 1 && frames.len[0] == sizeof(grb), "format %d flags %x: %u frames, %u bytes", format,
+                   flags, frames.num, frames.len[0]);
+        for (uint32_t i = 0; frames.num == 1 && i < TEST_LED_NUM; ++i) {
+            TEST_CHECK(memcmp(&frames.bytes[0][i * 3], &grb[i * 3], 3) == 0,
+                       "format %d flags %x pixel %u: %02x%02x%02x, expected %02x%02x%02x", format, flags, i,
+                       frames.bytes[0][i * 3], frames.bytes[0][i * 3 + 1], frames.bytes[0][i * 3 + 2], grb[i * 3],
+                       grb[i * 3 + 1], grb[i * 3 + 2]);
+        }
+        test_strip_del(strip);
+    }
+
+    led_strip_handle_t strip = test_strip_new(conf, flags);
+    uint8_t src[8] = { 0 };
+    TEST_CHECK(led_strip_set_pixels(strip, 0, 1, src, (led_pixel_format_t)(LED_PIXEL_FORMAT_RGB565 + 1)) ==
+               ESP_ERR_INVALID_ARG, "unknown format");
+    TEST_CHECK(led_strip_set_pixels(strip, TEST_LED_NUM - 1, 2, src, LED_PIXEL_FORMAT_RGB565) == ESP_ERR_INVALID_ARG,
+               "out of strip");
+    test_strip_del(strip);
+}
+
+int main(void)
+{
+    const pwe_config_t ws2812 = PWE_WS2812_CONFIG;
+    const pwe_config_t sk6812 = PWE_SK6812_CONFIG;
+    uint32_t seed = 1;
+    test_refresh(&ws2812, &seed);
+    test_refresh(&sk6812, &seed);
+    test_set_pixels(&ws2812, 0, &seed);
+    test_set_pixels(&ws2812, LED_STRIP_PWE_FLAG_WRITE_THROUGH, &seed);
+    test_dirty_range(&ws2812, &seed);
+    test_write_through(&ws2812, &seed);
+    test_write_through(&sk6812, &seed);
+    test_brightness_gamma(&ws2812);
+    test_group_refresh(&ws2812, &seed);
+    return TEST_RESULT();
+}
@@ -0,0 +1,122 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * RMT backend against the bit by bit conversion it replaced: random payloads of any bit length, with and without
+ * byte table, one and two outgoing buffers, and in place updates of random byte ranges of a frame.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pwe.h"
+#include "pwe_io_rmt.h"
+#include "pwe_timing.h"
+#include "led_strip_pwe.h"
+#include "dshot.h"
+#include "host_test.h"
+#include "pwe_reference.h"
+
+#define TEST_MAX_BITS       (24 * 64)
+#define TEST_ROUNDS         200
+
+typedef struct {
+    const char *name;
+    pwe_config_t config;
+    uint8_t clk_div;
+} test_preset_t;
+
+static const test_preset_t s_presets[] = {
+    { "WS2812", PWE_WS2812_CONFIG, 2 },
+    { "SK6812", PWE_SK6812_CONFIG, 4 },
+    { "DShot150", PWE_DSHOT150_CONFIG, 8 },
+    { "DShot300", PWE_DSHOT300_CONFIG, 1 },
+    { "DShot600", PWE_DSHOT600_CONFIG, 4 },
+    { "DShot1200", PWE_DSHOT1200_CONFIG, 2 },
+};
+
+static uint8_t s_frame[TEST_MAX_BITS / 8];
+static uint8_t s_mapped[TEST_MAX_BITS / 8];
+static rmt_item32_t s_expected[TEST_MAX_BITS];
+static uint8_t s_lut[256];
+
+/**
+ * @brief Compare the outgoing buffer with the reference conversion of len bits of s_mapped
+ */
+static void test_compare(const char *name, pwe_handle_t pwe, const pwe_timing_t *timing, uint32_t len, const char *what)
+{
+    const rmt_item32_t *items = NULL;
+    uint32_t tick_hz = 0;
+    TEST_CHECK(pwe_rmt_get_outgoing_buffer(pwe, &items, &tick_hz) == ESP_OK, "%s", name);
+    pwe_ref_rmt_convert(timing, s_mapped, len, s_expected);
+    uint32_t diff = 0;
+    while (diff < len && items[diff].val == s_expected[diff].val) {
+        ++diff;
+    }
+    TEST_CHECK(diff == len, "%s %s: %u bits, item %u is 0x%08x instead of 0x%08x", name, what, len, diff,
+               diff < len ? items[diff].val : 0, diff < len ? s_expected[diff].val : 0);
+}
+
+static void test_preset(const test_preset_t *preset, uint32_t flags, uint32_t seed)
+{
+    rmt_config_t rmt_conf = RMT_DEFAULT_CONFIG_TX(18, RMT_CHANNEL_0);
+    rmt_conf.clk_div = preset->clk_div;
+    pwe_config_t config = preset->config;
+    config.flags = flags;
+    char name[48];
+    snprintf(name, sizeof(name), "%s/div%u%s", preset->name, preset->clk_div, flags ? "/double" : "");
+    pwe_handle_t pwe = NULL;
+    TEST_CHECK(pwe_new_rmt_backend(&config, &rmt_conf, TEST_MAX_BITS, &pwe) == ESP_OK, "%s", name);
+    if (pwe == NULL) {
+        return;
+    }
+    pwe_timing_t timing;
+    TEST_CHECK(pwe_get_timing(pwe, &timing) == ESP_OK, "%s", name);
+
+    for (uint32_t round = 0; round < TEST_ROUNDS; ++round) {
+        const uint32_t len = 1 + test_rand(&seed) % TEST_MAX_BITS;
+        for (uint32_t i = 0; i < sizeof(s_frame); ++i) {
+            s_frame[i] = test_rand(&seed);
+        }
+        const bool use_lut = round % 2;
+        for (uint32_t i = 0; i < 256; ++i) {
+            s_lut[i] = (i * 13 + round) & 0xff;
+        }
+        pwe_set_byte_lut(pwe, use_lut ? s_lut : NULL);
+        for (uint32_t i = 0; i < sizeof(s_frame); ++i) {
+            s_mapped[i] = use_lut ? s_lut[s_frame[i]] : s_frame[i];
+        }
+        uint32_t out_len = 0;
+        TEST_CHECK(pwe_io_convert_buffer(pwe, s_frame, len, &out_len) == ESP_OK, "%s", name);
+        TEST_CHECK(out_len == len, "%s: %u bits give %u items", name, len, out_len);
+        test_compare(name, pwe, &timing, len, use_lut ? "convert_buffer with lut" : "convert_buffer");
+    }
+    pwe_set_byte_lut(pwe, NULL);
+
+    uint32_t out_len = 0;
+    TEST_CHECK(pwe_io_convert_buffer(pwe, s_frame, TEST_MAX_BITS, &out_len) == ESP_OK, "%s", name);
+    for (uint32_t round = 0; round < TEST_ROUNDS; ++round) {
+        const uint32_t offset = test_rand(&seed) % sizeof(s_frame);
+        const uint32_t bytes = 1 + test_rand(&seed) % (sizeof(s_frame) - offset);
+        for (uint32_t i = offset; i < offset + bytes; ++i) {
+            s_frame[i] = test_rand(&seed);
+        }
+        TEST_CHECK(pwe_io_convert_range(pwe, &s_frame[offset], offset * 8, bytes * 8, &out_len) == ESP_OK, "%s", name);
+        TEST_CHECK(out_len == (offset + bytes) * 8, "%s: range [%u, %u) gives %u items", name, offset, offset + bytes,
+                   out_len);
+        memcpy(s_mapped, s_frame, sizeof(s_frame));
+        test_compare(name, pwe, &timing, TEST_MAX_BITS, "convert_range");
+    }
+    pwe_delete_rmt_backend(pwe);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(s_presets) / sizeof(s_presets[0]); ++i) {
+        test_preset(&s_presets[i], 0, 0x5eed + i);
+        test_preset(&s_presets[i], PWE_FLAG_DOUBLE_BUFFER, 0xbeef + i);
+    }
+    return TEST_RESULT();
+}
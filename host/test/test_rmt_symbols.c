@@ -0,0 +1,176 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * RMT symbol encoder against symbols worked out by hand: WS2812 at 20MHz where every pulse is a whole number of ticks,
+ * known payloads, partial last bytes, TRST split over several symbols, and resuming at any position.
+ */
+
+#include <string.h>
+#include "pwe_rmt_symbols.h"
+#include "led_strip_pwe.h"
+#include "host_test.h"
+
+#define TEST_SRC_HZ         80000000
+#define TEST_RESOLUTION_HZ  20000000
+#define TEST_MAX_SYMBOLS    64
+
+// duration0 | level0 << 15 | duration1 << 16 | level1 << 31
+#define TEST_SYMBOL(d0, l0, d1, l1) ((uint32_t)(d0) | ((uint32_t)(l0) << 15) | ((uint32_t)(d1) << 16) | ((uint32_t)(l1) << 31))
+
+// WS2812 at 20MHz: T1H 800ns, T1L 450ns, T0H 400ns, T0L 850ns
+#define TEST_SYM1           TEST_SYMBOL(16, 1, 9, 0)
+#define TEST_SYM0           TEST_SYMBOL(8, 1, 17, 0)
+
+static const pwe_config_t s_ws2812 = PWE_WS2812_CONFIG;
+
+/**
+ * @brief Encode a whole transmission chunk by chunk
+ *
+ * @return symbols written
+ */
+static size_t test_encode(const pwe_rmt_symbols_t *symbols, const uint8_t *data, size_t chunk, uint32_t *out)
+{
+    size_t written = 0;
+    bool done = false;
+    while (!done && written < TEST_MAX_SYMBOLS) {
+        const size_t n = pwe_rmt_symbols_encode(symbols, data, written, chunk, out + written, &done);
+        TEST_CHECK(n > 0 || done, "no progress at %zu", written);
+        if (n == 0) {
+            break;
+        }
+        written += n;
+    }
+    return written;
+}
+
+static void test_init(pwe_rmt_symbols_t *symbols, const pwe_config_t *config)
+{
+    pwe_timing_t timing;
+    TEST_CHECK(pwe_rmt_symbols_init(symbols, config, TEST_SRC_HZ, TEST_RESOLUTION_HZ, &timing) == ESP_OK, "init");
+    TEST_CHECK(timing.div == TEST_SRC_HZ / TEST_RESOLUTION_HZ && timing.clock_hz == TEST_RESOLUTION_HZ, "div %u",
+               timing.div);
+}
+
+static void test_bit_symbols(void)
+{
+    pwe_rmt_symbols_t symbols;
+    test_init(&symbols, &s_ws2812);
+    TEST_CHECK(symbols.bit_symbols[0] == TEST_SYM0, "logical 0 %08x", symbols.bit_symbols[0]);
+    TEST_CHECK(symbols.bit_symbols[1] == TEST_SYM1, "logical 1 %08x", symbols.bit_symbols[1]);
+    TEST_CHECK(symbols.reset_ticks == 1000, "TRST %u ticks", symbols.reset_ticks);
+}
+
+/**
+ * @brief Known payloads of any bit length, encoded at once and chunk by chunk
+ */
+static void test_payload(void)
+{
+    static const uint8_t data[] = { 0xa5, 0x0f, 0x80 };
+    static const uint32_t expected[] = {
+        TEST_SYM1, TEST_SYM0, TEST_SYM1, TEST_SYM0, TEST_SYM0, TEST_SYM1, TEST_SYM0, TEST_SYM1,     // 0xa5
+        TEST_SYM0, TEST_SYM0, TEST_SYM0, TEST_SYM0, TEST_SYM1, TEST_SYM1, TEST_SYM1, TEST_SYM1,     // 0x0f
+        TEST_SYM1, TEST_SYM0, TEST_SYM0, TEST_SYM0, TEST_SYM0, TEST_SYM0, TEST_SYM0, TEST_SYM0,     // 0x80
+    };
+    pwe_rmt_symbols_t symbols;
+    test_init(&symbols, &s_ws2812);
+    // whole bytes, and partial last bytes taking only their MSBits
+    for (uint32_t bits = 1; bits <= sizeof(data) * 8; ++bits) {
+        symbols.payload_bits = bits;
+        TEST_CHECK(pwe_rmt_symbols_total(&symbols) == bits, "%u bits: total %zu", bits, pwe_rmt_symbols_total(&symbols));
+        for (size_t chunk = 1; chunk <= 10; ++chunk) {
+            uint32_t out[TEST_MAX_SYMBOLS];
+            memset(out, 0xff, sizeof(out));
+            const size_t written = test_encode(&symbols, data, chunk, out);
+            TEST_CHECK(written == bits, "%u bits, chunk %zu: %zu symbols", bits, chunk, written);
+            TEST_CHECK(memcmp(out, expected, bits * sizeof(uint32_t)) == 0, "%u bits, chunk %zu: symbols differ", bits,
+                       chunk);
+            TEST_CHECK(out[bits] == 0xffffffff, "%u bits, chunk %zu: written past the end", bits, chunk);
+        }
+    }
+}
+
+static void test_byte_lut(void)
+{
+    static const uint8_t data[] = { 0x01 };
+    uint8_t lut[256];
+    for (int i = 0; i < 256; ++i) {
+        lut[i] = ~i;
+    }
+    pwe_rmt_symbols_t symbols;
+    test_init(&symbols, &s_ws2812);
+    symbols.byte_lut = lut;
+    symbols.payload_bits = 8;
+    uint32_t out[TEST_MAX_SYMBOLS];
+    test_encode(&symbols, data, 8, out);
+    for (int i = 0; i < 8; ++i) {
+        TEST_CHECK(out[i] == (i < 7 ? TEST_SYM1 : TEST_SYM0), "table, symbol %d %08x", i, out[i]);
+    }
+}
+
+/**
+ * @brief TRST following the payload, low on both halves, split into symbols of at most 2 * 0x7fff ticks
+ */
+static void test_reset(void)
+{
+    static const uint8_t data[] = { 0xff };
+    pwe_rmt_symbols_t symbols;
+    test_init(&symbols, &s_ws2812);
+    symbols.payload_bits = 3;
+    symbols.with_reset = true;
+    TEST_CHECK(pwe_rmt_symbols_total(&symbols) == 4, "total %zu", pwe_rmt_symbols_total(&symbols));
+    uint32_t out[TEST_MAX_SYMBOLS];
+    TEST_CHECK(test_encode(&symbols, data, 64, out) == 4, "payload and TRST");
+    TEST_CHECK(out[2] == TEST_SYM1, "last payload symbol %08x", out[2]);
+    TEST_CHECK(out[3] == TEST_SYMBOL(500, 0, 500, 0), "TRST %08x", out[3]);
+
+    // 5ms: 100000 ticks
+    pwe_config_t config = s_ws2812;
+    config.TRST = 5000000;
+    test_init(&symbols, &config);
+    symbols.payload_bits = 0;
+    symbols.with_reset = true;
+    TEST_CHECK(pwe_rmt_symbols_total(&symbols) == 2, "long TRST total %zu", pwe_rmt_symbols_total(&symbols));
+    for (size_t chunk = 1; chunk <= 2; ++chunk) {
+        TEST_CHECK(test_encode(&symbols, data, chunk, out) == 2, "long TRST, chunk %zu", chunk);
+        TEST_CHECK(out[0] == TEST_SYMBOL(0x7fff, 0, 0x7fff, 0), "long TRST first %08x", out[0]);
+        TEST_CHECK(out[1] == TEST_SYMBOL(17233, 0, 17233, 0), "long TRST second %08x", out[1]);
+    }
+
+    // one tick left over: a duration of 0 would end the transmission early
+    symbols.reset_ticks = 2 * 0x7fff + 1;
+    TEST_CHECK(test_encode(&symbols, data, 64, out) == 2, "odd TRST");
+    TEST_CHECK(out[1] == TEST_SYMBOL(1, 0, 1, 0), "odd TRST second %08x", out[1]);
+
+    // without TRST requested, nothing follows the payload
+    symbols.with_reset = false;
+    symbols.payload_bits = 8;
+    TEST_CHECK(pwe_rmt_symbols_total(&symbols) == 8, "no TRST total %zu", pwe_rmt_symbols_total(&symbols));
+}
+
+static void test_done(void)
+{
+    static const uint8_t data[] = { 0x00 };
+    pwe_rmt_symbols_t symbols;
+    test_init(&symbols, &s_ws2812);
+    symbols.payload_bits = 8;
+    uint32_t out[TEST_MAX_SYMBOLS];
+    bool done = true;
+    TEST_CHECK(pwe_rmt_symbols_encode(&symbols, data, 0, 0, out, &done) == 0 && !done, "no room");
+    TEST_CHECK(pwe_rmt_symbols_encode(&symbols, data, 0, 5, out, &done) == 5 && !done, "first part");
+    TEST_CHECK(pwe_rmt_symbols_encode(&symbols, data, 5, 5, out, &done) == 3 && done, "last part");
+    TEST_CHECK(pwe_rmt_symbols_encode(&symbols, data, 8, 5, out, &done) == 0 && done, "after the end");
+}
+
+int main(void)
+{
+    test_bit_symbols();
+    test_payload();
+    test_byte_lut();
+    test_reset();
+    test_done();
+    return TEST_RESULT();
+}
@@ -0,0 +1,93 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+/*
+ * Decoding of waveforms recorded by the simulated backend, include after host_test.h:
+ *
+ *     uint32_t frame_num = test_sim_decode(pwe, &conf, false, bits, max_bits, frames, max_frames);
+ *
+ * Pulses must have the widths of the configuration exactly (sim resolution 0), a bit being 1 if its pulse is T1H
+ * long. Frames are told apart by the line idling for TRST at least after the low time of the last bit.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include "pwe.h"
+#include "pwe_io_sim.h"
+
+typedef struct {
+    uint64_t start_ns;      // first rising edge
+    uint32_t first_bit;     // index in decoded bits
+    uint32_t bits;
+} test_sim_frame_t;
+
+/**
+ * @brief Decode recorded edges back into bits, one uint8_t per bit, malformed waveform being reported as failed check
+ *
+ * @return number of frames decoded, 0 on a malformed waveform
+ */
+static inline uint32_t test_sim_decode(pwe_handle_t pwe, const pwe_config_t *conf, bool invert, uint8_t *bits,
+                                       uint32_t max_bits, test_sim_frame_t *frames, uint32_t max_frames)
+{
+    const pwe_sim_edge_t *edges = NULL;
+    uint32_t num = 0;
+    uint32_t dropped = 0;
+    const uint8_t active = invert ? 0 : 1;
+    if (pwe_sim_get_edges(pwe, &edges, &num, &dropped) != ESP_OK) {
+        TEST_CHECK(false, "no edges");
+        return 0;
+    }
+    TEST_CHECK(dropped == 0 && num % 2 == 0 && num / 2 <= max_bits, "%u edges, %u dropped", num, dropped);
+    if (dropped != 0 || num % 2 != 0 || num / 2 > max_bits) {
+        return 0;
+    }
+    uint32_t frame_num = 0;
+    for (uint32_t i = 0; i < num / 2; ++i) {
+        const pwe_sim_edge_t *rise = &edges[2 * i];
+        const pwe_sim_edge_t *fall = &edges[2 * i + 1];
+        const uint64_t high = fall->time_ns - rise->time_ns;
+        const bool ok = rise->level == active && fall->level != active && (high == conf->T1H || high == conf->T0H);
+        TEST_CHECK(ok, "bit %u: levels %u %u, high %" PRIu64 "ns", i, rise->level, fall->level, high);
+        if (!ok) {
+            return 0;
+        }
+        bits[i] = high == conf->T1H;
+        if (i != 0) {
+            const uint64_t low = rise->time_ns - edges[2 * i - 1].time_ns;
+            const uint64_t bit_low = bits[i - 1] ? conf->T1L : conf->T0L;
+            if (low == bit_low) {
+                ++frames[frame_num - 1].bits;
+                continue;
+            }
+            TEST_CHECK(low >= bit_low + conf->TRST, "bit %u: line idle for %" PRIu64 "ns, below %" PRIu64 "ns", i, low,
+                       bit_low + conf->TRST);
+        }
+        TEST_CHECK(frame_num < max_frames, "more than %u frames", max_frames);
+        if (frame_num >= max_frames) {
+            return 0;
+        }
+        frames[frame_num].start_ns = rise->time_ns;
+        frames[frame_num].first_bit = i;
+        frames[frame_num].bits = 1;
+        ++frame_num;
+    }
+    return frame_num;
+}
+
+/**
+ * @brief Pack decoded bits MSB first
+ */
+static inline uint32_t test_sim_bits_value(const uint8_t *bits, uint32_t num)
+{
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < num; ++i) {
+        value = (value << 1) | bits[i];
+    }
+    return value;
+}
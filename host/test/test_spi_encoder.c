@@ -0,0 +1,130 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * SPI backend against the bit by bit encoder it replaced: random payloads of any bit length, with and without byte
+ * table, and in place updates of random byte ranges of a frame.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "pwe.h"
+#include "pwe_io_spi.h"
+#include "pwe_timing.h"
+#include "led_strip_pwe.h"
+#include "dshot.h"
+#include "host_test.h"
+#include "pwe_reference.h"
+
+#define TEST_MAX_BITS       (24 * 64)
+#define TEST_ROUNDS         200
+
+typedef struct {
+    const char *name;
+    pwe_config_t config;
+    uint32_t clock_speed_hz;    // 0 to let the backend pick the clock
+} test_preset_t;
+
+static const test_preset_t s_presets[] = {
+    { "WS2812", PWE_WS2812_CONFIG, 0 },
+    { "SK6812", PWE_SK6812_CONFIG, 0 },
+    { "WS2812@4MHz", PWE_WS2812_CONFIG, 4000000 },
+    { "DShot150", PWE_DSHOT150_CONFIG, 0 },
+    { "DShot300", PWE_DSHOT300_CONFIG, 0 },
+    { "DShot600", PWE_DSHOT600_CONFIG, 0 },
+    { "DShot1200", PWE_DSHOT1200_CONFIG, 0 },
+};
+
+static uint8_t s_frame[TEST_MAX_BITS / 8];
+static uint8_t s_mapped[TEST_MAX_BITS / 8];
+static uint8_t s_expected[TEST_MAX_BITS * PWE_IO_SPI_MAX_SLOTS_PER_BIT / 8 + 2];
+static uint8_t s_lut[256];
+
+/**
+ * @brief Compare the outgoing buffer with the reference encoding of the bytes in s_mapped
+ */
+static void test_compare(const test_preset_t *preset, pwe_handle_t pwe, const pwe_timing_t *timing, uint32_t len,
+                         uint32_t out_len, const char *what)
+{
+    const uint8_t *samples = NULL;
+    uint32_t sample_hz = 0;
+    TEST_CHECK(pwe_spi_get_outgoing_buffer(pwe, &samples, &sample_hz) == ESP_OK, "%s", preset->name);
+    const uint32_t expected_len = pwe_ref_spi_encode(timing, s_mapped, len, s_expected, sizeof(s_expected));
+    TEST_CHECK(out_len == expected_len, "%s %s: %u bits, %u slots instead of %u", preset->name, what, len, out_len,
+               expected_len);
+    const size_t bytes = (expected_len + 7) / 8;
+    size_t diff = 0;
+    while (diff < bytes && samples[diff] == s_expected[diff]) {
+        ++diff;
+    }
+    TEST_CHECK(diff == bytes, "%s %s: %u bits, byte %zu is 0x%02x instead of 0x%02x", preset->name, what, len, diff,
+               diff < bytes ? samples[diff] : 0, diff < bytes ? s_expected[diff] : 0);
+}
+
+static void test_preset(const test_preset_t *preset, uint32_t seed)
+{
+    const pwe_io_spi_config_t spi_conf = {
+        .gpio = 18,
+        .spi_bus = SPI2_HOST,
+        .clock_speed_hz = preset->clock_speed_hz,
+    };
+    pwe_handle_t pwe = NULL;
+    TEST_CHECK(pwe_new_spi_backend(&preset->config, &spi_conf, TEST_MAX_BITS, &pwe) == ESP_OK, "%s", preset->name);
+    if (pwe == NULL) {
+        return;
+    }
+    pwe_timing_t timing;
+    TEST_CHECK(pwe_get_timing(pwe, &timing) == ESP_OK, "%s", preset->name);
+    // the old encoder handles a bit as long as it fits into 16 slots from any position in a byte
+    TEST_CHECK(timing.slots_per_bit <= 9, "%s: %u slots per bit", preset->name, timing.slots_per_bit);
+
+    for (uint32_t round = 0; round < TEST_ROUNDS; ++round) {
+        const uint32_t len = 1 + test_rand(&seed) % TEST_MAX_BITS;
+        for (uint32_t i = 0; i < sizeof(s_frame); ++i) {
+            s_frame[i] = test_rand(&seed);
+        }
+        const bool use_lut = round % 2;
+        for (uint32_t i = 0; i < 256; ++i) {
+            s_lut[i] = (i * 7 + round) & 0xff;
+        }
+        pwe_set_byte_lut(pwe, use_lut ? s_lut : NULL);
+        for (uint32_t i = 0; i < sizeof(s_frame); ++i) {
+            s_mapped[i] = use_lut ? s_lut[s_frame[i]] : s_frame[i];
+        }
+        uint32_t out_len = 0;
+        TEST_CHECK(pwe_io_convert_buffer(pwe, s_frame, len, &out_len) == ESP_OK, "%s", preset->name);
+        test_compare(preset, pwe, &timing, len, out_len, use_lut ? "convert_buffer with lut" : "convert_buffer");
+    }
+    pwe_set_byte_lut(pwe, NULL);
+
+    if (timing.t1h + timing.t1l == timing.t0h + timing.t0l) {
+        // bits sit at fixed positions, whole bytes can be updated in place anywhere in the frame
+        uint32_t out_len = 0;
+        TEST_CHECK(pwe_io_convert_buffer(pwe, s_frame, TEST_MAX_BITS, &out_len) == ESP_OK, "%s", preset->name);
+        for (uint32_t round = 0; round < TEST_ROUNDS; ++round) {
+            const uint32_t offset = test_rand(&seed) % sizeof(s_frame);
+            const uint32_t bytes = 1 + test_rand(&seed) % (sizeof(s_frame) - offset);
+            for (uint32_t i = offset; i < offset + bytes; ++i) {
+                s_frame[i] = test_rand(&seed);
+            }
+            TEST_CHECK(pwe_io_convert_range(pwe, &s_frame[offset], offset * 8, bytes * 8, &out_len) == ESP_OK, "%s",
+                       preset->name);
+            TEST_CHECK(out_len == (offset + bytes) * 8 * timing.slots_per_bit, "%s: range [%u, %u) gives %u slots",
+                       preset->name, offset, offset + bytes, out_len);
+            memcpy(s_mapped, s_frame, sizeof(s_frame));
+            test_compare(preset, pwe, &timing, TEST_MAX_BITS, TEST_MAX_BITS * timing.slots_per_bit, "convert_range");
+        }
+    }
+    pwe_delete_spi_backend(pwe);
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < sizeof(s_presets) / sizeof(s_presets[0]); ++i) {
+        test_preset(&s_presets[i], 0x5eed + i);
+    }
+    return TEST_RESULT();
+}
@@ -0,0 +1,82 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Bit transpose of the parallel backend against picking bits one by one: every lane count, lane lengths not being
+ * a multiple of 8, strides larger than the lanes, with and without byte table.
+ */
+
+#include <string.h>
+#include "pwe_transpose.h"
+#include "host_test.h"
+
+#define TEST_MAX_BYTES      16
+#define TEST_MAX_STRIDE     (TEST_MAX_BYTES + 5)
+#define TEST_ROUNDS         50
+
+static uint8_t s_lanes[PWE_TRANSPOSE_MAX_LANES * TEST_MAX_STRIDE];
+static uint8_t s_lut[256];
+
+static void test_8x8(uint32_t *seed)
+{
+    for (uint32_t stride = 1; stride <= 4; ++stride) {
+        for (int round = 0; round < TEST_ROUNDS; ++round) {
+            for (size_t i = 0; i < sizeof(s_lanes); ++i) {
+                s_lanes[i] = test_rand(seed);
+            }
+            uint8_t dst[8];
+            pwe_transpose_8x8(s_lanes, stride, dst);
+            for (int k = 0; k < 8; ++k) {
+                uint8_t expected = 0;
+                for (int i = 0; i < 8; ++i) {
+                    expected |= ((s_lanes[i * stride] >> (7 - k)) & 1) << i;
+                }
+                TEST_CHECK(dst[k] == expected, "stride %u row %d: %02x, expected %02x", stride, k, dst[k], expected);
+            }
+        }
+    }
+}
+
+static void test_lanes(uint32_t *seed, const uint8_t *lut)
+{
+    for (uint32_t lane_num = 1; lane_num <= PWE_TRANSPOSE_MAX_LANES; ++lane_num) {
+        for (int round = 0; round < TEST_ROUNDS; ++round) {
+            const uint32_t len = 1 + test_rand(seed) % (TEST_MAX_BYTES * 8);
+            const uint32_t stride = (len + 7) / 8 + test_rand(seed) % (TEST_MAX_STRIDE - TEST_MAX_BYTES + 1);
+            for (size_t i = 0; i < sizeof(s_lanes); ++i) {
+                s_lanes[i] = test_rand(seed);
+            }
+            uint16_t masks[TEST_MAX_BYTES * 8 + 1];
+            masks[len] = 0x5a5a;
+            pwe_transpose_lanes(s_lanes, stride, lane_num, len, lut, masks);
+            int mismatches = 0;
+            for (uint32_t k = 0; k < len; ++k) {
+                uint16_t expected = 0;
+                for (uint32_t i = 0; i < lane_num; ++i) {
+                    uint8_t v = s_lanes[i * stride + k / 8];
+                    v = lut ? lut[v] : v;
+                    expected |= ((v >> (7 - k % 8)) & 1) << i;
+                }
+                mismatches += masks[k] != expected;
+            }
+            TEST_CHECK(mismatches == 0, "%u lanes of %u bits, stride %u%s: %d masks differ", lane_num, len, stride,
+                       lut ? ", table" : "", mismatches);
+            TEST_CHECK(masks[len] == 0x5a5a, "%u lanes of %u bits: mask past the end written", lane_num, len);
+        }
+    }
+}
+
+int main(void)
+{
+    uint32_t seed = 1;
+    for (int i = 0; i < 256; ++i) {
+        s_lut[i] = ~i;
+    }
+    test_8x8(&seed);
+    test_lanes(&seed, NULL);
+    test_lanes(&seed, s_lut);
+    return TEST_RESULT();
+}
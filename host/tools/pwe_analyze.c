@@ -0,0 +1,211 @@
+/*
+ * SPDX-FileCopyrightText: SalimTerryLi <lhf2613@gmail.com>
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Encode a batch with SPI and RMT backends over a range of clocks, decode the outgoing buffers back with the analyzer
+ * and report pulse width errors.
+ *
+ * Usage: pwe_analyze [preset] [led_num] [min_margin_ns]
+ *
+ * RMT TX backend is covered through its symbol encoder at the resolution it would pick.
+ *
+ * One JSON object per line on stdout for every clock the backend accepts, then a last line recommending the fastest
+ * SPI clock which decodes without error and keeps at least min_margin_ns away from every TxX_ACC.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <inttypes.h>
+#include "esp_err.h"
+#include "pwe.h"
+#include "pwe_analyzer.h"
+#include "pwe_io_rmt.h"
+#include "pwe_io_spi.h"
+#include "pwe_rmt_symbols.h"
+#include "led_strip_pwe.h"
+#include "dshot.h"
+
+#define ANALYZE_SPI_MIN_HZ      100000
+#define ANALYZE_RMT_MAX_DIV     128
+#define ANALYZE_BIN_NS          10
+#define ANALYZE_SYMBOLS_CHUNK   (SOC_RMT_MEM_WORDS_PER_CHANNEL / 2)
+
+typedef struct {
+    const char *name;
+    pwe_config_t config;
+    bool led;
+} analyze_preset_t;
+
+static const analyze_preset_t s_presets[] = {
+    { "WS2812", PWE_WS2812_CONFIG, true },
+    { "SK6812", PWE_SK6812_CONFIG, true },
+    { "DShot150", PWE_DSHOT150_CONFIG, false },
+    { "DShot300", PWE_DSHOT300_CONFIG, false },
+    { "DShot600", PWE_DSHOT600_CONFIG, false },
+    { "DShot1200", PWE_DSHOT1200_CONFIG, false },
+};
+
+static const char *s_pulse_names[PWE_ANALYZER_PULSE_MAX] = {
+    [PWE_ANALYZER_T0H] = "T0H",
+    [PWE_ANALYZER_T0L] = "T0L",
+    [PWE_ANALYZER_T1H] = "T1H",
+    [PWE_ANALYZER_T1L] = "T1L",
+};
+
+static void analyze_print(const char *backend, uint32_t clock_hz, uint32_t divider, uint32_t samples,
+                          const pwe_config_t *config, const pwe_analyzer_report_t *report)
+{
+    printf("{\"backend\":\"%s\",\"clock_hz\":%" PRIu32 ",\"divider\":%" PRIu32 ",\"samples\":%" PRIu32 ","
+           "\"bits\":%" PRIu32 ",\"mismatches\":%" PRIu32 ",\"duration_ns\":%" PRIu64 ",\"bitrate\":%" PRIu32 ","
+           "\"margin_ns\":%" PRId32 ",\"bin_ns\":%" PRIu32 ",\"pulse\":{",
+           backend, clock_hz, divider, samples, report->bits, report->mismatches, report->duration_ns,
+           report->bitrate, pwe_analyzer_margin_ns(config, report), report->bin_ns);
+    for (int i = 0; i < PWE_ANALYZER_PULSE_MAX; ++i) {
+        const pwe_analyzer_hist_t *hist = &report->pulse[i];
+        printf("%s\"%s\":{\"count\":%" PRIu32 ",\"out_of_range\":%" PRIu32 ",\"min_ns\":%" PRId32 ",\"max_ns\":%" PRId32
+               ",\"mean_ns\":%.2f,\"hist\":[", i ? "," : "", s_pulse_names[i], hist->count, hist->out_of_range,
+               hist->min_error_ns, hist->max_error_ns, hist->count ? (double)hist->sum_error_ns / hist->count : 0.0);
+        for (int b = 0; b < PWE_ANALYZER_HIST_BINS; ++b) {
+            printf("%s%" PRIu32, b ? "," : "", hist->bins[b]);
+        }
+        printf("]}");
+    }
+    printf("}}\n");
+}
+
+/**
+ * @return true if the clock is accepted by the backend and the batch decodes back without error
+ */
+static bool analyze_spi(const pwe_config_t *config, uint32_t clock_hz, uint32_t divider, const uint8_t *data,
+                        uint32_t bits, pwe_analyzer_report_t *report)
+{
+    pwe_io_spi_config_t spi_config = {
+        .gpio = 18,
+        .spi_bus = SPI2_HOST,
+        .clock_speed_hz = clock_hz,
+    };
+    pwe_handle_t pwe = NULL;
+    if (pwe_new_spi_backend(config, &spi_config, bits, &pwe) != ESP_OK) {
+        return false;
+    }
+    uint32_t samples_num = 0;
+    const uint8_t *samples = NULL;
+    uint32_t sample_hz = 0;
+    ESP_ERROR_CHECK(pwe_io_convert_buffer(pwe, data, bits, &samples_num));
+    ESP_ERROR_CHECK(pwe_spi_get_outgoing_buffer(pwe, &samples, &sample_hz));
+    ESP_ERROR_CHECK(pwe_analyze_samples(config, samples, samples_num, sample_hz, data, bits, ANALYZE_BIN_NS, report));
+    analyze_print("spi", sample_hz, divider, samples_num, config, report);
+    pwe_delete_spi_backend(pwe);
+    return report->mismatches == 0;
+}
+
+static void analyze_rmt(const pwe_config_t *config, uint32_t clk_div, const uint8_t *data, uint32_t bits)
+{
+    rmt_config_t rmt_config = RMT_DEFAULT_CONFIG_TX(18, RMT_CHANNEL_0);
+    rmt_config.clk_div = clk_div;
+    pwe_handle_t pwe = NULL;
+    if (pwe_new_rmt_backend(config, &rmt_config, bits, &pwe) != ESP_OK) {
+        return;
+    }
+    // a divider out of TxX_ACC is replaced by the backend, which is reported by the row of that divider
+    pwe_timing_t timing;
+    ESP_ERROR_CHECK(pwe_get_timing(pwe, &timing));
+    if (timing.div != clk_div) {
+        pwe_delete_rmt_backend(pwe);
+        return;
+    }
+    uint32_t items_num = 0;
+    const rmt_item32_t *items = NULL;
+    uint32_t tick_hz = 0;
+    pwe_analyzer_report_t report;
+    ESP_ERROR_CHECK(pwe_io_convert_buffer(pwe, data, bits, &items_num));
+    ESP_ERROR_CHECK(pwe_rmt_get_outgoing_buffer(pwe, &items, &tick_hz));
+    ESP_ERROR_CHECK(pwe_analyze_items(config, &items->val, items_num, tick_hz, data, bits, ANALYZE_BIN_NS, &report));
+    analyze_print("rmt", tick_hz, clk_div, items_num, config, &report);
+    pwe_delete_rmt_backend(pwe);
+}
+
+/**
+ * @brief Encoder of RMT TX backend at the resolution it would pick, fed half of RMT memory at a time as from its ISR
+ */
+static void analyze_rmt_symbols(const pwe_config_t *config, const uint8_t *data, uint32_t bits)
+{
+    pwe_rmt_symbols_t symbols;
+    pwe_timing_t timing;
+    if (pwe_rmt_symbols_init(&symbols, config, APB_CLK_FREQ, 0, &timing) != ESP_OK) {
+        return;
+    }
+    symbols.payload_bits = bits;
+    symbols.with_reset = true;
+    const size_t total = pwe_rmt_symbols_total(&symbols);
+    uint32_t *items = malloc(total * sizeof(uint32_t));
+    ESP_ERROR_CHECK(items == NULL ? ESP_ERR_NO_MEM : ESP_OK);
+    size_t written = 0;
+    bool done = false;
+    while (!done) {
+        const size_t room = total - written < ANALYZE_SYMBOLS_CHUNK ? total - written : ANALYZE_SYMBOLS_CHUNK;
+        written += pwe_rmt_symbols_encode(&symbols, data, written, room, items + written, &done);
+    }
+    // TRST symbols following the payload are not decoded
+    pwe_analyzer_report_t report;
+    ESP_ERROR_CHECK(pwe_analyze_items(config, items, bits, timing.clock_hz, data, bits, ANALYZE_BIN_NS, &report));
+    analyze_print("rmt_tx", timing.clock_hz, timing.div, written, config, &report);
+    free(items);
+}
+
+int main(int argc, char **argv)
+{
+    const char *preset_name = argc > 1 ? argv[1] : "WS2812";
+    const uint32_t led_num = argc > 2 ? strtoul(argv[2], NULL, 0) : 100;
+    const int32_t min_margin_ns = argc > 3 ? strtol(argv[3], NULL, 0) : 0;
+    const analyze_preset_t *preset = NULL;
+    for (size_t i = 0; i < sizeof(s_presets) / sizeof(s_presets[0]); ++i) {
+        if (strcasecmp(s_presets[i].name, preset_name) == 0) {
+            preset = &s_presets[i];
+        }
+    }
+    if (preset == NULL || led_num == 0) {
+        fprintf(stderr, "usage: %s [WS2812|SK6812|DShot150|DShot300|DShot600|DShot1200] [led_num] [min_margin_ns]\n", argv[0]);
+        return 1;
+    }
+    // LED strips send 3 bytes per LED, DShot one 16 bits frame
+    const uint32_t bits = preset->led ? led_num * 3 * 8 : 16;
+    uint8_t *data = malloc(bits / 8);
+    if (data == NULL) {
+        return 1;
+    }
+    srand(1);
+    for (uint32_t i = 0; i < bits / 8; ++i) {
+        data[i] = rand();
+    }
+
+    pwe_analyzer_report_t report;
+    uint32_t recommended_hz = 0;
+    int32_t recommended_margin = 0;
+    // SPI clock is APB divided by an integer, fastest first
+    for (uint32_t divider = 1; APB_CLK_FREQ / divider >= ANALYZE_SPI_MIN_HZ; ++divider) {
+        const uint32_t clock_hz = APB_CLK_FREQ / divider;
+        if (analyze_spi(&preset->config, clock_hz, divider, data, bits, &report)) {
+            const int32_t margin = pwe_analyzer_margin_ns(&preset->config, &report);
+            if (recommended_hz == 0 && margin >= min_margin_ns) {
+                recommended_hz = clock_hz;
+                recommended_margin = margin;
+            }
+        }
+    }
+    // clock picked by the backend itself
+    analyze_spi(&preset->config, 0, 0, data, bits, &report);
+    for (uint32_t clk_div = 1; clk_div <= ANALYZE_RMT_MAX_DIV; clk_div *= 2) {
+        analyze_rmt(&preset->config, clk_div, data, bits);
+    }
+    analyze_rmt_symbols(&preset->config, data, bits);
+    printf("{\"preset\":\"%s\",\"bits\":%" PRIu32 ",\"min_margin_ns\":%" PRId32 ",\"recommended_spi_clock_hz\":%" PRIu32
+           ",\"margin_ns\":%" PRId32 "}\n", preset->name, bits, min_margin_ns, recommended_hz, recommended_margin);
+    free(data);
+    return recommended_hz ? 0 : 2;
+}